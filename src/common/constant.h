@@ -67,6 +67,11 @@ namespace Constant
     static const QString KEY_HEIGHT = "height";
     static const QString KEY_WIDTH = "width";
     static const QString KEY_FPS = "fps";
+    static const QString KEY_BITRATE = "bitrate";
+    static const QString KEY_CONTROL_MAX_WIDTH = "control_max_width"; // 控制端可显示的最大区域
+    static const QString KEY_CONTROL_MAX_HEIGHT = "control_max_height";
+    static const QString KEY_VIDEO_CODECS = "video_codecs"; // 控制端能解码的视频格式，按偏好排序
+    static const QString KEY_TEXT_TILES = "text_tiles"; // 控制端支持的无损文字块压缩方式，按偏好排序
     static const QString KEY_LABEL_NAME = "label_name";
     static const QString KEY_IS_ONLY_FILE = "is_only_file";
     static const QString KEY_ONLY_RELAY = "only_relay";
@@ -107,6 +112,7 @@ namespace Constant
     static const QString TYPE_VIDEO_MSID = "video_stream1_airan";
     static const QString TYPE_AUDIO = "audio_airan";
     static const QString TYPE_INPUT = "input_airan"; // 键盘鼠标输入通道
+    static const QString TYPE_TEXT_TILES = "text_tiles_airan"; // 无损文字块通道
     static const QString TYPE_DIR = "dir";
     static const QString TYPE_CONNECT = "connect";
     static const QString TYPE_CONNECTED = "connected";
@@ -119,6 +125,7 @@ namespace Constant
     // 控制消息类型和附加字段
     static const QString TYPE_KEYBOARD = "keyboard";
     static const QString TYPE_MOUSE = "mouse";
+    static const QString TYPE_VIDEO_CONFIG = "video_config"; // 控制端请求调整视频分辨率/帧率/码率
 
     static const QString KEY_KEY = "key";
     static const QString KEY_DWFLAGS = "dwFlags";
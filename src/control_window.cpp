@@ -19,16 +19,19 @@
 #include <QMouseEvent>
 #include <QVBoxLayout>
 #include <QSettings>
+#include <QWindow>
 
 ControlWindow::ControlWindow(QString remoteId, QString remotePwdMd5, WsCli *_ws_cli,
                              bool adaptiveResolution, QWidget *parent)
     : QMainWindow(parent), isReceivedImg(false), windowSizeAdjusted(false),
       remote_id(remoteId), remote_pwd_md5(remotePwdMd5), m_rtc_ctl(remoteId, remotePwdMd5, false, adaptiveResolution), m_ws(_ws_cli),
-      m_adaptiveResolution(adaptiveResolution), m_floatingToolbar(nullptr), m_draggingToolbar(false)
+      m_adaptiveResolution(adaptiveResolution), m_floatingToolbar(nullptr), m_draggingToolbar(false),
+      m_watchedScreen(nullptr)
 {
     initUI();
     initCLI();
     createFloatingToolbar();
+    watchDisplayChanges();
     // 初始化WebRtcCtl
     emit initRtcCtl();
 }
@@ -80,17 +83,15 @@ void ControlWindow::initUI()
     // 设置初始窗口大小（将在收到第一帧视频时自动调整）
     resize(800, 600);
 
-    // 使用传统QLabel渲染
-    label.setText("正在连接...");
-    label.setAlignment(Qt::AlignCenter);
-    label.setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
-    // 设置文字颜色为白色，在黑色背景上可见
-    label.setStyleSheet("QLabel { background: black; border: none; margin: 0px; padding: 0px; color: white; font-size: 16px; }");
+    // 视频控件自己绘制画面，不经过QLabel和样式表
+    m_videoWidget.setPlaceholderText("正在连接...");
+    m_videoWidget.setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    m_videoWidget.setFixedSize(size());
 
-    // 将QLabel设置为滚动区域的子部件
-    scrollArea.setWidget(&label);
+    // 将视频控件设置为滚动区域的子部件
+    scrollArea.setWidget(&m_videoWidget);
 
-    LOG_INFO("Initialized with QLabel video rendering, window size will auto-adjust to video");
+    LOG_INFO("Initialized with VideoWidget rendering, window size will auto-adjust to video");
 
     // 禁用滚动条作为默认设置（当视频适合屏幕时）
     scrollArea.setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
@@ -152,11 +153,6 @@ void ControlWindow::initUI()
     scrollArea.setLineWidth(0);
     scrollArea.setMidLineWidth(0);
 
-    // 确保label也没有边框和内边距
-    label.setContentsMargins(0, 0, 0, 0);
-    // 注释掉原来的样式设置，因为上面已经设置了包含颜色的完整样式
-    // label.setStyleSheet("QLabel { background: black; border: none; margin: 0px; padding: 0px; }");
-
     this->setCentralWidget(&scrollArea);
 
     // 确保主窗口也没有额外的边距
@@ -175,7 +171,12 @@ void ControlWindow::initCLI()
     connect(this, &ControlWindow::initRtcCtl, &m_rtc_ctl, &WebRtcCtl::init);
     connect(this, &ControlWindow::sendMsg2InputChannel, &m_rtc_ctl, &WebRtcCtl::inputChannelSendMsg);
 
-    connect(&m_rtc_ctl, &WebRtcCtl::videoFrameDecoded, this, &ControlWindow::updateImg);
+    // 解码出的帧只替换待显示的一帧，跟随刷新的平台上等窗口的UpdateRequest再显示，绘制时统计间隔
+    connect(&m_rtc_ctl, &WebRtcCtl::videoFrameDecoded, &m_presenter, &PresentationScheduler::submit,
+            Qt::DirectConnection);
+    connect(&m_presenter, &PresentationScheduler::present, this, &ControlWindow::updateImg);
+    connect(&m_videoWidget, &VideoWidget::framePainted, &m_presenter, &PresentationScheduler::framePainted);
+    connect(this, &ControlWindow::sendVideoConfig, &m_rtc_ctl, &WebRtcCtl::sendVideoConfig);
 
     m_rtc_ctl_thread.setObjectName("ControlWindow-WebRtcCtlThread");
     m_rtc_ctl.moveToThread(&m_rtc_ctl_thread);
@@ -280,6 +281,71 @@ void ControlWindow::wheelEvent(QWheelEvent *event)
     emit sendMsg2InputChannel(msgStr);
 }
 
+void ControlWindow::watchDisplayChanges()
+{
+    // 显示调度在支持的平台上由顶层窗口的UpdateRequest驱动；顶层窗口需要先创建原生窗口才能拿到windowHandle
+    winId();
+    m_presenter.setWindow(windowHandle());
+
+    if (!m_adaptiveResolution)
+    {
+        return;
+    }
+
+    // 屏幕变化往往连续触发多次，合并后只发送一次
+    m_videoConfigTimer.setSingleShot(true);
+    m_videoConfigTimer.setInterval(500);
+    connect(&m_videoConfigTimer, &QTimer::timeout, this, &ControlWindow::requestVideoConfig);
+
+    // CONNECT消息里已经带了主屏幕的可显示区域
+    m_lastMaxDisplayArea = WebRtcCtl::maxDisplayArea(QApplication::primaryScreen());
+
+    if (windowHandle())
+    {
+        connect(windowHandle(), &QWindow::screenChanged, this, &ControlWindow::onScreenChanged);
+        onScreenChanged(windowHandle()->screen());
+    }
+}
+
+void ControlWindow::onScreenChanged(QScreen *screen)
+{
+    if (m_watchedScreen)
+    {
+        disconnect(m_watchedScreen, &QScreen::availableGeometryChanged, this, nullptr);
+    }
+    m_watchedScreen = screen;
+    if (!screen)
+    {
+        return;
+    }
+
+    connect(screen, &QScreen::availableGeometryChanged, this, [this]()
+            { m_videoConfigTimer.start(); });
+    // 窗口被拖到另一块屏幕上时，可显示区域可能变化
+    if (isReceivedImg)
+    {
+        m_videoConfigTimer.start();
+    }
+}
+
+void ControlWindow::requestVideoConfig()
+{
+    if (!isReceivedImg)
+    {
+        return;
+    }
+
+    QSize maxArea = WebRtcCtl::maxDisplayArea(m_watchedScreen);
+    if (maxArea == m_lastMaxDisplayArea)
+    {
+        return;
+    }
+    m_lastMaxDisplayArea = maxArea;
+
+    LOG_INFO("Display area changed to {}x{}, requesting new video resolution", maxArea.width(), maxArea.height());
+    emit sendVideoConfig(maxArea.width(), maxArea.height(), ConfigUtil->fps, 0);
+}
+
 void ControlWindow::resizeEvent(QResizeEvent *event)
 {
     // 如果窗口大小已经根据视频调整过，阻止用户手动调整
@@ -298,45 +364,8 @@ void ControlWindow::resizeEvent(QResizeEvent *event)
 
 QPointF ControlWindow::getNormPoint(const QPoint &pos)
 {
-    // 获取鼠标在label内的坐标
-    QPointF labelPos = pos - label.pos(); // 如果label不是顶层控件，需要正确计算相对位置
-
-    QPointF res;
-    // 获取label和pixmap的尺寸
-    QSize labelSize = label.size();
-    QSize pixmapSize = label.pixmap()->size();
-
-    // 计算实际显示区域（保持宽高比）
-    QSize scaledSize = pixmapSize.scaled(labelSize, Qt::KeepAspectRatio);
-    QPointF offset(
-        (labelSize.width() - scaledSize.width()) / 2.0,
-        (labelSize.height() - scaledSize.height()) / 2.0);
-
-    // 检查点击是否在有效区域内
-    if (labelPos.x() < offset.x() ||
-        labelPos.y() < offset.y() ||
-        labelPos.x() > (offset.x() + scaledSize.width()) ||
-        labelPos.y() > (offset.y() + scaledSize.height()))
-    {
-        // 点击在边框区域，不处理
-        return res;
-    }
-
-    // 转换为pixmap坐标
-    qreal scaleFactor = qMin(
-        (qreal)scaledSize.width() / pixmapSize.width(),
-        (qreal)scaledSize.height() / pixmapSize.height());
-    QPointF pixmapPos(
-        (labelPos.x() - offset.x()) / scaleFactor,
-        (labelPos.y() - offset.y()) / scaleFactor);
-
-    // 归一化坐标
-    qreal x_n = pixmapPos.x() / pixmapSize.width();
-    qreal y_n = pixmapPos.y() / pixmapSize.height();
-
-    res.setX(x_n);
-    res.setY(y_n);
-    return res;
+    // pos为本窗口坐标，视频控件在滚动区域内，可能被滚动
+    return m_videoWidget.normalizedPos(m_videoWidget.mapFrom(this, pos));
 }
 
 void ControlWindow::updateImg(const QImage &img)
@@ -355,95 +384,9 @@ void ControlWindow::updateImg(const QImage &img)
         adjustWindowSizeToVideo(img.size());
     }
     m_windowSize = img.size(); // 更新窗口大小为视频尺寸
-    // 检查图像数据质量（可选的质量检测）
-    static int consecutiveBadFrames = 0;
-    bool imageQualityGood = true;
-
-    // 简单的图像质量检测：检查是否有足够的非零像素
-    if (img.depth() >= 24)
-    { // 确保是彩色图像
-        const uchar *bits = img.constBits();
-        int totalBytes = img.byteCount();
-        int nonZeroBytes = 0;
-
-        // 采样检查前1000字节
-        int checkBytes = qMin(1000, totalBytes);
-        for (int i = 0; i < checkBytes; i++)
-        {
-            if (bits[i] != 0)
-            {
-                nonZeroBytes++;
-            }
-        }
-
-        // 如果非零字节太少，可能是解码问题
-        if (nonZeroBytes < checkBytes / 20)
-        { // 少于5%的非零字节
-            imageQualityGood = false;
-            consecutiveBadFrames++;
-            LOG_WARN("Detected potentially corrupted frame: {}/{} non-zero bytes, consecutive bad frames: {}",
-                     nonZeroBytes, checkBytes, consecutiveBadFrames);
-        }
-        else
-        {
-            consecutiveBadFrames = 0; // 重置计数
-        }
-    }
-
-    // 如果连续收到太多质量差的帧，显示警告但仍然尝试显示
-    if (consecutiveBadFrames > 5)
-    {
-        // 显示连接质量警告，但不阻止显示
-        static bool warningShown = false;
-        if (!warningShown)
-        {
-            LOG_ERROR("Video quality appears poor, may need to check network connection");
-            warningShown = true;
-            // 可以在UI上显示警告文字，保持白色文字和黑色背景
-            label.setStyleSheet("QLabel { background: black; border: 2px solid red; margin: 0px; padding: 0px; color: white; font-size: 16px; }");
-        }
-    }
-    else if (consecutiveBadFrames == 0)
-    {
-        // 恢复正常样式，保持白色文字和黑色背景
-        label.setStyleSheet("QLabel { background: black; border: none; margin: 0px; padding: 0px; color: white; font-size: 16px; }");
-    }
-
-    // 确保图像格式一致，避免格式转换问题
-    QImage displayImg = img;
-    if (img.format() != QImage::Format_RGB888)
-    {
-        displayImg = img.convertToFormat(QImage::Format_RGB888);
-        LOG_DEBUG("Converted image format from {} to RGB888", static_cast<int>(img.format()));
-    }
-
-    // 使用Qt的优化转换，并设置合适的转换标志
-    QPixmap pixmap = QPixmap::fromImage(displayImg, Qt::ColorOnly);
-
-    // 检查转换结果
-    if (pixmap.isNull())
-    {
-        LOG_ERROR("Failed to convert QImage to QPixmap, image size: {}x{}, format: {}",
-                  displayImg.width(), displayImg.height(), static_cast<int>(displayImg.format()));
-        return;
-    }
 
-    // 更新标签尺寸和内容 - 优化渲染延迟
-    label.setFixedSize(displayImg.size());
-    label.setPixmap(pixmap);
-
-    // 优化重绘策略，减少延迟
-    label.update(); // 使用update()而不是repaint()，让Qt优化重绘时机
-
-    // 减少统计输出频率，降低日志开销
-    static int frameCount = 0;
-    frameCount++;
-    // if (frameCount % 300 == 0)
-    // { // 每300帧输出一次，减少日志开销
-    //     LOG_INFO("QLabel rendered frame #{}, size: {}x{}, quality check: {}",
-    //              frameCount, displayImg.width(), displayImg.height(),
-    //              imageQualityGood ? "good" : "poor");
-    // }
+    // 质量检测和绘制都在视频控件中，只重绘画面区域
+    m_videoWidget.setFrame(img);
 }
 
 void ControlWindow::adjustWindowSizeToVideo(const QSize &videoSize)
@@ -458,8 +401,8 @@ void ControlWindow::adjustWindowSizeToVideo(const QSize &videoSize)
     int titleBarHeight = style()->pixelMetric(QStyle::PM_TitleBarHeight);
     int maxContentWidth = screenGeometry.width();                    // 减去边框和滚动条的宽度
     int maxContentHeight = screenGeometry.height() - titleBarHeight; // 减去边框
-    // 设置label大小为原始视频大小（用于鼠标坐标计算）
-    label.setFixedSize(videoSize);
+    // 视频控件按原始视频大小显示，不缩放
+    m_videoWidget.setFixedSize(videoSize);
 
     // 设置滚动区域大小
     scrollArea.setFixedSize(videoSize);
@@ -727,18 +670,18 @@ void ControlWindow::mouseReleaseEvent(QMouseEvent *event)
 // 工具栏按钮槽函数实现
 void ControlWindow::onScreenshotClicked()
 {
-    if (!label.pixmap() || label.pixmap()->isNull())
+    if (!m_videoWidget.hasFrame())
     {
         LOG_WARN("No image available for screenshot");
         return;
     }
 
-    // 获取当前显示的图像
-    QPixmap screenshot = *label.pixmap();
+    // 深拷贝当前显示的图像，不占用解码器图像环
+    QImage screenshot = m_videoWidget.frame().copy();
 
     // 复制到系统剪切板
     QClipboard *clipboard = QApplication::clipboard();
-    clipboard->setPixmap(screenshot);
+    clipboard->setImage(screenshot);
 
     LOG_INFO("Screenshot copied to clipboard, size: {}x{}",
              screenshot.width(), screenshot.height());
@@ -5,7 +5,6 @@
 #include <QWheelEvent>
 #include <QScrollArea>
 #include <QTimer>
-#include <QLabel>
 #include <QPushButton>
 #include <QHBoxLayout>
 #include <QComboBox>
@@ -17,6 +16,8 @@
 #include <config_util.h>
 #include <webrtc_ctl.h>
 #include <ws_cli.h>
+#include "video_widget.h"
+#include "presentation_scheduler.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -43,6 +44,9 @@ public:
     void createFloatingToolbar();
     void updateToolbarPosition();
 
+    // 自适应分辨率：监听所在屏幕的可用区域变化，通知被控端调整编码分辨率
+    void watchDisplayChanges();
+
 protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -53,7 +57,9 @@ private:
     bool windowSizeAdjusted; // 标记窗口大小是否已经根据视频调整过
     QScrollArea scrollArea;
 
-    QLabel label;
+    VideoWidget m_videoWidget; // 视频画面，鼠标坐标也按它换算
+    // 解码线程直接提交帧，交给updateImg；须在m_rtc_ctl之后析构（解码线程先停止）
+    PresentationScheduler m_presenter;
 
     QString remote_id;
     QString remote_pwd_md5;
@@ -74,8 +80,14 @@ private:
     QPoint m_dragStartPosition;
     QPoint m_toolbarOffset;
     QSize m_windowSize; // 用于存储窗口大小
+
+    // 自适应分辨率
+    QScreen *m_watchedScreen;
+    QTimer m_videoConfigTimer;  // 合并短时间内的多次屏幕变化
+    QSize m_lastMaxDisplayArea; // 上次发送给被控端的可显示区域
 signals:
     void sendMsg2InputChannel(const rtc::message_variant &data);
+    void sendVideoConfig(int maxWidth, int maxHeight, int fps, int bitrate);
     void initRtcCtl();
 public slots:
     void updateImg(const QImage &img);
@@ -86,5 +98,7 @@ public slots:
     
 private slots:
     void adjustWindowSizeToVideo(const QSize &videoSize); // 根据视频尺寸调整窗口大小
+    void onScreenChanged(QScreen *screen);
+    void requestVideoConfig();
 };
 #endif // CONTROL_WINDOW_H
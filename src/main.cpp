@@ -6,6 +6,10 @@
 #include <QTranslator>
 #include <QAbstractSocket>
 #include "logger_manager.h"
+#include "encoded_frame.h"
+#include "media_buffer.h"
+#include "encoder_registry.h"
+#include "media_bench.h"
 
 /**
  * @brief registerCustomTypes 注册自定义对象，为了Qt信号槽可以作为形参使用
@@ -17,6 +21,8 @@ void registerCustomTypes()
     qRegisterMetaType<rtc::PeerConnection::State>("rtc::PeerConnection::State");
     qRegisterMetaType<rtc::message_variant>("rtc::message_variant");
     qRegisterMetaType<rtc::binary>("rtc::binary");
+    qRegisterMetaType<EncodedVideoFrame>("EncodedVideoFrame");
+    qRegisterMetaType<MediaBuffer>("MediaBuffer");
 }
 /**
  * @brief initLog   初始化日志组件
@@ -88,6 +94,13 @@ int main(int argc, char *argv[])
     QApplication::setOrganizationName("wxalh.com");
     QApplication::setApplicationName("airan");
     QApplication a(argc, argv);
+    // --bench：运行媒体管线基准测试后退出，不受禁止多开限制
+    if (MediaBench::requested(a.arguments()))
+    {
+        registerCustomTypes();
+        initLog();
+        return MediaBench::run(a.arguments());
+    }
     if (isRunning())
     {
         return 0;
@@ -104,6 +117,8 @@ int main(int argc, char *argv[])
     initLog();
 
     MainWindow w;
+    // 后台探测并测速可用的编码器（有缓存时只读取缓存），首次连接时无需再等待探测
+    EncoderCapabilityRegistry::instance().probeAsync();
     if (ConfigUtil->showUI)
     {
         w.show();
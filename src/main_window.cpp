@@ -295,10 +295,10 @@ void MainWindow::onWsCliRecvBinaryMsg(const QByteArray &message)
         int controlMaxWidth = -1; // 默认值-1表示不使用自适应分辨率
         int controlMaxHeight = -1;
 
-        if (object.contains("control_max_width") && object.contains("control_max_height"))
+        if (object.contains(Constant::KEY_CONTROL_MAX_WIDTH) && object.contains(Constant::KEY_CONTROL_MAX_HEIGHT))
         {
-            controlMaxWidth = JsonUtil::getInt(object, "control_max_width", 1920);
-            controlMaxHeight = JsonUtil::getInt(object, "control_max_height", 1080);
+            controlMaxWidth = JsonUtil::getInt(object, Constant::KEY_CONTROL_MAX_WIDTH, 1920);
+            controlMaxHeight = JsonUtil::getInt(object, Constant::KEY_CONTROL_MAX_HEIGHT, 1080);
             LOG_INFO("Received connection request with adaptive resolution - control max display area: {}x{}",
                      controlMaxWidth, controlMaxHeight);
         }
@@ -307,10 +307,23 @@ void MainWindow::onWsCliRecvBinaryMsg(const QByteArray &message)
             LOG_INFO("Received connection request without adaptive resolution - will use original resolution");
         }
 
+        // 控制端能解码的视频格式，旧版本控制端不带此字段
+        QStringList controlVideoCodecs;
+        for (const QJsonValue &codec : JsonUtil::getArray(object, Constant::KEY_VIDEO_CODECS))
+        {
+            controlVideoCodecs << codec.toString();
+        }
+        QStringList controlTextTiles;
+        for (const QJsonValue &compression : JsonUtil::getArray(object, Constant::KEY_TEXT_TILES))
+        {
+            controlTextTiles << compression.toString();
+        }
+
         QThread *m_rtc_cli_thread = new QThread();
         QString senderName = QString("WebRtcCli_%1_%2").arg(sender, isOnlyFile ? "file" : "desktop");
         m_rtc_cli_thread->setObjectName(senderName);
-        WebRtcCli *m_rtc_cli = new WebRtcCli(sender, fps, isOnlyFile, controlMaxWidth, controlMaxHeight);
+        WebRtcCli *m_rtc_cli = new WebRtcCli(sender, fps, isOnlyFile, controlMaxWidth, controlMaxHeight, controlVideoCodecs,
+                                             controlTextTiles);
 
         connect(&m_ws, &WsCli::onWsCliRecvBinaryMsg, m_rtc_cli, &WebRtcCli::onWsCliRecvBinaryMsg);
         connect(&m_ws, &WsCli::onWsCliRecvTextMsg, m_rtc_cli, &WebRtcCli::onWsCliRecvTextMsg);
@@ -0,0 +1,335 @@
+#include "color_convert.h"
+#include "color_convert_kernels.h"
+#include "logger_manager.h"
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__) && defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+namespace
+{
+    // 条带最少行数，太细的条带线程调度开销大于收益
+    constexpr int kMinSliceRows = 64;
+    constexpr int kMaxThreads = 4;
+
+    inline uint8_t clampByte(int v)
+    {
+        return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+
+    bool cpuHasSse41()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4] = {0};
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    bool cpuHasAvx2()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        // GCC的检测已经包含操作系统是否保存YMM寄存器
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4] = {0};
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    bool cpuHasNeon()
+    {
+#if defined(__aarch64__) || defined(_M_ARM64)
+        return true;
+#elif defined(__linux__) && defined(__arm__)
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+        return false;
+#endif
+    }
+
+    const ColorConvertKernels::KernelSet kScalarKernels = {"scalar", ColorConvertKernels::bgraToNv12RowsScalar,
+                                                           ColorConvertKernels::boxDownscaleRowScalar};
+
+    class SliceTask : public QRunnable
+    {
+    public:
+        explicit SliceTask(std::function<void()> fn) : m_fn(std::move(fn)) {}
+        void run() override { m_fn(); }
+
+    private:
+        std::function<void()> m_fn;
+    };
+}
+
+// ---------------- 标量参考实现 ----------------
+
+void ColorConvertKernels::bgraToNv12RowsScalar(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1,
+                                               uint8_t *uv, int width)
+{
+    for (int x = 0; x + 1 < width; x += 2)
+    {
+        const uint8_t *a = src0 + x * 4;
+        const uint8_t *b = src1 + x * 4;
+        y0[x] = clampByte(((25 * a[0] + 129 * a[1] + 66 * a[2] + 128) >> 8) + 16);
+        y0[x + 1] = clampByte(((25 * a[4] + 129 * a[5] + 66 * a[6] + 128) >> 8) + 16);
+        y1[x] = clampByte(((25 * b[0] + 129 * b[1] + 66 * b[2] + 128) >> 8) + 16);
+        y1[x + 1] = clampByte(((25 * b[4] + 129 * b[5] + 66 * b[6] + 128) >> 8) + 16);
+
+        // 色度取2x2块的均值
+        const int blue = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+        const int green = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+        const int red = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+        uv[x] = clampByte(((112 * blue - 74 * green - 38 * red + 128) >> 8) + 128);
+        uv[x + 1] = clampByte(((-18 * blue - 94 * green + 112 * red + 128) >> 8) + 128);
+    }
+}
+
+void ColorConvertKernels::boxDownscaleRowScalar(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth)
+{
+    // 先纵向再横向求(a+b+1)>>1，与SIMD的pavgb/vrhadd舍入一致
+    for (int x = 0; x < dstWidth; ++x)
+    {
+        const uint8_t *a = src0 + x * 8;
+        const uint8_t *b = src1 + x * 8;
+        for (int c = 0; c < 4; ++c)
+        {
+            const int left = (a[c] + b[c] + 1) >> 1;
+            const int right = (a[c + 4] + b[c + 4] + 1) >> 1;
+            dst[x * 4 + c] = static_cast<uint8_t>((left + right + 1) >> 1);
+        }
+    }
+}
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::scalarKernels()
+{
+    return &kScalarKernels;
+}
+
+// ---------------- ColorConverter ----------------
+
+ColorConverter::ColorConverter()
+    : m_kernels(bestKernels()), m_verifyInterval(0), m_frameCount(0)
+{
+    // 调用线程自己也处理一个条带
+    const int threads = qBound(1, QThread::idealThreadCount(), kMaxThreads);
+    m_pool.setMaxThreadCount(qMax(1, threads - 1));
+    m_scratch.resize(threads);
+    LOG_INFO("ColorConverter using {} kernels, {} slice threads", m_kernels->name, threads);
+}
+
+ColorConverter::~ColorConverter()
+{
+    m_pool.waitForDone();
+}
+
+const ColorConvertKernels::KernelSet *ColorConverter::bestKernels()
+{
+    const ColorConvertKernels::KernelSet *kernels = nullptr;
+    if ((kernels = ColorConvertKernels::avx2Kernels()) && cpuHasAvx2())
+    {
+        return kernels;
+    }
+    if ((kernels = ColorConvertKernels::sse41Kernels()) && cpuHasSse41())
+    {
+        return kernels;
+    }
+    if ((kernels = ColorConvertKernels::neonKernels()) && cpuHasNeon())
+    {
+        return kernels;
+    }
+    return ColorConvertKernels::scalarKernels();
+}
+
+const char *ColorConverter::kernelName() const
+{
+    return m_kernels->name;
+}
+
+int ColorConverter::downscaleFactor(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    if (dstWidth <= 0 || dstHeight <= 0 || (dstWidth & 1) || (dstHeight & 1))
+    {
+        return 0;
+    }
+    if (srcWidth == dstWidth && srcHeight == dstHeight)
+    {
+        return 1;
+    }
+    if (srcWidth / 2 == dstWidth && srcHeight / 2 == dstHeight)
+    {
+        return 2;
+    }
+    return 0;
+}
+
+bool ColorConverter::convertToNv12(const uint8_t *bgra, int srcWidth, int srcHeight, int srcStride, int downscale,
+                                   uint8_t *dstY, int dstYStride, uint8_t *dstUV, int dstUVStride)
+{
+    if (downscale != 1 && downscale != 2)
+    {
+        return false;
+    }
+    const int dstWidth = srcWidth / downscale;
+    const int dstHeight = srcHeight / downscale;
+    if (downscaleFactor(srcWidth, srcHeight, dstWidth, dstHeight) != downscale)
+    {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    const Job job = {bgra, srcStride, dstWidth, downscale, dstY, dstYStride, dstUV, dstUVStride};
+
+    // 按偶数行切分条带
+    const int maxSlices = static_cast<int>(m_scratch.size());
+    const int slices = qBound(1, dstHeight / kMinSliceRows, maxSlices);
+    const int rowsPerSlice = (((dstHeight + slices - 1) / slices) + 1) & ~1;
+
+    QSemaphore done;
+    int started = 0;
+    for (int i = 1; i < slices; ++i)
+    {
+        const int first = i * rowsPerSlice;
+        const int last = std::min(dstHeight, first + rowsPerSlice);
+        if (first >= last)
+        {
+            break;
+        }
+        auto *task = new SliceTask([this, &job, &done, first, last, i]() {
+            convertRows(job, first, last, i, m_kernels);
+            done.release();
+        });
+        task->setAutoDelete(true);
+        m_pool.start(task);
+        ++started;
+    }
+    convertRows(job, 0, std::min(dstHeight, rowsPerSlice), 0, m_kernels);
+    done.acquire(started);
+
+    ++m_frameCount;
+    if (m_verifyInterval > 0 && m_kernels != ColorConvertKernels::scalarKernels() &&
+        m_frameCount % m_verifyInterval == 0)
+    {
+        verify(job, dstHeight);
+    }
+    return true;
+}
+
+void ColorConverter::convertRows(const Job &job, int firstRow, int lastRow, int slice,
+                                 const ColorConvertKernels::KernelSet *kernels)
+{
+    if (job.downscale == 1)
+    {
+        for (int y = firstRow; y + 1 < lastRow; y += 2)
+        {
+            const uint8_t *src0 = job.bgra + static_cast<size_t>(y) * job.srcStride;
+            kernels->bgraToNv12Rows(src0, src0 + job.srcStride, job.dstY + static_cast<size_t>(y) * job.dstYStride,
+                                    job.dstY + static_cast<size_t>(y + 1) * job.dstYStride,
+                                    job.dstUV + static_cast<size_t>(y / 2) * job.dstUVStride, job.dstWidth);
+        }
+        return;
+    }
+
+    // 2x下采样：每两行输出需要四行输入，先box到条带自己的行缓冲
+    std::vector<uint8_t> &scratch = m_scratch[slice];
+    const size_t rowBytes = static_cast<size_t>(job.dstWidth) * 4;
+    if (scratch.size() < rowBytes * 2)
+    {
+        scratch.resize(rowBytes * 2);
+    }
+    uint8_t *row0 = scratch.data();
+    uint8_t *row1 = scratch.data() + rowBytes;
+    for (int y = firstRow; y + 1 < lastRow; y += 2)
+    {
+        const uint8_t *src = job.bgra + static_cast<size_t>(y) * 2 * job.srcStride;
+        kernels->boxDownscaleRow(src, src + job.srcStride, row0, job.dstWidth);
+        kernels->boxDownscaleRow(src + 2 * job.srcStride, src + 3 * job.srcStride, row1, job.dstWidth);
+        kernels->bgraToNv12Rows(row0, row1, job.dstY + static_cast<size_t>(y) * job.dstYStride,
+                                job.dstY + static_cast<size_t>(y + 1) * job.dstYStride,
+                                job.dstUV + static_cast<size_t>(y / 2) * job.dstUVStride, job.dstWidth);
+    }
+}
+
+void ColorConverter::verify(const Job &job, int dstHeight)
+{
+    // 抽取几组行用标量实现重新计算，与SIMD输出逐字节比较
+    const int width = job.dstWidth;
+    std::vector<uint8_t> y(static_cast<size_t>(width) * 2);
+    std::vector<uint8_t> uv(static_cast<size_t>(width));
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> boxed(rowBytes * 2);
+    int maxDiff = 0;
+
+    for (int probe = 1; probe <= 3; ++probe)
+    {
+        const int row = ((dstHeight * probe / 4) & ~1);
+        const uint8_t *src0 = nullptr;
+        const uint8_t *src1 = nullptr;
+        if (job.downscale == 1)
+        {
+            src0 = job.bgra + static_cast<size_t>(row) * job.srcStride;
+            src1 = src0 + job.srcStride;
+        }
+        else
+        {
+            const uint8_t *src = job.bgra + static_cast<size_t>(row) * 2 * job.srcStride;
+            ColorConvertKernels::boxDownscaleRowScalar(src, src + job.srcStride, boxed.data(), width);
+            ColorConvertKernels::boxDownscaleRowScalar(src + 2 * job.srcStride, src + 3 * job.srcStride,
+                                                       boxed.data() + rowBytes, width);
+            src0 = boxed.data();
+            src1 = boxed.data() + rowBytes;
+        }
+        ColorConvertKernels::bgraToNv12RowsScalar(src0, src1, y.data(), y.data() + width, uv.data(), width);
+
+        const uint8_t *outY0 = job.dstY + static_cast<size_t>(row) * job.dstYStride;
+        const uint8_t *outY1 = outY0 + job.dstYStride;
+        const uint8_t *outUV = job.dstUV + static_cast<size_t>(row / 2) * job.dstUVStride;
+        for (int x = 0; x < width; ++x)
+        {
+            maxDiff = std::max(maxDiff, std::abs(int(outY0[x]) - int(y[x])));
+            maxDiff = std::max(maxDiff, std::abs(int(outY1[x]) - int(y[width + x])));
+            maxDiff = std::max(maxDiff, std::abs(int(outUV[x]) - int(uv[x])));
+        }
+    }
+
+    if (maxDiff != 0)
+    {
+        LOG_ERROR("ColorConverter {} kernels differ from scalar reference (max diff {}), switching to scalar",
+                  m_kernels->name, maxDiff);
+        m_kernels = ColorConvertKernels::scalarKernels();
+    }
+    else
+    {
+        LOG_DEBUG("ColorConverter {} kernels verified against scalar reference", m_kernels->name);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <QMutex>
+#include <QThreadPool>
+#include <cstdint>
+#include <vector>
+
+namespace ColorConvertKernels {
+struct KernelSet;
+}
+
+// 32位BGRA -> NV12 颜色转换，可选2x2 box下采样
+// 按CPU能力在运行时选择AVX2/SSE4.1/NEON内核，按水平条带分给小线程池并行处理
+class ColorConverter {
+public:
+  ColorConverter();
+  ~ColorConverter();
+
+  // downscale为1（同尺寸）或2（宽高各减半），目标宽高为源宽高/downscale且必须为偶数
+  bool convertToNv12(const uint8_t *bgra, int srcWidth, int srcHeight,
+                     int srcStride, int downscale, uint8_t *dstY,
+                     int dstYStride, uint8_t *dstUV, int dstUVStride);
+
+  // 判断给定的源/目标尺寸能否由本转换器处理（否则需要走swscale）
+  static int downscaleFactor(int srcWidth, int srcHeight, int dstWidth,
+                             int dstHeight);
+
+  const char *kernelName() const;
+
+  // 每隔interval帧用标量参考实现抽样校验一次SIMD输出，0为关闭
+  void setVerifyInterval(int interval) { m_verifyInterval = interval; }
+
+  // 当前CPU可用的最优内核
+  static const ColorConvertKernels::KernelSet *bestKernels();
+
+private:
+  struct Job {
+    const uint8_t *bgra;
+    int srcStride;
+    int dstWidth;
+    int downscale;
+    uint8_t *dstY;
+    int dstYStride;
+    uint8_t *dstUV;
+    int dstUVStride;
+  };
+
+  // 处理目标行 [firstRow, lastRow)，均为偶数
+  void convertRows(const Job &job, int firstRow, int lastRow, int slice,
+                   const ColorConvertKernels::KernelSet *kernels);
+  void verify(const Job &job, int dstHeight);
+
+  const ColorConvertKernels::KernelSet *m_kernels;
+  QThreadPool m_pool;
+  QMutex m_mutex; // 同一时间只允许一次转换（共享条带缓冲）
+  std::vector<std::vector<uint8_t>> m_scratch; // 每个条带下采样用的行缓冲
+  int m_verifyInterval;
+  quint64 m_frameCount;
+};
+
+#endif // COLOR_CONVERT_H
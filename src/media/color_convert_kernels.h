@@ -0,0 +1,32 @@
+#ifndef COLOR_CONVERT_KERNELS_H
+#define COLOR_CONVERT_KERNELS_H
+
+#include <cstdint>
+
+// ColorConverter内部使用的行级内核，每个指令集一组，由ColorConverter在运行时选择
+// 系数为BT.601 limited range（与swscale默认一致），所有实现的结果逐字节相同
+namespace ColorConvertKernels
+{
+    struct KernelSet
+    {
+        const char *name;
+        // 两行BGRA -> 两行Y和一行交错UV，width为偶数像素数
+        void (*bgraToNv12Rows)(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                               int width);
+        // 两行BGRA做2x2 box下采样为一行BGRA，dstWidth为输出像素数
+        void (*boxDownscaleRow)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth);
+    };
+
+    // 标量参考实现，SIMD内核也用它处理行尾
+    void bgraToNv12RowsScalar(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                              int width);
+    void boxDownscaleRowScalar(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth);
+
+    const KernelSet *scalarKernels();
+    // 当前平台/编译器不支持时返回nullptr
+    const KernelSet *sse41Kernels();
+    const KernelSet *avx2Kernels();
+    const KernelSet *neonKernels();
+}
+
+#endif // COLOR_CONVERT_KERNELS_H
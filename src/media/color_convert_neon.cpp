@@ -0,0 +1,101 @@
+#include "color_convert_kernels.h"
+
+// 32位ARM上本文件单独以-mfpu=neon编译（见CMakeLists.txt），是否真正使用由运行时检测决定
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+namespace
+{
+    // 16个像素的亮度，系数与标量实现一致，中间结果不超过uint16范围
+    inline uint8x16_t lumaNeon(const uint8x16x4_t &px)
+    {
+        uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), vdup_n_u8(25));
+        lo = vmlal_u8(lo, vget_low_u8(px.val[1]), vdup_n_u8(129));
+        lo = vmlal_u8(lo, vget_low_u8(px.val[2]), vdup_n_u8(66));
+        uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), vdup_n_u8(25));
+        hi = vmlal_u8(hi, vget_high_u8(px.val[1]), vdup_n_u8(129));
+        hi = vmlal_u8(hi, vget_high_u8(px.val[2]), vdup_n_u8(66));
+        uint8x8_t yLo = vshrn_n_u16(vaddq_u16(lo, vdupq_n_u16(128)), 8);
+        uint8x8_t yHi = vshrn_n_u16(vaddq_u16(hi, vdupq_n_u16(128)), 8);
+        return vaddq_u8(vcombine_u8(yLo, yHi), vdupq_n_u8(16));
+    }
+
+    // 2x2块均值：(sum + 2) >> 2
+    inline int16x8_t blockAvgNeon(uint8x16_t r0, uint8x16_t r1)
+    {
+        uint16x8_t sum = vpadalq_u8(vpaddlq_u8(r0), r1);
+        return vreinterpretq_s16_u16(vrshrq_n_u16(sum, 2));
+    }
+
+    inline uint8x8_t chromaNeon(int16x8_t b, int16x8_t g, int16x8_t r, int16_t cb, int16_t cg, int16_t cr)
+    {
+        int16x8_t acc = vmulq_n_s16(b, cb);
+        acc = vmlaq_n_s16(acc, g, cg);
+        acc = vmlaq_n_s16(acc, r, cr);
+        acc = vshrq_n_s16(vaddq_s16(acc, vdupq_n_s16(128)), 8);
+        return vqmovun_s16(vaddq_s16(acc, vdupq_n_s16(128)));
+    }
+
+    void bgraToNv12RowsNeon(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                            int width)
+    {
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t p0 = vld4q_u8(src0 + x * 4);
+            uint8x16x4_t p1 = vld4q_u8(src1 + x * 4);
+
+            vst1q_u8(y0 + x, lumaNeon(p0));
+            vst1q_u8(y1 + x, lumaNeon(p1));
+
+            int16x8_t b = blockAvgNeon(p0.val[0], p1.val[0]);
+            int16x8_t g = blockAvgNeon(p0.val[1], p1.val[1]);
+            int16x8_t r = blockAvgNeon(p0.val[2], p1.val[2]);
+            uint8x8x2_t chroma;
+            chroma.val[0] = chromaNeon(b, g, r, 112, -74, -38);
+            chroma.val[1] = chromaNeon(b, g, r, -18, -94, 112);
+            vst2_u8(uv + x, chroma);
+        }
+
+        if (x < width)
+        {
+            ColorConvertKernels::bgraToNv12RowsScalar(src0 + x * 4, src1 + x * 4, y0 + x, y1 + x, uv + x,
+                                                      width - x);
+        }
+    }
+
+    void boxDownscaleRowNeon(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth)
+    {
+        int x = 0;
+        for (; x + 4 <= dstWidth; x += 4)
+        {
+            // 先纵向再横向求平均（vrhadd即(a+b+1)>>1），舍入方式与标量实现一致
+            uint8x16_t a = vrhaddq_u8(vld1q_u8(src0 + x * 8), vld1q_u8(src1 + x * 8));
+            uint8x16_t b = vrhaddq_u8(vld1q_u8(src0 + x * 8 + 16), vld1q_u8(src1 + x * 8 + 16));
+            uint32x4x2_t pairs = vuzpq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b));
+            uint8x16_t out = vrhaddq_u8(vreinterpretq_u8_u32(pairs.val[0]), vreinterpretq_u8_u32(pairs.val[1]));
+            vst1q_u8(dst + x * 4, out);
+        }
+
+        if (x < dstWidth)
+        {
+            ColorConvertKernels::boxDownscaleRowScalar(src0 + x * 8, src1 + x * 8, dst + x * 4, dstWidth - x);
+        }
+    }
+
+    const ColorConvertKernels::KernelSet kNeonKernels = {"neon", bgraToNv12RowsNeon, boxDownscaleRowNeon};
+}
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::neonKernels()
+{
+    return &kNeonKernels;
+}
+
+#else
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::neonKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "color_convert_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+
+// GCC/Clang按函数打开指令集，整个工程不需要-mavx2；MSVC默认即可使用这些内建函数
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+    // madd系数，按BGRA字节顺序排列，A通道系数为0
+    // Y = (25B + 129G + 66R + 128) >> 8 + 16
+    // U = (112B - 74G - 38R + 128) >> 8 + 128
+    // V = (-18B - 94G + 112R + 128) >> 8 + 128
+    constexpr short kCoefY[4] = {25, 129, 66, 0};
+    constexpr short kCoefU[4] = {112, -74, -38, 0};
+    constexpr short kCoefV[4] = {-18, -94, 112, 0};
+
+    // ---------------- SSE4.1 ----------------
+
+    TARGET_SSE41 inline __m128i coef128(const short c[4])
+    {
+        return _mm_setr_epi16(c[0], c[1], c[2], c[3], c[0], c[1], c[2], c[3]);
+    }
+
+    // 4个BGRA像素 -> 4个32位Y（未加偏移）
+    TARGET_SSE41 inline __m128i lumaSse(__m128i px, __m128i coef)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coef);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coef);
+        return _mm_hadd_epi32(lo, hi);
+    }
+
+    // 两行各4个像素 -> 2个2x2块的BGRA均值（16位）
+    TARGET_SSE41 inline __m128i blockAvgSse(__m128i r0, __m128i r1)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    }
+
+    TARGET_SSE41 inline __m128i scaleSse(__m128i v, __m128i offset)
+    {
+        return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(v, _mm_set1_epi32(128)), 8), offset);
+    }
+
+    TARGET_SSE41 void bgraToNv12RowsSse41(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1,
+                                          uint8_t *uv, int width)
+    {
+        const __m128i coefY = coef128(kCoefY);
+        const __m128i coefU = coef128(kCoefU);
+        const __m128i coefV = coef128(kCoefV);
+        const __m128i offY = _mm_set1_epi32(16);
+        const __m128i offUV = _mm_set1_epi32(128);
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i *p0 = reinterpret_cast<const __m128i *>(src0 + x * 4);
+            const __m128i *p1 = reinterpret_cast<const __m128i *>(src1 + x * 4);
+            __m128i a0 = _mm_loadu_si128(p0), b0 = _mm_loadu_si128(p0 + 1);
+            __m128i c0 = _mm_loadu_si128(p0 + 2), d0 = _mm_loadu_si128(p0 + 3);
+            __m128i a1 = _mm_loadu_si128(p1), b1 = _mm_loadu_si128(p1 + 1);
+            __m128i c1 = _mm_loadu_si128(p1 + 2), d1 = _mm_loadu_si128(p1 + 3);
+
+            // 亮度：每行16个像素
+            __m128i ya = _mm_packs_epi32(scaleSse(lumaSse(a0, coefY), offY), scaleSse(lumaSse(b0, coefY), offY));
+            __m128i yb = _mm_packs_epi32(scaleSse(lumaSse(c0, coefY), offY), scaleSse(lumaSse(d0, coefY), offY));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(y0 + x), _mm_packus_epi16(ya, yb));
+            ya = _mm_packs_epi32(scaleSse(lumaSse(a1, coefY), offY), scaleSse(lumaSse(b1, coefY), offY));
+            yb = _mm_packs_epi32(scaleSse(lumaSse(c1, coefY), offY), scaleSse(lumaSse(d1, coefY), offY));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(y1 + x), _mm_packus_epi16(ya, yb));
+
+            // 色度：8个2x2块
+            __m128i avgA = blockAvgSse(a0, a1);
+            __m128i avgB = blockAvgSse(b0, b1);
+            __m128i avgC = blockAvgSse(c0, c1);
+            __m128i avgD = blockAvgSse(d0, d1);
+            __m128i u = _mm_packs_epi32(
+                scaleSse(_mm_hadd_epi32(_mm_madd_epi16(avgA, coefU), _mm_madd_epi16(avgB, coefU)), offUV),
+                scaleSse(_mm_hadd_epi32(_mm_madd_epi16(avgC, coefU), _mm_madd_epi16(avgD, coefU)), offUV));
+            __m128i v = _mm_packs_epi32(
+                scaleSse(_mm_hadd_epi32(_mm_madd_epi16(avgA, coefV), _mm_madd_epi16(avgB, coefV)), offUV),
+                scaleSse(_mm_hadd_epi32(_mm_madd_epi16(avgC, coefV), _mm_madd_epi16(avgD, coefV)), offUV));
+            __m128i uvPacked = _mm_packus_epi16(_mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(uv + x), uvPacked);
+        }
+
+        if (x < width)
+        {
+            ColorConvertKernels::bgraToNv12RowsScalar(src0 + x * 4, src1 + x * 4, y0 + x, y1 + x, uv + x,
+                                                      width - x);
+        }
+    }
+
+    TARGET_SSE41 void boxDownscaleRowSse41(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth)
+    {
+        int x = 0;
+        for (; x + 4 <= dstWidth; x += 4)
+        {
+            const __m128i *p0 = reinterpret_cast<const __m128i *>(src0 + x * 8);
+            const __m128i *p1 = reinterpret_cast<const __m128i *>(src1 + x * 8);
+            // 先纵向再横向求平均，舍入方式与标量实现一致
+            __m128i a = _mm_avg_epu8(_mm_loadu_si128(p0), _mm_loadu_si128(p1));
+            __m128i b = _mm_avg_epu8(_mm_loadu_si128(p0 + 1), _mm_loadu_si128(p1 + 1));
+            __m128 fa = _mm_castsi128_ps(a);
+            __m128 fb = _mm_castsi128_ps(b);
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_avg_epu8(even, odd));
+        }
+
+        if (x < dstWidth)
+        {
+            ColorConvertKernels::boxDownscaleRowScalar(src0 + x * 8, src1 + x * 8, dst + x * 4, dstWidth - x);
+        }
+    }
+
+    // ---------------- AVX2 ----------------
+    // unpack/madd/hadd/pack都在128位通道内进行，最后用一次跨通道置换恢复像素顺序
+
+    TARGET_AVX2 inline __m256i coef256(const short c[4])
+    {
+        return _mm256_setr_epi16(c[0], c[1], c[2], c[3], c[0], c[1], c[2], c[3],
+                                 c[0], c[1], c[2], c[3], c[0], c[1], c[2], c[3]);
+    }
+
+    // 8个BGRA像素 -> 通道0: 像素0-3，通道1: 像素4-7 的32位Y
+    TARGET_AVX2 inline __m256i lumaAvx2(__m256i px, __m256i coef)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), coef);
+        __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), coef);
+        return _mm256_hadd_epi32(lo, hi);
+    }
+
+    // 两行各8个像素 -> 通道0: 块0-1，通道1: 块2-3 的BGRA均值
+    TARGET_AVX2 inline __m256i blockAvgAvx2(__m256i r0, __m256i r1)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(r0, zero), _mm256_unpacklo_epi8(r1, zero));
+        __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(r0, zero), _mm256_unpackhi_epi8(r1, zero));
+        __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+        return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+    }
+
+    TARGET_AVX2 inline __m256i scaleAvx2(__m256i v, __m256i offset)
+    {
+        return _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(v, _mm256_set1_epi32(128)), 8), offset);
+    }
+
+    TARGET_AVX2 inline __m256i lumaRowAvx2(const __m256i *p, __m256i coef, __m256i off, __m256i order)
+    {
+        __m256i lo = _mm256_packs_epi32(scaleAvx2(lumaAvx2(_mm256_loadu_si256(p), coef), off),
+                                        scaleAvx2(lumaAvx2(_mm256_loadu_si256(p + 1), coef), off));
+        __m256i hi = _mm256_packs_epi32(scaleAvx2(lumaAvx2(_mm256_loadu_si256(p + 2), coef), off),
+                                        scaleAvx2(lumaAvx2(_mm256_loadu_si256(p + 3), coef), off));
+        // 4字节一组的顺序为 0,8,16,24 | 4,12,20,28，置换回连续顺序
+        return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+    }
+
+    TARGET_AVX2 void bgraToNv12RowsAvx2(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1,
+                                        uint8_t *uv, int width)
+    {
+        const __m256i coefY = coef256(kCoefY);
+        const __m256i coefU = coef256(kCoefU);
+        const __m256i coefV = coef256(kCoefV);
+        const __m256i offY = _mm256_set1_epi32(16);
+        const __m256i offUV = _mm256_set1_epi32(128);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        int x = 0;
+        for (; x + 32 <= width; x += 32)
+        {
+            const __m256i *p0 = reinterpret_cast<const __m256i *>(src0 + x * 4);
+            const __m256i *p1 = reinterpret_cast<const __m256i *>(src1 + x * 4);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(y0 + x), lumaRowAvx2(p0, coefY, offY, order));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(y1 + x), lumaRowAvx2(p1, coefY, offY, order));
+
+            __m256i avgA = blockAvgAvx2(_mm256_loadu_si256(p0), _mm256_loadu_si256(p1));
+            __m256i avgB = blockAvgAvx2(_mm256_loadu_si256(p0 + 1), _mm256_loadu_si256(p1 + 1));
+            __m256i avgC = blockAvgAvx2(_mm256_loadu_si256(p0 + 2), _mm256_loadu_si256(p1 + 2));
+            __m256i avgD = blockAvgAvx2(_mm256_loadu_si256(p0 + 3), _mm256_loadu_si256(p1 + 3));
+            __m256i u = _mm256_packs_epi32(
+                scaleAvx2(_mm256_hadd_epi32(_mm256_madd_epi16(avgA, coefU), _mm256_madd_epi16(avgB, coefU)), offUV),
+                scaleAvx2(_mm256_hadd_epi32(_mm256_madd_epi16(avgC, coefU), _mm256_madd_epi16(avgD, coefU)), offUV));
+            __m256i v = _mm256_packs_epi32(
+                scaleAvx2(_mm256_hadd_epi32(_mm256_madd_epi16(avgA, coefV), _mm256_madd_epi16(avgB, coefV)), offUV),
+                scaleAvx2(_mm256_hadd_epi32(_mm256_madd_epi16(avgC, coefV), _mm256_madd_epi16(avgD, coefV)), offUV));
+            __m256i uvPacked = _mm256_packus_epi16(_mm256_unpacklo_epi16(u, v), _mm256_unpackhi_epi16(u, v));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(uv + x), _mm256_permutevar8x32_epi32(uvPacked, order));
+        }
+
+        if (x < width)
+        {
+            ColorConvertKernels::bgraToNv12RowsScalar(src0 + x * 4, src1 + x * 4, y0 + x, y1 + x, uv + x,
+                                                      width - x);
+        }
+    }
+
+    TARGET_AVX2 void boxDownscaleRowAvx2(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int dstWidth)
+    {
+        int x = 0;
+        for (; x + 8 <= dstWidth; x += 8)
+        {
+            const __m256i *p0 = reinterpret_cast<const __m256i *>(src0 + x * 8);
+            const __m256i *p1 = reinterpret_cast<const __m256i *>(src1 + x * 8);
+            __m256i a = _mm256_avg_epu8(_mm256_loadu_si256(p0), _mm256_loadu_si256(p1));
+            __m256i b = _mm256_avg_epu8(_mm256_loadu_si256(p0 + 1), _mm256_loadu_si256(p1 + 1));
+            __m256 fa = _mm256_castsi256_ps(a);
+            __m256 fb = _mm256_castsi256_ps(b);
+            __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+            // 64位一组的顺序为 0-1,4-5 | 2-3,6-7
+            __m256i out = _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), out);
+        }
+
+        if (x < dstWidth)
+        {
+            ColorConvertKernels::boxDownscaleRowScalar(src0 + x * 8, src1 + x * 8, dst + x * 4, dstWidth - x);
+        }
+    }
+
+    const ColorConvertKernels::KernelSet kSse41Kernels = {"sse4.1", bgraToNv12RowsSse41, boxDownscaleRowSse41};
+    const ColorConvertKernels::KernelSet kAvx2Kernels = {"avx2", bgraToNv12RowsAvx2, boxDownscaleRowAvx2};
+}
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::sse41Kernels()
+{
+    return &kSse41Kernels;
+}
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::avx2Kernels()
+{
+    return &kAvx2Kernels;
+}
+
+#else
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::sse41Kernels()
+{
+    return nullptr;
+}
+
+const ColorConvertKernels::KernelSet *ColorConvertKernels::avx2Kernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "decode_worker.h"
+#include "frame_ring.h"
+#include "logger_manager.h"
+#include "video_decoder.h"
+
+namespace
+{
+    // 每解码这么多帧输出一次统计
+    const quint64 kStatsInterval = 300;
+}
+
+DecodeWorker::DecodeWorker(QObject *parent)
+    : QObject(parent),
+      m_queue(kQueueCapacity),
+      m_drainScheduled(false),
+      m_overflow(false),
+      m_producerWaitingKey(false),
+      m_overflowAtUs(0),
+      m_decoder(new VideoDecoder(this)),
+      m_resyncing(false),
+      m_decoderWaiting(true),
+      m_decoded(0),
+      m_displayed(0),
+      m_skipped(0),
+      m_dropped(0),
+      m_overflowDropped(0)
+{
+    m_batch.reserve(kQueueCapacity);
+    // 解码器与工作者在同一线程，直接转发
+    connect(m_decoder, &VideoDecoder::keyFrameRequired, this, &DecodeWorker::keyFrameRequired);
+}
+
+DecodeWorker::~DecodeWorker()
+{
+}
+
+void DecodeWorker::setOverlay(std::function<void(QImage &)> overlay)
+{
+    m_decoder->setOverlay(std::move(overlay));
+}
+
+void DecodeWorker::enqueue(rtc::binary &&data, bool keyFrame, bool recoveryPoint)
+{
+    if (data.empty())
+    {
+        return;
+    }
+    // 溢出后之前的参考帧已经丢失，非关键帧送进去也解不出来；
+    // 但发送端不一定会再发关键帧（帧内刷新只带恢复点），超时后照常送入，由解码器自己恢复
+    if (m_producerWaitingKey && !keyFrame && !recoveryPoint)
+    {
+        if (FrameRing::clockUs() - m_overflowAtUs < kResyncTimeoutUs)
+        {
+            m_overflowDropped++;
+            return;
+        }
+        LOG_WARN("No key frame or recovery point {} ms after decode queue overflow, resuming",
+                 kResyncTimeoutUs / 1000);
+    }
+
+    Unit unit;
+    unit.data = std::move(data);
+    unit.keyFrame = keyFrame;
+    unit.resync = m_producerWaitingKey;
+    if (m_queue.push(std::move(unit)))
+    {
+        m_producerWaitingKey = false;
+    }
+    else
+    {
+        m_overflowDropped++;
+        if (!m_producerWaitingKey)
+        {
+            m_overflowAtUs = FrameRing::clockUs();
+        }
+        m_producerWaitingKey = true;
+        m_overflow.store(true, std::memory_order_release);
+    }
+
+    // 已有一次drain在路上时不再投递，避免事件堆积
+    if (!m_drainScheduled.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, &DecodeWorker::drain, Qt::QueuedConnection);
+    }
+}
+
+void DecodeWorker::initializeDecoder(VideoCodec codec)
+{
+    // 丢弃按旧格式解包的帧
+    Unit unit;
+    while (m_queue.pop(unit))
+    {
+        m_dropped++;
+    }
+    m_resyncing = false;
+    m_decoderWaiting = true;
+    if (!m_decoder->initialize(codec))
+    {
+        LOG_ERROR("Failed to initialize {} decoder", VideoCodecs::name(codec));
+    }
+}
+
+void DecodeWorker::drain()
+{
+    // 先清标志再取，之后放入的帧会再投递一次drain
+    m_drainScheduled.store(false);
+
+    m_batch.clear();
+    Unit unit;
+    while (m_queue.pop(unit))
+    {
+        m_batch.push_back(std::move(unit));
+    }
+
+    if (m_overflow.exchange(false, std::memory_order_acquire))
+    {
+        LOG_WARN("Decode queue overflowed, dropping until next key frame or recovery point");
+        m_resyncing = true;
+        m_decoder->resetDecoder();
+        m_decoderWaiting = true;
+        emit keyFrameRequired();
+    }
+    if (m_batch.empty())
+    {
+        return;
+    }
+
+    size_t start = 0;
+    if (m_resyncing)
+    {
+        while (start < m_batch.size() && !m_batch[start].resync)
+        {
+            start++;
+        }
+        m_dropped += start;
+        if (start == m_batch.size())
+        {
+            return;
+        }
+        m_resyncing = false;
+    }
+
+    // 落后多帧时从最新的关键帧开始，它之前的帧不再被引用
+    for (size_t i = m_batch.size() - 1; i > start; --i)
+    {
+        if (m_batch[i].keyFrame)
+        {
+            m_skipped += i - start;
+            start = i;
+            break;
+        }
+    }
+
+    const size_t last = m_batch.size() - 1;
+    for (size_t i = start; i <= last; ++i)
+    {
+        // 中间的帧只作为参考解码，只有最后一帧转换输出
+        QImage frame = m_decoder->decodeFrame(m_batch[i].data, i == last);
+        m_batch[i].data = rtc::binary();
+        m_decoded++;
+
+        const bool waiting = m_decoder->isWaitingForKeyFrame();
+        if (m_decoderWaiting && !waiting)
+        {
+            emit decoderRecovered();
+        }
+        m_decoderWaiting = waiting;
+
+        if (!frame.isNull())
+        {
+            m_displayed++;
+            emit frameDecoded(frame);
+        }
+        if (m_decoded % kStatsInterval == 0)
+        {
+            logStats();
+        }
+    }
+}
+
+void DecodeWorker::logStats()
+{
+    LOG_DEBUG("Decode stats - decoded: {}, displayed: {}, skipped: {}, dropped: {}, overflow dropped: {}",
+              m_decoded, m_displayed, m_skipped, m_dropped, m_overflowDropped.load());
+}
@@ -0,0 +1,73 @@
+#ifndef DECODE_WORKER_H
+#define DECODE_WORKER_H
+
+#include <QImage>
+#include <QObject>
+#include <QtGlobal>
+#include <atomic>
+#include <functional>
+#include <rtc/rtc.hpp>
+#include <vector>
+
+#include "spsc_queue.h"
+#include "video_codec.h"
+
+class VideoDecoder;
+
+// 控制端的视频解码工作者（不继承QThread），网络线程只把解包后的帧放入无锁队列
+// 解码落后时跳到队列中最新的关键帧；队列满时丢弃直到下一个关键帧或恢复点并请求关键帧
+// （发送端开启帧内刷新时只有恢复点，都没有时等待kResyncTimeoutUs后照常送入），
+// 追帧时之前的帧只解码不转换，只输出最后一帧
+class DecodeWorker : public QObject {
+  Q_OBJECT
+public:
+  explicit DecodeWorker(QObject *parent = nullptr);
+  ~DecodeWorker();
+
+  // 网络线程调用（单生产者）：放入一帧，keyFrame为可独立解码的帧，
+  // recoveryPoint为帧内刷新的起点（溢出后可以从这里重新开始解码）
+  void enqueue(rtc::binary &&data, bool keyFrame, bool recoveryPoint = false);
+  // 须在解码开始前设置，回调在解码线程执行
+  void setOverlay(std::function<void(QImage &)> overlay);
+
+public slots:
+  void initializeDecoder(VideoCodec codec);
+  void drain(); // 取出队列中的全部帧并解码
+
+signals:
+  void frameDecoded(const QImage &frame);
+  void keyFrameRequired(); // 解码出错或队列溢出，需要发送端补一个IDR
+  void decoderRecovered(); // 解码器从等待关键帧恢复
+
+private:
+  struct Unit {
+    rtc::binary data;
+    bool keyFrame = false;
+    bool resync = false; // 溢出后重新开始解码的帧
+  };
+  static constexpr size_t kQueueCapacity = 16;
+  static constexpr qint64 kResyncTimeoutUs = 1000000;
+
+  void logStats();
+
+  SpscQueue<Unit> m_queue;
+  std::atomic<bool> m_drainScheduled; // 已有一次drain在事件队列中
+  std::atomic<bool> m_overflow;       // 生产者丢过帧，消费者需要重新同步
+
+  // 只在网络线程访问
+  bool m_producerWaitingKey; // 溢出后丢弃非关键帧
+  qint64 m_overflowAtUs;     // 开始丢弃的时刻
+
+  // 只在解码线程访问
+  VideoDecoder *m_decoder;
+  std::vector<Unit> m_batch;
+  bool m_resyncing;     // 丢弃到带resync标记的关键帧
+  bool m_decoderWaiting;
+  quint64 m_decoded;    // 送入解码器的帧
+  quint64 m_displayed;  // 转换并输出的帧
+  quint64 m_skipped;    // 追帧时跳过（不解码）的帧
+  quint64 m_dropped;    // 溢出后丢弃的帧
+  std::atomic<quint64> m_overflowDropped; // 生产者因队列满丢弃的帧
+};
+
+#endif // DECODE_WORKER_H
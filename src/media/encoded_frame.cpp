@@ -0,0 +1,144 @@
+#include "encoded_frame.h"
+#include <cstring>
+
+EncodedVideoFrame::Data::~Data()
+{
+    for (AVPacket *packet : packets)
+    {
+        av_packet_free(&packet);
+    }
+}
+
+EncodedVideoFrame::Data *EncodedVideoFrame::mutableData()
+{
+    if (!d)
+    {
+        d = std::make_shared<Data>();
+    }
+    return d.get();
+}
+
+int EncodedVideoFrame::packetCount() const
+{
+    return d ? static_cast<int>(d->packets.size()) : 0;
+}
+
+const uint8_t *EncodedVideoFrame::packetData(int index) const
+{
+    return d->packets[index]->data;
+}
+
+int EncodedVideoFrame::packetSize(int index) const
+{
+    return d->packets[index]->size;
+}
+
+size_t EncodedVideoFrame::size() const
+{
+    size_t total = 0;
+    if (d)
+    {
+        for (const AVPacket *packet : d->packets)
+        {
+            total += packet->size;
+        }
+    }
+    return total;
+}
+
+bool EncodedVideoFrame::appendPacket(AVPacket *packet)
+{
+    if (!packet || packet->size <= 0)
+    {
+        return false;
+    }
+
+    AVPacket *owned = av_packet_alloc();
+    if (!owned)
+    {
+        return false;
+    }
+    // 只移动缓冲引用，不拷贝数据
+    av_packet_move_ref(owned, packet);
+
+    Data *data = mutableData();
+    if (owned->flags & AV_PKT_FLAG_KEY)
+    {
+        data->keyFrame = true;
+    }
+    data->packets.push_back(owned);
+    return true;
+}
+
+bool EncodedVideoFrame::appendData(const uint8_t *data, int size, bool keyFrame)
+{
+    if (!data || size <= 0)
+    {
+        return false;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet || av_new_packet(packet, size) < 0)
+    {
+        av_packet_free(&packet);
+        return false;
+    }
+    std::memcpy(packet->data, data, size);
+    if (keyFrame)
+    {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    bool appended = appendPacket(packet);
+    av_packet_free(&packet);
+    return appended;
+}
+
+bool EncodedVideoFrame::appendPackets(const EncodedVideoFrame &other)
+{
+    if (other.isEmpty())
+    {
+        return false;
+    }
+
+    Data *data = mutableData();
+    for (const AVPacket *packet : other.d->packets)
+    {
+        AVPacket *ref = av_packet_clone(packet);
+        if (!ref)
+        {
+            return false;
+        }
+        data->packets.push_back(ref);
+    }
+    if (other.d->keyFrame)
+    {
+        data->keyFrame = true;
+    }
+    return true;
+}
+
+void EncodedVideoFrame::setTimestampUs(quint64 timestampUs)
+{
+    mutableData()->timestampUs = timestampUs;
+}
+
+void EncodedVideoFrame::setCaptureTimeUs(qint64 captureTimeUs)
+{
+    mutableData()->captureTimeUs = captureTimeUs;
+}
+
+void EncodedVideoFrame::setEncodeDurationUs(qint64 durationUs)
+{
+    mutableData()->encodeDurationUs = durationUs;
+}
+
+void EncodedVideoFrame::setQp(int qp)
+{
+    mutableData()->qp = qp;
+}
+
+void EncodedVideoFrame::setFrameEnd(bool frameEnd)
+{
+    mutableData()->frameEnd = frameEnd;
+}
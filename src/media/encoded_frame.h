@@ -0,0 +1,66 @@
+#ifndef ENCODED_FRAME_H
+#define ENCODED_FRAME_H
+
+#include <QMetaType>
+#include <QtGlobal>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// 编码输出的一帧视频：直接持有编码器输出AVPacket的引用（包含该帧全部NAL单元），不拷贝数据
+// 对象本身只是共享指针，经过排队信号槽传递时只增加引用计数；构建完成后只读
+class EncodedVideoFrame {
+public:
+  EncodedVideoFrame() = default;
+
+  bool isEmpty() const { return !d || d->packets.empty(); }
+  int packetCount() const;
+  const uint8_t *packetData(int index) const;
+  int packetSize(int index) const;
+  size_t size() const; // 所有数据包的总字节数
+
+  bool isKeyFrame() const { return d && d->keyFrame; }
+  quint64 timestampUs() const { return d ? d->timestampUs : 0; }    // 媒体时间戳（RTP时间戳来源）
+  qint64 captureTimeUs() const { return d ? d->captureTimeUs : 0; } // 捕获时刻（单调时钟）
+  qint64 encodeDurationUs() const { return d ? d->encodeDurationUs : 0; }
+  int qp() const { return d ? d->qp : -1; } // 编码器报告的帧QP，-1为未知
+  // 条带输出时一帧分多段发送，只有最后一段为true（对应RTP marker）；整帧输出总是true
+  bool isFrameEnd() const { return !d || d->frameEnd; }
+
+  // 以下仅供编码器在发布之前构建帧使用
+  // 接管packet中的缓冲引用，packet被重置为空包可继续接收
+  bool appendPacket(AVPacket *packet);
+  // 拷贝一段编码数据，用于输出缓冲归编码器所有、下一帧会被覆盖的后端
+  bool appendData(const uint8_t *data, int size, bool keyFrame);
+  // 引用另一帧的全部数据包，只增加缓冲引用计数
+  bool appendPackets(const EncodedVideoFrame &other);
+  void setTimestampUs(quint64 timestampUs);
+  void setCaptureTimeUs(qint64 captureTimeUs);
+  void setEncodeDurationUs(qint64 durationUs);
+  void setQp(int qp);
+  void setFrameEnd(bool frameEnd);
+
+private:
+  struct Data {
+    ~Data();
+    std::vector<AVPacket *> packets;
+    bool keyFrame = false;
+    quint64 timestampUs = 0;
+    qint64 captureTimeUs = 0;
+    qint64 encodeDurationUs = 0;
+    int qp = -1;
+    bool frameEnd = true;
+  };
+
+  Data *mutableData();
+
+  std::shared_ptr<Data> d;
+};
+
+Q_DECLARE_METATYPE(EncodedVideoFrame)
+
+#endif // ENCODED_FRAME_H
@@ -0,0 +1,410 @@
+#include "encoder_registry.h"
+#include "ffmpeg_encoder.h"
+#include "synthetic_corpus.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QSysInfo>
+#include <QThread>
+#include <algorithm>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+}
+
+namespace
+{
+    // 检查常见的硬件加速器，按优先级排序（测速前的默认顺序）
+    const char *const kAccelNames[] = {
+        "nvidia", // NVIDIA CUDA
+        "cuda",   // NVIDIA CUDA
+        "nvenc",  // NVIDIA
+        "amf",    // AMD
+        "vaapi",  // Intel VAAPI
+        "qsv",    // Intel Quick Sync
+        "vulkan", // Vulkan
+        // "mf",     // Microsoft Media Foundation
+        "videotoolbox", // macOS
+        "v4l2m2m",      // Linux V4L2
+        "omx",          // OpenMAX
+        "rkmpp",        // Rockchip MPP
+        "mpp",          // MPP
+        "mppenc",       // MPP Encoder
+        nullptr};
+
+    // 缓存格式版本，记录内容变化时递增
+    constexpr int kCacheVersion = 2;
+
+    // 测速用的合成画面
+    constexpr int kBenchWidth = 1920;
+    constexpr int kBenchHeight = 1080;
+    constexpr int kBenchFps = 30;
+    constexpr int kBenchFrames = 30;
+}
+
+EncoderCapabilityRegistry &EncoderCapabilityRegistry::instance()
+{
+    static EncoderCapabilityRegistry registry;
+    return registry;
+}
+
+EncoderCapabilityRegistry::EncoderCapabilityRegistry()
+    : m_probed(false),
+      m_probing(false)
+{
+}
+
+QString EncoderCapabilityRegistry::cacheFilePath()
+{
+    QString configPath = ConfigUtil->filePath;
+    if (configPath.isEmpty())
+    {
+        configPath = QCoreApplication::applicationDirPath() + "/config.ini";
+    }
+    return QFileInfo(configPath).absolutePath() + "/encoder_cache.ini";
+}
+
+QString EncoderCapabilityRegistry::cacheKey()
+{
+    // FFmpeg库版本 + 系统内核 + 能拿到的显卡驱动版本，任一变化都重新探测
+    QString driver;
+#ifdef Q_OS_LINUX
+    QFile nvidiaVersion("/proc/driver/nvidia/version");
+    if (nvidiaVersion.open(QIODevice::ReadOnly))
+    {
+        driver += QString::fromUtf8(nvidiaVersion.readLine()).trimmed();
+    }
+    driver += qgetenv("LIBVA_DRIVER_NAME");
+#endif
+    return QString("%1|%2|%3|%4|%5|%6")
+        .arg(kCacheVersion)
+        .arg(av_version_info())
+        .arg(avcodec_version())
+        .arg(QSysInfo::kernelVersion())
+        .arg(QSysInfo::currentCpuArchitecture())
+        .arg(driver);
+}
+
+bool EncoderCapabilityRegistry::loadCache(const QString &key, QList<Capability> &capabilities)
+{
+    QSettings cache(cacheFilePath(), QSettings::IniFormat);
+    if (cache.value("cache/key").toString() != key)
+    {
+        return false;
+    }
+
+    capabilities.clear();
+    int count = cache.beginReadArray("encoders");
+    for (int i = 0; i < count; ++i)
+    {
+        cache.setArrayIndex(i);
+        Capability capability;
+        capability.hwAccel = cache.value("hwAccel").toString();
+        capability.available = cache.value("available").toBool();
+        capability.firstFrameMs = cache.value("firstFrameMs").toDouble();
+        capability.frameMs = cache.value("frameMs").toDouble();
+        capability.codecs = VideoCodecs::fromNames(cache.value("codecs").toStringList());
+        capabilities.append(capability);
+    }
+    cache.endArray();
+
+    return !capabilities.isEmpty();
+}
+
+void EncoderCapabilityRegistry::saveCache(const QString &key, const QList<Capability> &capabilities)
+{
+    QSettings cache(cacheFilePath(), QSettings::IniFormat);
+    cache.clear();
+    cache.setValue("cache/key", key);
+    cache.beginWriteArray("encoders", capabilities.size());
+    for (int i = 0; i < capabilities.size(); ++i)
+    {
+        const Capability &capability = capabilities[i];
+        cache.setArrayIndex(i);
+        cache.setValue("hwAccel", capability.hwAccel);
+        cache.setValue("available", capability.available);
+        cache.setValue("firstFrameMs", capability.firstFrameMs);
+        cache.setValue("frameMs", capability.frameMs);
+        cache.setValue("codecs", VideoCodecs::names(capability.codecs));
+    }
+    cache.endArray();
+    cache.sync();
+}
+
+bool EncoderCapabilityRegistry::testOpen(const QString &hwAccel)
+{
+    QString codecName = QString("h264_%1").arg(hwAccel);
+    const AVCodec *codec = avcodec_find_encoder_by_name(codecName.toUtf8().data());
+    if (!codec)
+    {
+        LOG_DEBUG("Hardware encoder not found: {}", codecName);
+        return false;
+    }
+
+    // 实际测试编码器是否可用（创建上下文并尝试打开）
+    AVCodecContext *testContext = avcodec_alloc_context3(codec);
+    if (!testContext)
+    {
+        return false;
+    }
+    testContext->width = 640;
+    testContext->height = 480;
+    testContext->time_base = AVRational{1, 30};
+    testContext->framerate = AVRational{30, 1};
+    testContext->pix_fmt = AV_PIX_FMT_NV12;
+
+    int ret = avcodec_open2(testContext, codec, nullptr);
+    avcodec_free_context(&testContext);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        LOG_DEBUG("✗ Hardware encoder {} found but cannot be opened: {}", codecName, errbuf);
+        return false;
+    }
+    LOG_INFO("✓ Hardware encoder {} is available and working", codecName);
+    return true;
+}
+
+bool EncoderCapabilityRegistry::testOpen(VideoCodec codec, const QString &hwAccel)
+{
+    // 走编码时相同的初始化流程（硬件帧上下文、像素格式、码率参数），只打开不测速
+    FFmpegEncoder encoder(codec);
+    const bool opened = encoder.initializeWith(QStringList{hwAccel}, 640, 480, 30, 640 * 480 * 30 / 10);
+    LOG_INFO("{} {} encoder via {}", opened ? "✓" : "✗", VideoCodecs::name(codec),
+             hwAccel.isEmpty() ? "software" : hwAccel);
+    return opened;
+}
+
+void EncoderCapabilityRegistry::probeCodecs(Capability &capability)
+{
+    capability.codecs.clear();
+    if (!capability.available)
+    {
+        return;
+    }
+    capability.codecs << VideoCodec::H264;
+    for (VideoCodec codec : {VideoCodec::H265, VideoCodec::AV1, VideoCodec::VP9})
+    {
+        // 先查名字，没有编译进FFmpeg的不去打开
+        const QString encoderName = capability.hwAccel.isEmpty()
+                                        ? VideoCodecs::softwareEncoder(codec)
+                                        : QString("%1_%2").arg(VideoCodecs::hardwareEncoderPrefix(codec), capability.hwAccel);
+        if (encoderName.isEmpty() || !avcodec_find_encoder_by_name(encoderName.toUtf8().constData()))
+        {
+            continue;
+        }
+        if (testOpen(codec, capability.hwAccel))
+        {
+            capability.codecs << codec;
+        }
+    }
+}
+
+void EncoderCapabilityRegistry::benchmark(Capability &capability)
+{
+    // 渐变背景上拖动窗口，画面每帧都有变化
+    SyntheticCorpus corpus(kBenchWidth, kBenchHeight);
+    const uchar *bgra = corpus.render(SyntheticCorpus::WindowDrag, 0);
+
+    FFmpegEncoder encoder;
+    QElapsedTimer timer;
+    timer.start();
+    if (!encoder.initializeWith(QStringList{capability.hwAccel}, kBenchWidth, kBenchHeight, kBenchFps,
+                                static_cast<int>(kBenchWidth * kBenchHeight * kBenchFps * 0.1)))
+    {
+        capability.available = false;
+        return;
+    }
+
+    int encodedFrames = 0;
+    qint64 steadyNs = 0;
+    for (int i = 0; i < kBenchFrames; ++i)
+    {
+        if (i > 0)
+        {
+            bgra = corpus.render(SyntheticCorpus::WindowDrag, i);
+            timer.restart();
+        }
+        EncodedVideoFrame frame = encoder.encodeFrame(bgra, kBenchWidth, kBenchHeight, corpus.stride());
+        qint64 elapsedNs = timer.nsecsElapsed();
+        if (frame.isEmpty())
+        {
+            continue;
+        }
+        if (encodedFrames == 0)
+        {
+            capability.firstFrameMs = elapsedNs / 1e6;
+        }
+        else
+        {
+            steadyNs += elapsedNs;
+        }
+        encodedFrames++;
+    }
+
+    capability.available = encodedFrames > 1;
+    capability.frameMs = capability.available ? steadyNs / 1e6 / (encodedFrames - 1) : 0;
+}
+
+void EncoderCapabilityRegistry::probe()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_probing)
+        {
+            m_probeFinished.wait(&m_mutex);
+        }
+        if (m_probed)
+        {
+            return;
+        }
+        m_probing = true;
+    }
+
+    // 以下不持有锁，结果在本地列表里生成，完成后一次性发布
+    QList<Capability> capabilities;
+    QString key = cacheKey();
+    if (loadCache(key, capabilities))
+    {
+        LOG_INFO("Loaded encoder capabilities from cache ({} encoders)", capabilities.size());
+    }
+    else
+    {
+        LOG_INFO("Probing video encoders, this only runs once per FFmpeg/driver version");
+        QElapsedTimer probeTimer;
+        probeTimer.start();
+
+        for (int i = 0; kAccelNames[i]; ++i)
+        {
+            Capability capability;
+            capability.hwAccel = kAccelNames[i];
+            if (testOpen(capability.hwAccel))
+            {
+                benchmark(capability);
+                probeCodecs(capability);
+            }
+            capabilities.append(capability);
+        }
+
+        Capability software; // libx264
+        benchmark(software);
+        probeCodecs(software);
+        capabilities.append(software);
+
+        saveCache(key, capabilities);
+        LOG_INFO("Encoder probe finished in {} ms", probeTimer.elapsed());
+    }
+
+    for (const Capability &capability : capabilities)
+    {
+        if (capability.available)
+        {
+            LOG_INFO("Encoder {}: first frame {:.1f} ms, {:.2f} ms/frame at 1080p",
+                     capability.hwAccel.isEmpty() ? "libx264" : capability.hwAccel, capability.firstFrameMs,
+                     capability.frameMs);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_capabilities = capabilities;
+    m_probed = true;
+    m_probing = false;
+    m_probeFinished.wakeAll();
+}
+
+void EncoderCapabilityRegistry::probeAsync()
+{
+    QThread *thread = QThread::create([this]()
+                                      { probe(); });
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start(QThread::LowPriority);
+}
+
+QList<EncoderCapabilityRegistry::Capability> EncoderCapabilityRegistry::capabilities()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_probed)
+        {
+            return m_capabilities;
+        }
+        if (m_probing)
+        {
+            // 后台探测可能要几秒，先用libx264，不等探测结果
+            Capability software;
+            software.available = true;
+            software.codecs << VideoCodec::H264;
+            return QList<Capability>{software};
+        }
+    }
+    probe();
+    QMutexLocker locker(&m_mutex);
+    return m_capabilities;
+}
+
+QList<VideoCodec> EncoderCapabilityRegistry::encodableCodecs()
+{
+    QList<VideoCodec> codecs;
+    for (const Capability &capability : capabilities())
+    {
+        for (VideoCodec codec : capability.codecs)
+        {
+            if (!codecs.contains(codec))
+            {
+                codecs << codec;
+            }
+        }
+    }
+    return codecs;
+}
+
+QStringList EncoderCapabilityRegistry::availableHWAccels()
+{
+    QStringList hwAccels;
+    for (const Capability &capability : capabilities())
+    {
+        if (capability.available && !capability.hwAccel.isEmpty())
+        {
+            hwAccels << capability.hwAccel;
+        }
+    }
+    return hwAccels;
+}
+
+QStringList EncoderCapabilityRegistry::preferredAccels()
+{
+    QList<Capability> available;
+    for (const Capability &capability : capabilities())
+    {
+        if (capability.available)
+        {
+            available.append(capability);
+        }
+    }
+
+    // 满足延迟目标的编码器中选单帧耗时最短的；都不满足时仍按耗时排序
+    const double targetMs = ConfigUtil->encoderLatencyTargetMs;
+    std::stable_sort(available.begin(), available.end(), [targetMs](const Capability &a, const Capability &b)
+                     {
+        bool aMeets = a.frameMs <= targetMs;
+        bool bMeets = b.frameMs <= targetMs;
+        if (aMeets != bMeets)
+        {
+            return aMeets;
+        }
+        return a.frameMs < b.frameMs; });
+
+    QStringList accels;
+    for (const Capability &capability : available)
+    {
+        accels << capability.hwAccel;
+    }
+    return accels;
+}
@@ -0,0 +1,61 @@
+#ifndef ENCODER_REGISTRY_H
+#define ENCODER_REGISTRY_H
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+#include "video_codec.h"
+
+// 编码器能力注册表
+// 每个进程只探测一次可用的编码器，并在合成的1080p画面上测速H264；
+// H265/AV1/VP9只在同一加速方式下实际打开一次，能打开的才对外宣告可编码；
+// 结果按FFmpeg版本和驱动版本缓存在config.ini同目录的encoder_cache.ini中
+class EncoderCapabilityRegistry {
+public:
+  struct Capability {
+    QString hwAccel;         // 空字符串为libx264软件编码
+    bool available = false;  // 能否打开并正常出帧
+    double firstFrameMs = 0; // 打开编码器到输出第一帧的耗时
+    double frameMs = 0;      // 稳定后的平均单帧编码耗时
+    QList<VideoCodec> codecs; // 用这种加速方式能实际打开的编码格式
+  };
+
+  static EncoderCapabilityRegistry &instance();
+
+  // 阻塞直到探测完成，可在任意线程调用，完成后重复调用直接返回
+  // 测试打开和测速期间不持有锁，其他线程查询能力不会被卡住
+  void probe();
+  // 程序启动时在后台线程预先探测，不阻塞界面
+  void probeAsync();
+
+  // 可用的硬件编码器名称（不含软件编码）
+  QStringList availableHWAccels();
+  // 按测速结果排序的候选编码器：满足延迟目标的在前，其中单帧耗时短的优先；空字符串表示软件编码
+  QStringList preferredAccels();
+  // 探测完成前不等待：后台正在探测时只返回libx264，还没开始探测时在当前线程探测
+  QList<Capability> capabilities();
+  // 任一编码器能实际打开的格式，不阻塞（同capabilities）
+  QList<VideoCodec> encodableCodecs();
+
+private:
+  EncoderCapabilityRegistry();
+
+  static bool loadCache(const QString &key, QList<Capability> &capabilities);
+  static void saveCache(const QString &key, const QList<Capability> &capabilities);
+  static QString cacheKey();
+  static QString cacheFilePath();
+  static bool testOpen(const QString &hwAccel);
+  static bool testOpen(VideoCodec codec, const QString &hwAccel);
+  static void benchmark(Capability &capability);
+  static void probeCodecs(Capability &capability);
+
+  QMutex m_mutex;
+  QWaitCondition m_probeFinished;
+  bool m_probed;  // 由m_mutex保护
+  bool m_probing; // 有线程正在探测，由m_mutex保护
+  QList<Capability> m_capabilities;
+};
+
+#endif // ENCODER_REGISTRY_H
@@ -0,0 +1,1328 @@
+#include "ffmpeg_encoder.h"
+#include "color_convert.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#include "encoder_registry.h"
+extern "C" {
+#include <libavutil/intreadwrite.h>
+}
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // 帧池深度：帧环中的帧 + 编码器/硬件上传中同时在途的帧
+    constexpr int kFramePoolDepth = 4;
+    // 不再周期性插入IDR，关键帧只在首帧、重新打开编码器或接收端请求时产生（libx264视为无限GOP）
+    constexpr int kOnDemandGopSize = 1 << 30;
+}
+
+// 硬件设备上下文管理器 - 单例模式，避免重复创建硬件上下文
+class HardwareContextManager
+{
+public:
+    static HardwareContextManager &instance()
+    {
+        static HardwareContextManager instance;
+        return instance;
+    }
+
+    AVBufferRef *getDeviceContext(const QString &hwAccel)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (m_contexts.contains(hwAccel))
+        {
+            AVBufferRef *ctx = m_contexts[hwAccel];
+            if (ctx)
+            {
+                return av_buffer_ref(ctx);
+            }
+            else
+            {
+                m_contexts.remove(hwAccel);
+            }
+        }
+
+        AVHWDeviceType deviceType = av_hwdevice_find_type_by_name(hwAccel.toUtf8().data());
+        if (deviceType == AV_HWDEVICE_TYPE_NONE)
+        {
+            LOG_ERROR("Hardware device type not found: {}", hwAccel);
+            return nullptr;
+        }
+
+        AVBufferRef *newCtx = nullptr;
+        int ret = av_hwdevice_ctx_create(&newCtx, deviceType, nullptr, nullptr, 0);
+        if (ret < 0)
+        {
+            if (hwAccel == "qsv")
+            {
+                ret = av_hwdevice_ctx_create(&newCtx, deviceType, "auto", nullptr, 0);
+            }
+
+            if (ret < 0)
+            {
+                char errbuf[AV_ERROR_MAX_STRING_SIZE];
+                av_strerror(ret, errbuf, sizeof(errbuf));
+                LOG_WARN("Failed to create shared hardware device context {}: {}", hwAccel, errbuf);
+                return nullptr;
+            }
+        }
+
+        m_contexts[hwAccel] = newCtx;
+        LOG_DEBUG("Created shared hardware device context for: {}", hwAccel);
+        return av_buffer_ref(newCtx);
+    }
+
+private:
+    QMap<QString, AVBufferRef *> m_contexts;
+    QMutex m_mutex;
+};
+
+FFmpegEncoder::FFmpegEncoder(VideoCodec codec, QObject *parent)
+    : QObject(parent), m_videoCodec(codec), m_inputPixelFormat(AV_PIX_FMT_NV12), m_codecContext(nullptr), m_codec(nullptr), m_frame(nullptr), m_hwFrame(nullptr), m_scaledFrame(nullptr), m_packet(nullptr), m_hwDeviceCtx(nullptr), m_width(0), m_height(0), m_fps(30), m_openFps(30), m_bitrate(2000000), m_pts(0), m_ptsBase(0), m_timestampBaseUs(0), m_frameCount(0), m_hwPixelFormat(AV_PIX_FMT_NONE), m_initialized(false), m_lastQp(-1)
+{
+    m_h264Bsf = nullptr;
+    m_colorConverter = std::make_unique<ColorConverter>();
+    m_colorConverter->setVerifyInterval(ConfigUtil->colorConvertVerifyInterval);
+    m_keyFrameRequested = false;
+    m_keyFrameMinIntervalMs = ConfigUtil->keyFrameMinIntervalMs;
+    m_intraRefresh = ConfigUtil->intraRefresh;
+    m_intraRefreshPeriod = ConfigUtil->intraRefreshPeriod;
+    m_rateControl = RateControlSettings::fromConfig();
+    m_roi = RoiSettings::fromConfig();
+}
+
+FFmpegEncoder::~FFmpegEncoder()
+{
+    cleanup();
+}
+
+QStringList FFmpegEncoder::getAvailableHWAccels()
+{
+    // 探测结果由能力注册表缓存，每个进程只探测一次
+    return EncoderCapabilityRegistry::instance().availableHWAccels();
+}
+
+bool FFmpegEncoder::initialize(int width, int height, int fps, int bitrate)
+{
+    // 按能力注册表的测速结果依次尝试，最后退回软件编码
+    QStringList hwAccels = EncoderCapabilityRegistry::instance().preferredAccels();
+    if (!hwAccels.contains(QString()))
+    {
+        hwAccels << QString();
+    }
+    return initializeWith(hwAccels, width, height, fps, bitrate);
+}
+
+bool FFmpegEncoder::initializeWith(const QStringList &hwAccels, int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_initialized)
+    {
+        LOG_INFO("Encoder already initialized, cleaning up first");
+        cleanup();
+    }
+
+    m_fps = fps;
+
+    bool success = false;
+    for (const QString &hwAccel : hwAccels)
+    {
+        QString accelType = hwAccel.isEmpty() ? "software" : hwAccel;
+        LOG_INFO("Trying {} encoding", accelType);
+        // 上一次失败的尝试可能已经对齐了尺寸或调整了码率
+        m_width = width;
+        m_height = height;
+        m_bitrate = bitrate;
+        if (initializeCodec(hwAccel))
+        {
+            LOG_INFO("Successfully initialized {} encoder with {} acceleration", VideoCodecs::name(m_videoCodec), accelType);
+            success = true;
+            break;
+        }
+        // 释放失败尝试留下的上下文，再试下一个
+        closeCodec();
+    }
+
+    if (success)
+    {
+        m_initialized = true;
+        QString accelType = m_hwAccelName.isEmpty() ? "software" : m_hwAccelName;
+        LOG_INFO("🎯 {} encoder successfully initialized with {} acceleration", VideoCodecs::name(m_videoCodec), accelType);
+
+        // 性能优化提示
+        if (m_hwAccelName.isEmpty())
+        {
+            LOG_INFO("💡 Using optimized software encoding - consider upgrading GPU drivers for hardware acceleration");
+        }
+        else
+        {
+            LOG_INFO("🚀 Hardware acceleration active - optimal performance enabled");
+        }
+    }
+    else
+    {
+        LOG_ERROR("❌ Failed to initialize {} encoder with any method", VideoCodecs::name(m_videoCodec));
+        cleanup();
+    }
+
+    return success;
+}
+
+bool FFmpegEncoder::initializeCodec(const QString &hwAccel)
+{
+    // 查找编码器
+    QString codecName = hwAccel.isEmpty() ? VideoCodecs::softwareEncoder(m_videoCodec)
+                                          : QString("%1_%2").arg(VideoCodecs::hardwareEncoderPrefix(m_videoCodec), hwAccel);
+    if (codecName.isEmpty())
+    {
+        LOG_ERROR("No software encoder available for {}", VideoCodecs::name(m_videoCodec));
+        return false;
+    }
+    m_codec = avcodec_find_encoder_by_name(codecName.toUtf8().data());
+
+    if (!m_codec)
+    {
+        LOG_ERROR("Codec {} not found", codecName);
+        return false;
+    }
+
+    LOG_INFO("Found codec: {}", codecName);
+
+    // 创建编码器上下文
+    m_codecContext = avcodec_alloc_context3(m_codec);
+    if (!m_codecContext)
+    {
+        LOG_ERROR("Could not allocate video codec context");
+        return false;
+    }
+
+    // 设置编码参数
+    m_codecContext->bit_rate = m_bitrate;
+    m_codecContext->width = m_width;
+    m_codecContext->height = m_height;
+    m_codecContext->time_base = AVRational{1, m_fps};
+    m_codecContext->framerate = AVRational{m_fps, 1};
+    m_codecContext->gop_size = kOnDemandGopSize; // 关键帧按需产生
+    m_codecContext->max_b_frames = 0;       // 不使用B帧，只使用I帧和P帧
+    m_codecContext->keyint_min = m_fps / 2; // 最小关键帧间隔0.5秒
+
+    // 网络自适应优化：针对高延迟网络的编码参数
+    // 禁用全局头部（强制输出 Annex-B）
+    m_codecContext->flags &= ~AV_CODEC_FLAG_GLOBAL_HEADER;
+    m_codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    m_codecContext->flags2 |= AV_CODEC_FLAG2_FAST;
+    m_codecContext->slices = VideoCodecs::kSliceCount;
+    av_opt_set(m_codecContext->priv_data, "annexb", "1", 0);
+
+    // 设置编码预设和调优
+    if (hwAccel.isEmpty())
+    {
+        // 软件编码优先NV12（可走SIMD转换），编码器不接受时（libvpx/libaom/libx265）用YUV420P
+        m_inputPixelFormat = AV_PIX_FMT_YUV420P;
+        for (const AVPixelFormat *fmt = m_codec->pix_fmts; fmt && *fmt != AV_PIX_FMT_NONE; ++fmt)
+        {
+            if (*fmt == AV_PIX_FMT_NV12)
+            {
+                m_inputPixelFormat = AV_PIX_FMT_NV12;
+                break;
+            }
+        }
+        m_codecContext->pix_fmt = m_inputPixelFormat;
+        m_hwPixelFormat = AV_PIX_FMT_NONE;
+        m_hwDeviceCtx = nullptr;
+
+        // 验证分辨率参数 - 确保分辨率是偶数（H264要求）
+        if (m_width % 16 != 0 || m_height % 16 != 0)
+        {
+            LOG_WARN("Adjusting resolution from {}x{} to make it even for H264 compatibility", m_width, m_height);
+            m_width = m_width & ~15;
+            m_height = m_height & ~15;
+            m_codecContext->width = m_width;
+            m_codecContext->height = m_height;
+        }
+
+        // 验证比特率是否合理
+        int minBitrate = m_width * m_height * m_fps * 0.05;
+        int maxBitrate = m_width * m_height * m_fps * 0.5;
+        if (m_bitrate < minBitrate)
+        {
+            m_bitrate = minBitrate;
+            m_codecContext->bit_rate = m_bitrate;
+            LOG_WARN("Adjusted bitrate to minimum safe value: {}", m_bitrate);
+        }
+        else if (m_bitrate > maxBitrate)
+        {
+            m_bitrate = maxBitrate;
+            m_codecContext->bit_rate = m_bitrate;
+            LOG_WARN("Adjusted bitrate to maximum safe value: {}", m_bitrate);
+        }
+
+        LOG_INFO("Setting software encoding parameters: {}x{}, {}fps, {}bps", m_width, m_height, m_fps, m_bitrate);
+
+        configureSoftwareEncoder(codecName);
+    }
+    else
+    {
+        // 硬件加速初始化，硬件编码器统一吃NV12
+        m_inputPixelFormat = AV_PIX_FMT_NV12;
+        LOG_INFO("Setting hardware encoding parameters: {}x{}, {}fps, {}bps", m_width, m_height, m_fps, m_bitrate);
+        if (!initializeHardwareAccel(hwAccel))
+        {
+            return false;
+        }
+    }
+
+    configureRateControl(hwAccel);
+
+    if (m_intraRefresh)
+    {
+        // 帧内刷新期间旧画面会被逐列刷新掉，两者不同时使用
+        configureIntraRefresh(hwAccel);
+    }
+    else if (longTermRefs() > 0)
+    {
+        // libx264/nvenc只有滑动窗口参考，光标和保活帧很快就会把旧画面挤出去
+        LOG_WARN("Long-term references require the openh264 backend, ignored by {} encoder", m_codec->name);
+    }
+
+    // 打开编码器
+    int ret = avcodec_open2(m_codecContext, m_codec, nullptr);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        LOG_ERROR("Could not open codec {} ({}x{}, {}fps, {}bps): {} (error code: {})",
+                  codecName, m_width, m_height, m_fps, m_bitrate, errbuf, ret);
+
+        // 如果是软件编码器，尝试使用更保守的参数
+        if (hwAccel.isEmpty() && ret == AVERROR(EINVAL))
+        {
+            LOG_WARN("Trying with more conservative software encoding parameters");
+
+            // 重置编码器上下文
+            avcodec_free_context(&m_codecContext);
+            m_codecContext = avcodec_alloc_context3(m_codec);
+            if (!m_codecContext)
+            {
+                LOG_ERROR("Could not allocate video codec context for retry");
+                return false;
+            }
+
+            // 使用更保守的参数
+            m_codecContext->bit_rate = m_width * m_height * m_fps * 0.1;
+            m_codecContext->width = m_width;
+            m_codecContext->height = m_height;
+            m_codecContext->time_base = AVRational{1, m_fps};
+            m_codecContext->framerate = AVRational{m_fps, 1};
+            m_codecContext->gop_size = kOnDemandGopSize;
+            m_codecContext->max_b_frames = 0;
+            m_codecContext->keyint_min = m_fps;
+            m_codecContext->pix_fmt = m_inputPixelFormat;
+
+            if (m_videoCodec == VideoCodec::H264)
+            {
+                av_opt_set(m_codecContext->priv_data, "preset", "ultrafast", 0);
+                av_opt_set(m_codecContext->priv_data, "profile", "baseline", 0);
+            }
+            if (m_intraRefresh)
+            {
+                configureIntraRefresh(hwAccel);
+            }
+
+            ret = avcodec_open2(m_codecContext, m_codec, nullptr);
+            if (ret < 0)
+            {
+                av_strerror(ret, errbuf, sizeof(errbuf));
+                LOG_ERROR("Failed even with conservative parameters: {}", errbuf);
+                return false;
+            }
+            else
+            {
+                LOG_INFO("Successfully opened codec with conservative parameters");
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // 输入帧与硬件帧只分配一次外壳，像素缓冲每帧从池中取、送入编码器后归还
+    if (!m_frame)
+    {
+        m_frame = av_frame_alloc();
+    }
+    if (!m_hwFrame)
+    {
+        m_hwFrame = av_frame_alloc();
+    }
+    if (!m_scaledFrame)
+    {
+        m_scaledFrame = av_frame_alloc();
+    }
+    if (!m_frame || !m_hwFrame || !m_scaledFrame)
+    {
+        LOG_ERROR("Could not allocate video frame");
+        return false;
+    }
+
+    // 硬件编码器（包括QSV）和libx264使用NV12输入，其它软件编码器使用YUV420P
+    if (!m_framePool.init(m_inputPixelFormat, m_width, m_height, kFramePoolDepth))
+    {
+        LOG_ERROR("Could not allocate video frame pool");
+        return false;
+    }
+
+    // 分配数据包
+    m_packet = av_packet_alloc();
+    if (!m_packet)
+    {
+        LOG_ERROR("Could not allocate packet");
+        return false;
+    }
+
+    // 图像格式转换器按实际输入尺寸在bgraToAVFrame中从缓存获取
+    // 因为分辨率可能被对齐，需要在转换时确定正确的参数
+
+    m_hwAccelName = hwAccel;
+    m_openFps = m_fps;
+    return true;
+}
+
+EncodedVideoFrame FFmpegEncoder::encodeFrame(const QImage &image, qint64 captureTimeUs)
+{
+    // 小端机器上RGB32/ARGB32的内存布局即BGRA，可直接送入转换
+    QImage bgraImage = image;
+    if (bgraImage.format() != QImage::Format_RGB32 && bgraImage.format() != QImage::Format_ARGB32 &&
+        bgraImage.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        bgraImage = bgraImage.convertToFormat(QImage::Format_RGB32);
+    }
+    return encodeFrame(bgraImage.constBits(), bgraImage.width(), bgraImage.height(),
+                       static_cast<int>(bgraImage.bytesPerLine()), captureTimeUs);
+}
+
+EncodedVideoFrame FFmpegEncoder::encodeFrame(const uchar *bgra, int width, int height, int stride,
+                                           qint64 captureTimeUs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+
+    EncodedVideoFrame result;
+    // 转成微秒；帧率在运行中改变时从改变点重新起算，保证时间戳连续
+    quint64 timestamp_us = m_timestampBaseUs + (m_pts - m_ptsBase) * (1000000 / m_fps);
+
+    if (!m_initialized)
+    {
+        LOG_ERROR("Encoder not initialized");
+        return result;
+    }
+
+    // 不预先缩放，让FFmpeg的SwsContext在颜色转换时一并处理分辨率变化
+    // 返回的是m_frame（缓冲来自帧池），送入编码器后解除引用，缓冲自动回到池中
+    AVFrame *inputFrame = bgraToAVFrame(bgra, width, height, stride);
+
+    if (!inputFrame)
+    {
+        LOG_ERROR("Failed to convert BGRA pixels to AVFrame with scaling");
+        return result;
+    }
+
+    AVFrame *encodingFrame = inputFrame;
+
+    // 如果使用硬件加速，需要将软件帧传输到硬件
+    if (m_hwPixelFormat != AV_PIX_FMT_NONE && m_hwDeviceCtx)
+    {
+        encodingFrame = transferToHardware(inputFrame);
+        if (!encodingFrame)
+        {
+            av_frame_unref(m_frame);
+            LOG_ERROR("Failed to transfer frame to hardware");
+            return result;
+        }
+    }
+
+    // 强制第一帧为关键帧，并确保包含SPS/PPS参数集
+    // 之后只在接收端请求（PLI/FIR/keyframe_request）时插入，短时间内的多次请求合并为一个IDR
+    bool needKeyFrame = (m_frameCount == 0);
+    if (!needKeyFrame && m_keyFrameRequested.load() &&
+        (!m_lastKeyFrameTimer.isValid() || m_lastKeyFrameTimer.elapsed() >= m_keyFrameMinIntervalMs))
+    {
+        LOG_INFO("Forcing IDR on key frame request");
+        needKeyFrame = true;
+    }
+    if (needKeyFrame)
+    {
+        m_keyFrameRequested = false;
+        m_lastKeyFrameTimer.start();
+    }
+
+    if (needKeyFrame)
+    {
+        encodingFrame->pict_type = AV_PICTURE_TYPE_I;
+
+        // 注意：部分 FFmpeg 版本的 AVFrame 没有 key_frame 字段（例如 4.4 系列头文件）。
+        // 这里用 flags 做兼容标记；真正强制 IDR 主要依赖 pict_type + 编码器侧参数/请求。
+#ifdef AV_FRAME_FLAG_KEY
+        encodingFrame->flags |= AV_FRAME_FLAG_KEY;
+#endif
+
+        // 对于libx264，强制立即输出关键帧
+        if (m_hwAccelName.isEmpty())
+        {
+            encodingFrame->pict_type = AV_PICTURE_TYPE_I;
+        }
+    }
+
+    // 按分块变化图调整各区域QP：libx264/libx265/libvpx/qsv读取ROI旁路数据，其余编码器忽略
+    // 精修帧没有逐帧QP接口，按上一帧的QP换算成变化块的偏移
+    const TileChanges tileChanges = takeTileChanges();
+    const int refinementQp = takeRefinementQp();
+    int focusOffset = m_roi.focusQpOffset;
+    if (refinementQp >= 0)
+    {
+        focusOffset = m_lastQp >= 0 ? qBound(-51, refinementQp - m_lastQp, 0) : -12;
+    }
+    if (tileChanges.isValid() &&
+        !tileChanges.attachRegionsOfInterest(encodingFrame, focusOffset, m_roi.staticQpOffset))
+    {
+        LOG_WARN("Failed to attach regions of interest to video frame");
+    }
+
+    // 编码帧
+    int ret = avcodec_send_frame(m_codecContext, encodingFrame);
+
+    // 编码器已持有自己需要的引用，这里只解除本地引用
+    av_frame_unref(m_frame);
+    av_frame_unref(m_hwFrame);
+
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        LOG_ERROR("Error sending frame to encoder: {}", errbuf);
+        return result;
+    }
+
+    // 接收编码后的全部数据包，只移动缓冲引用，不拷贝数据
+    while (ret >= 0)
+    {
+        ret = avcodec_receive_packet(m_codecContext, m_packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        {
+            break;
+        }
+        else if (ret < 0)
+        {
+            char errbuf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            LOG_ERROR("Error receiving packet from encoder: {}", errbuf);
+            break;
+        }
+        // libx264/libx265/nvenc/qsv等会在数据包上附带本帧QP（lambda刻度）
+#if LIBAVCODEC_VERSION_MAJOR >= 59
+        size_t statsSize = 0;
+#else
+        int statsSize = 0;
+#endif
+        const uint8_t *qualityStats = av_packet_get_side_data(m_packet, AV_PKT_DATA_QUALITY_STATS, &statsSize);
+        if (qualityStats && statsSize >= 4)
+        {
+            result.setQp(static_cast<int>(AV_RL32(qualityStats) / FF_QP2LAMBDA));
+        }
+        result.appendPacket(m_packet);
+        av_packet_unref(m_packet);
+    }
+
+    if (result.isEmpty())
+    {
+        LOG_DEBUG("No encoded data produced (encoder buffering)");
+        return result;
+    }
+
+    // 增加帧计数
+    m_frameCount++;
+    if (result.qp() >= 0)
+    {
+        m_lastQp = result.qp();
+    }
+    recordFrameSize(static_cast<int>(result.size()), result.isKeyFrame(), result.qp());
+
+    result.setTimestampUs(timestamp_us);
+    result.setCaptureTimeUs(captureTimeUs);
+    result.setEncodeDurationUs(encodeTimer.nsecsElapsed() / 1000);
+
+    return result;
+}
+
+AVFrame *FFmpegEncoder::bgraToAVFrame(const uchar *bgra, int width, int height, int stride)
+{
+    // 缓冲从帧池中取，不再每帧分配，像素格式与编码器输入一致
+    AVFrame *frame = m_frame;
+    if (!m_framePool.getFrame(frame))
+    {
+        LOG_ERROR("Could not get video frame from pool");
+        return nullptr;
+    }
+
+    // 确保帧时间基准设置正确
+    frame->pts = m_pts++;
+
+    // 同尺寸或宽高正好减半时走SIMD转换，其它缩放比例交给swscale
+    int downscale = ColorConverter::downscaleFactor(width, height, m_width, m_height);
+    if (downscale > 0 && m_inputPixelFormat == AV_PIX_FMT_NV12 &&
+        m_colorConverter->convertToNv12(bgra, width, height, stride, downscale, frame->data[0], frame->linesize[0],
+                                        frame->data[1], frame->linesize[1]))
+    {
+        return frame;
+    }
+
+    // BGRA数据指针
+    const uint8_t *srcData[1] = {bgra};
+    int srcLinesize[1] = {stride};
+
+    // 按(输入尺寸, 编码尺寸)取缓存的SwsContext，尺寸来回切换时不再重建
+    SwsContext *swsContext = m_swsCache.get(width, height, AV_PIX_FMT_BGRA, m_width, m_height, m_inputPixelFormat);
+    if (!swsContext)
+    {
+        LOG_ERROR("SwsContext creation failed for BGRA to {} conversion ({}x{} -> {}x{})",
+                  av_get_pix_fmt_name(m_inputPixelFormat), width, height, m_width, m_height);
+        av_frame_unref(frame);
+        return nullptr;
+    }
+
+    // 转换BGRA到编码器输入格式（同时进行缩放）
+    int swsRet = sws_scale(swsContext,
+                           srcData, srcLinesize, 0, height, // 使用输入图像的高度
+                           frame->data, frame->linesize);
+
+    if (swsRet != m_height)
+    { // 输出应该是编码器的高度
+        LOG_ERROR("sws_scale failed: expected {} lines, got {}", m_height, swsRet);
+        av_frame_unref(frame);
+        return nullptr;
+    }
+
+    return frame;
+}
+
+AVFrame *FFmpegEncoder::transferToHardware(AVFrame *swFrame)
+{
+    if (!m_hwDeviceCtx || m_hwPixelFormat == AV_PIX_FMT_NONE)
+    {
+        // 不需要硬件传输，直接使用原帧
+        return swFrame;
+    }
+
+    // 检查硬件帧上下文是否有效
+    if (!m_codecContext || !m_codecContext->hw_frames_ctx)
+    {
+        LOG_WARN("Hardware frames context not available, falling back to software frame");
+        return swFrame;
+    }
+
+    // 硬件帧缓冲来自hw_frames_ctx自带的池
+    AVFrame *hwFrame = m_hwFrame;
+    int ret = av_hwframe_get_buffer(m_codecContext->hw_frames_ctx, hwFrame, 0);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        LOG_ERROR("Failed to allocate hardware frame buffer: {}", errbuf);
+        return nullptr;
+    }
+
+    // 设置硬件帧属性（在分配缓冲区后）
+    hwFrame->width = m_codecContext->width;
+    hwFrame->height = m_codecContext->height;
+    hwFrame->pts = swFrame->pts;
+
+    // 如果软件帧尺寸与硬件帧尺寸不同，需要先缩放（缩放帧同样来自帧池）
+    AVFrame *scaledFrame = swFrame;
+    if (swFrame->width != hwFrame->width || swFrame->height != hwFrame->height)
+    {
+        AVPixelFormat swFormat = static_cast<AVPixelFormat>(swFrame->format);
+        if (!m_scaledFramePool.isValid() || m_scaledFramePool.width() != hwFrame->width ||
+            m_scaledFramePool.height() != hwFrame->height || m_scaledFramePool.format() != swFormat)
+        {
+            if (!m_scaledFramePool.init(swFormat, hwFrame->width, hwFrame->height, kFramePoolDepth))
+            {
+                LOG_ERROR("Could not allocate scaled frame pool");
+                av_frame_unref(hwFrame);
+                return nullptr;
+            }
+        }
+
+        // 缩放帧的外壳只分配一次，缓冲每帧从池中取
+        scaledFrame = m_scaledFrame;
+        if (!m_scaledFramePool.getFrame(scaledFrame))
+        {
+            LOG_ERROR("Failed to get scaled frame from pool");
+            av_frame_unref(hwFrame);
+            return nullptr;
+        }
+
+        SwsContext *swsContext = m_swsCache.get(swFrame->width, swFrame->height, swFormat,
+                                                scaledFrame->width, scaledFrame->height, swFormat);
+        if (!swsContext)
+        {
+            LOG_ERROR("Failed to create sws context for scaling");
+            av_frame_unref(scaledFrame);
+            av_frame_unref(hwFrame);
+            return nullptr;
+        }
+
+        sws_scale(swsContext,
+                  swFrame->data, swFrame->linesize, 0, swFrame->height,
+                  scaledFrame->data, scaledFrame->linesize);
+    }
+
+    // 传输数据到硬件帧
+    ret = av_hwframe_transfer_data(hwFrame, scaledFrame, 0);
+
+    // 缩放帧的缓冲回到池中
+    if (scaledFrame != swFrame)
+    {
+        av_frame_unref(scaledFrame);
+    }
+
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        LOG_ERROR("Failed to transfer data to hardware frame: {}", errbuf);
+        av_frame_unref(hwFrame);
+        return nullptr;
+    }
+
+    return hwFrame;
+}
+
+bool FFmpegEncoder::initializeHardwareAccel(const QString &hwAccel)
+{
+    if (!m_codecContext)
+    {
+        LOG_ERROR("initializeHardwareAccel called with null codec context");
+        return false;
+    }
+
+    // QSV 单独走（它对 hw_frames_ctx/对齐更敏感）
+    if (hwAccel == "qsv")
+    {
+        return initializeQSV();
+    }
+
+    // 关键修正：NVENC/AMF/MF/D3D12VA 这类编码器绝大多数期望的是 system-memory NV12 输入，
+    // 不需要也不应该配置 hw_frames_ctx，更不要把 pix_fmt 设成 CUDA/VAAPI 等硬件像素格式。
+    // 否则 avcodec_send_frame() 很容易报 "Generic error in an external library"。
+
+    // 先默认走“软件帧输入”（NV12）
+    m_hwPixelFormat = AV_PIX_FMT_NONE;
+    m_codecContext->pix_fmt = AV_PIX_FMT_NV12;
+
+    // 分辨率对齐：保守处理，避免硬编吃不下（尤其是 NVENC/D3D12VA 对奇数分辨率很敏感）
+    if ((m_codecContext->width % 16 != 0) || (m_codecContext->height % 16 != 0))
+    {
+        int w = m_codecContext->width & ~15;
+        int h = m_codecContext->height & ~15;
+        LOG_WARN("Aligning HW encoder resolution from {}x{} to {}x{}", m_codecContext->width, m_codecContext->height, w, h);
+        m_codecContext->width = w;
+        m_codecContext->height = h;
+        m_width = w;
+        m_height = h;
+    }
+
+    // 仅对明确需要 hwframe 的编码器才去创建/绑定 hwdevice + hwframes。
+    // Windows 常见：
+    // - h264_nvenc / h264_mf / h264_d3d12va : NV12 system-memory
+    // - h264_vaapi / h264_videotoolbox     : 通常需要 hw pix_fmt
+    bool needHwFrames = false;
+
+    if (hwAccel == "vaapi")
+    {
+        needHwFrames = true;
+        m_hwPixelFormat = AV_PIX_FMT_VAAPI;
+        m_codecContext->pix_fmt = m_hwPixelFormat;
+    }
+    else if (hwAccel == "videotoolbox")
+    {
+        needHwFrames = true;
+        m_hwPixelFormat = AV_PIX_FMT_VIDEOTOOLBOX;
+        m_codecContext->pix_fmt = m_hwPixelFormat;
+    }
+    else if (hwAccel == "cuda")
+    {
+        // h264_cuda 很少见且行为与 nvenc 不同；若用户真要走它，则按 hwframe 路径处理。
+        needHwFrames = true;
+        m_hwPixelFormat = AV_PIX_FMT_CUDA;
+        m_codecContext->pix_fmt = m_hwPixelFormat;
+    }
+
+    if (needHwFrames)
+    {
+        m_hwDeviceCtx = HardwareContextManager::instance().getDeviceContext(hwAccel);
+        if (!m_hwDeviceCtx)
+        {
+            LOG_ERROR("Failed to create/get hardware device context for {}", hwAccel);
+            m_hwPixelFormat = AV_PIX_FMT_NONE;
+            m_codecContext->pix_fmt = AV_PIX_FMT_NV12;
+            return false;
+        }
+
+        m_codecContext->hw_device_ctx = av_buffer_ref(m_hwDeviceCtx);
+        if (!m_codecContext->hw_device_ctx)
+        {
+            LOG_ERROR("Failed to ref hw_device_ctx for {}", hwAccel);
+            return false;
+        }
+
+        AVBufferRef *hwFramesRef = av_hwframe_ctx_alloc(m_hwDeviceCtx);
+        if (!hwFramesRef)
+        {
+            LOG_ERROR("Failed to allocate hwframe context for {}", hwAccel);
+            return false;
+        }
+
+        AVHWFramesContext *framesCtx = reinterpret_cast<AVHWFramesContext *>(hwFramesRef->data);
+        framesCtx->format = m_hwPixelFormat;
+        framesCtx->sw_format = AV_PIX_FMT_NV12;
+        framesCtx->width = m_codecContext->width;
+        framesCtx->height = m_codecContext->height;
+        framesCtx->initial_pool_size = 20;
+
+        int ret = av_hwframe_ctx_init(hwFramesRef);
+        if (ret < 0)
+        {
+            char errbuf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            LOG_ERROR("Failed to init hwframe context for {}: {}", hwAccel, errbuf);
+            av_buffer_unref(&hwFramesRef);
+            return false;
+        }
+
+        m_codecContext->hw_frames_ctx = hwFramesRef;
+    }
+
+    // 硬编专有参数（稳定优先、低延迟）
+    if (hwAccel == "nvenc")
+    {
+        // 说明：不同 FFmpeg/NVENC 版本可用值不同；这里选择相对保守且广泛支持的取值
+        av_opt_set(m_codecContext->priv_data, "preset", "p4", 0);
+        av_opt_set(m_codecContext->priv_data, "tune", "ll", 0);
+        av_opt_set(m_codecContext->priv_data, "forced-idr", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "repeat-headers", "1", 0);
+
+        // 明确 profile，避免某些驱动/构建默认高 profile 导致兼容性问题
+        if (m_videoCodec == VideoCodec::H264)
+        {
+            av_opt_set(m_codecContext->priv_data, "profile", "baseline", 0);
+        }
+
+        // 若驱动支持，启用 0-latency（不支持会被忽略/返回错误，FFmpeg 不会因此崩）
+        av_opt_set(m_codecContext->priv_data, "zerolatency", "1", 0);
+    }
+    else if (hwAccel == "amf")
+    {
+        av_opt_set(m_codecContext->priv_data, "usage", "lowlatency", 0);
+        av_opt_set(m_codecContext->priv_data, "repeat-headers", "1", 0);
+        if (m_videoCodec == VideoCodec::H264)
+        {
+            av_opt_set(m_codecContext->priv_data, "profile", "baseline", 0);
+        }
+    }
+    else if (hwAccel == "mf")
+    {
+        // MF 通常吃 NV12 system-memory
+        m_codecContext->pix_fmt = AV_PIX_FMT_NV12;
+    }
+    else if (hwAccel == "d3d12va")
+    {
+        // d3d12va 编码器同样通常吃 NV12 system-memory
+        m_codecContext->pix_fmt = AV_PIX_FMT_NV12;
+    }
+    else if (hwAccel == "vaapi")
+    {
+        av_opt_set(m_codecContext->priv_data, "low_power", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "idr_interval", "1", 0);
+    }
+
+    m_codecContext->max_b_frames = 0;
+
+    LOG_INFO("Hardware encoder pre-configured: hwAccel={}, pix_fmt={}, hwPixFmt={}, hwFramesCtx={}",
+             hwAccel,
+             av_get_pix_fmt_name(m_codecContext->pix_fmt),
+             (m_hwPixelFormat == AV_PIX_FMT_NONE ? "none" : av_get_pix_fmt_name(m_hwPixelFormat)),
+             (m_codecContext->hw_frames_ctx ? "yes" : "no"));
+
+    return true;
+}
+
+bool FFmpegEncoder::initializeQSV()
+{
+    if (!m_codecContext)
+    {
+        return false;
+    }
+
+    // QSV 对分辨率对齐很敏感：按 16 对齐
+    int alignedW = m_codecContext->width & ~15;
+    int alignedH = m_codecContext->height & ~15;
+    if (alignedW != m_codecContext->width || alignedH != m_codecContext->height)
+    {
+        LOG_WARN("Aligning QSV resolution from {}x{} to {}x{}", m_codecContext->width, m_codecContext->height, alignedW, alignedH);
+        m_codecContext->width = alignedW;
+        m_codecContext->height = alignedH;
+        m_width = alignedW;
+        m_height = alignedH;
+    }
+
+    // QSV：优先走 NV12 system-memory 输入（更兼容，避免复杂的 hwframe 管线）
+    m_codecContext->pix_fmt = AV_PIX_FMT_NV12;
+    m_hwPixelFormat = AV_PIX_FMT_NONE;
+
+    // QSV 常用稳定参数（不一定每个 build 都支持，设置失败不会致命）
+    av_opt_set(m_codecContext->priv_data, "async_depth", "1", 0);
+    av_opt_set(m_codecContext->priv_data, "look_ahead", "0", 0);
+    av_opt_set(m_codecContext->priv_data, "b", "0", 0);
+    av_opt_set(m_codecContext->priv_data, "bf", "0", 0);
+    av_opt_set(m_codecContext->priv_data, "repeat-headers", "1", 0);
+    // QSV的GOP长度是16位整数，取最大值；关键帧靠按需请求
+    m_codecContext->gop_size = 0xFFFF;
+
+    LOG_INFO("QSV encoder pre-configured: pix_fmt=NV12, aligned {}x{}", m_codecContext->width, m_codecContext->height);
+    return true;
+}
+
+bool FFmpegEncoder::reconfigure(int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_initialized || !m_codecContext)
+    {
+        LOG_WARN("Cannot reconfigure encoder - not initialized");
+        return false;
+    }
+
+    fps = qBound(1, fps, 60);
+    if (bitrate <= 0)
+    {
+        bitrate = m_bitrate;
+    }
+
+    // 编码尺寸与initializeCodec一致按16对齐
+    bool sizeChanged = (width & ~15) != m_width || (height & ~15) != m_height;
+
+    if (fps != m_fps)
+    {
+        m_timestampBaseUs += static_cast<quint64>(m_pts - m_ptsBase) * (1000000 / m_fps);
+        m_ptsBase = m_pts;
+        m_fps = fps;
+    }
+    m_bitrate = bitrate;
+
+    if (!sizeChanged && supportsDynamicBitrate())
+    {
+        // 编码器仍按打开时的帧率分配每帧码率，实际帧率变化通过等比例调整码率来补偿
+        int64_t codecBitrate = static_cast<int64_t>(m_bitrate) * m_openFps / m_fps;
+        // 按质量编码时bit_rate不参与码率控制，只调整上限
+        if (m_rateControl.mode == RateControlMode::Cbr)
+        {
+            m_codecContext->bit_rate = codecBitrate;
+        }
+        if (m_codecContext->rc_max_rate > 0)
+        {
+            m_codecContext->rc_max_rate = codecBitrate;
+            m_codecContext->rc_buffer_size = static_cast<int>(codecBitrate / m_openFps * m_rateControl.vbvFrames);
+        }
+        LOG_INFO("Encoder reconfigured in place: {}fps, {}bps (codec bitrate {} at {}fps)", m_fps, m_bitrate,
+                 codecBitrate, m_openFps);
+        return true;
+    }
+
+    return reopenCodec(width, height);
+}
+
+void FFmpegEncoder::requestKeyFrame()
+{
+    m_keyFrameRequested = true;
+}
+
+bool FFmpegEncoder::supportsDynamicBitrate() const
+{
+    // 这两个封装在avcodec_send_frame时检测到码率变化会自行重新配置，其它编码器需要重新打开
+    if (!m_codec)
+    {
+        return false;
+    }
+    QString name = QString::fromUtf8(m_codec->name);
+    return name == "libx264" || name == "h264_nvenc";
+}
+
+bool FFmpegEncoder::reopenCodec(int width, int height)
+{
+    QString hwAccel = m_hwAccelName;
+    LOG_INFO("Reopening {} encoder: {}x{} -> {}x{}, {}fps, {}bps",
+             hwAccel.isEmpty() ? "software" : hwAccel, m_width, m_height, width, height, m_fps, m_bitrate);
+
+    // 硬件设备上下文由HardwareContextManager持有，重新打开时直接复用，不会重新创建设备
+    closeCodec();
+    m_width = width;
+    m_height = height;
+
+    bool success = initializeCodec(hwAccel);
+    if (!success && !hwAccel.isEmpty())
+    {
+        LOG_WARN("Failed to reopen {} encoder, falling back to software encoding", hwAccel);
+        closeCodec();
+        m_width = width;
+        m_height = height;
+        success = initializeCodec();
+    }
+
+    if (!success)
+    {
+        LOG_ERROR("Failed to reopen encoder at {}x{}", width, height);
+        closeCodec();
+        m_initialized = false;
+        return false;
+    }
+
+    // 新参数集必须随IDR一起下发，解码端才能切换分辨率
+    m_frameCount = 0;
+    m_initialized = true;
+    return true;
+}
+
+bool FFmpegEncoder::supportsRegionQp() const
+{
+    // nvenc/vaapi/amf/mf等忽略AV_FRAME_DATA_REGIONS_OF_INTEREST
+    static const char *const kRoiEncoders[] = {"libx264", "libx265", "libvpx-vp9", "h264_qsv", "hevc_qsv"};
+    if (!m_codec)
+    {
+        return false;
+    }
+    for (const char *name : kRoiEncoders)
+    {
+        if (std::strcmp(m_codec->name, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+quint64 FFmpegEncoder::framePoolAllocations() const
+{
+    return m_framePool.allocations() + m_scaledFramePool.allocations();
+}
+
+void FFmpegEncoder::configureIntraRefresh(const QString &hwAccel)
+{
+    // 帧内刷新：每帧编码一列帧内宏块，period帧后整幅画面刷新一次，不再需要完整的IDR
+    // 首帧和重新打开编码器后仍然是IDR
+    const QByteArray period = QByteArray::number(m_intraRefreshPeriod);
+    int ret = AVERROR_OPTION_NOT_FOUND;
+
+    if (m_videoCodec != VideoCodec::H264)
+    {
+        // 其它格式的编码器没有统一的帧内刷新选项
+    }
+    else if (hwAccel.isEmpty())
+    {
+        // libx264以keyint作为刷新周期；关键帧请求改为开始新一轮刷新而不是IDR
+        m_codecContext->gop_size = m_intraRefreshPeriod;
+        m_codecContext->keyint_min = qMin(m_codecContext->keyint_min, m_intraRefreshPeriod / 2);
+        ret = av_opt_set(m_codecContext->priv_data, "intra-refresh", "1", 0);
+        if (ret >= 0)
+        {
+            av_opt_set(m_codecContext->priv_data, "forced-idr", "0", 0);
+        }
+    }
+    else if (hwAccel == "nvenc")
+    {
+        // nvenc的刷新周期取gop_size，GOP本身保持无限长
+        ret = av_opt_set(m_codecContext->priv_data, "intra-refresh", "1", 0);
+        if (ret >= 0)
+        {
+            m_codecContext->gop_size = m_intraRefreshPeriod;
+        }
+    }
+    else if (hwAccel == "qsv")
+    {
+        ret = av_opt_set(m_codecContext->priv_data, "int_ref_type", "vertical", 0);
+        if (ret >= 0)
+        {
+            av_opt_set(m_codecContext->priv_data, "int_ref_cycle_size", period.constData(), 0);
+            av_opt_set(m_codecContext->priv_data, "recovery_point_sei", "1", 0);
+        }
+    }
+    else if (hwAccel == "amf")
+    {
+        // AMF按每帧刷新的宏块数配置
+        int macroblocks = ((m_codecContext->width + 15) / 16) * ((m_codecContext->height + 15) / 16);
+        int perFrame = (macroblocks + m_intraRefreshPeriod - 1) / m_intraRefreshPeriod;
+        ret = av_opt_set_int(m_codecContext->priv_data, "intra_refresh_mb", perFrame, 0);
+    }
+
+    if (ret < 0)
+    {
+        LOG_WARN("Intra refresh is not supported by {} encoder, using key frames only", m_codec->name);
+        return;
+    }
+    LOG_INFO("Intra refresh enabled for {} encoder, period {} frames", m_codec->name, m_intraRefreshPeriod);
+}
+
+void FFmpegEncoder::configureSoftwareEncoder(const QString &codecName)
+{
+    // 各软件编码器的低延迟配置：不做前瞻、不引入重排序帧，请求的关键帧立即生效
+    if (codecName == "libx264")
+    {
+        av_opt_set(m_codecContext->priv_data, "preset", "fast", 0);
+        av_opt_set(m_codecContext->priv_data, "tune", "zerolatency", 0);
+        av_opt_set(m_codecContext->priv_data, "profile", "baseline", 0); // 使用baseline profile提高兼容性
+        av_opt_set(m_codecContext->priv_data, "forced-idr", "1", 0);     // 请求的关键帧必须是IDR
+    }
+    else if (codecName == "libx265")
+    {
+        av_opt_set(m_codecContext->priv_data, "preset", "ultrafast", 0);
+        av_opt_set(m_codecContext->priv_data, "tune", "zerolatency", 0);
+        av_opt_set(m_codecContext->priv_data, "forced-idr", "1", 0);
+        // 每个IDR前重复VPS/SPS/PPS，关闭场景切换检测，与H264按需关键帧的行为一致
+        av_opt_set(m_codecContext->priv_data, "x265-params", "repeat-headers=1:scenecut=0:info=0", 0);
+    }
+    else if (codecName == "libvpx-vp9")
+    {
+        av_opt_set(m_codecContext->priv_data, "deadline", "realtime", 0);
+        av_opt_set(m_codecContext->priv_data, "cpu-used", "8", 0);
+        av_opt_set(m_codecContext->priv_data, "lag-in-frames", "0", 0);
+        av_opt_set(m_codecContext->priv_data, "row-mt", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "tile-columns", "2", 0);
+        av_opt_set(m_codecContext->priv_data, "aq-mode", "3", 0);
+        av_opt_set(m_codecContext->priv_data, "tune-content", "screen", 0);
+    }
+    else if (codecName == "libsvtav1")
+    {
+        // preset 10以上才能满足实时编码；pred-struct=1为低延迟结构，scm=1开启屏幕内容工具
+        av_opt_set(m_codecContext->priv_data, "preset", "10", 0);
+        av_opt_set(m_codecContext->priv_data, "svtav1-params", "pred-struct=1:scm=1", 0);
+    }
+    else if (codecName == "libaom-av1")
+    {
+        av_opt_set(m_codecContext->priv_data, "usage", "realtime", 0);
+        av_opt_set(m_codecContext->priv_data, "cpu-used", "8", 0);
+        av_opt_set(m_codecContext->priv_data, "lag-in-frames", "0", 0);
+        av_opt_set(m_codecContext->priv_data, "row-mt", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "tile-columns", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "tile-rows", "1", 0);
+        av_opt_set(m_codecContext->priv_data, "aq-mode", "3", 0);
+        av_opt_set(m_codecContext->priv_data, "tune-content", "screen", 0);
+    }
+}
+
+void FFmpegEncoder::configureRateControl(const QString &hwAccel)
+{
+    // VBV按帧数计：1帧时单帧大小基本不超过 码率/帧率，不会因关键帧或大面积变化产生突发
+    const RateControlMode mode = m_rateControl.mode;
+    const bool capped = mode != RateControlMode::Quality;
+    const int vbvSize = static_cast<int>(static_cast<int64_t>(m_bitrate) / qMax(1, m_fps) * m_rateControl.vbvFrames);
+    const int quality = m_rateControl.quality;
+    void *opts = m_codecContext->priv_data;
+
+    m_codecContext->bit_rate = m_bitrate;
+    m_codecContext->rc_max_rate = capped ? m_bitrate : 0;
+    m_codecContext->rc_buffer_size = capped ? vbvSize : 0;
+    m_codecContext->rc_min_rate = 0;
+
+    bool supported = true;
+    if (hwAccel.isEmpty())
+    {
+        const QString name = QString::fromUtf8(m_codec->name);
+        // VP9/AV1编码器的CRF是0-63
+        const bool crf63 = name == "libvpx-vp9" || name == "libaom-av1" || name == "libsvtav1";
+        const QByteArray crf = QByteArray::number(crf63 ? quality * 63 / 51 : quality);
+        if (mode == RateControlMode::Cbr)
+        {
+            if (name == "libvpx-vp9" || name == "libaom-av1")
+            {
+                m_codecContext->rc_min_rate = m_bitrate; // 最小码率等于最大码率即CBR
+            }
+        }
+        else
+        {
+            // libx264/libx265的CRF优先于bit_rate；libvpx/libaom在bit_rate为0时才是纯质量模式
+            av_opt_set(opts, "crf", crf.constData(), 0);
+            if (mode == RateControlMode::Quality)
+            {
+                m_codecContext->bit_rate = 0;
+            }
+        }
+    }
+    else if (hwAccel == "nvenc")
+    {
+        if (mode == RateControlMode::Cbr)
+        {
+            av_opt_set(opts, "rc", "cbr", 0);
+        }
+        else
+        {
+            // 目标质量的VBR：bit_rate为0，cq决定质量，maxrate为上限
+            av_opt_set(opts, "rc", "vbr", 0);
+            av_opt_set_int(opts, "cq", quality, 0);
+            m_codecContext->bit_rate = 0;
+        }
+    }
+    else if (hwAccel == "qsv")
+    {
+        // QSV按bit_rate/maxrate/global_quality组合选择CBR、QVBR或ICQ
+        if (mode != RateControlMode::Cbr)
+        {
+            m_codecContext->global_quality = quality;
+            if (mode == RateControlMode::Quality)
+            {
+                m_codecContext->bit_rate = 0;
+            }
+        }
+    }
+    else if (hwAccel == "amf")
+    {
+        if (mode == RateControlMode::Cbr)
+        {
+            av_opt_set(opts, "rc", "cbr", 0);
+        }
+        else if (mode == RateControlMode::CappedCrf)
+        {
+            if (av_opt_set(opts, "rc", "qvbr", 0) >= 0)
+            {
+                av_opt_set_int(opts, "qvbr_quality_level", quality, 0);
+            }
+            else
+            {
+                av_opt_set(opts, "rc", "vbr_peak", 0); // 旧版AMF没有QVBR，退回峰值受限VBR
+            }
+        }
+        else
+        {
+            av_opt_set(opts, "rc", "cqp", 0);
+            av_opt_set_int(opts, "qp_i", quality, 0);
+            av_opt_set_int(opts, "qp_p", quality, 0);
+        }
+    }
+    else if (hwAccel == "vaapi" || hwAccel == "d3d12va")
+    {
+        const char *rcMode[] = {"CBR", "QVBR", "CQP"};
+        av_opt_set(opts, "rc_mode", rcMode[static_cast<int>(mode)], 0);
+        if (mode != RateControlMode::Cbr)
+        {
+            m_codecContext->global_quality = quality;
+        }
+    }
+    else if (hwAccel == "mf")
+    {
+        const char *rateControl[] = {"cbr", "pc_vbr", "quality"};
+        av_opt_set(opts, "rate_control", rateControl[static_cast<int>(mode)], 0);
+    }
+    else
+    {
+        supported = mode == RateControlMode::Cbr;
+    }
+
+    if (!supported)
+    {
+        LOG_WARN("{} rate control is not supported by {} encoder, using bitrate mode",
+                 RateControlSettings::modeName(mode), hwAccel);
+    }
+    LOG_INFO("Rate control {}: {}bps, max {}bps, VBV {} bytes, quality {}", RateControlSettings::modeName(mode),
+             m_codecContext->bit_rate, m_codecContext->rc_max_rate, m_codecContext->rc_buffer_size / 8, quality);
+}
+
+void FFmpegEncoder::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pts = 0;
+    m_ptsBase = 0;
+    m_timestampBaseUs = 0;
+    m_frameCount = 0;
+}
+
+void FFmpegEncoder::closeCodec()
+{
+    if (m_packet)
+    {
+        av_packet_free(&m_packet);
+        m_packet = nullptr;
+    }
+
+    // 帧外壳上可能还挂着池中的缓冲，先解除引用再释放池
+    if (m_frame)
+    {
+        av_frame_unref(m_frame);
+    }
+    if (m_hwFrame)
+    {
+        av_frame_unref(m_hwFrame);
+    }
+    if (m_scaledFrame)
+    {
+        av_frame_unref(m_scaledFrame);
+    }
+    m_framePool.reset();
+    m_scaledFramePool.reset();
+
+    if (m_codecContext)
+    {
+        avcodec_free_context(&m_codecContext);
+        m_codecContext = nullptr;
+    }
+
+    // 释放硬件设备上下文的引用（共享管理器会处理实际的释放）
+    if (m_hwDeviceCtx)
+    {
+        av_buffer_unref(&m_hwDeviceCtx);
+        m_hwDeviceCtx = nullptr;
+    }
+
+    // 释放 BSF
+    if (m_h264Bsf)
+    {
+        av_bsf_free(&m_h264Bsf);
+        m_h264Bsf = nullptr;
+    }
+
+    m_codec = nullptr;
+    m_hwPixelFormat = AV_PIX_FMT_NONE;
+    m_hwAccelName.clear();
+}
+
+void FFmpegEncoder::cleanup()
+{
+    closeCodec();
+
+    if (m_frame)
+    {
+        av_frame_free(&m_frame);
+        m_frame = nullptr;
+    }
+
+    if (m_hwFrame)
+    {
+        av_frame_free(&m_hwFrame);
+        m_hwFrame = nullptr;
+    }
+
+    if (m_scaledFrame)
+    {
+        av_frame_free(&m_scaledFrame);
+        m_scaledFrame = nullptr;
+    }
+
+    m_swsCache.clear();
+    m_initialized = false;
+
+    LOG_DEBUG("FFmpegEncoder cleanup completed");
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#ifndef FFMPEG_ENCODER_H
+#define FFMPEG_ENCODER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QObject>
+#include <atomic>
+#include <memory>
+#include <rtc/rtc.hpp>
+
+#include "frame_pool.h"
+#include "video_encoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+#include <libavcodec/bsf.h>
+}
+
+class ColorConverter;
+
+#ifndef AV_ERROR_MAX_STRING_SIZE
+#define AV_ERROR_MAX_STRING_SIZE 64
+#endif
+
+// FFmpeg编码后端：优先硬件编码，软件编码兜底（libx264/libx265/libvpx-vp9/SVT-AV1/libaom）
+class FFmpegEncoder : public QObject, public VideoEncoder {
+  Q_OBJECT
+
+public:
+  explicit FFmpegEncoder(VideoCodec codec = VideoCodec::H264,
+                         QObject *parent = nullptr);
+  ~FFmpegEncoder();
+
+  // 初始化编码器
+  bool initialize(int width, int height, int fps = 30,
+                  int bitrate = 2000000) override;
+  // 按给定顺序尝试编码器，空字符串为软件编码；不会自动追加其它候选
+  bool initializeWith(const QStringList &hwAccels, int width, int height,
+                      int fps, int bitrate);
+
+  // 编码QImage为一帧码流，captureTimeUs为该帧的捕获时刻
+  EncodedVideoFrame encodeFrame(const QImage &image, qint64 captureTimeUs = 0);
+  // 编码32位BGRA原始像素（捕获后端输出），尺寸不同时由颜色转换同时缩放
+  EncodedVideoFrame encodeFrame(const uchar *bgra, int width, int height,
+                                int stride, qint64 captureTimeUs = 0) override;
+
+  // 运行中调整编码参数：尺寸不变且编码器支持时就地修改码率/帧率，
+  // 否则复用硬件设备快速重新打开编码器，下一帧为IDR
+  bool reconfigure(int width, int height, int fps, int bitrate) override;
+
+  // 请求下一帧编码为IDR，可在任意线程调用
+  void requestKeyFrame() override;
+
+  void reset() override;
+  // 释放资源
+  void cleanup() override;
+
+  QString backendName() const override { return "ffmpeg"; }
+  VideoCodec codec() const override { return m_videoCodec; }
+  // 只有读取ROI旁路数据的编码器（libx264/libx265/libvpx/qsv）
+  bool supportsRegionQp() const override;
+  // 帧池累计分配的缓冲块数，稳定运行时保持不变
+  quint64 framePoolAllocations() const override;
+
+  // 检查硬件加速支持
+  static QStringList getAvailableHWAccels();
+
+private:
+  bool initializeCodec(const QString &hwAccel = QString());
+  bool initializeHardwareAccel(const QString &hwAccel);
+  bool initializeQSV(); // QSV专用初始化
+  AVFrame *bgraToAVFrame(const uchar *bgra, int width, int height, int stride);
+  AVFrame *transferToHardware(AVFrame *swFrame);
+  bool supportsDynamicBitrate() const;
+  bool reopenCodec(int width, int height);
+  void closeCodec(); // 释放与已打开编码器相关的资源，保留帧外壳和缩放上下文缓存
+  void configureIntraRefresh(const QString &hwAccel);
+  void configureSoftwareEncoder(const QString &codecName);
+  // 按m_rateControl设置码率、VBV和CRF/CQ，映射到各软件/硬件编码器的选项
+  void configureRateControl(const QString &hwAccel);
+
+  // FFmpeg 组件
+  AVCodecContext *m_codecContext;
+  const AVCodec *m_codec;
+  AVFrame *m_frame;
+  AVFrame *m_hwFrame;
+  AVFrame *m_scaledFrame; // 缩放帧外壳，缓冲来自m_scaledFramePool
+  AVPacket *m_packet;
+  VideoFramePool m_framePool;       // 编码尺寸的NV12输入帧
+  VideoFramePool m_scaledFramePool; // 硬件帧尺寸与编码尺寸不一致时的缩放帧
+  SwsContextCache m_swsCache;
+  std::unique_ptr<ColorConverter> m_colorConverter; // 同尺寸/2倍下采样的SIMD快速路径
+  AVBufferRef *m_hwDeviceCtx;
+  AVBSFContext *m_h264Bsf;
+
+  // 编码参数
+  VideoCodec m_videoCodec;
+  AVPixelFormat m_inputPixelFormat; // 送入编码器的软件帧格式：NV12，软件编码器不支持时为YUV420P
+  int m_width;
+  int m_height;
+  int m_fps;
+  int m_openFps; // 编码器打开时的帧率（time_base），就地调整帧率时不变
+  int m_bitrate;
+  RateControlSettings m_rateControl;
+  RoiSettings m_roi;
+  int m_lastQp; // 上一帧编码器报告的QP，-1为未知
+  int m_pts;
+  int m_ptsBase;             // 最近一次帧率变化时的m_pts
+  quint64 m_timestampBaseUs; // 最近一次帧率变化时的时间戳
+
+  // 编码状态
+  int m_frameCount; // 已编码帧数
+
+  // 按需关键帧
+  std::atomic<bool> m_keyFrameRequested;
+  QElapsedTimer m_lastKeyFrameTimer; // 距上一个IDR的时间
+  int m_keyFrameMinIntervalMs;       // 两个请求IDR之间的最小间隔
+
+  // 周期帧内刷新
+  bool m_intraRefresh;
+  int m_intraRefreshPeriod; // 一轮刷新的帧数
+
+  // 线程安全
+  QMutex m_mutex;
+
+  // 硬件加速
+  QString m_hwAccelName;
+  enum AVPixelFormat m_hwPixelFormat;
+
+  bool m_initialized;
+};
+
+#endif // FFMPEG_ENCODER_H
@@ -0,0 +1,210 @@
+#include "frame_pool.h"
+#include "logger_manager.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+namespace
+{
+    // 与av_frame_get_buffer相同的行对齐与尾部填充
+    constexpr int kLineAlign = 32;
+    constexpr int kBufferPadding = 64;
+}
+
+VideoFramePool::VideoFramePool()
+    : m_pool(nullptr), m_format(AV_PIX_FMT_NONE), m_width(0), m_height(0), m_depth(0), m_linesize{0, 0, 0, 0},
+      m_allocations(0)
+{
+}
+
+VideoFramePool::~VideoFramePool()
+{
+    reset();
+}
+
+AVBufferRef *VideoFramePool::allocBuffer(void *opaque,
+#if LIBAVUTIL_VERSION_MAJOR < 57
+                                         int size
+#else
+                                         size_t size
+#endif
+)
+{
+    VideoFramePool *self = static_cast<VideoFramePool *>(opaque);
+    AVBufferRef *buffer = av_buffer_alloc(size);
+    if (buffer)
+    {
+        quint64 count = ++self->m_allocations;
+        if (count > static_cast<quint64>(self->m_depth))
+        {
+            // 池中缓冲都被占用时才会走到这里，说明下游持有帧的时间超过了预期的流水线深度
+            LOG_DEBUG("VideoFramePool grew beyond depth {}: {} buffers of {} bytes", self->m_depth, count,
+                      static_cast<quint64>(size));
+        }
+    }
+    return buffer;
+}
+
+bool VideoFramePool::init(AVPixelFormat format, int width, int height, int depth)
+{
+    reset();
+
+    if (width <= 0 || height <= 0 || depth <= 0)
+    {
+        LOG_ERROR("VideoFramePool: invalid parameters {}x{} depth {}", width, height, depth);
+        return false;
+    }
+
+    int ret = av_image_fill_linesizes(m_linesize, format, (width + kLineAlign - 1) & ~(kLineAlign - 1));
+    if (ret < 0)
+    {
+        LOG_ERROR("VideoFramePool: unsupported pixel format {}", static_cast<int>(format));
+        return false;
+    }
+
+    uint8_t *planes[4] = {nullptr, nullptr, nullptr, nullptr};
+    int size = av_image_fill_pointers(planes, format, height, nullptr, m_linesize);
+    if (size <= 0)
+    {
+        LOG_ERROR("VideoFramePool: failed to compute buffer size for {}x{}", width, height);
+        return false;
+    }
+
+    m_pool = av_buffer_pool_init2(size + kBufferPadding, this, &VideoFramePool::allocBuffer, nullptr);
+    if (!m_pool)
+    {
+        LOG_ERROR("VideoFramePool: av_buffer_pool_init2 failed");
+        return false;
+    }
+
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_depth = depth;
+
+    // 预先分配depth块缓冲，编码过程中不再触发分配
+    std::vector<AVBufferRef *> warmup;
+    for (int i = 0; i < depth; ++i)
+    {
+        AVBufferRef *buffer = av_buffer_pool_get(m_pool);
+        if (!buffer)
+        {
+            break;
+        }
+        warmup.push_back(buffer);
+    }
+    for (AVBufferRef *buffer : warmup)
+    {
+        av_buffer_unref(&buffer);
+    }
+
+    LOG_DEBUG("VideoFramePool ready: {}x{} fmt {} depth {}, {} bytes per frame", width, height,
+              static_cast<int>(format), depth, size);
+    return true;
+}
+
+void VideoFramePool::reset()
+{
+    if (m_pool)
+    {
+        // 还被引用的缓冲在最后一个引用释放时才真正回收
+        av_buffer_pool_uninit(&m_pool);
+        m_pool = nullptr;
+    }
+    m_format = AV_PIX_FMT_NONE;
+    m_width = 0;
+    m_height = 0;
+    m_depth = 0;
+    m_allocations = 0;
+}
+
+bool VideoFramePool::getFrame(AVFrame *frame)
+{
+    if (!m_pool || !frame)
+    {
+        return false;
+    }
+
+    AVBufferRef *buffer = av_buffer_pool_get(m_pool);
+    if (!buffer)
+    {
+        LOG_ERROR("VideoFramePool: failed to get buffer from pool");
+        return false;
+    }
+
+    frame->buf[0] = buffer;
+    frame->format = m_format;
+    frame->width = m_width;
+    frame->height = m_height;
+    av_image_fill_pointers(frame->data, m_format, m_height, buffer->data, m_linesize);
+    for (int i = 0; i < 4; ++i)
+    {
+        frame->linesize[i] = m_linesize[i];
+    }
+    frame->extended_data = frame->data;
+    return true;
+}
+
+SwsContextCache::SwsContextCache(int capacity)
+    : m_capacity(qMax(1, capacity)), m_useCounter(0)
+{
+}
+
+SwsContextCache::~SwsContextCache()
+{
+    clear();
+}
+
+SwsContext *SwsContextCache::get(int srcWidth, int srcHeight, AVPixelFormat srcFormat, int dstWidth, int dstHeight,
+                                 AVPixelFormat dstFormat, int flags)
+{
+    for (Entry &entry : m_entries)
+    {
+        if (entry.srcWidth == srcWidth && entry.srcHeight == srcHeight && entry.srcFormat == srcFormat &&
+            entry.dstWidth == dstWidth && entry.dstHeight == dstHeight && entry.dstFormat == dstFormat &&
+            entry.flags == flags)
+        {
+            entry.lastUse = ++m_useCounter;
+            return entry.context;
+        }
+    }
+
+    SwsContext *context =
+        sws_getContext(srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, flags, nullptr, nullptr, nullptr);
+    if (!context)
+    {
+        LOG_ERROR("SwsContext creation failed ({}x{} fmt {} -> {}x{} fmt {})", srcWidth, srcHeight,
+                  static_cast<int>(srcFormat), dstWidth, dstHeight, static_cast<int>(dstFormat));
+        return nullptr;
+    }
+
+    // 满了就淘汰最久未使用的一项
+    if (static_cast<int>(m_entries.size()) >= m_capacity)
+    {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if (it->lastUse < oldest->lastUse)
+            {
+                oldest = it;
+            }
+        }
+        sws_freeContext(oldest->context);
+        m_entries.erase(oldest);
+    }
+
+    m_entries.push_back({srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, flags, context, ++m_useCounter});
+    LOG_DEBUG("Created SwsContext {}x{} fmt {} -> {}x{} fmt {} ({} cached)", srcWidth, srcHeight,
+              static_cast<int>(srcFormat), dstWidth, dstHeight, static_cast<int>(dstFormat), m_entries.size());
+    return context;
+}
+
+void SwsContextCache::clear()
+{
+    for (Entry &entry : m_entries)
+    {
+        sws_freeContext(entry.context);
+    }
+    m_entries.clear();
+}
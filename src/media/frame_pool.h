@@ -0,0 +1,84 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+extern "C" {
+#include <libavutil/version.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
+}
+
+// 固定格式/尺寸的AVFrame缓冲池（基于AVBufferPool）
+// 帧引用全部释放后缓冲回到池中复用，稳定运行时不再分配像素内存
+class VideoFramePool {
+public:
+  VideoFramePool();
+  ~VideoFramePool();
+
+  // depth为流水线深度，初始化时预先分配这么多块缓冲
+  bool init(AVPixelFormat format, int width, int height, int depth);
+  void reset();
+
+  // 给一个空的AVFrame挂上池中的缓冲并填好data/linesize/format/尺寸
+  bool getFrame(AVFrame *frame);
+
+  bool isValid() const { return m_pool != nullptr; }
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  AVPixelFormat format() const { return m_format; }
+  // 累计分配的缓冲块数，稳定时应等于池深度
+  quint64 allocations() const { return m_allocations.load(); }
+
+private:
+  static AVBufferRef *allocBuffer(void *opaque,
+#if LIBAVUTIL_VERSION_MAJOR < 57
+                                  int size
+#else
+                                  size_t size
+#endif
+  );
+
+  AVBufferPool *m_pool;
+  AVPixelFormat m_format;
+  int m_width;
+  int m_height;
+  int m_depth;
+  int m_linesize[4];
+  std::atomic<quint64> m_allocations;
+};
+
+// 按(源尺寸/格式, 目标尺寸/格式)缓存SwsContext，避免尺寸切换时反复创建
+class SwsContextCache {
+public:
+  explicit SwsContextCache(int capacity = 4);
+  ~SwsContextCache();
+
+  SwsContext *get(int srcWidth, int srcHeight, AVPixelFormat srcFormat,
+                  int dstWidth, int dstHeight, AVPixelFormat dstFormat,
+                  int flags = SWS_BILINEAR);
+  void clear();
+
+private:
+  struct Entry {
+    int srcWidth;
+    int srcHeight;
+    AVPixelFormat srcFormat;
+    int dstWidth;
+    int dstHeight;
+    AVPixelFormat dstFormat;
+    int flags;
+    SwsContext *context;
+    quint64 lastUse;
+  };
+
+  std::vector<Entry> m_entries;
+  int m_capacity;
+  quint64 m_useCounter;
+};
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,113 @@
+#include "frame_ring.h"
+#include <chrono>
+
+FrameRing::FrameRing(int slotCount)
+    : m_slots(qMax(2, slotCount)), m_ready(nullptr), m_readerNotified(false), m_nextSequence(0)
+{
+}
+
+qint64 FrameRing::clockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void FrameRing::preallocate(int width, int height)
+{
+    QMutexLocker locker(&m_mutex);
+    const size_t bytes = static_cast<size_t>(width) * height * 4;
+    for (Slot &slot : m_slots)
+    {
+        // 正在被编码端读取的槽不能动，等它下次被写入时再扩容
+        if (slot.state != Slot::Reading && slot.pixels.size() < bytes)
+        {
+            slot.pixels.resize(bytes);
+        }
+    }
+}
+
+FrameRing::Slot *FrameRing::acquireWrite()
+{
+    QMutexLocker locker(&m_mutex);
+    for (Slot &slot : m_slots)
+    {
+        if (slot.state == Slot::Free)
+        {
+            slot.state = Slot::Writing;
+            slot.damage = QRegion();
+            return &slot;
+        }
+    }
+    // 至少3个槽时不会发生：一个在读、一个待读、一个在写
+    m_stats.captureDropped++;
+    return nullptr;
+}
+
+bool FrameRing::commitWrite(Slot *slot)
+{
+    QMutexLocker locker(&m_mutex);
+    slot->sequence = m_nextSequence++;
+    if (m_ready)
+    {
+        // 最新帧优先：旧帧的损伤合并到新帧里，避免后续阶段漏掉变化区域
+        slot->damage += m_ready->damage;
+        m_ready->state = Slot::Free;
+        m_stats.overwritten++;
+    }
+    slot->state = Slot::Ready;
+    m_ready = slot;
+    m_stats.captured++;
+
+    const bool notify = !m_readerNotified;
+    m_readerNotified = true;
+    return notify;
+}
+
+void FrameRing::cancelWrite(Slot *slot)
+{
+    QMutexLocker locker(&m_mutex);
+    slot->state = Slot::Free;
+    m_stats.captureDropped++;
+}
+
+FrameRing::Slot *FrameRing::acquireRead()
+{
+    QMutexLocker locker(&m_mutex);
+    Slot *slot = m_ready;
+    if (!slot)
+    {
+        // 已经取空，下一次发布时重新唤醒编码端
+        m_readerNotified = false;
+        return nullptr;
+    }
+    m_ready = nullptr;
+    slot->state = Slot::Reading;
+    return slot;
+}
+
+void FrameRing::releaseRead(Slot *slot, bool encoded)
+{
+    QMutexLocker locker(&m_mutex);
+    slot->state = Slot::Free;
+    if (encoded)
+    {
+        m_stats.encoded++;
+    }
+    else
+    {
+        m_stats.encodeDropped++;
+    }
+}
+
+void FrameRing::releaseUnchanged(Slot *slot)
+{
+    QMutexLocker locker(&m_mutex);
+    slot->state = Slot::Free;
+    m_stats.unchanged++;
+}
+
+FrameRing::Stats FrameRing::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,72 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <QMutex>
+#include <QPoint>
+#include <QRegion>
+#include <QVector>
+#include <vector>
+
+// 捕获线程与编码线程之间的固定大小帧环
+// 槽位内存预先分配并循环复用；编码端总是取最新发布的帧，未被取走的旧帧直接被覆盖
+class FrameRing {
+public:
+  struct Slot {
+    std::vector<uchar> pixels; // BGRA像素
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    QRegion damage;        // 相对上一帧的损伤区域（被覆盖的帧会合并进来）
+    QPoint cursor{-1, -1}; // 捕获时的光标位置（捕获区域像素坐标），负坐标表示未知
+    qint64 captureTimeUs = 0; // 捕获时刻（单调时钟，微秒）
+    quint64 sequence = 0;
+
+  private:
+    friend class FrameRing;
+    enum State { Free, Writing, Ready, Reading };
+    State state = Free;
+  };
+
+  // 每个阶段的计数器
+  struct Stats {
+    quint64 captured = 0;         // 捕获端成功发布的帧
+    quint64 captureDropped = 0;   // 捕获端因没有空闲槽或抓屏失败而丢弃的帧
+    quint64 overwritten = 0;      // 编码端还没取走就被新帧覆盖的帧
+    quint64 encoded = 0;          // 编码端成功编码的帧
+    quint64 encodeDropped = 0;    // 编码端取走但编码失败/无输出的帧
+    quint64 unchanged = 0;        // 编码端发现内容与上一帧相同而跳过的帧
+  };
+
+  explicit FrameRing(int slotCount = 3);
+
+  // 进程内共用的单调时钟（微秒），捕获时刻和发送端延迟统计都以它为准
+  static qint64 clockUs();
+
+  // 按帧尺寸预分配所有槽位，之后尺寸不变时不再分配内存
+  void preallocate(int width, int height);
+
+  // 捕获端：取得一个可写槽，全部占用时返回nullptr并计入丢弃
+  Slot *acquireWrite();
+  // 捕获端：发布写好的槽；返回true表示编码端需要被唤醒
+  bool commitWrite(Slot *slot);
+  // 捕获端：放弃写入（抓屏失败）
+  void cancelWrite(Slot *slot);
+
+  // 编码端：取得最新发布的帧，没有时返回nullptr
+  Slot *acquireRead();
+  void releaseRead(Slot *slot, bool encoded);
+  // 编码端：内容未变化，不编码直接归还
+  void releaseUnchanged(Slot *slot);
+
+  Stats stats() const;
+
+private:
+  mutable QMutex m_mutex;
+  QVector<Slot> m_slots;
+  Slot *m_ready;             // 最新已发布、尚未被编码端取走的槽
+  bool m_readerNotified;     // 是否已有一次唤醒在路上，避免信号堆积
+  quint64 m_nextSequence;
+  Stats m_stats;
+};
+
+#endif // FRAME_RING_H
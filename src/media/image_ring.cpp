@@ -0,0 +1,37 @@
+#include "image_ring.h"
+
+ImageRing::ImageRing(int slotCount, QImage::Format format)
+    : m_format(format), m_images(static_cast<size_t>(qMax(2, slotCount))), m_next(0), m_allocations(0)
+{
+}
+
+QImage &ImageRing::acquire(int width, int height)
+{
+    // 从上次之后的槽开始找尺寸相同且没有外部引用的图像
+    for (size_t i = 0; i < m_images.size(); ++i)
+    {
+        const size_t index = (m_next + i) % m_images.size();
+        QImage &image = m_images[index];
+        if (!image.isNull() && image.width() == width && image.height() == height && image.isDetached())
+        {
+            m_next = (index + 1) % m_images.size();
+            return image;
+        }
+    }
+
+    // 尺寸变化或全部被显示端占用：替换下一个槽，旧图像在持有者释放后自然回收
+    QImage &image = m_images[m_next];
+    image = QImage(width, height, m_format);
+    m_allocations++;
+    m_next = (m_next + 1) % m_images.size();
+    return image;
+}
+
+void ImageRing::clear()
+{
+    for (QImage &image : m_images)
+    {
+        image = QImage();
+    }
+    m_next = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef IMAGE_RING_H
+#define IMAGE_RING_H
+
+#include <QImage>
+#include <QtGlobal>
+#include <vector>
+
+// 解码输出图像的固定大小环，只在解码线程使用
+// 图像按尺寸预先分配并循环复用；显示端仍持有的图像（QImage隐式共享，引用计数大于1）
+// 会被跳过，全部仍在使用时才分配新图像
+class ImageRing {
+public:
+  explicit ImageRing(int slotCount = 4,
+                     QImage::Format format = QImage::Format_RGB32);
+
+  // 取得一张width x height、当前只被环引用的图像，直接写入像素不会触发拷贝；
+  // 写完后按值交出（浅拷贝），引用在下一次acquire之前有效
+  QImage &acquire(int width, int height);
+  // 丢弃所有图像，显示端持有的不受影响
+  void clear();
+
+  QImage::Format format() const { return m_format; }
+  // 累计分配的图像数，稳定运行时应等于槽位数
+  quint64 allocations() const { return m_allocations; }
+
+private:
+  QImage::Format m_format;
+  std::vector<QImage> m_images;
+  size_t m_next;
+  quint64 m_allocations;
+};
+
+#endif // IMAGE_RING_H
@@ -0,0 +1,669 @@
+#include "media_bench.h"
+#include "video_encoder.h"
+#include "video_decoder.h"
+#include "synthetic_corpus.h"
+#include "scroll_detector.h"
+#include "text_tile_codec.h"
+#include "frame_ring.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#include <QElapsedTimer>
+#include <QSize>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#if defined(Q_OS_WIN64) || defined(Q_OS_WIN32)
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    struct BenchOptions
+    {
+        int width = 1920;
+        int height = 1080;
+        int fps = 30;
+        int frames = 120;
+    };
+
+    struct BenchCase
+    {
+        const char *name;
+        const char *description;
+        std::function<bool(const BenchOptions &)> run;
+    };
+
+    // 在每种合成画面上编码相同的帧序列，输出单帧CPU耗时和码流大小
+    bool benchEncoder(const BenchOptions &options, SyntheticCorpus &corpus, const char *benchName,
+                      const QString &backend, VideoCodec codec)
+    {
+        const int bitrate = static_cast<int>(options.width * options.height * options.fps * 0.1);
+        const QString label = codec == VideoCodec::H264 ? backend : QString("%1/%2").arg(backend, VideoCodecs::name(codec));
+        for (SyntheticCorpus::Content content : SyntheticCorpus::allContents())
+        {
+            std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create(backend, codec);
+            if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+            {
+                LOG_ERROR("[bench {}] {} failed to initialize", benchName, label);
+                return false;
+            }
+
+            qint64 cpuUs = 0;
+            qint64 wallNs = 0;
+            qint64 totalBytes = 0;
+            int encodedFrames = 0;
+            QElapsedTimer timer;
+            for (int i = 0; i < options.frames; ++i)
+            {
+                const uchar *bgra = corpus.render(content, i);
+                qint64 cpuStart = MediaBench::processCpuTimeUs();
+                timer.start();
+                EncodedVideoFrame frame = encoder->encodeFrame(bgra, corpus.width(), corpus.height(), corpus.stride());
+                wallNs += timer.nsecsElapsed();
+                cpuUs += MediaBench::processCpuTimeUs() - cpuStart;
+                if (!frame.isEmpty())
+                {
+                    totalBytes += frame.size();
+                    encodedFrames++;
+                }
+            }
+
+            FrameSizeStats stats = encoder->takeFrameSizeStats();
+            encoder->cleanup();
+            LOG_INFO("[bench {}] {:<12} {:<12} cpu {:.2f} ms/frame, wall {:.2f} ms/frame, "
+                     "avg {} bytes, p95 {} bytes, max key frame {} bytes, avg qp {:.1f} ({}/{} frames)",
+                     benchName, label, SyntheticCorpus::contentName(content),
+                     cpuUs / 1e3 / options.frames, wallNs / 1e6 / options.frames,
+                     encodedFrames > 0 ? totalBytes / encodedFrames : 0, stats.p95, stats.maxKeyFrame,
+                     stats.avgQp, encodedFrames, options.frames);
+        }
+        return true;
+    }
+
+    // 比较各编码后端（H264）
+    bool benchEncoders(const BenchOptions &options)
+    {
+        bool ok = true;
+        SyntheticCorpus corpus(options.width, options.height);
+        for (const QString &backend : VideoEncoder::availableBackends())
+        {
+            ok = benchEncoder(options, corpus, "encoders", backend, VideoCodec::H264) && ok;
+        }
+        return ok;
+    }
+
+    // 同样码率下比较本机FFmpeg能编码的各视频格式
+    bool benchCodecs(const BenchOptions &options)
+    {
+        bool ok = true;
+        SyntheticCorpus corpus(options.width, options.height);
+        for (VideoCodec codec : VideoCodecs::encodable())
+        {
+            ok = benchEncoder(options, corpus, "codecs", "ffmpeg", codec) && ok;
+        }
+        return ok;
+    }
+
+    // 整帧输出与条带输出对比：从送入编码器到第一段码流可以发送、到整帧都可以发送的时间
+    bool benchSlices(const BenchOptions &options)
+    {
+        if (!VideoEncoder::availableBackends().contains("x264"))
+        {
+            LOG_WARN("[bench slices] x264 encoder backend is not built in, skipped");
+            return true;
+        }
+
+        SyntheticCorpus corpus(options.width, options.height);
+        const int bitrate = static_cast<int>(options.width * options.height * options.fps * 0.1);
+        for (bool sliceOutput : {false, true})
+        {
+            for (SyntheticCorpus::Content content : SyntheticCorpus::allContents())
+            {
+                // 条带回调在x264的条带线程中执行
+                std::atomic<qint64> firstOutputUs{0};
+                std::atomic<int> slices{0};
+                std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create("x264");
+                if (sliceOutput)
+                {
+                    encoder->setSliceCallback([&](const EncodedVideoFrame &)
+                                              {
+                        qint64 expected = 0;
+                        firstOutputUs.compare_exchange_strong(expected, FrameRing::clockUs());
+                        slices++; });
+                }
+                if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+                {
+                    LOG_ERROR("[bench slices] x264 failed to initialize");
+                    return false;
+                }
+
+                qint64 firstSumUs = 0;
+                qint64 frameSumUs = 0;
+                qint64 frameMaxUs = 0;
+                int encodedFrames = 0;
+                for (int i = 0; i < options.frames; ++i)
+                {
+                    const uchar *bgra = corpus.render(content, i);
+                    firstOutputUs = 0;
+                    const qint64 startUs = FrameRing::clockUs();
+                    EncodedVideoFrame frame = encoder->encodeFrame(bgra, corpus.width(), corpus.height(),
+                                                                   corpus.stride(), startUs);
+                    const qint64 doneUs = FrameRing::clockUs();
+                    if (frame.isEmpty())
+                    {
+                        continue;
+                    }
+                    // 整帧输出时第一段码流要等encodeFrame返回
+                    const qint64 firstUs = firstOutputUs > 0 ? firstOutputUs.load() : doneUs;
+                    firstSumUs += firstUs - startUs;
+                    frameSumUs += doneUs - startUs;
+                    frameMaxUs = qMax(frameMaxUs, doneUs - startUs);
+                    encodedFrames++;
+                }
+                encoder->cleanup();
+
+                const int divisor = qMax(1, encodedFrames);
+                LOG_INFO("[bench slices] {:<6} {:<12} first data {:.2f} ms, whole frame {:.2f} ms (max {:.2f} ms), "
+                         "{:.1f} sends/frame ({}/{} frames)",
+                         sliceOutput ? "sliced" : "whole", SyntheticCorpus::contentName(content),
+                         firstSumUs / 1e3 / divisor, frameSumUs / 1e3 / divisor, frameMaxUs / 1e3,
+                         sliceOutput ? static_cast<double>(slices) / divisor : 1.0, encodedFrames, options.frames);
+            }
+        }
+        return true;
+    }
+
+    // 脚本化的Alt+Tab：两个窗口交替显示，比较只参考上一帧与保留长期参考时每次切换的码流大小
+    // 只测显式支持长期参考的后端：滑动窗口参考在一个切换周期内就会丢掉旧画面
+    bool benchAltTab(const BenchOptions &options)
+    {
+        SyntheticCorpus corpus(options.width, options.height);
+        const int bitrate = static_cast<int>(options.width * options.height * options.fps * 0.1);
+        const int period = SyntheticCorpus::kAltTabPeriod;
+        // 两个窗口交替：当前窗口在短期参考里，另一个窗口至少要占一个长期参考
+        const int longTermRefs = qMax(SyntheticCorpus::kAltTabWindows - 1, ConfigUtil->longTermRefs);
+        if (options.frames < period * 3)
+        {
+            LOG_WARN("[bench alttab] needs at least {} frames to measure a switch back, skipped", period * 3);
+            return true;
+        }
+        for (const QString &backend : VideoEncoder::availableBackends())
+        {
+            if (!VideoEncoder::create(backend)->supportsLongTermRefs())
+            {
+                LOG_INFO("[bench alttab] {} has no long-term references, skipped", backend);
+                continue;
+            }
+            qint64 baselineBytesPerSwitch = 0;
+            for (int refs : {0, longTermRefs})
+            {
+                std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create(backend);
+                encoder->setLongTermRefs(refs);
+                if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+                {
+                    LOG_ERROR("[bench alttab] {} failed to initialize", backend);
+                    return false;
+                }
+
+                // 第一次切换到第二个窗口时没有可参考的旧画面，不计入
+                qint64 switchBytes = 0;
+                qint64 otherBytes = 0;
+                int switches = 0;
+                int others = 0;
+                int keyFrames = 0;
+                for (int i = 0; i < options.frames; ++i)
+                {
+                    const uchar *bgra = corpus.render(SyntheticCorpus::AltTab, i);
+                    EncodedVideoFrame frame = encoder->encodeFrame(bgra, corpus.width(), corpus.height(),
+                                                                   corpus.stride());
+                    if (frame.isEmpty())
+                    {
+                        continue;
+                    }
+                    if (i > 0 && frame.isKeyFrame())
+                    {
+                        keyFrames++;
+                    }
+                    if (i >= period * 2 && i % period == 0)
+                    {
+                        switchBytes += frame.size();
+                        switches++;
+                    }
+                    else if (i % period != 0)
+                    {
+                        otherBytes += frame.size();
+                        others++;
+                    }
+                }
+                encoder->cleanup();
+
+                const qint64 bytesPerSwitch = switches > 0 ? switchBytes / switches : 0;
+                LOG_INFO("[bench alttab] {:<9} long-term refs {:<2} {} bytes/switch ({} switches), "
+                         "{} bytes/other frame, {} key frames after the first",
+                         backend, refs, bytesPerSwitch, switches, others > 0 ? otherBytes / others : 0, keyFrames);
+                if (refs == 0)
+                {
+                    baselineBytesPerSwitch = bytesPerSwitch;
+                }
+                else if (bytesPerSwitch * 2 > baselineBytesPerSwitch)
+                {
+                    // 切回时引用到旧画面的帧应远小于重新编码整个窗口
+                    LOG_WARN("[bench alttab] {} switches did not reference the previous window", backend);
+                }
+            }
+        }
+        return true;
+    }
+
+    // 合成滚动页面：滚动检测的准确率和耗时，以及x264有无滚动提示时的码率
+    bool benchScroll(const BenchOptions &options)
+    {
+        SyntheticCorpus corpus(options.width, options.height);
+        const int bitrate = static_cast<int>(options.width * options.height * options.fps * 0.1);
+        const bool haveX264 = VideoEncoder::availableBackends().contains("x264");
+        if (!haveX264)
+        {
+            LOG_WARN("[bench scroll] x264 encoder backend is not built in, only measuring detection");
+        }
+
+        // 12像素约为逐行平滑滚动，60像素约为滚轮一次三行
+        for (int step : {12, 60})
+        {
+            corpus.setScrollStep(step);
+            for (bool hints : {false, true})
+            {
+                if (!hints && !haveX264)
+                {
+                    continue;
+                }
+                std::unique_ptr<VideoEncoder> encoder;
+                if (haveX264)
+                {
+                    encoder = VideoEncoder::create("x264");
+                    if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+                    {
+                        LOG_ERROR("[bench scroll] x264 failed to initialize");
+                        return false;
+                    }
+                }
+
+                TileChangeMap tileChangeMap;
+                ScrollDetector detector;
+                qint64 detectNs = 0;
+                int detected = 0;
+                int correct = 0;
+                qint64 totalBytes = 0;
+                int encodedFrames = 0;
+                QElapsedTimer timer;
+                for (int i = 0; i < options.frames; ++i)
+                {
+                    const uchar *bgra = corpus.render(SyntheticCorpus::Scrolling, i);
+                    const TileChanges changes = tileChangeMap.update(bgra, corpus.width(), corpus.height(),
+                                                                     corpus.stride(), QRegion(), QPoint(-1, -1));
+                    timer.start();
+                    const ScrollMotion scroll =
+                        detector.detect(bgra, corpus.width(), corpus.height(), corpus.stride(), changes);
+                    detectNs += timer.nsecsElapsed();
+                    if (scroll.isValid())
+                    {
+                        detected++;
+                        // 页面向下翻，内容向上移动
+                        correct += scroll.dy == -step ? 1 : 0;
+                    }
+                    if (!encoder)
+                    {
+                        continue;
+                    }
+                    if (hints && scroll.isValid())
+                    {
+                        encoder->setScrollMotion(scroll);
+                    }
+                    EncodedVideoFrame frame =
+                        encoder->encodeFrame(bgra, corpus.width(), corpus.height(), corpus.stride());
+                    if (!frame.isEmpty())
+                    {
+                        totalBytes += frame.size();
+                        encodedFrames++;
+                    }
+                }
+
+                FrameSizeStats stats;
+                if (encoder)
+                {
+                    stats = encoder->takeFrameSizeStats();
+                    encoder->cleanup();
+                }
+                LOG_INFO("[bench scroll] {:>2} px/frame, hints {:<3} detected {}/{} ({} correct), "
+                         "detect {:.2f} ms/frame, avg {} bytes, p95 {} bytes, avg qp {:.1f}",
+                         step, hints ? "on" : "off", detected, options.frames - 1, correct,
+                         detectNs / 1e6 / options.frames, encodedFrames > 0 ? totalBytes / encodedFrames : 0,
+                         stats.p95, stats.avgQp);
+            }
+        }
+        return true;
+    }
+
+    // 滚动的终端：只用H264与H264加无损文字块（覆盖的块按未变化做区域QP）的总码率，
+    // 以及每种方式下H264编码、文字块编码和控制端应用/合成的进程CPU时间；控制端合成后逐像素核对覆盖的块
+    bool benchTextTiles(const BenchOptions &options)
+    {
+        SyntheticCorpus corpus(options.width, options.height);
+        const int bitrate = static_cast<int>(options.width * options.height * options.fps * 0.1);
+        const int budgetBytes = ConfigUtil->textTileBudgetKbps * 1000 / 8 / options.fps;
+        QList<TextTileCompression> modes = {TextTileCompression::None};
+        for (const QString &name : TextTileCodec::supportedCompressions())
+        {
+            modes << TextTileCodec::negotiate({name});
+        }
+
+        for (TextTileCompression mode : modes)
+        {
+            std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create(ConfigUtil->videoEncoderBackend);
+            if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+            {
+                LOG_ERROR("[bench texttiles] {} failed to initialize", encoder->backendName());
+                return false;
+            }
+
+            std::unique_ptr<TextTileEncoder> tiles;
+            if (mode != TextTileCompression::None)
+            {
+                tiles = std::make_unique<TextTileEncoder>(mode, ConfigUtil->textTileMaxColors);
+            }
+            TextTileOverlay overlay;
+            QImage composited(corpus.width(), corpus.height(), QImage::Format_RGB32);
+            TileChangeMap tileChangeMap;
+            qint64 videoBytes = 0;
+            qint64 tileBytes = 0;
+            qint64 videoCpuUs = 0;
+            qint64 tileCpuUs = 0;
+            qint64 overlayCpuUs = 0;
+            qint64 coveredSum = 0;
+            int messages = 0;
+            int invalidMessages = 0;
+            int mismatchedTiles = 0;
+            for (int i = 0; i < options.frames; ++i)
+            {
+                const uchar *bgra = corpus.render(SyntheticCorpus::Terminal, i);
+                TileChanges changes = tileChangeMap.update(bgra, corpus.width(), corpus.height(), corpus.stride(),
+                                                           QRegion(), QPoint(-1, -1));
+                if (tiles)
+                {
+                    qint64 cpuStart = MediaBench::processCpuTimeUs();
+                    const QList<QByteArray> encoded = tiles->encode(bgra, corpus.width(), corpus.height(),
+                                                                    corpus.stride(), changes, budgetBytes);
+                    tileCpuUs += MediaBench::processCpuTimeUs() - cpuStart;
+
+                    // 覆盖的块合成到黑色画面上应与原始像素完全相同
+                    composited.fill(Qt::black);
+                    cpuStart = MediaBench::processCpuTimeUs();
+                    for (const QByteArray &message : encoded)
+                    {
+                        invalidMessages += overlay.apply(message) ? 0 : 1;
+                    }
+                    overlay.composite(composited);
+                    overlayCpuUs += MediaBench::processCpuTimeUs() - cpuStart;
+                    for (const QByteArray &message : encoded)
+                    {
+                        tileBytes += message.size();
+                        messages++;
+                    }
+                    const std::vector<uint8_t> &covered = tiles->covered();
+                    for (size_t index = 0; index < covered.size(); ++index)
+                    {
+                        if (!covered[index])
+                        {
+                            continue;
+                        }
+                        coveredSum++;
+                        const int x = static_cast<int>(index % changes.columns) * changes.tileSize;
+                        const int y = static_cast<int>(index / changes.columns) * changes.tileSize;
+                        const int width = qMin(changes.tileSize, corpus.width() - x);
+                        const int height = qMin(changes.tileSize, corpus.height() - y);
+                        for (int row = y; row < y + height; ++row)
+                        {
+                            const QRgb *shown = reinterpret_cast<const QRgb *>(composited.constScanLine(row)) + x;
+                            const uchar *source = bgra + static_cast<size_t>(row) * corpus.stride() + x * 4;
+                            bool same = true;
+                            for (int column = 0; column < width && same; ++column, source += 4)
+                            {
+                                same = shown[column] == qRgb(source[2], source[1], source[0]);
+                            }
+                            if (!same)
+                            {
+                                mismatchedTiles++;
+                                break;
+                            }
+                        }
+                        changes.tiles[index] = TileChanges::Unchanged;
+                    }
+                }
+                encoder->setTileChanges(changes);
+                const qint64 cpuStart = MediaBench::processCpuTimeUs();
+                EncodedVideoFrame frame = encoder->encodeFrame(bgra, corpus.width(), corpus.height(), corpus.stride());
+                videoCpuUs += MediaBench::processCpuTimeUs() - cpuStart;
+                videoBytes += frame.size();
+            }
+            encoder->cleanup();
+
+            // CPU按进程统计，包含编码器内部线程；none一行即纯H264的基线
+            const double seconds = static_cast<double>(options.frames) / options.fps;
+            const double frames = options.frames;
+            LOG_INFO("[bench texttiles] {:<5} {} video {:.0f} kbps + tiles {:.0f} kbps = {:.0f} kbps, "
+                     "cpu h264 {:.2f} + tiles {:.2f} = {:.2f} ms/frame, overlay {:.2f} ms/frame, "
+                     "{:.0f} tiles covered/frame, {} messages, {} invalid, {} tiles mismatched",
+                     TextTileCodec::compressionName(mode), encoder->backendName(), videoBytes * 8 / seconds / 1000,
+                     tileBytes * 8 / seconds / 1000, (videoBytes + tileBytes) * 8 / seconds / 1000,
+                     videoCpuUs / 1e3 / frames, tileCpuUs / 1e3 / frames, (videoCpuUs + tileCpuUs) / 1e3 / frames,
+                     overlayCpuUs / 1e3 / frames, coveredSum / frames, messages, invalidMessages, mismatchedTiles);
+        }
+        return true;
+    }
+
+    // 各解码线程策略在1080p和1440p下的单帧延迟：从送入解码器到这一帧的RGB32图像输出，
+    // 帧级多线程推迟输出的帧数也计入延迟；码流由x264（没有时FFmpeg）后端按4个条带编码
+    bool benchDecode(const BenchOptions &options)
+    {
+        const QString backend = VideoEncoder::availableBackends().contains("x264") ? "x264" : "ffmpeg";
+        const QList<DecoderThreading> modes = {DecoderThreading::Slice, DecoderThreading::Frame,
+                                               DecoderThreading::Auto, DecoderThreading::None};
+        for (const QSize &size : {QSize(1920, 1080), QSize(2560, 1440)})
+        {
+            SyntheticCorpus corpus(size.width(), size.height());
+            const int bitrate = static_cast<int>(size.width() * size.height() * options.fps * 0.1);
+            for (SyntheticCorpus::Content content : SyntheticCorpus::allContents())
+            {
+                // 先编码好整段码流，解码计时不受编码影响
+                std::unique_ptr<VideoEncoder> encoder = VideoEncoder::create(backend);
+                if (!encoder->initialize(corpus.width(), corpus.height(), options.fps, bitrate))
+                {
+                    LOG_ERROR("[bench decode] {} failed to initialize", backend);
+                    return false;
+                }
+                std::vector<rtc::binary> units;
+                for (int i = 0; i < options.frames; ++i)
+                {
+                    EncodedVideoFrame frame = encoder->encodeFrame(corpus.render(content, i), corpus.width(),
+                                                                   corpus.height(), corpus.stride());
+                    if (frame.isEmpty())
+                    {
+                        continue;
+                    }
+                    rtc::binary unit;
+                    unit.reserve(frame.size());
+                    for (int packet = 0; packet < frame.packetCount(); ++packet)
+                    {
+                        const rtc::byte *data = reinterpret_cast<const rtc::byte *>(frame.packetData(packet));
+                        unit.insert(unit.end(), data, data + frame.packetSize(packet));
+                    }
+                    units.push_back(std::move(unit));
+                }
+                encoder->cleanup();
+
+                for (DecoderThreading mode : modes)
+                {
+                    DecoderThreadingSettings settings = DecoderThreadingSettings::fromConfig();
+                    settings.mode = mode;
+                    VideoDecoder decoder;
+                    decoder.setThreading(settings);
+                    if (!decoder.initialize(VideoCodec::H264))
+                    {
+                        LOG_ERROR("[bench decode] H264 decoder failed to initialize");
+                        return false;
+                    }
+
+                    // 解码器按送入顺序输出，每输出一帧对应最早一个还没输出的数据包
+                    std::deque<qint64> submitted;
+                    std::vector<qint64> latencies;
+                    int maxDelayFrames = 0;
+                    for (const rtc::binary &unit : units)
+                    {
+                        submitted.push_back(FrameRing::clockUs());
+                        QImage image = decoder.decodeFrame(unit);
+                        if (!image.isNull() && !submitted.empty())
+                        {
+                            latencies.push_back(FrameRing::clockUs() - submitted.front());
+                            submitted.pop_front();
+                        }
+                        maxDelayFrames = qMax(maxDelayFrames, static_cast<int>(submitted.size()));
+                    }
+                    decoder.cleanup();
+
+                    std::sort(latencies.begin(), latencies.end());
+                    qint64 sumUs = 0;
+                    for (qint64 latency : latencies)
+                    {
+                        sumUs += latency;
+                    }
+                    const size_t count = latencies.size();
+                    LOG_INFO("[bench decode] {}x{} {:<5} {:<12} avg {:.2f} ms, p95 {:.2f} ms, max {:.2f} ms, "
+                             "output delay up to {} frames ({}/{} frames)",
+                             size.width(), size.height(), DecoderThreadingSettings::modeName(mode),
+                             SyntheticCorpus::contentName(content), count > 0 ? sumUs / 1e3 / count : 0.0,
+                             count > 0 ? latencies[(count * 95) / 100] / 1e3 : 0.0,
+                             count > 0 ? latencies.back() / 1e3 : 0.0, maxDelayFrames, count, units.size());
+                }
+            }
+        }
+        return true;
+    }
+
+    // 新的基准用例追加到这里，名称即命令行参数
+    const std::vector<BenchCase> &benchCases()
+    {
+        static const std::vector<BenchCase> cases = {
+            {"encoders", "CPU time and bitrate of each encoder backend", benchEncoders},
+            {"codecs", "CPU time and bitrate of each video codec at the same target bitrate", benchCodecs},
+            {"slices", "Encode-to-send latency of whole-frame versus per-slice output (x264)", benchSlices},
+            {"alttab", "Bytes per window switch with and without long-term references", benchAltTab},
+            {"scroll", "Scroll detection accuracy and x264 bitrate with and without scroll hints", benchScroll},
+            {"texttiles", "Bitrate of H.264 alone versus H.264 plus lossless text tiles on a scrolling terminal",
+             benchTextTiles},
+            {"decode", "Per-frame decode latency of each decoder threading mode at 1080p and 1440p", benchDecode},
+        };
+        return cases;
+    }
+
+    BenchOptions parseOptions(const QStringList &arguments, QStringList &selected)
+    {
+        BenchOptions options;
+        int index = arguments.indexOf("--bench");
+        for (int i = index + 1; i < arguments.size(); ++i)
+        {
+            const QString &arg = arguments[i];
+            if (arg == "--frames" && i + 1 < arguments.size())
+            {
+                options.frames = qMax(1, arguments[++i].toInt());
+            }
+            else if (arg == "--size" && i + 1 < arguments.size())
+            {
+                QStringList size = arguments[++i].split('x');
+                if (size.size() == 2 && size[0].toInt() > 0 && size[1].toInt() > 0)
+                {
+                    options.width = size[0].toInt();
+                    options.height = size[1].toInt();
+                }
+            }
+            else if (!arg.startsWith("--"))
+            {
+                selected << arg;
+            }
+        }
+        return options;
+    }
+}
+
+namespace MediaBench
+{
+    bool requested(const QStringList &arguments)
+    {
+        return arguments.contains("--bench");
+    }
+
+    qint64 processCpuTimeUs()
+    {
+#if defined(Q_OS_WIN64) || defined(Q_OS_WIN32)
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        {
+            return 0;
+        }
+        auto toUs = [](const FILETIME &time)
+        {
+            ULARGE_INTEGER value;
+            value.LowPart = time.dwLowDateTime;
+            value.HighPart = time.dwHighDateTime;
+            return static_cast<qint64>(value.QuadPart / 10); // 100ns单位
+        };
+        return toUs(kernelTime) + toUs(userTime);
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+        return static_cast<qint64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+               usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+    }
+
+    int run(const QStringList &arguments)
+    {
+        QStringList selected;
+        BenchOptions options = parseOptions(arguments, selected);
+        LOG_INFO("Media bench: {}x{}, {} frames per content", options.width, options.height, options.frames);
+
+        int failures = 0;
+        bool matched = false;
+        for (const BenchCase &benchCase : benchCases())
+        {
+            if (!selected.isEmpty() && !selected.contains(benchCase.name))
+            {
+                continue;
+            }
+            matched = true;
+            LOG_INFO("Running bench '{}': {}", benchCase.name, benchCase.description);
+            if (!benchCase.run(options))
+            {
+                failures++;
+            }
+        }
+
+        if (!matched)
+        {
+            QStringList names;
+            for (const BenchCase &benchCase : benchCases())
+            {
+                names << benchCase.name;
+            }
+            LOG_ERROR("Unknown bench {}, available: {}", selected.join(","), names.join(","));
+            return 2;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef MEDIA_BENCH_H
+#define MEDIA_BENCH_H
+
+#include <QStringList>
+
+// 媒体管线基准测试，命令行 --bench [用例...] 触发，结果输出到日志
+// 不指定用例时运行全部；--frames N 指定每种画面的帧数，--size WxH 指定分辨率
+namespace MediaBench {
+bool requested(const QStringList &arguments);
+int run(const QStringList &arguments);
+
+// 进程累计CPU时间（用户态+内核态，微秒），包含编码器内部线程
+qint64 processCpuTimeUs();
+} // namespace MediaBench
+
+#endif // MEDIA_BENCH_H
@@ -0,0 +1,33 @@
+#include "media_buffer.h"
+#include <atomic>
+#include <cstring>
+
+namespace
+{
+    std::atomic<quint64> g_copiedBytes{0};
+}
+
+MediaBuffer::MediaBuffer(rtc::binary &&data)
+    : m_data(std::make_shared<const rtc::binary>(std::move(data)))
+{
+}
+
+MediaBuffer MediaBuffer::copyFrom(const void *data, size_t size)
+{
+    rtc::binary copy(size);
+    if (size > 0)
+    {
+        std::memcpy(copy.data(), data, size);
+    }
+    return MediaBuffer(std::move(copy));
+}
+
+void MediaBuffer::countCopy(size_t bytes)
+{
+    g_copiedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+quint64 MediaBuffer::copiedBytes()
+{
+    return g_copiedBytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,34 @@
+#ifndef MEDIA_BUFFER_H
+#define MEDIA_BUFFER_H
+
+#include <QMetaType>
+#include <QtGlobal>
+#include <memory>
+#include <rtc/rtc.hpp>
+
+// 不可变、引用计数的媒体数据缓冲
+// 经过排队信号槽跨线程传递时只复制共享指针，不复制数据
+class MediaBuffer {
+public:
+  MediaBuffer() = default;
+  // 接管data的内存，不拷贝
+  explicit MediaBuffer(rtc::binary &&data);
+  // 从外部内存（采集设备缓冲等）拷贝一份，作为进入管线的唯一一次拷贝，不计入统计
+  static MediaBuffer copyFrom(const void *data, size_t size);
+
+  bool isEmpty() const { return !m_data || m_data->empty(); }
+  size_t size() const { return m_data ? m_data->size() : 0; }
+  const rtc::byte *data() const { return m_data ? m_data->data() : nullptr; }
+  const char *constData() const { return reinterpret_cast<const char *>(data()); }
+
+  // 数据进入管线之后在线程间传递时仍然发生的拷贝都通过这里记账
+  static void countCopy(size_t bytes);
+  static quint64 copiedBytes(); // 进程启动以来的累计拷贝字节数
+
+private:
+  std::shared_ptr<const rtc::binary> m_data;
+};
+
+Q_DECLARE_METATYPE(MediaBuffer)
+
+#endif // MEDIA_BUFFER_H
@@ -1,10 +1,14 @@
 #include "media_capture.h"
-#include "h264_encoder.h"
+#include "video_encoder.h"
+#include "x11_capture.h"
+#include "frame_ring.h"
 #include "logger_manager.h"
+#include "config_util.h"
 #include <QPixmap>
 #include <QBuffer>
 #include <QGuiApplication>
 #include <QScreen>
+#include <QCursor>
 #include <QAudioInput>
 #include <QAudioOutput>
 #include <QIODevice>
@@ -19,10 +23,66 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+std::unique_ptr<ScreenCaptureBackend> ScreenCaptureBackend::create(const QString &name)
+{
+    const QString backendName = name.trimmed().toLower();
+#if defined(Q_OS_LINUX)
+    if (backendName == "auto" || backendName == "xshm")
+    {
+        auto xshm = std::make_unique<XShmCaptureBackend>();
+        if (xshm->open())
+        {
+            LOG_INFO("Using xshm screen capture backend");
+            return xshm;
+        }
+        LOG_WARN("XShm screen capture unavailable, falling back to Qt screen grab");
+    }
+#else
+    if (backendName == "xshm")
+    {
+        LOG_WARN("XShm screen capture is only supported on Linux, using Qt screen grab");
+    }
+#endif
+    auto qt = std::make_unique<QtScreenCaptureBackend>();
+    qt->open();
+    LOG_INFO("Using qt screen capture backend");
+    return qt;
+}
+
+bool QtScreenCaptureBackend::grab(CaptureFrame &frame)
+{
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (!screen)
+    {
+        return false;
+    }
+
+    // 截取完整屏幕
+    QPixmap pixmap = screen->grabWindow(0);
+    if (pixmap.isNull())
+    {
+        return false;
+    }
+    m_image = pixmap.toImage();
+
+    // RGB32/ARGB32在小端机器上的内存布局就是BGRA，其它格式统一转换一次
+    if (m_image.format() != QImage::Format_RGB32 && m_image.format() != QImage::Format_ARGB32 &&
+        m_image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        m_image = m_image.convertToFormat(QImage::Format_RGB32);
+    }
+
+    frame.bits = m_image.constBits();
+    frame.width = m_image.width();
+    frame.height = m_image.height();
+    frame.stride = static_cast<int>(m_image.bytesPerLine());
+    return true;
+}
+
 // 视频捕获工作者实现
-CaptureWorker::CaptureWorker(QObject *parent)
-    : QObject(parent), m_running(false), m_width(1920), m_height(1080), m_fps(10),
-      m_lastFrameTime(0), m_encoder(nullptr), m_captureTimer(nullptr)
+CaptureWorker::CaptureWorker(std::shared_ptr<FrameRing> ring, QObject *parent)
+    : QObject(parent), m_running(false), m_fps(10), m_captureTimer(nullptr), m_lastFrameTime(0),
+      m_damageTracking(false), m_idleKeepaliveMs(1000), m_ring(std::move(ring))
 {
     // 获取实际屏幕分辨率
     QScreen *screen = QGuiApplication::primaryScreen();
@@ -30,7 +90,6 @@ CaptureWorker::CaptureWorker(QObject *parent)
     m_screenWidth = screenGeometry.width();
     m_screenHeight = screenGeometry.height();
 
-    m_encoder = new H264Encoder(this);
     m_captureTimer = new QTimer(this);
     connect(m_captureTimer, &QTimer::timeout, this, &CaptureWorker::captureFrame);
 }
@@ -40,54 +99,25 @@ CaptureWorker::~CaptureWorker()
     stopCapture();
 }
 
-void CaptureWorker::startCapture(int width, int height, int fps)
+void CaptureWorker::startCapture(int fps)
 {
     QMutexLocker locker(&m_mutex);
-    m_width = width;
-    m_height = height;
     m_fps = fps;
 
-    // 初始化H264编码器（启用硬件加速）
-    // 设置高质量编码参数
-    int bitrate = width * height * fps * 0.1; // 自适应码率
-    m_encoder->reset();                       // 重置PTS和帧数量计数器
-    // 尝试启用硬件加速编码
-    QStringList availableAccels = H264Encoder::getAvailableHWAccels();
-    bool encoderInitialized = false;
-
-    if (!availableAccels.isEmpty())
+    // 捕获后端必须在捕获线程内创建（X连接只在本线程使用）
+    m_backend = ScreenCaptureBackend::create(ConfigUtil->captureBackend);
+    m_damageTracking = ConfigUtil->damageTracking && m_backend->enableDamageTracking();
+    m_idleKeepaliveMs = ConfigUtil->idleKeepaliveMs;
+    m_lastFrameTime = 0;
+    if (m_damageTracking)
     {
-        LOG_INFO("Available hardware encoders: {}", availableAccels.join(", "));
-
-        for (const QString &preferred : availableAccels)
-        {
-            LOG_INFO("Attempting to initialize H264 encoder with {} acceleration", preferred);
-            if (m_encoder->initialize(width, height, fps, bitrate))
-            {
-                LOG_INFO("Successfully initialized H264 encoder with {} hardware acceleration", preferred);
-                encoderInitialized = true;
-                break;
-            }
-            else
-            {
-                LOG_WARN("Failed to initialize H264 encoder with {} acceleration", preferred);
-            }
-        }
+        LOG_INFO("Damage-driven capture enabled, idle keepalive every {} ms", m_idleKeepaliveMs);
     }
 
-    // 如果硬件加速失败，使用软件编码
-    if (!encoderInitialized)
-    {
-        LOG_INFO("Falling back to software H264 encoding");
-        if (!m_encoder->initialize(width, height, fps, bitrate))
-        {
-            LOG_ERROR("Failed to initialize H264 encoder even with software encoding");
-        }
-        else
-        {
-            LOG_INFO("Successfully initialized H264 encoder with software encoding");
-        }
-    }
+    // 按屏幕尺寸预分配帧环，避免运行中分配大块内存
+    QScreen *screen = QGuiApplication::primaryScreen();
+    const qreal dpr = screen ? screen->devicePixelRatio() : 1.0;
+    m_ring->preallocate(qRound(m_screenWidth * dpr), qRound(m_screenHeight * dpr));
 
     m_running = true;
 
@@ -99,7 +129,7 @@ void CaptureWorker::startCapture(int width, int height, int fps)
     }
 
     emit captureStarted();
-    LOG_INFO("CaptureWorker started: {}x{} @ {}fps", width, height, fps);
+    LOG_INFO("CaptureWorker started: {} backend @ {}fps", m_backend->name(), fps);
 }
 
 void CaptureWorker::stopCapture()
@@ -112,6 +142,8 @@ void CaptureWorker::stopCapture()
         m_captureTimer->stop();
     }
 
+    m_backend.reset();
+
     emit captureStopped();
     LOG_INFO("CaptureWorker stopped");
 }
@@ -121,51 +153,109 @@ void CaptureWorker::captureFrame()
     if (!m_running)
         return;
 
-    // 截图并编码为H264
-    auto [h264Data, timestamp_us] = captureScreenH264();
-    if (!h264Data.empty())
+    // 截图写入帧环，编码在编码线程进行
+    if (grabToRing())
     {
-        QMutexLocker locker(&m_mutex);
         m_lastFrameTime = QDateTime::currentMSecsSinceEpoch();
-        locker.unlock();
+    }
+}
 
-        emit frameReady(h264Data, timestamp_us);
-        LOG_DEBUG("Captured and sent video frame: {}", Convert::formatFileSize(h264Data.size()));
+void CaptureWorker::captureNow()
+{
+    if (!m_running)
+        return;
+
+    if (grabToRing(true))
+    {
+        m_lastFrameTime = QDateTime::currentMSecsSinceEpoch();
     }
 }
 
-std::pair<rtc::binary, quint64> CaptureWorker::captureScreenH264()
+bool CaptureWorker::grabToRing(bool force)
 {
-    QScreen *screen = QGuiApplication::primaryScreen();
-    if (!screen || !m_encoder)
+    if (!m_backend)
     {
-        return {rtc::binary(), 0};
+        return false;
     }
 
-    // 截取完整屏幕
-    QPixmap pixmap = screen->grabWindow(0);
-    if (pixmap.isNull())
+    CaptureFrame frame;
+    if (m_damageTracking)
     {
-        return {rtc::binary(), 0};
+        // 没有累计损伤时跳过本次定时，仅按保活间隔发送一帧
+        // 保活帧的damage为空，表示内容未变化
+        QRegion damage;
+        if (!m_backend->takeDamage(damage) && !force &&
+            QDateTime::currentMSecsSinceEpoch() - m_lastFrameTime < m_idleKeepaliveMs)
+        {
+            return false;
+        }
+        frame.damage = damage;
     }
-    // 转换为QImage
-    QImage image = pixmap.toImage();
-    // 使用H264编码器编码（编码器已经用m_width和m_height初始化）
-    return m_encoder->encodeFrame(image);
-}
 
-void CaptureWorker::setResolution(int width, int height)
-{
-    QMutexLocker locker(&m_mutex);
-    if (m_width != width || m_height != height)
+    FrameRing::Slot *slot = m_ring->acquireWrite();
+    if (!slot)
     {
-        int oldWidth = m_width;
-        int oldHeight = m_height;
-        m_width = width;
-        m_height = height;
-        LOG_INFO("📺 CaptureWorker: Resolution changed from {}x{} to {}x{}",
-                 oldWidth, oldHeight, width, height);
+        LOG_DEBUG("No free frame slot, dropping captured frame");
+        return false;
     }
+
+    if (!m_backend->grab(frame))
+    {
+        m_ring->cancelWrite(slot);
+        // 共享内存等后端在运行中失效时（例如显示服务器重启），退回Qt截屏
+        if (qstrcmp(m_backend->name(), "qt") != 0)
+        {
+            LOG_WARN("{} screen capture failed, switching to qt backend", m_backend->name());
+            m_backend = ScreenCaptureBackend::create("qt");
+            m_damageTracking = false;
+        }
+        return false;
+    }
+
+    if (!frame.damage.isEmpty())
+    {
+        LOG_TRACE("Frame damage: {} rects, bounding {}x{}", frame.damage.rectCount(),
+                  frame.damage.boundingRect().width(), frame.damage.boundingRect().height());
+    }
+
+    // 后端缓冲区在下次grab时会被覆盖，拷贝到槽位后交给编码线程
+    const int rowBytes = frame.width * 4;
+    const size_t bytes = static_cast<size_t>(rowBytes) * frame.height;
+    if (slot->pixels.size() < bytes)
+    {
+        slot->pixels.resize(bytes);
+    }
+    if (frame.stride == rowBytes)
+    {
+        std::memcpy(slot->pixels.data(), frame.bits, bytes);
+    }
+    else
+    {
+        for (int y = 0; y < frame.height; ++y)
+        {
+            std::memcpy(slot->pixels.data() + static_cast<size_t>(y) * rowBytes,
+                        frame.bits + static_cast<size_t>(y) * frame.stride, rowBytes);
+        }
+    }
+    slot->width = frame.width;
+    slot->height = frame.height;
+    slot->stride = rowBytes;
+    slot->damage = frame.damage;
+    slot->captureTimeUs = FrameRing::clockUs();
+    // 光标位置换算到捕获像素坐标，编码端据此提高光标附近的画质
+    slot->cursor = QPoint(-1, -1);
+    if (QScreen *screen = QGuiApplication::primaryScreen())
+    {
+        const QPoint pos = QCursor::pos(screen) - screen->geometry().topLeft();
+        const qreal dpr = screen->devicePixelRatio();
+        slot->cursor = QPoint(qRound(pos.x() * dpr), qRound(pos.y() * dpr));
+    }
+
+    if (m_ring->commitWrite(slot))
+    {
+        emit frameCaptured();
+    }
+    return true;
 }
 
 void CaptureWorker::setFps(int fps)
@@ -187,12 +277,420 @@ void CaptureWorker::setFps(int fps)
                 m_captureTimer->start(interval);
                 LOG_INFO("🎬 Updated capture timer interval to {} ms", interval);
             }
+        }
+    }
+}
+
+// 视频编码工作者实现
+EncodeWorker::EncodeWorker(std::shared_ptr<FrameRing> ring, VideoCodec codec, QObject *parent)
+    : QObject(parent), m_running(false), m_sliceOutput(false), m_keyFramePending(false), m_changeRatioSum(0),
+      m_changeRatioFrames(0), m_textTileCompression(TextTileCompression::None), m_textTileBytes(0),
+      m_textTileChannelOpen(false), m_width(1920), m_height(1080), m_fps(10), m_bitrate(0), m_statsTimer(nullptr), m_lastCopiedBytes(0), m_codec(codec),
+      m_encoder(VideoEncoder::create(ConfigUtil->videoEncoderBackend, codec)), m_ring(std::move(ring))
+{
+    m_roi = RoiSettings::fromConfig();
+    m_skipUnchanged = ConfigUtil->skipUnchangedFrames;
+    m_scrollDetection = ConfigUtil->scrollDetection;
+    m_scrollFrames = 0;
+    m_refineAfterMs = ConfigUtil->refineAfterMs;
+    m_refineFrames = ConfigUtil->refineFrames;
+    m_refineQp = qBound(0, ConfigUtil->refineQp, 51);
+    m_refineFramesLeft = 0;
+    m_statsTimer = new QTimer(this);
+    connect(m_statsTimer, &QTimer::timeout, this, &EncodeWorker::logStats);
+    m_refineTimer = new QTimer(this);
+    m_refineTimer->setSingleShot(true);
+    connect(m_refineTimer, &QTimer::timeout, this, &EncodeWorker::captureRequested);
+    m_textTileTimer = new QTimer(this);
+    m_textTileTimer->setSingleShot(true);
+    connect(m_textTileTimer, &QTimer::timeout, this, &EncodeWorker::captureRequested);
+}
+
+EncodeWorker::~EncodeWorker()
+{
+    stopEncoder();
+}
+
+int EncodeWorker::defaultBitrate(int width, int height, int fps)
+{
+    return width * height * fps * 0.1; // 自适应码率
+}
+
+void EncodeWorker::startEncoder(int width, int height, int fps, int bitrate)
+{
+    m_width = width;
+    m_height = height;
+    m_fps = fps;
+    m_bitrate = bitrate;
+
+    // 初始化视频编码器（启用硬件加速）
+    // 设置高质量编码参数，未指定码率时按分辨率和帧率估算
+    if (bitrate <= 0)
+    {
+        bitrate = defaultBitrate(width, height, fps);
+    }
+    m_encoder->reset();                       // 重置PTS和帧数量计数器
+    // 条带回调须在打开编码器之前设置；条带从编码器内部线程发出，经排队连接按顺序到达发送端
+    m_sliceOutput = ConfigUtil->sliceOutput &&
+                    m_encoder->setSliceCallback([this](const EncodedVideoFrame &slice) { emit frameReady(slice); });
+    // FFmpeg后端按能力注册表测得的速度依次尝试（硬件/软件），其它后端失败时退回FFmpeg
+    bool initialized = m_encoder->initialize(width, height, fps, bitrate);
+    if (!initialized && m_encoder->backendName() != "ffmpeg")
+    {
+        LOG_WARN("Encoder backend {} failed to initialize, falling back to ffmpeg", m_encoder->backendName());
+        m_encoder = VideoEncoder::create("ffmpeg", m_codec);
+        m_sliceOutput = false;
+        initialized = m_encoder->initialize(width, height, fps, bitrate);
+    }
+    if (ConfigUtil->sliceOutput && !m_sliceOutput)
+    {
+        LOG_WARN("Encoder backend {} has no per-slice output, sending whole frames", m_encoder->backendName());
+    }
+    if (!initialized)
+    {
+        LOG_ERROR("Failed to initialize {} encoder with any method", VideoCodecs::name(m_codec));
+    }
+
+    m_tileChangeMap.reset(); // 第一帧总是完整编码
+    m_refineArea = TileChanges();
+    m_refineFramesLeft = 0;
+    // 不能按区域调整QP的编码器上精修帧和普通帧一样，只会白白重编码
+    m_refineFrames = ConfigUtil->refineFrames;
+    if (m_refineFrames > 0 && !m_encoder->supportsRegionQp())
+    {
+        LOG_INFO("Encoder backend {} ignores per-region QP, refinement frames disabled", m_encoder->backendName());
+        m_refineFrames = 0;
+    }
+    // 滚动检测每帧都要重算行哈希并投票，不使用提示的编码器上结果只会被丢弃
+    m_scrollDetection = ConfigUtil->scrollDetection;
+    if (m_scrollDetection && !m_encoder->supportsScrollHints())
+    {
+        LOG_INFO("Encoder backend {} ignores scroll hints, scroll detection disabled", m_encoder->backendName());
+        m_scrollDetection = false;
+    }
+    if (m_textTileCompression != TextTileCompression::None)
+    {
+        m_textTiles = std::make_unique<TextTileEncoder>(m_textTileCompression, ConfigUtil->textTileMaxColors);
+        LOG_INFO("Lossless text tiles enabled: {} compression, budget {} kbps",
+                 TextTileCodec::compressionName(m_textTileCompression), ConfigUtil->textTileBudgetKbps);
+    }
+    m_running = true;
+    m_statsTimer->start(10000);
+    m_statsElapsed.start();
+    m_lastCopiedBytes = MediaBuffer::copiedBytes();
+    LOG_INFO("EncodeWorker started: {}x{} @ {}fps, {} via backend {}", width, height, fps, VideoCodecs::name(m_codec),
+             m_encoder->backendName());
+
+    // 启动前已经捕获的帧
+    encodePendingFrames();
+}
+
+void EncodeWorker::stopEncoder()
+{
+    if (!m_running)
+        return;
+
+    m_running = false;
+    m_statsTimer->stop();
+    m_refineTimer->stop();
+    m_textTileTimer->stop();
+    logStats();
+    LOG_INFO("EncodeWorker stopped");
+}
+
+void EncodeWorker::encodePendingFrames()
+{
+    // 只取最新的一帧，编码期间到达的帧在帧环中互相覆盖
+    FrameRing::Slot *slot = m_ring->acquireRead();
+    if (!slot)
+    {
+        return;
+    }
 
-            // 不重新初始化编码器，编码器的FPS参数不影响实际捕获频率
-            // 实际的FPS由定时器控制，编码器保持原始初始化状态
-            LOG_INFO("🎬 FPS change applied via timer, encoder parameters unchanged");
+    if (!m_running)
+    {
+        m_ring->releaseRead(slot, false);
+        return;
+    }
+
+    // 与上一次处理的帧按64x64块比较，捕获端给出损伤区域时只比较相交的块
+    TileChanges tileChanges;
+    if (m_roi.enabled || m_skipUnchanged || m_refineFrames > 0 || m_scrollDetection || m_textTiles)
+    {
+        tileChanges = m_tileChangeMap.update(slot->pixels.data(), slot->width, slot->height, slot->stride,
+                                             slot->damage, slot->cursor);
+        m_changeRatioSum += tileChanges.changeRatio();
+        m_changeRatioFrames++;
+        accumulateRefinement(tileChanges);
+    }
+
+    // 文字类的块先经数据通道无损发送，画面没变时也要处理等待预算的块
+    TileChanges roiChanges = tileChanges;
+    if (m_textTiles && m_textTileChannelOpen && tileChanges.isValid())
+    {
+        const int budgetBytes = ConfigUtil->textTileBudgetKbps * 1000 / 8 / qMax(1, m_fps);
+        const QList<QByteArray> messages = m_textTiles->encode(slot->pixels.data(), slot->width, slot->height,
+                                                               slot->stride, tileChanges, budgetBytes);
+        for (const QByteArray &message : messages)
+        {
+            m_textTileBytes += message.size();
+            emit textTilesReady(message);
+        }
+        if (m_textTiles->hasPending())
+        {
+            m_textTileTimer->start(1000 / qMax(1, m_fps));
+        }
+
+        // 控制端显示的是无损块，H264在这些块上按未变化处理，少花码率
+        const std::vector<uint8_t> &covered = m_textTiles->covered();
+        for (size_t i = 0; i < roiChanges.tiles.size() && i < covered.size(); ++i)
+        {
+            if (covered[i])
+            {
+                roiChanges.tiles[i] = TileChanges::Unchanged;
+            }
+        }
+    }
+
+    // 画面静止足够久、之前变化过的区域还没精修完时，这一帧作为精修帧
+    const bool refine = tileChanges.isValid() && tileChanges.changedTiles == 0 && m_refineFramesLeft > 0 &&
+                        !m_keyFramePending && m_lastChangeTimer.isValid() &&
+                        m_lastChangeTimer.elapsed() >= m_refineAfterMs;
+
+    // 完全没有变化的帧不编码；有关键帧请求或到了保活间隔时照常编码
+    const bool keepaliveDue =
+        !m_lastEncodeTimer.isValid() || m_lastEncodeTimer.elapsed() >= ConfigUtil->idleKeepaliveMs;
+    if (m_skipUnchanged && tileChanges.isValid() && tileChanges.changedTiles == 0 && !m_keyFramePending &&
+        !keepaliveDue && !refine)
+    {
+        m_ring->releaseUnchanged(slot);
+        LOG_TRACE("Skipped unchanged video frame");
+    }
+    else
+    {
+        if (refine)
+        {
+            m_encoder->setTileChanges(m_refineArea);
+            m_encoder->setRefinementQp(m_refineQp);
+        }
+        else if (m_roi.enabled && !m_keyFramePending)
+        {
+            // 关键帧整帧都要清晰，不做区域QP调整
+            m_encoder->setTileChanges(roiChanges);
+        }
+        if (m_scrollDetection)
+        {
+            // 关键帧也要更新行哈希，只是不需要提示
+            const ScrollMotion scroll = m_scrollDetector.detect(slot->pixels.data(), slot->width, slot->height,
+                                                                slot->stride, tileChanges);
+            if (scroll.isValid() && !m_keyFramePending)
+            {
+                m_scrollFrames++;
+                m_encoder->setScrollMotion(scroll);
+                LOG_TRACE("Scroll detected: dy {} in {}x{} at ({}, {}), {} row segments matched", scroll.dy,
+                          scroll.area.width(), scroll.area.height(), scroll.area.x(), scroll.area.y(),
+                          scroll.matches);
+            }
+        }
+
+        // BGRA像素直接交给编码器的颜色转换（编码器已经用m_width和m_height初始化）
+        EncodedVideoFrame frame = m_encoder->encodeFrame(slot->pixels.data(), slot->width, slot->height,
+                                                         slot->stride, slot->captureTimeUs);
+        m_ring->releaseRead(slot, !frame.isEmpty());
+
+        if (!frame.isEmpty())
+        {
+            m_lastEncodeTimer.start();
+            if (frame.isKeyFrame() || ConfigUtil->intraRefresh)
+            {
+                m_keyFramePending = false;
+            }
+            if (refine)
+            {
+                LOG_DEBUG("Sent refinement frame for {} tiles at qp {}, {} left", m_refineArea.changedTiles,
+                          m_refineQp, m_refineFramesLeft - 1);
+                // 本轮精修没发完时尽快再取一帧，发完后等下一次变化
+                if (--m_refineFramesLeft > 0)
+                {
+                    m_refineTimer->start(1000 / qMax(1, m_fps));
+                }
+                else
+                {
+                    m_refineArea = TileChanges();
+                }
+            }
+            if (!m_sliceOutput)
+            {
+                emit frameReady(frame);
+            }
+            LOG_DEBUG("Encoded and sent video frame: {}, key frame: {}, qp: {}, tiles changed: {:.1f}%, "
+                      "encode time: {} us",
+                      Convert::formatFileSize(frame.size()), frame.isKeyFrame(), frame.qp(),
+                      tileChanges.changeRatio() * 100, frame.encodeDurationUs());
+        }
+        else
+        {
+            // 这一帧没有送出，下一帧不能再以它为比较基准
+            m_tileChangeMap.reset();
         }
     }
+
+    // 编码期间可能又有新帧，排队继续处理，让停止/参数调整等事件有机会先执行
+    QMetaObject::invokeMethod(this, &EncodeWorker::encodePendingFrames, Qt::QueuedConnection);
+}
+
+void EncodeWorker::reconfigure(int width, int height, int fps, int bitrate)
+{
+    if (m_width == width && m_height == height && m_fps == fps && m_bitrate == bitrate)
+    {
+        return;
+    }
+
+    LOG_INFO("📺 EncodeWorker: reconfigure {}x{}@{}fps -> {}x{}@{}fps, bitrate {}",
+             m_width, m_height, m_fps, width, height, fps, bitrate > 0 ? QString::number(bitrate) : QString("auto"));
+    m_width = width;
+    m_height = height;
+    m_fps = fps;
+    m_bitrate = bitrate;
+
+    if (!m_running)
+    {
+        // 编码器还没启动，参数在startEncoder时生效
+        return;
+    }
+
+    int targetBitrate = bitrate > 0 ? bitrate : defaultBitrate(width, height, fps);
+    if (!m_encoder->reconfigure(width, height, fps, targetBitrate))
+    {
+        LOG_ERROR("Failed to reconfigure encoder to {}x{}@{}fps", width, height, fps);
+    }
+    // 编码器可能重新打开，下一帧即使画面没变也要编码
+    m_tileChangeMap.reset();
+}
+
+void EncodeWorker::accumulateRefinement(const TileChanges &changes)
+{
+    if (m_refineFrames <= 0 || changes.changedTiles == 0)
+    {
+        return;
+    }
+
+    // 记录变化过的块（光标附近但内容未变的不算），尺寸变化时重新开始
+    if (!m_refineArea.isValid() || m_refineArea.columns != changes.columns || m_refineArea.rows != changes.rows)
+    {
+        m_refineArea = changes;
+        m_refineArea.changedTiles = 0;
+        std::fill(m_refineArea.tiles.begin(), m_refineArea.tiles.end(), TileChanges::Unchanged);
+    }
+    for (size_t i = 0; i < changes.tiles.size(); ++i)
+    {
+        if (changes.tiles[i] == TileChanges::Changed && m_refineArea.tiles[i] != TileChanges::Changed)
+        {
+            m_refineArea.tiles[i] = TileChanges::Changed;
+            m_refineArea.changedTiles++;
+        }
+    }
+
+    // 画面又变了：重新计时，静止refineAfterMs后请求一帧新画面开始精修
+    m_refineFramesLeft = m_refineFrames;
+    m_lastChangeTimer.start();
+    m_refineTimer->start(m_refineAfterMs);
+}
+
+void EncodeWorker::requestKeyFrame()
+{
+    m_keyFramePending = true;
+    m_encoder->requestKeyFrame();
+}
+
+void EncodeWorker::resetTextTiles()
+{
+    if (!m_textTiles)
+    {
+        return;
+    }
+    // 下一帧检查所有块，画面静止时也立即捕获一帧
+    m_textTiles->reset();
+    emit captureRequested();
+}
+
+void EncodeWorker::setTextTileChannelOpen(bool open)
+{
+    if (m_textTileChannelOpen == open)
+    {
+        return;
+    }
+    m_textTileChannelOpen = open;
+    if (open)
+    {
+        // 通道打开前发出的块控制端都没收到，从头发送
+        resetTextTiles();
+        return;
+    }
+    if (!m_textTiles)
+    {
+        return;
+    }
+
+    // 控制端关闭通道时清除了全部无损块，之前按未变化处理的块需要H264重新编码
+    const std::vector<uint8_t> &covered = m_textTiles->covered();
+    const bool anyCovered = std::find(covered.begin(), covered.end(), 1) != covered.end();
+    m_textTiles->reset();
+    m_textTileTimer->stop();
+    LOG_INFO("Text tile channel closed, sending text regions through the video stream");
+    if (anyCovered)
+    {
+        requestKeyFrame();
+        emit captureRequested();
+    }
+}
+
+void EncodeWorker::logStats()
+{
+    const FrameRing::Stats stats = m_ring->stats();
+    LOG_INFO("Video pipeline: captured {}, capture dropped {}, overwritten {}, encoded {}, encode dropped {}, "
+             "unchanged {}, frame pool buffers {}",
+             stats.captured, stats.captureDropped, stats.overwritten, stats.encoded, stats.encodeDropped,
+             stats.unchanged, m_encoder->framePoolAllocations());
+    if (m_changeRatioFrames > 0)
+    {
+        LOG_INFO("Tile change ratio: avg {:.1f}% over {} frames", m_changeRatioSum * 100 / m_changeRatioFrames,
+                 m_changeRatioFrames);
+        m_changeRatioSum = 0;
+        m_changeRatioFrames = 0;
+    }
+    if (m_scrollFrames > 0)
+    {
+        LOG_INFO("Scroll detected in {} frames", m_scrollFrames);
+        m_scrollFrames = 0;
+    }
+    if (m_textTiles)
+    {
+        LOG_INFO("Text tiles: {} covered, {} sent", std::count_if(m_textTiles->covered().begin(),
+                                                                  m_textTiles->covered().end(),
+                                                                  [](uint8_t covered) { return covered != 0; }),
+                 Convert::formatFileSize(m_textTileBytes));
+        m_textTileBytes = 0;
+    }
+
+    const FrameSizeStats sizes = m_encoder->takeFrameSizeStats();
+    if (sizes.frames > 0)
+    {
+        LOG_INFO("Encoded frame sizes: {} frames, {} key frames, p50 {}, p95 {}, max {}, max key frame {}, "
+                 "avg qp {:.1f}, max qp {}",
+                 sizes.frames, sizes.keyFrames, Convert::formatFileSize(sizes.p50),
+                 Convert::formatFileSize(sizes.p95), Convert::formatFileSize(sizes.max),
+                 Convert::formatFileSize(sizes.maxKeyFrame), sizes.avgQp, sizes.maxQp);
+    }
+
+    // 媒体数据在各线程间传递产生的拷贝量，视频路径上应接近0
+    const quint64 copiedBytes = MediaBuffer::copiedBytes();
+    const qint64 elapsedMs = m_statsElapsed.isValid() ? m_statsElapsed.restart() : 0;
+    if (elapsedMs > 0)
+    {
+        LOG_INFO("Media bytes copied: {}/s", Convert::formatFileSize((copiedBytes - m_lastCopiedBytes) * 1000 / elapsedMs));
+    }
+    m_lastCopiedBytes = copiedBytes;
 }
 
 // 音频捕获工作者实现
@@ -300,9 +798,8 @@ void AudioCaptureWorker::processAudioData()
     // 只有超过阈值才发送音频数据
     if (level > m_audioThreshold)
     {
-        rtc::binary audioData;
-        audioData.resize(data.size());
-        std::memcpy(audioData.data(), data.constData(), data.size());
+        // 从QAudioInput读出的数据只拷贝这一次，之后各线程共享同一块缓冲
+        MediaBuffer audioData = MediaBuffer::copyFrom(data.constData(), data.size());
 
         emit audioFrameReady(audioData);
         LOG_DEBUG("Captured and sent audio frame: {}, level: {:.3f}", Convert::formatFileSize(data.size()), level);
@@ -476,7 +973,7 @@ void AudioCaptureWorker::cleanupAudio()
 
 // MediaCapture实现
 MediaCapture::MediaCapture(QObject *parent)
-    : QObject(parent), m_isCapturing(false), m_isAudioCapturing(false), m_captureWorker(nullptr), m_audioCaptureWorker(nullptr), m_captureThread(nullptr), m_audioCaptureThread(nullptr), m_width(1920), m_height(1080), m_fps(10)
+    : QObject(parent), m_isCapturing(false), m_isAudioCapturing(false), m_captureWorker(nullptr), m_encodeWorker(nullptr), m_audioCaptureWorker(nullptr), m_captureThread(nullptr), m_encodeThread(nullptr), m_audioCaptureThread(nullptr), m_width(1920), m_height(1080), m_fps(10), m_bitrate(0), m_videoCodec(VideoCodec::H264), m_textTileCompression(TextTileCompression::None), m_textTileChannelOpen(false)
 {
 }
 
@@ -498,32 +995,51 @@ void MediaCapture::startCapture(int width, int height, int fps)
     m_height = height;
     m_fps = qMax(1, qMin(fps, 60)); // 限制帧率在1-60之间
 
+    // 捕获与编码阶段共享的帧环：一个在编码、一个待编码、一个在写入
+    m_frameRing = std::make_shared<FrameRing>(3);
+
     // 创建工作线程
     m_captureThread = new QThread();
+    m_encodeThread = new QThread();
 
     // 创建工作对象
-    m_captureWorker = new CaptureWorker();
+    m_captureWorker = new CaptureWorker(m_frameRing);
+    m_encodeWorker = new EncodeWorker(m_frameRing, m_videoCodec);
+    m_encodeWorker->setTextTileCompression(m_textTileCompression);
+    m_encodeWorker->setTextTileChannelOpen(m_textTileChannelOpen);
 
     // 将工作对象移动到工作线程
     m_captureWorker->moveToThread(m_captureThread);
+    m_encodeWorker->moveToThread(m_encodeThread);
 
     // 连接信号和槽
     connect(this, &MediaCapture::startVideoCapture, m_captureWorker, &CaptureWorker::startCapture);
+    connect(this, &MediaCapture::startVideoEncoder, m_encodeWorker, &EncodeWorker::startEncoder);
     connect(this, &MediaCapture::stopVideoCapture, m_captureWorker, &CaptureWorker::stopCapture);
-    connect(this, &MediaCapture::setResolutionSignal, m_captureWorker, &CaptureWorker::setResolution);
+    connect(this, &MediaCapture::stopVideoCapture, m_encodeWorker, &EncodeWorker::stopEncoder);
+    connect(this, &MediaCapture::reconfigureEncoderSignal, m_encodeWorker, &EncodeWorker::reconfigure);
     connect(this, &MediaCapture::setFpsSignal, m_captureWorker, &CaptureWorker::setFps);
-    connect(m_captureWorker, &CaptureWorker::frameReady, this, &MediaCapture::onCaptureFrameReady);
+    connect(this, &MediaCapture::requestKeyFrameSignal, m_encodeWorker, &EncodeWorker::requestKeyFrame);
+    connect(this, &MediaCapture::resetTextTilesSignal, m_encodeWorker, &EncodeWorker::resetTextTiles);
+    connect(this, &MediaCapture::textTileChannelOpenSignal, m_encodeWorker, &EncodeWorker::setTextTileChannelOpen);
+    connect(m_captureWorker, &CaptureWorker::frameCaptured, m_encodeWorker, &EncodeWorker::encodePendingFrames);
+    connect(m_encodeWorker, &EncodeWorker::frameReady, this, &MediaCapture::onCaptureFrameReady);
+    connect(m_encodeWorker, &EncodeWorker::textTilesReady, this, &MediaCapture::textTilesReady);
+    connect(m_encodeWorker, &EncodeWorker::captureRequested, m_captureWorker, &CaptureWorker::captureNow);
 
     // 当线程结束时清理工作对象
     connect(m_captureThread, &QThread::finished, m_captureWorker, &QObject::deleteLater);
+    connect(m_encodeThread, &QThread::finished, m_encodeWorker, &QObject::deleteLater);
 
     // 启动工作线程
+    m_encodeThread->start();
     m_captureThread->start();
 
     m_isCapturing = true;
 
-    // 启动捕获
-    emit startVideoCapture(m_width, m_height, m_fps);
+    // 先初始化编码器，再开始捕获
+    emit startVideoEncoder(m_width, m_height, m_fps, m_bitrate);
+    emit startVideoCapture(m_fps);
 }
 
 void MediaCapture::stopCapture()
@@ -537,7 +1053,8 @@ void MediaCapture::stopCapture()
     {
         // 断开信号连接防止回调到已销毁的对象
         disconnect(this, &MediaCapture::stopVideoCapture, m_captureWorker, &CaptureWorker::stopCapture);
-        disconnect(m_captureWorker, &CaptureWorker::frameReady, this, &MediaCapture::onCaptureFrameReady);
+        disconnect(m_captureWorker, &CaptureWorker::frameCaptured, m_encodeWorker, &EncodeWorker::encodePendingFrames);
+        disconnect(m_encodeWorker, &EncodeWorker::captureRequested, m_captureWorker, &CaptureWorker::captureNow);
 
         // 停止捕获
         QMetaObject::invokeMethod(m_captureWorker, "stopCapture", Qt::QueuedConnection);
@@ -554,6 +1071,29 @@ void MediaCapture::stopCapture()
         m_captureThread = nullptr;
         m_captureWorker = nullptr; // 已经通过finished信号自动删除
     }
+
+    if (m_encodeWorker && m_encodeThread)
+    {
+        disconnect(this, &MediaCapture::stopVideoCapture, m_encodeWorker, &EncodeWorker::stopEncoder);
+        disconnect(m_encodeWorker, &EncodeWorker::frameReady, this, &MediaCapture::onCaptureFrameReady);
+        disconnect(m_encodeWorker, &EncodeWorker::textTilesReady, this, &MediaCapture::textTilesReady);
+
+        // 停止编码
+        QMetaObject::invokeMethod(m_encodeWorker, "stopEncoder", Qt::QueuedConnection);
+
+        m_encodeThread->quit();
+        if (!m_encodeThread->wait(3000))
+        {
+            LOG_WARN("Video encode thread did not quit gracefully, terminating");
+            m_encodeThread->terminate();
+            m_encodeThread->wait(1000);
+        }
+
+        m_encodeThread = nullptr;
+        m_encodeWorker = nullptr; // 已经通过finished信号自动删除
+    }
+
+    m_frameRing.reset();
 }
 
 void MediaCapture::startAudioCapture(int sampleRate, int channels)
@@ -619,7 +1159,7 @@ void MediaCapture::stopAudioCapture()
     }
 }
 
-void MediaCapture::onCaptureFrameReady(const rtc::binary &h264Data, quint64 timestamp_us)
+void MediaCapture::onCaptureFrameReady(const EncodedVideoFrame &frame)
 {
     if (!m_isCapturing)
     {
@@ -627,13 +1167,13 @@ void MediaCapture::onCaptureFrameReady(const rtc::binary &h264Data, quint64 time
         return;
     }
 
-    LOG_DEBUG("MediaCapture received H264 frame: {}", Convert::formatFileSize(h264Data.size()));
+    LOG_DEBUG("MediaCapture received video frame: {}", Convert::formatFileSize(frame.size()));
 
-    // 直接发送H264数据，无需压缩
-    emit videoFrameReady(h264Data, timestamp_us);
+    // 直接转发编码帧，只传递引用
+    emit videoFrameReady(frame);
 }
 
-void MediaCapture::onAudioFrameReady(const rtc::binary &audioData)
+void MediaCapture::onAudioFrameReady(const MediaBuffer &audioData)
 {
     if (!m_isAudioCapturing)
         return;
@@ -644,34 +1184,58 @@ void MediaCapture::onAudioFrameReady(const rtc::binary &audioData)
 
 void MediaCapture::setResolution(int width, int height)
 {
-    if (m_isCapturing && m_captureWorker)
+    reconfigureVideo(width, height, m_fps, m_bitrate);
+}
+
+void MediaCapture::setFps(int fps)
+{
+    reconfigureVideo(m_width, m_height, fps, m_bitrate);
+}
+
+void MediaCapture::reconfigureVideo(int width, int height, int fps, int bitrate)
+{
+    fps = qMax(1, qMin(fps, 60)); // 限制帧率在1-60之间
+    bool fpsChanged = fps != m_fps;
+    m_width = width;
+    m_height = height;
+    m_fps = fps;
+    m_bitrate = qMax(0, bitrate);
+
+    if (!m_isCapturing || !m_encodeWorker)
     {
-        m_width = width;
-        m_height = height;
-        LOG_INFO("📺 MediaCapture: Setting resolution to {}x{}", width, height);
-        emit setResolutionSignal(width, height);
+        LOG_WARN("Capture not active, video settings {}x{}@{}fps will be used on next start", width, height, fps);
+        return;
     }
-    else
+
+    LOG_INFO("🎬 MediaCapture: reconfiguring video to {}x{}@{}fps, bitrate {}", m_width, m_height, m_fps, m_bitrate);
+    if (fpsChanged)
     {
-        LOG_WARN("Cannot set resolution - capture not active");
-        // 保存参数，下次启动时使用
-        m_width = width;
-        m_height = height;
+        emit setFpsSignal(m_fps);
     }
+    emit reconfigureEncoderSignal(m_width, m_height, m_fps, m_bitrate);
 }
 
-void MediaCapture::setFps(int fps)
+void MediaCapture::requestKeyFrame()
 {
-    if (m_isCapturing && m_captureWorker)
+    if (m_isCapturing && m_encodeWorker)
     {
-        m_fps = qMax(1, qMin(fps, 60)); // 限制帧率在1-60之间
-        LOG_INFO("🎬 MediaCapture: Setting FPS to {}", m_fps);
-        emit setFpsSignal(m_fps);
+        emit requestKeyFrameSignal();
     }
-    else
+}
+
+void MediaCapture::resetTextTiles()
+{
+    if (m_isCapturing && m_encodeWorker)
+    {
+        emit resetTextTilesSignal();
+    }
+}
+
+void MediaCapture::setTextTileChannelOpen(bool open)
+{
+    m_textTileChannelOpen = open;
+    if (m_isCapturing && m_encodeWorker)
     {
-        LOG_WARN("Cannot set FPS - capture not active");
-        // 保存参数，下次启动时使用
-        m_fps = qMax(1, qMin(fps, 60));
+        emit textTileChannelOpenSignal(open);
     }
 }
@@ -7,48 +7,187 @@
 #include <QAudioOutput>
 #include <QBuffer>
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QIODevice>
+#include <QImage>
 #include <QMutex>
 #include <QObject>
+#include <QRegion>
 #include <QThread>
 #include <QTimer>
 #include <QWaitCondition>
+#include <memory>
 #include <rtc/rtc.hpp>
 
-class H264Encoder;
+#include "encoded_frame.h"
+#include "media_buffer.h"
+#include "scroll_detector.h"
+#include "text_tile_codec.h"
+#include "tile_change_map.h"
+#include "video_codec.h"
+#include "video_encoder.h"
 
-// 视频捕获工作者类（不继承QThread）
+class FrameRing;
+
+// 捕获后端输出的一帧原始像素，格式为小端32位BGRA（BGRX）
+// 像素内存归后端所有，在下一次grab之前有效
+struct CaptureFrame {
+  const uchar *bits = nullptr;
+  int width = 0;
+  int height = 0;
+  int stride = 0; // 每行字节数
+  // 自上一帧以来的损伤区域（捕获区域坐标），为空表示未知/整帧
+  QRegion damage;
+};
+
+// 屏幕捕获后端接口，在捕获线程中创建和使用
+class ScreenCaptureBackend {
+public:
+  virtual ~ScreenCaptureBackend() = default;
+
+  virtual const char *name() const = 0;
+  virtual bool open() = 0;
+  virtual void close() = 0;
+  virtual bool grab(CaptureFrame &frame) = 0;
+
+  // 损伤跟踪（XDamage），不支持的后端返回false，由定时器整帧捕获
+  virtual bool enableDamageTracking() { return false; }
+  // 取出并清空累计的损伤区域，没有变化时返回false
+  virtual bool takeDamage(QRegion &damage) {
+    damage = QRegion();
+    return true;
+  }
+
+  // 按配置名称创建后端（auto/xshm/qt），不可用时退回Qt截屏
+  static std::unique_ptr<ScreenCaptureBackend> create(const QString &name);
+};
+
+// 基于QScreen::grabWindow的通用后端
+class QtScreenCaptureBackend : public ScreenCaptureBackend {
+public:
+  const char *name() const override { return "qt"; }
+  bool open() override { return true; }
+  void close() override { m_image = QImage(); }
+  bool grab(CaptureFrame &frame) override;
+
+private:
+  QImage m_image;
+};
+
+// 视频捕获工作者类（不继承QThread），负责抓屏并把像素写入帧环
 class CaptureWorker : public QObject {
   Q_OBJECT
 public:
-  explicit CaptureWorker(QObject *parent = nullptr);
+  explicit CaptureWorker(std::shared_ptr<FrameRing> ring,
+                         QObject *parent = nullptr);
   ~CaptureWorker();
 
 public slots:
-  void startCapture(int width, int height, int fps);
+  void startCapture(int fps);
   void stopCapture();
-  void captureFrame();                       // 定时器触发的捕获函数
-  void setResolution(int width, int height); // 动态设置分辨率
-  void setFps(int fps);                      // 动态设置帧率
+  void captureFrame();  // 定时器触发的捕获函数
+  void captureNow();    // 不论有无损伤立即捕获一帧（编码端精修需要最新画面）
+  void setFps(int fps); // 动态设置帧率
 
 signals:
-  void frameReady(const rtc::binary &h264Data, quint64 timestamp_us);
+  void frameCaptured(); // 帧环中有新帧，唤醒编码线程
   void captureStarted();
   void captureStopped();
 
 private:
-  std::pair<rtc::binary, quint64> captureScreenH264();
+  // force为true时跳过损伤检查
+  bool grabToRing(bool force = false);
   bool m_running;
-  int m_width;  // 编码器分辨率
-  int m_height; // 编码器分辨率
   int m_fps;
   int m_screenWidth;  // 实际屏幕分辨率
   int m_screenHeight; // 实际屏幕分辨率
   QMutex m_mutex;
   QTimer *m_captureTimer;
   qint64 m_lastFrameTime; // 上一帧发送时间
+  bool m_damageTracking;  // 是否按损伤区域调度捕获
+  int m_idleKeepaliveMs;  // 无损伤时的保活帧间隔
+
+  std::shared_ptr<FrameRing> m_ring;               // 与编码线程共享的帧环
+  std::unique_ptr<ScreenCaptureBackend> m_backend; // 屏幕捕获后端
+};
+
+// 视频编码工作者类（不继承QThread），从帧环取最新帧编码为协商的视频格式
+// 与CaptureWorker运行在不同线程，第N帧编码时第N+1帧的抓屏可以同时进行
+class EncodeWorker : public QObject {
+  Q_OBJECT
+public:
+  explicit EncodeWorker(std::shared_ptr<FrameRing> ring,
+                        VideoCodec codec = VideoCodec::H264,
+                        QObject *parent = nullptr);
+  ~EncodeWorker();
+
+  // 无损文字块的压缩方式，None为不发送，须在startEncoder之前设置
+  void setTextTileCompression(TextTileCompression compression) {
+    m_textTileCompression = compression;
+  }
+
+public slots:
+  void startEncoder(int width, int height, int fps, int bitrate);
+  void stopEncoder();
+  void encodePendingFrames(); // 取出帧环中最新的帧并编码
+  // 运行中调整编码分辨率/帧率/码率，bitrate为0时按分辨率和帧率估算
+  void reconfigure(int width, int height, int fps, int bitrate);
+  void requestKeyFrame(); // 下一帧编码为IDR
+  void resetTextTiles();  // 控制端丢失了文字块状态，从头发送
+  // 文字块通道打开/关闭：关闭期间不发送文字块，也不再把块当作已覆盖
+  void setTextTileChannelOpen(bool open);
+
+private slots:
+  void logStats();
+
+signals:
+  void frameReady(const EncodedVideoFrame &frame);
+  void textTilesReady(const QByteArray &message); // 一条无损文字块消息
+  void captureRequested(); // 需要一帧新画面（画面静止后的精修、等待预算的文字块）
+
+private:
+  static int defaultBitrate(int width, int height, int fps);
+
+  bool m_running;
+  bool m_sliceOutput; // 条带已由编码器回调逐个发出，整帧不再发送
+  bool m_keyFramePending; // 收到关键帧请求后还没有编码出关键帧
+  RoiSettings m_roi;
+  bool m_skipUnchanged;
+  TileChangeMap m_tileChangeMap; // 与上一次处理的帧比较的分块变化
+  double m_changeRatioSum;       // 统计周期内各帧变化块比例之和
+  int m_changeRatioFrames;
+  QElapsedTimer m_lastEncodeTimer; // 距上一次编码输出的时间，用于保活
+  bool m_scrollDetection;
+  ScrollDetector m_scrollDetector;
+  int m_scrollFrames; // 统计周期内检测到滚动的帧数
+
+  // 画面静止后的精修
+  void accumulateRefinement(const TileChanges &changes);
+  int m_refineAfterMs;
+  int m_refineFrames;
+  int m_refineQp;
+  TileChanges m_refineArea;  // 上次精修以来变化过的块
+  int m_refineFramesLeft;    // 本轮还可以发送的精修帧数
+  QElapsedTimer m_lastChangeTimer; // 距上一次画面变化的时间
+  QTimer *m_refineTimer;     // 静止到期后请求捕获一帧用于精修
+
+  // 文字类分块的无损辅助流
+  TextTileCompression m_textTileCompression;
+  std::unique_ptr<TextTileEncoder> m_textTiles;
+  QTimer *m_textTileTimer; // 还有文字块等待预算时下一帧间隔后请求捕获
+  quint64 m_textTileBytes; // 统计周期内发出的文字块字节数
+  bool m_textTileChannelOpen; // 文字块通道已打开，控制端能收到消息
+  int m_width;  // 编码器分辨率
+  int m_height; // 编码器分辨率
+  int m_fps;
+  int m_bitrate; // 控制端指定的码率，0为自动
+  QTimer *m_statsTimer;
+  QElapsedTimer m_statsElapsed; // 距上次输出统计的时间
+  quint64 m_lastCopiedBytes;    // 上次输出统计时的累计拷贝字节数
 
-  H264Encoder *m_encoder; // H264编码器
+  VideoCodec m_codec;
+  std::unique_ptr<VideoEncoder> m_encoder; // 视频编码后端
+  std::shared_ptr<FrameRing> m_ring;
 };
 
 // 音频捕获工作者类（不继承QThread）
@@ -67,7 +206,7 @@ private slots:
   void checkAudioLevel(); // 检查音频电平
 
 signals:
-  void audioFrameReady(const rtc::binary &audioData);
+  void audioFrameReady(const MediaBuffer &audioData);
   void captureStarted();
   void captureStopped();
 
@@ -104,13 +243,26 @@ public:
   explicit MediaCapture(QObject *parent = nullptr);
   ~MediaCapture();
 
+  // 视频编码格式由信令协商决定，须在startCapture之前设置
+  void setVideoCodec(VideoCodec codec) { m_videoCodec = codec; }
+  // 无损文字块的压缩方式，由信令协商决定，须在startCapture之前设置
+  void setTextTileCompression(TextTileCompression compression) {
+    m_textTileCompression = compression;
+  }
   void startCapture(int width = 1920, int height = 1080, int fps = 10);
   void stopCapture();
   bool isCapturing() const { return m_isCapturing; }
 
-  // 动态设置分辨率和帧率
+  // 动态设置分辨率、帧率和码率（bitrate为0时自动估算），不中断会话
   void setResolution(int width, int height);
   void setFps(int fps);
+  void reconfigureVideo(int width, int height, int fps, int bitrate);
+  // 控制端请求关键帧（PLI/FIR或数据通道消息）
+  void requestKeyFrame();
+  // 发送失败后让编码端从头发送文字块
+  void resetTextTiles();
+  // 文字块通道状态，可在startCapture之前调用
+  void setTextTileChannelOpen(bool open);
 
   // 启动音频捕获
   void startAudioCapture(int sampleRate = 44100, int channels = 2);
@@ -118,8 +270,8 @@ public:
   bool isAudioCapturing() const { return m_isAudioCapturing; }
 
 private slots:
-  void onCaptureFrameReady(const rtc::binary &h264Data, quint64 timestamp_us);
-  void onAudioFrameReady(const rtc::binary &audioData);
+  void onCaptureFrameReady(const EncodedVideoFrame &frame);
+  void onAudioFrameReady(const MediaBuffer &audioData);
 
 private:
   bool m_isCapturing;
@@ -127,27 +279,39 @@ private:
 
   // 工作者对象和线程
   CaptureWorker *m_captureWorker;
+  EncodeWorker *m_encodeWorker;
   AudioCaptureWorker *m_audioCaptureWorker;
   QThread *m_captureThread;
+  QThread *m_encodeThread;
   QThread *m_audioCaptureThread;
+  std::shared_ptr<FrameRing> m_frameRing; // 捕获与编码阶段之间的帧环
 
   int m_width;
   int m_height;
   int m_fps;
+  int m_bitrate;
+  VideoCodec m_videoCodec;
+  TextTileCompression m_textTileCompression;
+  bool m_textTileChannelOpen;
 
 signals:
-  void videoFrameReady(const rtc::binary &h264Data, quint64 timestamp_us);
-  void audioFrameReady(const rtc::binary &audioData);
+  void videoFrameReady(const EncodedVideoFrame &frame);
+  void textTilesReady(const QByteArray &message);
+  void audioFrameReady(const MediaBuffer &audioData);
 
   // 内部信号，用于线程间通信
-  void startVideoCapture(int width, int height, int fps);
+  void startVideoCapture(int fps);
+  void startVideoEncoder(int width, int height, int fps, int bitrate);
   void stopVideoCapture();
   void startAudioCaptureSignal(int sampleRate, int channels);
   void stopAudioCaptureSignal();
   void frameReceived();
-  void setResolutionSignal(int width,
-                           int height); // 内部信号，传递分辨率设置到工作线程
-  void setFpsSignal(int fps);           // 内部信号，传递帧率设置到工作线程
+  void reconfigureEncoderSignal(int width, int height, int fps,
+                                int bitrate); // 内部信号，传递编码参数到编码线程
+  void setFpsSignal(int fps); // 内部信号，传递帧率设置到捕获线程
+  void requestKeyFrameSignal();
+  void resetTextTilesSignal();
+  void textTileChannelOpenSignal(bool open);
 };
 
 #endif // MEDIA_CAPTURE_H
@@ -59,7 +59,7 @@ void AudioPlayWorker::stopPlayback()
     emit playbackStopped();
 }
 
-void AudioPlayWorker::addAudioData(const rtc::binary& audioData)
+void AudioPlayWorker::addAudioData(const MediaBuffer& audioData)
 {
     if (!m_running) {
         return;
@@ -183,11 +183,11 @@ void AudioPlayWorker::processAudioQueue()
     
     // 处理队列中的音频数据
     while (!m_audioQueue.isEmpty() && freeBytes > 0) {
-        rtc::binary audioData = m_audioQueue.dequeue();
+        MediaBuffer audioData = m_audioQueue.dequeue();
         
         if (audioData.size() > 0 && audioData.size() <= freeBytes) {
             qint64 bytesWritten = m_audioDevice->write(
-                reinterpret_cast<const char*>(audioData.data()), 
+                audioData.constData(), 
                 audioData.size()
             );
             
@@ -283,7 +283,7 @@ void MediaPlayer::stopPlayback()
     }
 }
 
-void MediaPlayer::playAudioData(const rtc::binary& audioData)
+void MediaPlayer::playAudioData(const MediaBuffer& audioData)
 {
     if (m_isPlaying) {
         emit addAudioDataToWorker(audioData);
@@ -13,6 +13,7 @@
 #include <QIODevice>
 #include <QBuffer>
 #include <rtc/rtc.hpp>
+#include "media_buffer.h"
 
 // 音频播放工作者类（不继承QThread）
 class AudioPlayWorker : public QObject
@@ -25,7 +26,7 @@ public:
 public slots:
     void startPlayback();
     void stopPlayback();
-    void addAudioData(const rtc::binary& audioData);
+    void addAudioData(const MediaBuffer& audioData);
     void processAudio();
     
 signals:
@@ -43,7 +44,7 @@ private:
     bool m_audioInitialized;
     QMutex m_mutex;
     QWaitCondition m_waitCondition;
-    QQueue<rtc::binary> m_audioQueue;
+    QQueue<MediaBuffer> m_audioQueue;
     QTimer* m_processTimer;
     
     // Qt Audio 相关
@@ -68,7 +69,7 @@ public:
 
     void startPlayback();
     void stopPlayback();
-    void playAudioData(const rtc::binary& audioData);
+    void playAudioData(const MediaBuffer& audioData);
     
     bool isPlaying() const { return m_isPlaying; }
 
@@ -84,7 +85,7 @@ signals:
     // 内部信号，用于线程间通信
     void startAudioPlayback();
     void stopAudioPlayback();
-    void addAudioDataToWorker(const rtc::binary& audioData);
+    void addAudioDataToWorker(const MediaBuffer& audioData);
 };
 
 #endif // MEDIA_PLAYER_H
@@ -0,0 +1,365 @@
+#include "openh264_encoder.h"
+
+#ifdef HAVE_OPENH264
+
+#include "color_convert.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#include <QThread>
+#include <cstring>
+
+OpenH264Encoder::OpenH264Encoder()
+    : m_encoder(nullptr), m_width(0), m_height(0), m_fps(30), m_bitrate(2000000), m_frameIndex(0),
+      m_frameIndexBase(0), m_timestampBaseUs(0), m_firstFrame(true)
+{
+    m_colorConverter = std::make_unique<ColorConverter>();
+    m_colorConverter->setVerifyInterval(ConfigUtil->colorConvertVerifyInterval);
+    m_keyFrameRequested = false;
+    m_keyFrameMinIntervalMs = ConfigUtil->keyFrameMinIntervalMs;
+    m_rateControl = RateControlSettings::fromConfig();
+}
+
+OpenH264Encoder::~OpenH264Encoder()
+{
+    cleanup();
+}
+
+bool OpenH264Encoder::initialize(int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    closeEncoder();
+    // OpenH264要求偶数尺寸
+    m_width = width & ~1;
+    m_height = height & ~1;
+    m_fps = qBound(1, fps, 60);
+    m_bitrate = bitrate;
+
+    if (!openEncoder())
+    {
+        closeEncoder();
+        return false;
+    }
+
+    LOG_INFO("OpenH264 encoder initialized: {}x{}, {}fps, {}bps, {} long-term refs", m_width, m_height, m_fps,
+             m_bitrate, longTermRefs());
+    return true;
+}
+
+bool OpenH264Encoder::openEncoder()
+{
+    if (WelsCreateSVCEncoder(&m_encoder) != 0 || !m_encoder)
+    {
+        LOG_ERROR("Failed to create OpenH264 encoder");
+        m_encoder = nullptr;
+        return false;
+    }
+
+    int traceLevel = WELS_LOG_ERROR;
+    m_encoder->SetOption(ENCODER_OPTION_TRACE_LEVEL, &traceLevel);
+
+    SEncParamExt param;
+    m_encoder->GetDefaultParams(&param);
+
+    // 屏幕内容实时模式：开启背景检测/场景切换检测，静止区域几乎不耗码率
+    param.iUsageType = SCREEN_CONTENT_REAL_TIME;
+    param.iPicWidth = m_width;
+    param.iPicHeight = m_height;
+    // OpenH264没有CRF：cbr用码率模式并把峰值限制为目标码率，其余用质量模式并收紧QP上限
+    const bool capped = m_rateControl.mode != RateControlMode::Quality;
+    const int maxBitrate = capped ? m_bitrate : UNSPECIFIED_BIT_RATE;
+    param.iTargetBitrate = m_bitrate;
+    param.iMaxBitrate = maxBitrate;
+    param.iRCMode = m_rateControl.mode == RateControlMode::Cbr ? RC_BITRATE_MODE : RC_QUALITY_MODE;
+    if (m_rateControl.mode != RateControlMode::Cbr)
+    {
+        param.iMaxQp = qBound(m_rateControl.quality, m_rateControl.quality + 8, 51);
+    }
+    param.fMaxFrameRate = static_cast<float>(m_fps);
+    param.iComplexityMode = LOW_COMPLEXITY;
+    param.uiIntraPeriod = 0; // 关键帧按需产生
+    param.iNumRefFrame = 1;
+    param.eSpsPpsIdStrategy = CONSTANT_ID;
+    param.iEntropyCodingModeFlag = 0; // CAVLC，与baseline profile一致
+    param.bEnableFrameSkip = true;
+    param.bEnableBackgroundDetection = true;
+    param.bEnableSceneChangeDetect = true;
+    param.bEnableAdaptiveQuant = false;
+    param.bEnableDenoise = false;
+    // 屏幕内容模式的长期参考按场景标记，切回之前的画面时以对应的长期参考帧预测
+    param.bEnableLongTermReference = longTermRefs() > 0;
+    if (param.bEnableLongTermReference)
+    {
+        param.iLTRRefNum = longTermRefs();
+        param.iNumRefFrame = 1 + longTermRefs();
+    }
+    param.bPrefixNalAddingCtrl = false;
+    param.iTemporalLayerNum = 1;
+    param.iSpatialLayerNum = 1;
+
+    // 采集线程也要占CPU，编码线程数不超过核心数-1
+    int threads = qBound(1, QThread::idealThreadCount() - 1, 4);
+    param.iMultipleThreadIdc = threads;
+
+    SSpatialLayerConfig &layer = param.sSpatialLayers[0];
+    layer.iVideoWidth = m_width;
+    layer.iVideoHeight = m_height;
+    layer.fFrameRate = static_cast<float>(m_fps);
+    layer.iSpatialBitrate = m_bitrate;
+    layer.iMaxSpatialBitrate = maxBitrate;
+    layer.uiProfileIdc = PRO_BASELINE;
+    if (threads > 1)
+    {
+        // 多线程按固定条带数并行
+        layer.sSliceArgument.uiSliceMode = SM_FIXEDSLCNUM_SLICE;
+        layer.sSliceArgument.uiSliceNum = threads;
+    }
+    else
+    {
+        layer.sSliceArgument.uiSliceMode = SM_SINGLE_SLICE;
+    }
+
+    int ret = m_encoder->InitializeExt(&param);
+    if (ret != cmResultSuccess)
+    {
+        LOG_ERROR("Failed to initialize OpenH264 encoder ({}x{}, {}fps, {}bps): {}", m_width, m_height, m_fps,
+                  m_bitrate, ret);
+        return false;
+    }
+
+    int videoFormat = videoFormatI420;
+    m_encoder->SetOption(ENCODER_OPTION_DATAFORMAT, &videoFormat);
+
+    m_i420.resize(static_cast<size_t>(m_width) * m_height * 3 / 2);
+    m_nv12UV.resize(static_cast<size_t>(m_width) * m_height / 2);
+    m_firstFrame = true;
+    return true;
+}
+
+void OpenH264Encoder::closeEncoder()
+{
+    if (m_encoder)
+    {
+        m_encoder->Uninitialize();
+        WelsDestroySVCEncoder(m_encoder);
+        m_encoder = nullptr;
+    }
+}
+
+bool OpenH264Encoder::bgraToI420(const uchar *bgra, int width, int height, int stride)
+{
+    uint8_t *dstY = m_i420.data();
+    uint8_t *dstU = dstY + static_cast<size_t>(m_width) * m_height;
+    uint8_t *dstV = dstU + static_cast<size_t>(m_width / 2) * (m_height / 2);
+
+    // 同尺寸或2倍下采样走SIMD转换得到NV12，再把交错的UV拆开
+    int downscale = ColorConverter::downscaleFactor(width, height, m_width, m_height);
+    if (downscale > 0 && m_colorConverter->convertToNv12(bgra, width, height, stride, downscale, dstY, m_width,
+                                                         m_nv12UV.data(), m_width))
+    {
+        const size_t chromaSize = static_cast<size_t>(m_width / 2) * (m_height / 2);
+        const uint8_t *uv = m_nv12UV.data();
+        for (size_t i = 0; i < chromaSize; ++i)
+        {
+            dstU[i] = uv[2 * i];
+            dstV[i] = uv[2 * i + 1];
+        }
+        return true;
+    }
+
+    SwsContext *swsContext = m_swsCache.get(width, height, AV_PIX_FMT_BGRA, m_width, m_height, AV_PIX_FMT_YUV420P);
+    if (!swsContext)
+    {
+        LOG_ERROR("SwsContext creation failed for BGRA to I420 conversion ({}x{} -> {}x{})", width, height, m_width,
+                  m_height);
+        return false;
+    }
+
+    const uint8_t *srcData[1] = {bgra};
+    int srcLinesize[1] = {stride};
+    uint8_t *dstData[3] = {dstY, dstU, dstV};
+    int dstLinesize[3] = {m_width, m_width / 2, m_width / 2};
+    return sws_scale(swsContext, srcData, srcLinesize, 0, height, dstData, dstLinesize) == m_height;
+}
+
+EncodedVideoFrame OpenH264Encoder::encodeFrame(const uchar *bgra, int width, int height, int stride,
+                                               qint64 captureTimeUs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+
+    EncodedVideoFrame result;
+    quint64 timestamp_us = m_timestampBaseUs + (m_frameIndex - m_frameIndexBase) * (1000000 / m_fps);
+
+    if (!m_encoder)
+    {
+        LOG_ERROR("Encoder not initialized");
+        return result;
+    }
+    if (!bgraToI420(bgra, width, height, stride))
+    {
+        LOG_ERROR("Failed to convert BGRA pixels to I420");
+        return result;
+    }
+    m_frameIndex++;
+
+    // 首帧之后只在接收端请求时插入IDR，短时间内的多次请求合并
+    if (!m_firstFrame && m_keyFrameRequested.load() &&
+        (!m_lastKeyFrameTimer.isValid() || m_lastKeyFrameTimer.elapsed() >= m_keyFrameMinIntervalMs))
+    {
+        LOG_INFO("Forcing IDR on key frame request");
+        m_encoder->ForceIntraFrame(true);
+        m_keyFrameRequested = false;
+        m_lastKeyFrameTimer.start();
+    }
+
+    SSourcePicture picture;
+    std::memset(&picture, 0, sizeof(picture));
+    picture.iColorFormat = videoFormatI420;
+    picture.iPicWidth = m_width;
+    picture.iPicHeight = m_height;
+    picture.iStride[0] = m_width;
+    picture.iStride[1] = m_width / 2;
+    picture.iStride[2] = m_width / 2;
+    picture.pData[0] = m_i420.data();
+    picture.pData[1] = picture.pData[0] + static_cast<size_t>(m_width) * m_height;
+    picture.pData[2] = picture.pData[1] + static_cast<size_t>(m_width / 2) * (m_height / 2);
+    picture.uiTimeStamp = static_cast<long long>(timestamp_us / 1000);
+
+    SFrameBSInfo info;
+    std::memset(&info, 0, sizeof(info));
+    int ret = m_encoder->EncodeFrame(&picture, &info);
+    if (ret != cmResultSuccess)
+    {
+        LOG_ERROR("OpenH264 EncodeFrame failed: {}", ret);
+        return result;
+    }
+    if (info.eFrameType == videoFrameTypeSkip || info.eFrameType == videoFrameTypeInvalid)
+    {
+        // 码控跳帧或画面没有变化
+        return result;
+    }
+
+    // 各层的码流在OpenH264内部缓冲中连续存放，带Annex-B起始码，下一帧会被覆盖，需要拷贝出来
+    bool keyFrame = info.eFrameType == videoFrameTypeIDR;
+    for (int i = 0; i < info.iLayerNum; ++i)
+    {
+        const SLayerBSInfo &layer = info.sLayerInfo[i];
+        int layerSize = 0;
+        for (int nal = 0; nal < layer.iNalCount; ++nal)
+        {
+            layerSize += layer.pNalLengthInByte[nal];
+        }
+        result.appendData(layer.pBsBuf, layerSize, keyFrame);
+    }
+
+    if (result.isEmpty())
+    {
+        return result;
+    }
+
+    if (keyFrame)
+    {
+        m_lastKeyFrameTimer.start();
+    }
+    m_firstFrame = false;
+    // uiAverageFrameQP为上一次编码的帧的平均QP，取不到时按未知处理
+    int qp = -1;
+    SEncoderStatistics stats;
+    std::memset(&stats, 0, sizeof(stats));
+    if (m_encoder->GetOption(ENCODER_OPTION_GET_STATISTICS, &stats) == cmResultSuccess)
+    {
+        qp = static_cast<int>(stats.uiAverageFrameQP);
+    }
+    result.setQp(qp);
+    recordFrameSize(static_cast<int>(result.size()), keyFrame, qp);
+
+    result.setTimestampUs(timestamp_us);
+    result.setCaptureTimeUs(captureTimeUs);
+    result.setEncodeDurationUs(encodeTimer.nsecsElapsed() / 1000);
+    return result;
+}
+
+bool OpenH264Encoder::reconfigure(int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_encoder)
+    {
+        LOG_WARN("Cannot reconfigure encoder - not initialized");
+        return false;
+    }
+
+    fps = qBound(1, fps, 60);
+    if (bitrate <= 0)
+    {
+        bitrate = m_bitrate;
+    }
+
+    if (fps != m_fps)
+    {
+        m_timestampBaseUs += (m_frameIndex - m_frameIndexBase) * (1000000 / m_fps);
+        m_frameIndexBase = m_frameIndex;
+    }
+
+    if ((width & ~1) == m_width && (height & ~1) == m_height)
+    {
+        // 尺寸不变时就地修改码率和帧率
+        SBitrateInfo bitrateInfo;
+        bitrateInfo.iLayer = SPATIAL_LAYER_ALL;
+        bitrateInfo.iBitrate = bitrate;
+        float frameRate = static_cast<float>(fps);
+        if (m_rateControl.mode != RateControlMode::Quality)
+        {
+            // 峰值码率与目标码率一起调整，否则目标码率超过原峰值时会被拒绝
+            SBitrateInfo maxBitrateInfo = bitrateInfo;
+            m_encoder->SetOption(ENCODER_OPTION_MAX_BITRATE, &maxBitrateInfo);
+        }
+        if (m_encoder->SetOption(ENCODER_OPTION_BITRATE, &bitrateInfo) == cmResultSuccess &&
+            m_encoder->SetOption(ENCODER_OPTION_FRAME_RATE, &frameRate) == cmResultSuccess)
+        {
+            m_fps = fps;
+            m_bitrate = bitrate;
+            LOG_INFO("OpenH264 encoder updated in place: {}fps, {}bps", m_fps, m_bitrate);
+            return true;
+        }
+    }
+
+    // 尺寸变化需要重新打开，新参数集随首帧IDR一起下发
+    closeEncoder();
+    m_width = width & ~1;
+    m_height = height & ~1;
+    m_fps = fps;
+    m_bitrate = bitrate;
+    if (!openEncoder())
+    {
+        closeEncoder();
+        return false;
+    }
+    LOG_INFO("OpenH264 encoder reopened: {}x{}, {}fps, {}bps", m_width, m_height, m_fps, m_bitrate);
+    return true;
+}
+
+void OpenH264Encoder::requestKeyFrame()
+{
+    m_keyFrameRequested = true;
+}
+
+void OpenH264Encoder::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_frameIndex = 0;
+    m_frameIndexBase = 0;
+    m_timestampBaseUs = 0;
+}
+
+void OpenH264Encoder::cleanup()
+{
+    QMutexLocker locker(&m_mutex);
+    closeEncoder();
+    m_swsCache.clear();
+}
+
+#endif // HAVE_OPENH264
@@ -0,0 +1,67 @@
+#ifndef OPENH264_ENCODER_H
+#define OPENH264_ENCODER_H
+
+#ifdef HAVE_OPENH264
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <wels/codec_api.h>
+
+#include "frame_pool.h"
+#include "video_encoder.h"
+
+class ColorConverter;
+
+// 直接调用OpenH264的软件编码后端，按屏幕内容（SCREEN_CONTENT_REAL_TIME）调优
+// 比libx264轻得多，用于没有硬件编码器的低功耗ARM设备
+class OpenH264Encoder : public VideoEncoder {
+public:
+  OpenH264Encoder();
+  ~OpenH264Encoder() override;
+
+  bool initialize(int width, int height, int fps, int bitrate) override;
+  EncodedVideoFrame encodeFrame(const uchar *bgra, int width, int height,
+                                int stride,
+                                qint64 captureTimeUs = 0) override;
+  bool reconfigure(int width, int height, int fps, int bitrate) override;
+  void requestKeyFrame() override;
+  void reset() override;
+  void cleanup() override;
+
+  QString backendName() const override { return "openh264"; }
+  bool supportsLongTermRefs() const override { return true; }
+
+private:
+  bool openEncoder();
+  void closeEncoder();
+  bool bgraToI420(const uchar *bgra, int width, int height, int stride);
+
+  ISVCEncoder *m_encoder;
+  std::unique_ptr<ColorConverter> m_colorConverter;
+  SwsContextCache m_swsCache;
+  std::vector<uint8_t> m_i420;   // 编码输入（Y/U/V连续存放）
+  std::vector<uint8_t> m_nv12UV; // SIMD转换输出的交错UV，再拆成U/V
+
+  int m_width;
+  int m_height;
+  int m_fps;
+  int m_bitrate;
+  RateControlSettings m_rateControl;
+  qint64 m_frameIndex;
+  qint64 m_frameIndexBase;   // 最近一次帧率变化时的帧序号
+  quint64 m_timestampBaseUs; // 最近一次帧率变化时的时间戳
+  bool m_firstFrame;
+
+  std::atomic<bool> m_keyFrameRequested;
+  QElapsedTimer m_lastKeyFrameTimer;
+  int m_keyFrameMinIntervalMs;
+
+  QMutex m_mutex;
+};
+
+#endif // HAVE_OPENH264
+
+#endif // OPENH264_ENCODER_H
@@ -0,0 +1,217 @@
+#include "presentation_scheduler.h"
+#include "frame_ring.h"
+#include "logger_manager.h"
+#include <QEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // 每绘制这么多帧输出一次统计
+    const size_t kStatsInterval = 300;
+    // 绘制间隔按刷新周期分档的上界，最后一档不设上界：
+    // 不到半个周期（同一刷新内画了两次，前一帧没有被看到）、约1个、约2个、更久（画面静止或丢帧）
+    const double kIntervalBinsPeriods[] = {0.5, 1.5, 2.5};
+    // 超过这么多个周期的间隔视为画面静止，不计入相位偏差
+    const double kMaxJitterPeriods = 4.0;
+
+    // 只有这些平台的requestUpdate由显示刷新驱动
+    bool updateRequestFollowsVsync()
+    {
+        const QString platform = QGuiApplication::platformName();
+        return platform.startsWith("wayland") || platform == "cocoa";
+    }
+}
+
+PresentationScheduler::PresentationScheduler(QObject *parent)
+    : QObject(parent),
+      m_pendingSinceUs(0),
+      m_updateRequested(false),
+      m_superseded(0),
+      m_useUpdateRequest(updateRequestFollowsVsync()),
+      m_paintPending(false),
+      m_submittedAtUs(0),
+      m_lastPaintUs(0),
+      m_presented(0),
+      m_waitSumUs(0),
+      m_waitCount(0)
+{
+    m_intervalsUs.reserve(kStatsInterval);
+    LOG_DEBUG("Presentation {} on platform {}",
+              m_useUpdateRequest ? "follows window update requests" : "is immediate",
+              QGuiApplication::platformName());
+}
+
+void PresentationScheduler::setWindow(QWindow *window)
+{
+    if (m_window == window)
+    {
+        return;
+    }
+    if (m_window)
+    {
+        m_window->removeEventFilter(this);
+    }
+    m_window = window;
+    if (m_window)
+    {
+        m_window->installEventFilter(this);
+    }
+}
+
+void PresentationScheduler::submit(const QImage &frame)
+{
+    bool request = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_pending.isNull())
+        {
+            // 还没显示就被取代，释放后解码器图像环可以复用它
+            m_superseded++;
+        }
+        else
+        {
+            m_pendingSinceUs = FrameRing::clockUs();
+        }
+        m_pending = frame;
+        request = !m_updateRequested;
+        m_updateRequested = true;
+    }
+    // 每次UpdateRequest之前最多投递一次，GUI事件队列里不会堆积帧
+    if (request)
+    {
+        QMetaObject::invokeMethod(this, &PresentationScheduler::requestUpdate, Qt::QueuedConnection);
+    }
+}
+
+void PresentationScheduler::requestUpdate()
+{
+    // 没有帧回调的平台上UpdateRequest只是定时器，白白多等最多5ms；
+    // 窗口不可见时平台可能不再投递UpdateRequest，也直接交给界面
+    if (m_useUpdateRequest && m_window && m_window->isExposed())
+    {
+        // 同一窗口的多次请求由Qt合并为一次UpdateRequest
+        m_window->requestUpdate();
+        return;
+    }
+    presentPending();
+}
+
+bool PresentationScheduler::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_window && event->type() == QEvent::UpdateRequest)
+    {
+        bool requested = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            requested = m_updateRequested;
+        }
+        if (requested)
+        {
+            // 这次是为视频帧请求的：只重绘视频控件的画面区域，不让QWidgetWindow整窗重绘
+            presentPending();
+            return true;
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void PresentationScheduler::presentPending()
+{
+    QImage frame;
+    qint64 pendingSinceUs = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        frame = m_pending;
+        m_pending = QImage();
+        pendingSinceUs = m_pendingSinceUs;
+        m_updateRequested = false;
+    }
+    if (frame.isNull())
+    {
+        return;
+    }
+
+    // 上一帧交给界面后还没画出来就被这一帧覆盖时，只统计这一帧
+    m_paintPending = true;
+    m_submittedAtUs = pendingSinceUs;
+    m_presented++;
+    emit present(frame);
+}
+
+void PresentationScheduler::framePainted()
+{
+    if (!m_paintPending)
+    {
+        return;
+    }
+    const qint64 nowUs = FrameRing::clockUs();
+    if (m_lastPaintUs > 0)
+    {
+        m_intervalsUs.push_back(nowUs - m_lastPaintUs);
+    }
+    m_lastPaintUs = nowUs;
+    m_waitSumUs += nowUs - m_submittedAtUs;
+    m_waitCount++;
+    m_paintPending = false;
+
+    if (m_intervalsUs.size() >= kStatsInterval)
+    {
+        logStats();
+    }
+}
+
+void PresentationScheduler::logStats()
+{
+    quint64 superseded = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        superseded = m_superseded;
+    }
+    if (m_intervalsUs.empty())
+    {
+        return;
+    }
+
+    QScreen *screen = m_window ? m_window->screen() : QGuiApplication::primaryScreen();
+    const double refreshHz = screen && screen->refreshRate() >= 1.0 ? screen->refreshRate() : 60.0;
+    const double periodUs = 1e6 / refreshHz;
+
+    // 间隔按刷新周期分档；画面连续变化时，间隔离最近的整数个周期越远，显示节奏越不均匀
+    int bins[4] = {0, 0, 0, 0};
+    std::vector<qint64> jitterUs;
+    jitterUs.reserve(m_intervalsUs.size());
+    for (qint64 interval : m_intervalsUs)
+    {
+        const double periods = interval / periodUs;
+        int bin = 0;
+        while (bin < 3 && periods >= kIntervalBinsPeriods[bin])
+        {
+            bin++;
+        }
+        bins[bin]++;
+        if (periods <= kMaxJitterPeriods)
+        {
+            const double nearest = std::max(1.0, std::round(periods));
+            jitterUs.push_back(static_cast<qint64>(std::abs(interval - nearest * periodUs)));
+        }
+    }
+
+    const size_t count = m_intervalsUs.size();
+    std::sort(m_intervalsUs.begin(), m_intervalsUs.end());
+    std::sort(jitterUs.begin(), jitterUs.end());
+    const double jitterP50 = jitterUs.empty() ? 0 : jitterUs[jitterUs.size() / 2] / 1e3;
+    const double jitterP95 = jitterUs.empty() ? 0 : jitterUs[(jitterUs.size() * 95) / 100] / 1e3;
+    LOG_INFO("Present stats - presented: {}, superseded: {}, avg submit-to-paint {:.2f} ms, "
+             "paint interval p50 {:.2f} ms, p95 {:.2f} ms at {:.2f} Hz ({:.2f} ms), "
+             "intervals <0.5 refresh: {}, ~1: {}, ~2: {}, longer: {}, "
+             "deviation from refresh multiple p50 {:.2f} ms, p95 {:.2f} ms",
+             m_presented, superseded, m_waitCount > 0 ? m_waitSumUs / 1e3 / m_waitCount : 0.0,
+             m_intervalsUs[count / 2] / 1e3, m_intervalsUs[(count * 95) / 100] / 1e3, refreshHz, periodUs / 1e3,
+             bins[0], bins[1], bins[2], bins[3], jitterP50, jitterP95);
+    m_intervalsUs.clear();
+    m_waitSumUs = 0;
+    m_waitCount = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef PRESENTATION_SCHEDULER_H
+#define PRESENTATION_SCHEDULER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QWindow>
+#include <QtGlobal>
+#include <vector>
+
+// 控制端的显示调度：最多保留一帧待显示，显示之前被新帧取代的帧直接丢弃，
+// 网络抖动后的一串帧不会被连续绘制。Wayland（帧回调）和macOS（显示链接）的
+// QWindow::requestUpdate跟随显示器刷新，在窗口的UpdateRequest中交给界面；
+// xcb/Windows上它只是Qt的5ms定时器，与刷新无关，收到帧后直接交给界面。
+// 统计相邻两次实际绘制的间隔相对所在屏幕刷新周期的分布
+class PresentationScheduler : public QObject {
+  Q_OBJECT
+public:
+  explicit PresentationScheduler(QObject *parent = nullptr);
+
+  // 任意线程调用：替换待显示的帧
+  void submit(const QImage &frame);
+  // 显示视频的顶层窗口，没有窗口时收到帧直接显示
+  void setWindow(QWindow *window);
+
+public slots:
+  // 视频控件在paintEvent中绘制了新的一帧
+  void framePainted();
+
+signals:
+  void present(const QImage &frame); // 在调度器所在线程发出
+
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+  void requestUpdate();
+
+private:
+  void presentPending();
+  void logStats();
+
+  QMutex m_mutex;
+  QImage m_pending;       // 待显示的帧，由m_mutex保护
+  qint64 m_pendingSinceUs;
+  bool m_updateRequested; // 已投递requestUpdate或在等UpdateRequest，由m_mutex保护
+  quint64 m_superseded;   // 显示前被新帧取代而丢弃的帧，由m_mutex保护
+
+  // 只在调度器所在线程访问
+  QPointer<QWindow> m_window;
+  bool m_useUpdateRequest; // 平台的UpdateRequest与显示刷新同步
+  bool m_paintPending;     // 已交给界面还没绘制
+  qint64 m_submittedAtUs;  // 该帧提交的时刻
+  qint64 m_lastPaintUs;    // 上一次绘制的时刻，0为还没有
+  quint64 m_presented;
+  qint64 m_waitSumUs;      // 帧从提交到绘制的等待时间之和
+  int m_waitCount;
+  std::vector<qint64> m_intervalsUs; // 统计周期内相邻两次绘制的间隔
+};
+
+#endif // PRESENTATION_SCHEDULER_H
@@ -0,0 +1,194 @@
+#include "scroll_detector.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    inline uint64_t rotl(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    const uint64_t kPrime = 0x9E3779B97F4A7C15ull;
+    // 至少这么多行段对上才认为是滚动，避免几行文字变化被误判
+    const int kMinMatches = 8;
+}
+
+ScrollDetector::ScrollDetector(int maxShift)
+    : m_maxShift(qMax(1, maxShift)), m_width(0), m_height(0), m_tileSize(0), m_columns(0)
+{
+}
+
+void ScrollDetector::reset()
+{
+    m_segments.clear();
+    m_width = 0;
+    m_height = 0;
+    m_tileSize = 0;
+    m_columns = 0;
+}
+
+uint64_t ScrollDetector::hashSegment(const uchar *pixels, int bytes)
+{
+    uint64_t hash = static_cast<uint64_t>(bytes);
+    int i = 0;
+    for (; i + 8 <= bytes; i += 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, pixels + i, sizeof(value));
+        hash = rotl(hash ^ value, 29) * kPrime;
+    }
+    for (; i + 4 <= bytes; i += 4)
+    {
+        uint32_t value;
+        std::memcpy(&value, pixels + i, sizeof(value));
+        hash = rotl(hash ^ value, 29) * kPrime;
+    }
+    return hash;
+}
+
+void ScrollDetector::hashTileRows(const uchar *bgra, int stride, int column, int row)
+{
+    const int x = column * m_tileSize;
+    const int bytes = std::min(m_tileSize, m_width - x) * 4;
+    const int bottom = std::min(m_height, (row + 1) * m_tileSize);
+    for (int y = row * m_tileSize; y < bottom; ++y)
+    {
+        const uchar *pixels = bgra + static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4;
+        m_segments[static_cast<size_t>(y) * m_columns + column] = hashSegment(pixels, bytes);
+    }
+}
+
+ScrollMotion ScrollDetector::detect(const uchar *bgra, int width, int height, int stride, const TileChanges &changes)
+{
+    ScrollMotion motion;
+    motion.sourceHeight = height;
+    if (!changes.isValid() || changes.sourceWidth != width || changes.sourceHeight != height)
+    {
+        return motion;
+    }
+
+    // 尺寸或分块变化时没有上一帧可比，全部重新哈希
+    if (width != m_width || height != m_height || changes.tileSize != m_tileSize || changes.columns != m_columns)
+    {
+        m_width = width;
+        m_height = height;
+        m_tileSize = changes.tileSize;
+        m_columns = changes.columns;
+        m_segments.assign(static_cast<size_t>(height) * m_columns, 0);
+        for (int row = 0; row < changes.rows; ++row)
+        {
+            for (int column = 0; column < changes.columns; ++column)
+            {
+                hashTileRows(bgra, stride, column, row);
+            }
+        }
+        return motion;
+    }
+    if (changes.changedTiles == 0)
+    {
+        return motion;
+    }
+
+    // 变化块的外接矩形，光标附近未变化的块不算
+    int left = changes.columns, right = -1, top = changes.rows, bottom = -1;
+    for (int row = 0; row < changes.rows; ++row)
+    {
+        for (int column = 0; column < changes.columns; ++column)
+        {
+            if (changes.tiles[static_cast<size_t>(row) * changes.columns + column] == TileChanges::Changed)
+            {
+                left = std::min(left, column);
+                right = std::max(right, column);
+                top = std::min(top, row);
+                bottom = std::max(bottom, row);
+            }
+        }
+    }
+    if (right < 0)
+    {
+        return motion;
+    }
+    const int topY = top * m_tileSize;
+    const int bottomY = std::min(height, (bottom + 1) * m_tileSize);
+    const int rows = bottomY - topY;
+    const int maxShift = std::min(m_maxShift, rows - 1);
+    if (maxShift <= 0)
+    {
+        return motion;
+    }
+
+    // 先留下上一帧的行段哈希，再更新变化块
+    m_previous.resize(static_cast<size_t>(right - left + 1) * rows);
+    for (int column = left; column <= right; ++column)
+    {
+        uint64_t *previous = m_previous.data() + static_cast<size_t>(column - left) * rows;
+        for (int y = 0; y < rows; ++y)
+        {
+            previous[y] = m_segments[static_cast<size_t>(topY + y) * m_columns + column];
+        }
+    }
+    for (int row = top; row <= bottom; ++row)
+    {
+        for (int column = left; column <= right; ++column)
+        {
+            if (changes.tiles[static_cast<size_t>(row) * changes.columns + column] == TileChanges::Changed)
+            {
+                hashTileRows(bgra, stride, column, row);
+            }
+        }
+    }
+
+    m_votes.assign(static_cast<size_t>(maxShift) * 2 + 1, 0);
+    int changedSegments = 0;
+    std::unordered_map<uint64_t, int> previousIndex;
+    previousIndex.reserve(rows);
+    for (int column = left; column <= right; ++column)
+    {
+        // 上一帧这一列中内容唯一的行段（空白行等重复的不参与投票），值为-1表示重复
+        const uint64_t *previous = m_previous.data() + static_cast<size_t>(column - left) * rows;
+        previousIndex.clear();
+        for (int y = 0; y < rows; ++y)
+        {
+            auto inserted = previousIndex.emplace(previous[y], y);
+            if (!inserted.second)
+            {
+                inserted.first->second = -1;
+            }
+        }
+
+        for (int y = 0; y < rows; ++y)
+        {
+            const uint64_t current = m_segments[static_cast<size_t>(topY + y) * m_columns + column];
+            if (current == previous[y])
+            {
+                continue;
+            }
+            changedSegments++;
+            auto it = previousIndex.find(current);
+            if (it == previousIndex.end() || it->second < 0)
+            {
+                continue;
+            }
+            const int shift = y - it->second;
+            if (qAbs(shift) <= maxShift)
+            {
+                m_votes[shift + maxShift]++;
+            }
+        }
+    }
+
+    const auto best = std::max_element(m_votes.begin(), m_votes.end());
+    const int matches = *best;
+    // 变化的行段中至少三分之一按同一位移对上
+    if (matches < kMinMatches || matches * 3 < changedSegments)
+    {
+        return motion;
+    }
+
+    motion.dy = static_cast<int>(best - m_votes.begin()) - maxShift;
+    motion.matches = matches;
+    motion.area = QRect(left * m_tileSize, topY, std::min(width, (right + 1) * m_tileSize) - left * m_tileSize, rows);
+    return motion;
+}
@@ -0,0 +1,47 @@
+#ifndef SCROLL_DETECTOR_H
+#define SCROLL_DETECTOR_H
+
+#include <QRect>
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+
+#include "tile_change_map.h"
+
+// 一帧中变化区域的主要垂直滚动，坐标为捕获分辨率
+struct ScrollMotion {
+  QRect area;           // 滚动的区域（变化块的外接矩形）
+  int dy = 0;           // 内容的垂直位移（像素），向上滚动为负
+  int matches = 0;      // 按该位移能与上一帧对上的行段数
+  int sourceHeight = 0; // 捕获高度，编码尺寸不同时按比例换算
+
+  bool isValid() const { return dy != 0 && !area.isEmpty(); }
+};
+
+// 用行哈希找变化区域的主要垂直位移：每行按分块列分段哈希（只重新计算变化块内的分段），
+// 每个行段到上一帧同一列中找内容相同且唯一的行段，按位移投票取票数最多的；
+// 按列比较，滚动的窗口旁边有静止的边栏或背景时也能找到
+class ScrollDetector {
+public:
+  explicit ScrollDetector(int maxShift = 512);
+
+  // changes为同一帧的分块变化图；第一帧、尺寸变化或没有明显滚动时返回无效结果
+  ScrollMotion detect(const uchar *bgra, int width, int height, int stride,
+                      const TileChanges &changes);
+  void reset();
+
+private:
+  static uint64_t hashSegment(const uchar *pixels, int bytes);
+  void hashTileRows(const uchar *bgra, int stride, int column, int row);
+
+  int m_maxShift;
+  int m_width;
+  int m_height;
+  int m_tileSize;
+  int m_columns;
+  std::vector<uint64_t> m_segments; // 每行每个分块列一个哈希，行优先
+  std::vector<uint64_t> m_previous; // 变化区域内上一帧的行段哈希，列优先
+  std::vector<int> m_votes;
+};
+
+#endif // SCROLL_DETECTOR_H
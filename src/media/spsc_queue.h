@@ -0,0 +1,49 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 单生产者单消费者的无锁有界队列，槽位预先分配
+// push只能在一个线程调用，pop只能在另一个线程调用；满时push失败，由调用方决定丢弃策略
+template <typename T> class SpscQueue {
+public:
+  explicit SpscQueue(size_t capacity)
+      : m_slots(capacity + 1), m_head(0), m_tail(0) {}
+
+  bool push(T &&value) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t next = advance(tail);
+    if (next == m_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    m_slots[tail] = std::move(value);
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &value) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(m_slots[head]);
+    m_head.store(advance(head), std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return m_slots.size() - 1; }
+
+private:
+  size_t advance(size_t index) const {
+    return index + 1 == m_slots.size() ? 0 : index + 1;
+  }
+
+  std::vector<T> m_slots;
+  alignas(64) std::atomic<size_t> m_head; // 消费者写
+  alignas(64) std::atomic<size_t> m_tail; // 生产者写
+};
+
+#endif // SPSC_QUEUE_H
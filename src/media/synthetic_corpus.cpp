@@ -0,0 +1,232 @@
+#include "synthetic_corpus.h"
+
+namespace
+{
+    inline void setPixel(uchar *px, uchar b, uchar g, uchar r)
+    {
+        px[0] = b;
+        px[1] = g;
+        px[2] = r;
+        px[3] = 255;
+    }
+
+    // 简单的线性同余随机数，保证每次运行生成的画面一致
+    inline quint32 nextRandom(quint32 &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+}
+
+SyntheticCorpus::SyntheticCorpus(int width, int height)
+    : m_width(width & ~1), m_height(height & ~1), m_scrollStep(12)
+{
+    m_pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+}
+
+QString SyntheticCorpus::contentName(Content content)
+{
+    switch (content)
+    {
+    case StaticDesktop:
+        return "static";
+    case WindowDrag:
+        return "window-drag";
+    case Scrolling:
+        return "scrolling";
+    case VideoRegion:
+        return "video";
+    case AltTab:
+        return "alt-tab";
+    case Terminal:
+        return "terminal";
+    }
+    return "unknown";
+}
+
+QList<SyntheticCorpus::Content> SyntheticCorpus::allContents()
+{
+    return {StaticDesktop, WindowDrag, Scrolling, VideoRegion, AltTab, Terminal};
+}
+
+void SyntheticCorpus::fillBackground()
+{
+    for (int y = 0; y < m_height; ++y)
+    {
+        uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+        for (int x = 0; x < m_width; ++x)
+        {
+            setPixel(row + x * 4, static_cast<uchar>(x * 255 / m_width), static_cast<uchar>(y * 255 / m_height), 96);
+        }
+    }
+}
+
+void SyntheticCorpus::drawTextRows(int top, int bottom, int scrollOffset)
+{
+    // 白底上的“文字”：每行由长短不一的深色笔画组成，行高20像素
+    const int left = m_width / 8;
+    const int right = m_width - m_width / 8;
+    for (int y = top; y < bottom; ++y)
+    {
+        uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+        int pageY = y - top + scrollOffset;
+        int line = pageY / 20;
+        int inLine = pageY % 20;
+        for (int x = left; x < right; ++x)
+        {
+            bool ink = false;
+            if (inLine >= 4 && inLine < 16)
+            {
+                int glyph = (x - left) / 9;
+                quint32 seed = static_cast<quint32>(line * 977 + glyph * 131);
+                bool wordGap = (nextRandom(seed) % 7) == 0;
+                int column = (x - left) % 9;
+                ink = !wordGap && column < 6 && ((nextRandom(seed) >> (column + inLine)) & 1);
+            }
+            uchar v = ink ? 30 : 250;
+            setPixel(row + x * 4, v, v, v);
+        }
+    }
+}
+
+void SyntheticCorpus::drawTerminalRows(int scrollOffset)
+{
+    // 整屏深色背景，每行一种前景色（提示符、输出、路径等），行高20像素
+    static const uchar colors[][3] = {{204, 204, 204}, {120, 200, 80}, {230, 160, 90}, {80, 200, 230}};
+    for (int y = 0; y < m_height; ++y)
+    {
+        uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+        int pageY = y + scrollOffset;
+        int line = pageY / 20;
+        int inLine = pageY % 20;
+        quint32 lineSeed = static_cast<quint32>(line * 7919);
+        const uchar *color = colors[nextRandom(lineSeed) % 4];
+        int lineEnd = static_cast<int>(nextRandom(lineSeed) % static_cast<quint32>(m_width));
+        for (int x = 0; x < m_width; ++x)
+        {
+            bool ink = false;
+            if (inLine >= 4 && inLine < 16 && x < lineEnd)
+            {
+                int glyph = x / 9;
+                quint32 seed = static_cast<quint32>(line * 977 + glyph * 131);
+                bool wordGap = (nextRandom(seed) % 6) == 0;
+                int column = x % 9;
+                ink = !wordGap && column < 6 && ((nextRandom(seed) >> (column + inLine)) & 1);
+            }
+            if (ink)
+            {
+                setPixel(row + x * 4, color[0], color[1], color[2]);
+            }
+            else
+            {
+                setPixel(row + x * 4, 30, 30, 30);
+            }
+        }
+    }
+}
+
+const uchar *SyntheticCorpus::render(Content content, int frameIndex)
+{
+    fillBackground();
+
+    switch (content)
+    {
+    case StaticDesktop:
+    {
+        drawTextRows(m_height / 8, m_height - m_height / 8, 0);
+        // 光标每15帧闪烁一次
+        if ((frameIndex / 15) % 2 == 0)
+        {
+            // --size可以很小，光标裁剪到画面内
+            int cursorX = m_width / 2;
+            for (int y = m_height / 2; y < qMin(m_height, m_height / 2 + 18); ++y)
+            {
+                uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+                setPixel(row + cursorX * 4, 0, 0, 0);
+                if (cursorX + 1 < m_width)
+                {
+                    setPixel(row + (cursorX + 1) * 4, 0, 0, 0);
+                }
+            }
+        }
+        break;
+    }
+    case WindowDrag:
+    {
+        const int shift = (frameIndex * 8) % qMax(1, m_width / 2);
+        const int blockLeft = m_width / 10 + shift;
+        const int blockRight = qMin(m_width, blockLeft + m_width / 3);
+        const int blockTop = m_height / 5;
+        const int blockBottom = m_height - m_height / 3;
+        for (int y = blockTop; y < blockBottom; ++y)
+        {
+            uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+            for (int x = blockLeft; x < blockRight; ++x)
+            {
+                uchar v = static_cast<uchar>(((x - shift) ^ y) * 7);
+                setPixel(row + x * 4, v, static_cast<uchar>(v >> 1), static_cast<uchar>(255 - v));
+            }
+        }
+        break;
+    }
+    case Scrolling:
+        drawTextRows(0, m_height, frameIndex * m_scrollStep);
+        break;
+    case VideoRegion:
+    {
+        drawTextRows(0, m_height, 0);
+        quint32 state = static_cast<quint32>(frameIndex * 2654435761u);
+        for (int y = m_height / 4; y < m_height * 3 / 4; ++y)
+        {
+            uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+            for (int x = m_width / 4; x < m_width * 3 / 4; ++x)
+            {
+                // 平滑运动的渐变叠加少量噪声，接近自然视频的统计特性
+                quint32 noise = nextRandom(state) & 15;
+                setPixel(row + x * 4, static_cast<uchar>(x + frameIndex * 3 + noise),
+                         static_cast<uchar>(y + frameIndex * 2 + noise), static_cast<uchar>((x + y) / 2 + noise));
+            }
+        }
+        break;
+    }
+    case AltTab:
+    {
+        // 偶数段是文字编辑器，奇数段是铺满大半屏幕的图形窗口
+        const int phase = frameIndex % kAltTabPeriod;
+        if ((frameIndex / kAltTabPeriod) % 2 == 0)
+        {
+            drawTextRows(m_height / 10, m_height - m_height / 10, 0);
+        }
+        else
+        {
+            for (int y = m_height / 10; y < m_height - m_height / 10; ++y)
+            {
+                uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+                for (int x = m_width / 10; x < m_width - m_width / 10; ++x)
+                {
+                    uchar v = static_cast<uchar>((x * 3) ^ (y * 5));
+                    setPixel(row + x * 4, static_cast<uchar>(255 - v), v, static_cast<uchar>(v >> 1));
+                }
+            }
+        }
+        // 光标像打字一样每帧右移一格，切换之间的帧也各不相同
+        // 同样裁剪到画面内
+        const int cursorX = qMax(0, qMin(m_width - 2, m_width / 4 + phase * 9));
+        for (int y = m_height / 2; y < qMin(m_height, m_height / 2 + 18); ++y)
+        {
+            uchar *row = m_pixels.data() + static_cast<size_t>(y) * stride();
+            setPixel(row + cursorX * 4, 0, 0, 0);
+            if (cursorX + 1 < m_width)
+            {
+                setPixel(row + (cursorX + 1) * 4, 0, 0, 0);
+            }
+        }
+        break;
+    }
+    case Terminal:
+        drawTerminalRows(frameIndex * 20);
+        break;
+    }
+
+    return m_pixels.data();
+}
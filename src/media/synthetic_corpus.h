@@ -0,0 +1,49 @@
+#ifndef SYNTHETIC_CORPUS_H
+#define SYNTHETIC_CORPUS_H
+
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// 合成的桌面画面序列（32位BGRA），用于编码器测速和基准测试，保证各后端输入完全相同
+class SyntheticCorpus {
+public:
+  enum Content {
+    StaticDesktop, // 静止桌面，只有光标闪烁
+    WindowDrag,    // 纹理窗口在渐变背景上水平拖动
+    Scrolling,     // 文字页面向上滚动
+    VideoRegion,   // 桌面中间一块每帧全变的视频区域
+    AltTab,        // 每kAltTabPeriod帧在两个窗口之间切换，窗口内光标逐帧移动
+    Terminal,      // 深色背景的少色文字终端，每帧滚动一行
+  };
+  static constexpr int kAltTabPeriod = 10;
+  static constexpr int kAltTabWindows = 2; // AltTab画面交替显示的窗口数
+
+  SyntheticCorpus(int width, int height);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int stride() const { return m_width * 4; }
+
+  // 生成第frameIndex帧，返回的像素在下一次render之前有效
+  const uchar *render(Content content, int frameIndex);
+
+  // Scrolling每帧滚动的像素数，默认12
+  void setScrollStep(int pixels) { m_scrollStep = qMax(1, pixels); }
+
+  static QString contentName(Content content);
+  static QList<Content> allContents();
+
+private:
+  void fillBackground();
+  void drawTextRows(int top, int bottom, int scrollOffset);
+  void drawTerminalRows(int scrollOffset);
+
+  int m_width;
+  int m_height;
+  int m_scrollStep;
+  std::vector<uchar> m_pixels;
+};
+
+#endif // SYNTHETIC_CORPUS_H
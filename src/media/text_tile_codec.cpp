@@ -0,0 +1,490 @@
+#include "text_tile_codec.h"
+#include "logger_manager.h"
+#include <QDataStream>
+#include <QPainter>
+#include <algorithm>
+#include <cstring>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+    // 消息头：版本、压缩方式、标志、捕获宽高、块大小、条目数、未压缩正文长度，小端
+    const quint8 kVersion = 1;
+    const int kHeaderSize = 1 + 1 + 1 + 2 + 2 + 2 + 2 + 4;
+    const quint8 kFlagReset = 0x01; // 应用前先清除全部无损块
+
+    // 正文超过这个长度就结束当前消息，压缩后也远小于SCTP的64KB消息上限
+    const int kMaxRawMessageBytes = 48 * 1024;
+    // 接收端接受的最大块边长，超过的消息直接丢弃
+    const int kMaxTileSize = 256;
+    // 预算按压缩后的大小计，未压缩的部分按这个比例估算
+    const int kCompressionEstimate = 4;
+
+    // 文字类判定：相邻像素亮度差超过kEdgeLumaDelta算一个边缘，边缘占像素数的百分比
+    const int kEdgeLumaDelta = 48;
+    const int kMinEdgePercent = 3;
+
+    const int kZstdLevel = 3;
+    const int kZlibLevel = 3;
+
+    inline int luma(quint32 rgb)
+    {
+        return (((rgb >> 16) & 0xFF) * 77 + ((rgb >> 8) & 0xFF) * 150 + (rgb & 0xFF) * 29) >> 8;
+    }
+
+    QByteArray compressBody(const QByteArray &raw, TextTileCompression compression)
+    {
+#ifdef HAVE_ZSTD
+        if (compression == TextTileCompression::Zstd)
+        {
+            QByteArray out(static_cast<int>(ZSTD_compressBound(raw.size())), Qt::Uninitialized);
+            const size_t size = ZSTD_compress(out.data(), out.size(), raw.constData(), raw.size(), kZstdLevel);
+            if (ZSTD_isError(size))
+            {
+                LOG_ERROR("zstd compression failed: {}", ZSTD_getErrorName(size));
+                return QByteArray();
+            }
+            out.resize(static_cast<int>(size));
+            return out;
+        }
+#else
+        Q_UNUSED(compression);
+#endif
+        // qCompress自带4字节长度头
+        return qCompress(raw, kZlibLevel);
+    }
+
+    // 正文在超过kMaxRawMessageBytes之后才结束，最多再多一个完整的块（索引、调色板、像素）
+    int maxRawBodySize(int tileSize)
+    {
+        return kMaxRawMessageBytes + 5 + 255 * 3 + tileSize * tileSize;
+    }
+
+    // rawSize来自远端，分配之前先检查，避免按伪造的长度申请几GB内存
+    QByteArray decompressBody(const char *data, int size, TextTileCompression compression, quint32 rawSize,
+                              int maxRawSize)
+    {
+        if (rawSize > static_cast<quint32>(maxRawSize))
+        {
+            LOG_WARN("Text tile message claims {} bytes uncompressed, limit is {}", rawSize, maxRawSize);
+            return QByteArray();
+        }
+        if (compression == TextTileCompression::Zstd)
+        {
+#ifdef HAVE_ZSTD
+            QByteArray out(static_cast<int>(rawSize), Qt::Uninitialized);
+            const size_t result = ZSTD_decompress(out.data(), out.size(), data, size);
+            if (ZSTD_isError(result) || result != static_cast<size_t>(rawSize))
+            {
+                return QByteArray();
+            }
+            return out;
+#else
+            return QByteArray();
+#endif
+        }
+        if (compression == TextTileCompression::Zlib)
+        {
+            // qUncompress按自带的4字节大端长度头分配，同样要和rawSize核对
+            if (size < 4)
+            {
+                return QByteArray();
+            }
+            const uchar *header = reinterpret_cast<const uchar *>(data);
+            const quint32 expected = (quint32(header[0]) << 24) | (quint32(header[1]) << 16) |
+                                     (quint32(header[2]) << 8) | quint32(header[3]);
+            if (expected != rawSize)
+            {
+                return QByteArray();
+            }
+            return qUncompress(header, size);
+        }
+        return QByteArray();
+    }
+}
+
+namespace TextTileCodec
+{
+    QStringList supportedCompressions()
+    {
+#ifdef HAVE_ZSTD
+        return {"zstd", "zlib"};
+#else
+        return {"zlib"};
+#endif
+    }
+
+    TextTileCompression negotiate(const QStringList &remote)
+    {
+        for (const QString &name : supportedCompressions())
+        {
+            if (remote.contains(name, Qt::CaseInsensitive))
+            {
+                return name == "zstd" ? TextTileCompression::Zstd : TextTileCompression::Zlib;
+            }
+        }
+        return TextTileCompression::None;
+    }
+
+    QString compressionName(TextTileCompression compression)
+    {
+        switch (compression)
+        {
+        case TextTileCompression::Zlib:
+            return "zlib";
+        case TextTileCompression::Zstd:
+            return "zstd";
+        case TextTileCompression::None:
+            break;
+        }
+        return "none";
+    }
+}
+
+TextTileEncoder::TextTileEncoder(TextTileCompression compression, int maxColors)
+    : m_compression(compression), m_maxColors(qBound(2, maxColors, 255)), m_sourceWidth(0), m_sourceHeight(0),
+      m_tileSize(0), m_columns(0), m_rows(0), m_resetPending(true), m_fullScan(true), m_pendingCount(0)
+{
+}
+
+void TextTileEncoder::reset()
+{
+    std::fill(m_covered.begin(), m_covered.end(), 0);
+    std::fill(m_pending.begin(), m_pending.end(), 0);
+    m_pendingCount = 0;
+    m_resetPending = true;
+    m_fullScan = true;
+}
+
+bool TextTileEncoder::buildPalette(const uchar *bgra, int stride, const QRect &rect)
+{
+    // 颜色变化时先查直接映射的小缓存，未命中再线性查找调色板
+    quint32 cacheColor[256];
+    uint8_t cacheIndex[256];
+    std::fill(std::begin(cacheColor), std::end(cacheColor), 0xFFFFFFFFu);
+
+    m_palette.clear();
+    m_indices.resize(static_cast<size_t>(rect.width()) * rect.height());
+    uint8_t *out = m_indices.data();
+    int edges = 0;
+    for (int y = 0; y < rect.height(); ++y)
+    {
+        const uchar *pixels = bgra + static_cast<size_t>(rect.y() + y) * stride + static_cast<size_t>(rect.x()) * 4;
+        quint32 previous = 0xFFFFFFFFu;
+        int previousLuma = 0;
+        uint8_t index = 0;
+        for (int x = 0; x < rect.width(); ++x, pixels += 4)
+        {
+            const quint32 color = pixels[0] | (pixels[1] << 8) | (pixels[2] << 16);
+            if (color != previous)
+            {
+                const int value = luma(color);
+                if (previous != 0xFFFFFFFFu && qAbs(value - previousLuma) >= kEdgeLumaDelta)
+                {
+                    edges++;
+                }
+                previous = color;
+                previousLuma = value;
+
+                const uint8_t slot = static_cast<uint8_t>((color * 2654435761u) >> 24);
+                if (cacheColor[slot] == color)
+                {
+                    index = cacheIndex[slot];
+                }
+                else
+                {
+                    auto it = std::find(m_palette.begin(), m_palette.end(), color);
+                    if (it == m_palette.end())
+                    {
+                        if (static_cast<int>(m_palette.size()) >= m_maxColors)
+                        {
+                            return false;
+                        }
+                        it = m_palette.insert(m_palette.end(), color);
+                    }
+                    index = static_cast<uint8_t>(it - m_palette.begin());
+                    cacheColor[slot] = color;
+                    cacheIndex[slot] = index;
+                }
+            }
+            *out++ = index;
+        }
+    }
+    // 纯色块和只有少量线条的界面交给H264
+    return m_palette.size() >= 2 && edges * 100 >= rect.width() * rect.height() * kMinEdgePercent;
+}
+
+QByteArray TextTileEncoder::finishMessage(QByteArray &body, int entries)
+{
+    const QByteArray compressed = compressBody(body, m_compression);
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << kVersion << static_cast<quint8>(m_compression) << static_cast<quint8>(m_resetPending ? kFlagReset : 0)
+           << static_cast<quint16>(m_sourceWidth) << static_cast<quint16>(m_sourceHeight)
+           << static_cast<quint16>(m_tileSize) << static_cast<quint16>(entries) << static_cast<quint32>(body.size());
+    message.append(compressed);
+    m_resetPending = false;
+    body.clear();
+    return message;
+}
+
+QList<QByteArray> TextTileEncoder::encode(const uchar *bgra, int width, int height, int stride,
+                                          const TileChanges &changes, int budgetBytes)
+{
+    QList<QByteArray> messages;
+    if (!changes.isValid() || changes.sourceWidth != width || changes.sourceHeight != height)
+    {
+        return messages;
+    }
+
+    // 尺寸或分块变化后控制端的块都对不上了，全部清除重来
+    if (width != m_sourceWidth || height != m_sourceHeight || changes.tileSize != m_tileSize ||
+        changes.columns != m_columns || changes.rows != m_rows)
+    {
+        m_sourceWidth = width;
+        m_sourceHeight = height;
+        m_tileSize = changes.tileSize;
+        m_columns = changes.columns;
+        m_rows = changes.rows;
+        m_covered.assign(changes.tiles.size(), 0);
+        m_pending.assign(changes.tiles.size(), 0);
+        reset();
+    }
+    if (changes.changedTiles == 0 && m_pendingCount == 0 && !m_fullScan && !m_resetPending)
+    {
+        return messages;
+    }
+
+    QByteArray body;
+    int entries = 0;
+    int sentBytes = 0;
+    auto appendClear = [&](int index)
+    {
+        const quint32 tileIndex = static_cast<quint32>(index);
+        body.append(reinterpret_cast<const char *>(&tileIndex), sizeof(tileIndex)); // 小端主机
+        body.append('\0');
+        entries++;
+        m_covered[index] = 0;
+    };
+
+    for (int index = 0; index < static_cast<int>(changes.tiles.size()); ++index)
+    {
+        const bool changed = changes.tiles[index] == TileChanges::Changed;
+        if (!changed && (m_covered[index] || (!m_fullScan && !m_pending[index])))
+        {
+            continue;
+        }
+
+        // 预算用完后剩下的块不再分类，先记为等待，之后的帧再检查
+        if (sentBytes + body.size() / kCompressionEstimate >= budgetBytes)
+        {
+            if (m_covered[index])
+            {
+                // 覆盖着的内容已经过时：清除总是发送，不受预算限制
+                appendClear(index);
+            }
+            if (!m_pending[index])
+            {
+                m_pending[index] = 1;
+                m_pendingCount++;
+            }
+            continue;
+        }
+
+        const int column = index % m_columns;
+        const int row = index / m_columns;
+        const QRect rect(column * m_tileSize, row * m_tileSize, qMin(m_tileSize, width - column * m_tileSize),
+                         qMin(m_tileSize, height - row * m_tileSize));
+        if (buildPalette(bgra, stride, rect))
+        {
+            const quint32 tileIndex = static_cast<quint32>(index);
+            body.append(reinterpret_cast<const char *>(&tileIndex), sizeof(tileIndex));
+            body.append(static_cast<char>(m_palette.size()));
+            for (quint32 color : m_palette)
+            {
+                body.append(static_cast<char>(color & 0xFF));
+                body.append(static_cast<char>((color >> 8) & 0xFF));
+                body.append(static_cast<char>((color >> 16) & 0xFF));
+            }
+            body.append(reinterpret_cast<const char *>(m_indices.data()), static_cast<int>(m_indices.size()));
+            entries++;
+            m_covered[index] = 1;
+        }
+        else if (m_covered[index])
+        {
+            // 不再像文字，恢复显示H264
+            appendClear(index);
+        }
+        if (m_pending[index])
+        {
+            m_pending[index] = 0;
+            m_pendingCount--;
+        }
+
+        if (body.size() >= kMaxRawMessageBytes)
+        {
+            messages << finishMessage(body, entries);
+            sentBytes += messages.last().size();
+            entries = 0;
+        }
+    }
+
+    if (entries > 0 || m_resetPending)
+    {
+        messages << finishMessage(body, entries);
+    }
+    m_fullScan = false;
+    return messages;
+}
+
+bool TextTileOverlay::apply(const QByteArray &message)
+{
+    if (message.size() < kHeaderSize)
+    {
+        return false;
+    }
+    QDataStream stream(message);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint8 version, compression, flags;
+    quint16 sourceWidth, sourceHeight, tileSize, entries;
+    quint32 rawSize;
+    stream >> version >> compression >> flags >> sourceWidth >> sourceHeight >> tileSize >> entries >> rawSize;
+    if (version != kVersion || tileSize == 0 || tileSize > kMaxTileSize || sourceWidth == 0 || sourceHeight == 0)
+    {
+        LOG_WARN("Unsupported text tile message: version {}, tile size {}", version, tileSize);
+        return false;
+    }
+
+    const QByteArray body = decompressBody(message.constData() + kHeaderSize, message.size() - kHeaderSize,
+                                           static_cast<TextTileCompression>(compression), rawSize,
+                                           maxRawBodySize(tileSize));
+    if (body.size() != static_cast<int>(rawSize))
+    {
+        LOG_WARN("Failed to decompress text tile message ({} compression, {} bytes)", compression, message.size());
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if ((flags & kFlagReset) || sourceWidth != m_sourceWidth || sourceHeight != m_sourceHeight ||
+        tileSize != m_tileSize)
+    {
+        m_sourceWidth = sourceWidth;
+        m_sourceHeight = sourceHeight;
+        m_tileSize = tileSize;
+        m_columns = (sourceWidth + tileSize - 1) / tileSize;
+        const int rows = (sourceHeight + tileSize - 1) / tileSize;
+        m_tiles.assign(static_cast<size_t>(m_columns) * rows, QImage());
+        m_coveredCount = 0;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(body.constData());
+    const uchar *end = data + body.size();
+    for (int i = 0; i < entries; ++i)
+    {
+        if (end - data < 5)
+        {
+            return false;
+        }
+        quint32 index;
+        std::memcpy(&index, data, sizeof(index));
+        const int colors = data[4];
+        data += 5;
+        if (index >= m_tiles.size())
+        {
+            return false;
+        }
+        if (colors == 0)
+        {
+            if (!m_tiles[index].isNull())
+            {
+                m_tiles[index] = QImage();
+                m_coveredCount--;
+            }
+            continue;
+        }
+
+        const int x = static_cast<int>(index % m_columns) * m_tileSize;
+        const int y = static_cast<int>(index / m_columns) * m_tileSize;
+        const int width = qMin(m_tileSize, m_sourceWidth - x);
+        const int height = qMin(m_tileSize, m_sourceHeight - y);
+        if (end - data < colors * 3 + width * height)
+        {
+            return false;
+        }
+        QRgb palette[256];
+        for (int c = 0; c < colors; ++c, data += 3)
+        {
+            palette[c] = qRgb(data[2], data[1], data[0]);
+        }
+        QImage tile(width, height, QImage::Format_RGB32);
+        for (int row = 0; row < height; ++row)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(tile.scanLine(row));
+            for (int column = 0; column < width; ++column)
+            {
+                const int paletteIndex = *data++;
+                if (paletteIndex >= colors)
+                {
+                    return false;
+                }
+                line[column] = palette[paletteIndex];
+            }
+        }
+        if (m_tiles[index].isNull())
+        {
+            m_coveredCount++;
+        }
+        m_tiles[index] = tile;
+    }
+    return true;
+}
+
+void TextTileOverlay::composite(QImage &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_coveredCount == 0 || frame.isNull())
+    {
+        return;
+    }
+
+    const bool scaled = frame.width() != m_sourceWidth || frame.height() != m_sourceHeight;
+    const qreal scaleX = static_cast<qreal>(frame.width()) / m_sourceWidth;
+    const qreal scaleY = static_cast<qreal>(frame.height()) / m_sourceHeight;
+    QPainter painter(&frame);
+    if (scaled)
+    {
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    }
+    for (size_t index = 0; index < m_tiles.size(); ++index)
+    {
+        const QImage &tile = m_tiles[index];
+        if (tile.isNull())
+        {
+            continue;
+        }
+        const int x = static_cast<int>(index % m_columns) * m_tileSize;
+        const int y = static_cast<int>(index / m_columns) * m_tileSize;
+        if (scaled)
+        {
+            painter.drawImage(QRectF(x * scaleX, y * scaleY, tile.width() * scaleX, tile.height() * scaleY), tile);
+        }
+        else
+        {
+            painter.drawImage(QPoint(x, y), tile);
+        }
+    }
+}
+
+void TextTileOverlay::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_tiles.clear();
+    m_coveredCount = 0;
+    m_sourceWidth = 0;
+    m_sourceHeight = 0;
+    m_tileSize = 0;
+    m_columns = 0;
+}
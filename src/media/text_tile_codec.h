@@ -0,0 +1,91 @@
+#ifndef TEXT_TILE_CODEC_H
+#define TEXT_TILE_CODEC_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QRect>
+#include <QStringList>
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+
+#include "tile_change_map.h"
+
+// 文字类分块无损辅助流的压缩方式，数值写入消息头
+enum class TextTileCompression : quint8 {
+  None = 0, // 不发送辅助流
+  Zlib = 1,
+  Zstd = 2, // 需要编译时找到libzstd
+};
+
+namespace TextTileCodec {
+// 本机支持的压缩方式名称，按偏好排序
+QStringList supportedCompressions();
+// 按对方支持的名称选本机也支持的第一种，都不支持时返回None
+TextTileCompression negotiate(const QStringList &remote);
+QString compressionName(TextTileCompression compression);
+} // namespace TextTileCodec
+
+// 被控端：把颜色少、边缘多的块（代码编辑器、终端里的文字）编码为无损调色板块，
+// 控制端用它们覆盖解码后的H264画面；覆盖着的块变得不像文字时发送清除，恢复显示H264
+class TextTileEncoder {
+public:
+  explicit TextTileEncoder(TextTileCompression compression, int maxColors = 64);
+
+  // 处理一帧：变化的块和之前因预算未发出的块中，文字类的在budgetBytes内编码，
+  // 返回按顺序发送的消息，每条都小于数据通道的消息大小上限
+  QList<QByteArray> encode(const uchar *bgra, int width, int height,
+                           int stride, const TileChanges &changes,
+                           int budgetBytes);
+  // 控制端正以无损块显示的块，行优先，非0为覆盖
+  const std::vector<uint8_t> &covered() const { return m_covered; }
+  // 还有文字类的块等待预算
+  bool hasPending() const { return m_pendingCount > 0; }
+  // 丢弃状态：下一条消息让控制端清除全部无损块，下一帧重新检查所有块
+  void reset();
+
+  TextTileCompression compression() const { return m_compression; }
+
+private:
+  // 颜色不超过m_maxColors且边缘足够多时生成调色板和索引，返回false表示不是文字类
+  bool buildPalette(const uchar *bgra, int stride, const QRect &rect);
+  QByteArray finishMessage(QByteArray &body, int entries);
+
+  TextTileCompression m_compression;
+  int m_maxColors;
+  int m_sourceWidth;
+  int m_sourceHeight;
+  int m_tileSize;
+  int m_columns;
+  int m_rows;
+  bool m_resetPending;   // 下一条消息带清除全部标志
+  bool m_fullScan;       // 下一帧检查所有块
+  std::vector<uint8_t> m_covered;
+  std::vector<uint8_t> m_pending; // 文字类但因预算还没发出的块
+  int m_pendingCount;
+  std::vector<quint32> m_palette;
+  std::vector<uint8_t> m_indices;
+};
+
+// 控制端：保存收到的无损块并合成到解码后的画面上，接收与合成可以在不同线程
+class TextTileOverlay {
+public:
+  // 应用一条辅助流消息，格式错误时返回false
+  bool apply(const QByteArray &message);
+  // 把覆盖着的块画到frame上，frame尺寸与被控端捕获尺寸不同时按比例缩放
+  void composite(QImage &frame);
+  void reset();
+
+private:
+  QMutex m_mutex;
+  int m_sourceWidth = 0;
+  int m_sourceHeight = 0;
+  int m_tileSize = 0;
+  int m_columns = 0;
+  int m_coveredCount = 0;
+  std::vector<QImage> m_tiles; // 行优先，空图像为未覆盖
+};
+
+#endif // TEXT_TILE_CODEC_H
@@ -0,0 +1,223 @@
+#include "tile_change_map.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    inline uint64_t rotl(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // 编码器的QP偏移刻度：H264/H265的QP范围为0-51
+    const int kQpRange = 51;
+}
+
+double TileChanges::changeRatio() const
+{
+    return tiles.empty() ? 0.0 : static_cast<double>(changedTiles) / tiles.size();
+}
+
+std::vector<float> TileChanges::macroblockQpOffsets(int width, int height, float focusOffset,
+                                                    float staticOffset) const
+{
+    std::vector<float> offsets;
+    if (!isValid() || width <= 0 || height <= 0)
+    {
+        return offsets;
+    }
+
+    const int mbColumns = (width + 15) / 16;
+    const int mbRows = (height + 15) / 16;
+    offsets.resize(static_cast<size_t>(mbColumns) * mbRows);
+    for (int my = 0; my < mbRows; ++my)
+    {
+        // 宏块中心映射回捕获分辨率，编码尺寸与捕获尺寸不同时按比例换算
+        const int sy = std::min(sourceHeight - 1, (my * 16 + 8) * sourceHeight / height);
+        const uint8_t *tileRow = tiles.data() + static_cast<size_t>(sy / tileSize) * columns;
+        for (int mx = 0; mx < mbColumns; ++mx)
+        {
+            const int sx = std::min(sourceWidth - 1, (mx * 16 + 8) * sourceWidth / width);
+            offsets[static_cast<size_t>(my) * mbColumns + mx] =
+                tileRow[sx / tileSize] == Unchanged ? staticOffset : focusOffset;
+        }
+    }
+    return offsets;
+}
+
+bool TileChanges::attachRegionsOfInterest(AVFrame *frame, int focusOffset, int staticOffset) const
+{
+    if (!isValid() || !frame || frame->width <= 0 || frame->height <= 0)
+    {
+        return false;
+    }
+
+    std::vector<AVRegionOfInterest> regions;
+    for (int row = 0; row < rows; ++row)
+    {
+        const uint8_t *tileRow = tiles.data() + static_cast<size_t>(row) * columns;
+        const int top = row * tileSize * frame->height / sourceHeight;
+        const int bottom = std::min(sourceHeight, (row + 1) * tileSize) * frame->height / sourceHeight;
+        int start = 0;
+        for (int column = 1; column <= columns; ++column)
+        {
+            const bool focus = tileRow[start] != Unchanged;
+            if (column < columns && (tileRow[column] != Unchanged) == focus)
+            {
+                continue;
+            }
+
+            AVRegionOfInterest region;
+            std::memset(&region, 0, sizeof(region));
+            region.self_size = sizeof(AVRegionOfInterest);
+            region.top = top;
+            region.bottom = bottom;
+            region.left = start * tileSize * frame->width / sourceWidth;
+            region.right = std::min(sourceWidth, column * tileSize) * frame->width / sourceWidth;
+            region.qoffset = AVRational{focus ? focusOffset : staticOffset, kQpRange};
+            regions.push_back(region);
+            start = column;
+        }
+    }
+
+    // 帧来自帧池，复用前已经unref，旧的区域不会残留
+    const size_t bytes = regions.size() * sizeof(AVRegionOfInterest);
+    AVFrameSideData *sideData = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST, bytes);
+    if (!sideData)
+    {
+        return false;
+    }
+    std::memcpy(sideData->data, regions.data(), bytes);
+    return true;
+}
+
+TileChangeMap::TileChangeMap(int tileSize)
+    : m_tileSize(qMax(16, tileSize)), m_width(0), m_height(0)
+{
+}
+
+void TileChangeMap::reset()
+{
+    m_hashes.clear();
+    m_width = 0;
+    m_height = 0;
+}
+
+uint64_t TileChangeMap::hashTile(const uchar *bgra, int stride, int x, int y, int width, int height)
+{
+    // 4路并行的乘法-异或哈希，每次读8字节；不需要抗碰撞，只要快且对任意像素变化敏感
+    const uint64_t kPrime = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {1, 2, 3, 4};
+    const int rowBytes = width * 4;
+    for (int row = 0; row < height; ++row)
+    {
+        const uchar *pixels = bgra + static_cast<size_t>(y + row) * stride + static_cast<size_t>(x) * 4;
+        int i = 0;
+        for (; i + 32 <= rowBytes; i += 32)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                uint64_t value;
+                std::memcpy(&value, pixels + i + lane * 8, sizeof(value));
+                lanes[lane] = rotl(lanes[lane] ^ value, 29) * kPrime;
+            }
+        }
+        for (; i + 4 <= rowBytes; i += 4)
+        {
+            uint32_t value;
+            std::memcpy(&value, pixels + i, sizeof(value));
+            lanes[0] = rotl(lanes[0] ^ value, 29) * kPrime;
+        }
+    }
+    return lanes[0] ^ rotl(lanes[1], 16) ^ rotl(lanes[2], 32) ^ rotl(lanes[3], 48);
+}
+
+TileChanges TileChangeMap::update(const uchar *bgra, int width, int height, int stride, const QRegion &damage,
+                                  const QPoint &cursor)
+{
+    TileChanges changes;
+    changes.tileSize = m_tileSize;
+    changes.columns = (width + m_tileSize - 1) / m_tileSize;
+    changes.rows = (height + m_tileSize - 1) / m_tileSize;
+    changes.sourceWidth = width;
+    changes.sourceHeight = height;
+    const size_t count = static_cast<size_t>(changes.columns) * changes.rows;
+    changes.tiles.assign(count, TileChanges::Unchanged);
+    if (count == 0)
+    {
+        return changes;
+    }
+
+    // 尺寸变化或刚重置时没有可比较的基准，所有块都算变化
+    const bool noBaseline = width != m_width || height != m_height || m_hashes.size() != count;
+    if (noBaseline)
+    {
+        m_hashes.assign(count, 0);
+        m_width = width;
+        m_height = height;
+    }
+
+    // 只需要重新哈希的块：损伤区域未知时为全部
+    std::vector<uint8_t> dirty(count, noBaseline || damage.isEmpty() ? 1 : 0);
+    if (!noBaseline && !damage.isEmpty())
+    {
+        const QRect bounds(0, 0, width, height);
+        for (const QRect &rect : damage)
+        {
+            const QRect clipped = rect.intersected(bounds);
+            if (clipped.isEmpty())
+            {
+                continue;
+            }
+            for (int row = clipped.top() / m_tileSize; row <= clipped.bottom() / m_tileSize; ++row)
+            {
+                for (int column = clipped.left() / m_tileSize; column <= clipped.right() / m_tileSize; ++column)
+                {
+                    dirty[static_cast<size_t>(row) * changes.columns + column] = 1;
+                }
+            }
+        }
+    }
+
+    for (int row = 0; row < changes.rows; ++row)
+    {
+        const int y = row * m_tileSize;
+        const int tileHeight = std::min(m_tileSize, height - y);
+        for (int column = 0; column < changes.columns; ++column)
+        {
+            const size_t index = static_cast<size_t>(row) * changes.columns + column;
+            if (!dirty[index])
+            {
+                continue;
+            }
+            const int x = column * m_tileSize;
+            const uint64_t hash = hashTile(bgra, stride, x, y, std::min(m_tileSize, width - x), tileHeight);
+            if (noBaseline || hash != m_hashes[index])
+            {
+                changes.tiles[index] = TileChanges::Changed;
+                changes.changedTiles++;
+            }
+            m_hashes[index] = hash;
+        }
+    }
+
+    // 光标所在块及其周围一圈是用户关注的区域
+    if (cursor.x() >= 0 && cursor.y() >= 0 && cursor.x() < width && cursor.y() < height)
+    {
+        const int cursorColumn = cursor.x() / m_tileSize;
+        const int cursorRow = cursor.y() / m_tileSize;
+        for (int row = qMax(0, cursorRow - 1); row <= qMin(changes.rows - 1, cursorRow + 1); ++row)
+        {
+            for (int column = qMax(0, cursorColumn - 1); column <= qMin(changes.columns - 1, cursorColumn + 1);
+                 ++column)
+            {
+                uint8_t &state = changes.tiles[static_cast<size_t>(row) * changes.columns + column];
+                if (state == TileChanges::Unchanged)
+                {
+                    state = TileChanges::NearCursor;
+                }
+            }
+        }
+    }
+    return changes;
+}
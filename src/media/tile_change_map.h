@@ -0,0 +1,64 @@
+#ifndef TILE_CHANGE_MAP_H
+#define TILE_CHANGE_MAP_H
+
+#include <QPoint>
+#include <QRegion>
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 一帧相对上一次处理的帧的分块变化图，坐标为捕获分辨率
+struct TileChanges {
+  enum State : uint8_t {
+    Unchanged = 0,
+    Changed = 1,
+    NearCursor = 2, // 内容未变但在光标附近
+  };
+
+  int tileSize = 64;
+  int columns = 0;
+  int rows = 0;
+  int sourceWidth = 0;
+  int sourceHeight = 0;
+  std::vector<uint8_t> tiles; // 行优先，每块一个State
+  int changedTiles = 0;       // 内容变化的块数，不含NearCursor
+
+  bool isValid() const { return !tiles.empty(); }
+  double changeRatio() const; // 0-1
+
+  // 展开为编码分辨率下16x16宏块的QP偏移：变化和光标附近的块用focusOffset，其余staticOffset
+  std::vector<float> macroblockQpOffsets(int width, int height,
+                                         float focusOffset,
+                                         float staticOffset) const;
+  // 写入AV_FRAME_DATA_REGIONS_OF_INTEREST（同一行相邻的同类块合并为一个区域），失败返回false
+  bool attachRegionsOfInterest(AVFrame *frame, int focusOffset,
+                               int staticOffset) const;
+};
+
+// 按块哈希比较连续两帧，找出变化的块
+// 捕获端给出损伤区域时只重新哈希与之相交的块
+class TileChangeMap {
+public:
+  explicit TileChangeMap(int tileSize = 64);
+
+  // damage为空表示未知，整帧重新哈希；cursor为光标位置，负坐标表示未知
+  TileChanges update(const uchar *bgra, int width, int height, int stride,
+                     const QRegion &damage, const QPoint &cursor);
+  // 丢弃保存的哈希，下一帧视为全部变化
+  void reset();
+
+private:
+  static uint64_t hashTile(const uchar *bgra, int stride, int x, int y,
+                           int width, int height);
+
+  int m_tileSize;
+  int m_width;
+  int m_height;
+  std::vector<uint64_t> m_hashes;
+};
+
+#endif // TILE_CHANGE_MAP_H
@@ -0,0 +1,199 @@
+#include "video_codec.h"
+#include "encoder_registry.h"
+#include "config_util.h"
+#include "logger_manager.h"
+
+namespace
+{
+    const QList<VideoCodec> kAllCodecs = {VideoCodec::H264, VideoCodec::H265, VideoCodec::AV1, VideoCodec::VP9};
+
+    // 按偏好排列的软件编码器：AV1优先SVT-AV1，实时模式下比libaom快得多
+    QStringList softwareEncoderNames(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return {"libx264"};
+        case VideoCodec::H265:
+            return {"libx265"};
+        case VideoCodec::VP9:
+            return {"libvpx-vp9"};
+        case VideoCodec::AV1:
+            return {"libsvtav1", "libaom-av1"};
+        }
+        return {};
+    }
+}
+
+namespace VideoCodecs
+{
+    QString name(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return "H264";
+        case VideoCodec::H265:
+            return "H265";
+        case VideoCodec::VP9:
+            return "VP9";
+        case VideoCodec::AV1:
+            return "AV1";
+        }
+        return "H264";
+    }
+
+    bool fromName(const QString &name, VideoCodec *codec)
+    {
+        const QString upper = name.trimmed().toUpper();
+        for (VideoCodec candidate : kAllCodecs)
+        {
+            if (upper == VideoCodecs::name(candidate))
+            {
+                *codec = candidate;
+                return true;
+            }
+        }
+        if (upper == "HEVC")
+        {
+            *codec = VideoCodec::H265;
+            return true;
+        }
+        return false;
+    }
+
+    QStringList names(const QList<VideoCodec> &codecs)
+    {
+        QStringList result;
+        for (VideoCodec codec : codecs)
+        {
+            result << name(codec);
+        }
+        return result;
+    }
+
+    QList<VideoCodec> fromNames(const QStringList &names)
+    {
+        QList<VideoCodec> result;
+        for (const QString &codecName : names)
+        {
+            VideoCodec codec;
+            if (fromName(codecName, &codec) && !result.contains(codec))
+            {
+                result << codec;
+            }
+        }
+        return result;
+    }
+
+    int payloadType(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return 96;
+        case VideoCodec::H265:
+            return 97;
+        case VideoCodec::VP9:
+            return 98;
+        case VideoCodec::AV1:
+            return 99;
+        }
+        return 96;
+    }
+
+    AVCodecID codecId(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return AV_CODEC_ID_H264;
+        case VideoCodec::H265:
+            return AV_CODEC_ID_HEVC;
+        case VideoCodec::VP9:
+            return AV_CODEC_ID_VP9;
+        case VideoCodec::AV1:
+            return AV_CODEC_ID_AV1;
+        }
+        return AV_CODEC_ID_H264;
+    }
+
+    QString hardwareEncoderPrefix(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return "h264";
+        case VideoCodec::H265:
+            return "hevc";
+        case VideoCodec::VP9:
+            return "vp9";
+        case VideoCodec::AV1:
+            return "av1";
+        }
+        return "h264";
+    }
+
+    QString softwareEncoder(VideoCodec codec)
+    {
+        for (const QString &encoderName : softwareEncoderNames(codec))
+        {
+            if (avcodec_find_encoder_by_name(encoderName.toUtf8().constData()))
+            {
+                return encoderName;
+            }
+        }
+        return QString();
+    }
+
+    const AVCodec *findDecoder(VideoCodec codec, bool hardware)
+    {
+        if (codec == VideoCodec::AV1)
+        {
+            // FFmpeg原生av1解码器只能配合hwaccel使用，软件解码走dav1d/libaom
+            if (hardware)
+            {
+                return avcodec_find_decoder_by_name("av1");
+            }
+            const AVCodec *decoder = avcodec_find_decoder_by_name("libdav1d");
+            return decoder ? decoder : avcodec_find_decoder_by_name("libaom-av1");
+        }
+        return avcodec_find_decoder(codecId(codec));
+    }
+
+    QList<VideoCodec> decodable()
+    {
+        QList<VideoCodec> ordered = kAllCodecs;
+        VideoCodec preferred;
+        if (fromName(ConfigUtil->videoCodec, &preferred))
+        {
+            ordered.removeAll(preferred);
+            ordered.prepend(preferred);
+        }
+
+        QList<VideoCodec> result;
+        for (VideoCodec codec : ordered)
+        {
+            if (findDecoder(codec, false))
+            {
+                result << codec;
+            }
+        }
+        return result;
+    }
+
+    QList<VideoCodec> encodable()
+    {
+        QList<VideoCodec> result{VideoCodec::H264}; // libx264/硬件编码/OpenH264至少有一个
+        // 只宣告注册表里实际打开过的编码器；后台探测未完成时只有H264，不阻塞界面线程
+        for (VideoCodec codec : EncoderCapabilityRegistry::instance().encodableCodecs())
+        {
+            if (!result.contains(codec))
+            {
+                result << codec;
+            }
+        }
+        LOG_DEBUG("Encodable video codecs: {}", names(result).join(","));
+        return result;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef VIDEO_CODEC_H
+#define VIDEO_CODEC_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// 视频轨道可协商的编码格式
+enum class VideoCodec { H264, H265, VP9, AV1 };
+
+// 编码格式与SDP名称、RTP负载类型、FFmpeg编解码器之间的对应关系
+namespace VideoCodecs {
+// 软件编码每帧的条带数（x264/FFmpeg后端），解码端按它设置条带线程数
+constexpr int kSliceCount = 4;
+
+// SDP rtpmap中的名称：H264/H265/VP9/AV1
+QString name(VideoCodec codec);
+// 按名称解析（不区分大小写，HEVC视为H265），无法识别时返回false
+bool fromName(const QString &name, VideoCodec *codec);
+QStringList names(const QList<VideoCodec> &codecs);
+QList<VideoCodec> fromNames(const QStringList &names);
+
+int payloadType(VideoCodec codec); // 96/97/98/99
+AVCodecID codecId(VideoCodec codec);
+
+// 硬件编码器名称前缀，如 hevc_nvenc 中的 hevc
+QString hardwareEncoderPrefix(VideoCodec codec);
+// 本机FFmpeg中可用的首选软件编码器，没有时返回空字符串
+QString softwareEncoder(VideoCodec codec);
+// 软件解码器；hardware为true时返回支持hwaccel的FFmpeg原生解码器
+const AVCodec *findDecoder(VideoCodec codec, bool hardware);
+
+// 本机能解码的格式，按偏好排序：配置的videoCodec在前，其余按H264/H265/AV1/VP9
+QList<VideoCodec> decodable();
+// 本机能编码的格式（不排序）
+QList<VideoCodec> encodable();
+} // namespace VideoCodecs
+
+#endif // VIDEO_CODEC_H
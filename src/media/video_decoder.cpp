@@ -1,5 +1,6 @@
-#include "h264_decoder.h"
+#include "video_decoder.h"
 #include "logger_manager.h"
+#include "config_util.h"
 #include <QDebug>
 #include <QMap>
 #include <QMutex>
@@ -79,28 +80,65 @@ private:
     }
 };
 
-H264Decoder::H264Decoder(QObject *parent)
+DecoderThreadingSettings DecoderThreadingSettings::fromConfig()
+{
+    DecoderThreadingSettings settings;
+    const QString mode = ConfigUtil->decoderThreading.trimmed().toLower();
+    if (mode == "frame") {
+        settings.mode = DecoderThreading::Frame;
+    } else if (mode == "auto") {
+        settings.mode = DecoderThreading::Auto;
+    } else if (mode == "none") {
+        settings.mode = DecoderThreading::None;
+    } else if (mode != "slice") {
+        LOG_WARN("Unknown decoder threading mode: {}, using slice", mode);
+    }
+    settings.threads = ConfigUtil->decoderThreads;
+    settings.lowDelay = ConfigUtil->decoderLowDelay;
+    settings.fast = ConfigUtil->decoderFast;
+    return settings;
+}
+
+QString DecoderThreadingSettings::modeName(DecoderThreading mode)
+{
+    switch (mode) {
+    case DecoderThreading::Frame:
+        return "frame";
+    case DecoderThreading::Auto:
+        return "auto";
+    case DecoderThreading::None:
+        return "none";
+    case DecoderThreading::Slice:
+        break;
+    }
+    return "slice";
+}
+
+VideoDecoder::VideoDecoder(QObject *parent)
     : QObject(parent)
+    , m_videoCodec(VideoCodec::H264)
+    , m_threading(DecoderThreadingSettings::fromConfig())
     , m_codecContext(nullptr)
     , m_codec(nullptr)
     , m_frame(nullptr)
     , m_swFrame(nullptr)
-    , m_convertFrame(nullptr)
     , m_packet(nullptr)
     , m_swsContext(nullptr)
     , m_hwDeviceCtx(nullptr)
     , m_hwPixelFormat(AV_PIX_FMT_NONE)
     , m_initialized(false)
     , m_consecutiveErrors(0)
+    , m_packetsWithoutFrame(0)
+    , m_waitingForKeyFrame(true)
 {
 }
 
-H264Decoder::~H264Decoder()
+VideoDecoder::~VideoDecoder()
 {
     cleanup();
 }
 
-QStringList H264Decoder::getAvailableHWAccels()
+QStringList VideoDecoder::getAvailableHWAccels()
 {
     QStringList hwAccels;
 
@@ -162,18 +200,20 @@ QStringList H264Decoder::getAvailableHWAccels()
     return hwAccels;
 }
 
-bool H264Decoder::initialize(const QString& hwAccel)
+bool VideoDecoder::initialize(VideoCodec codec, const QString& hwAccel)
 {
     QMutexLocker locker(&m_mutex);
     
     if (m_initialized) {
-        cleanup();
+        releaseResources();
     }
+    m_videoCodec = codec;
+    const QString codecName = VideoCodecs::name(codec);
     
     // 智能自适应硬件加速选择策略
     bool success = false;
     if (!hwAccel.isEmpty()) {
-        LOG_INFO("Attempting to initialize H264 decoder with {} acceleration", hwAccel);
+        LOG_INFO("Attempting to initialize {} decoder with {} acceleration", codecName, hwAccel);
         success = initializeCodec(hwAccel);
     } else {
         QStringList hwAccels = getAvailableHWAccels();
@@ -198,7 +238,7 @@ bool H264Decoder::initialize(const QString& hwAccel)
             for (const QString& hwType : adaptiveOrder) {
                 LOG_INFO("Attempting hardware acceleration: {}", hwType);
                 if (initializeCodec(hwType)) {
-                    LOG_INFO("✓ Successfully initialized H264 decoder with {} hardware acceleration", hwType);
+                    LOG_INFO("✓ Successfully initialized {} decoder with {} hardware acceleration", codecName, hwType);
                     success = true;
                     break;
                 } else {
@@ -217,7 +257,7 @@ bool H264Decoder::initialize(const QString& hwAccel)
     if (success) {
         m_initialized = true;
         QString accelType = m_hwAccelName.isEmpty() ? "software" : m_hwAccelName;
-        LOG_INFO("🎯 H264 decoder successfully initialized with {} acceleration", accelType);
+        LOG_INFO("🎯 {} decoder successfully initialized with {} acceleration", codecName, accelType);
         
         // 性能优化提示
         if (m_hwAccelName.isEmpty()) {
@@ -226,25 +266,24 @@ bool H264Decoder::initialize(const QString& hwAccel)
             LOG_INFO("🚀 Hardware acceleration active - optimal performance enabled");
         }
     } else {
-        LOG_ERROR("❌ Failed to initialize H264 decoder with any method");
-        cleanup();
+        LOG_ERROR("❌ Failed to initialize {} decoder with any method", codecName);
+        releaseResources();
     }
     
     return success;
 }
 
-bool H264Decoder::initializeCodec(const QString& hwAccel)
+bool VideoDecoder::initializeCodec(const QString& hwAccel)
 {
-    // 查找解码器 - 对于硬件解码，使用标准h264解码器而不是特定的硬件解码器
-    QString codecName = "h264";  // 始终使用标准h264解码器
-    m_codec = avcodec_find_decoder_by_name(codecName.toUtf8().data());
+    // 查找解码器 - 硬件解码使用FFmpeg原生解码器配合hwaccel，而不是特定的硬件解码器
+    m_codec = VideoCodecs::findDecoder(m_videoCodec, !hwAccel.isEmpty());
     
     if (!m_codec) {
-        LOG_ERROR("Codec {} not found", codecName);
+        LOG_ERROR("No decoder found for {}", VideoCodecs::name(m_videoCodec));
         return false;
     }
     
-    LOG_DEBUG("Found codec: {}", codecName);
+    LOG_DEBUG("Found codec: {}", m_codec->name);
     
     // 创建解码器上下文
     m_codecContext = avcodec_alloc_context3(m_codec);
@@ -252,6 +291,7 @@ bool H264Decoder::initializeCodec(const QString& hwAccel)
         LOG_ERROR("Could not allocate video codec context");
         return false;
     }
+    applyThreading();
     
     // 智能硬件加速初始化
     bool hardwareInitialized = false;
@@ -292,6 +332,7 @@ bool H264Decoder::initializeCodec(const QString& hwAccel)
                 LOG_ERROR("Could not allocate software video codec context");
                 return false;
             }
+            applyThreading();
             
             ret = avcodec_open2(m_codecContext, m_codec, nullptr);
             if (ret < 0) {
@@ -342,7 +383,38 @@ bool H264Decoder::initializeCodec(const QString& hwAccel)
     return true;
 }
 
-bool H264Decoder::initializeHardwareAccel(const QString& hwAccel)
+void VideoDecoder::applyThreading()
+{
+    // 帧级多线程每个线程都会把输出推迟一帧，远程桌面默认只用条带并行
+    switch (m_threading.mode) {
+    case DecoderThreading::Slice:
+        m_codecContext->thread_type = FF_THREAD_SLICE;
+        m_codecContext->thread_count = m_threading.threads > 0 ? m_threading.threads : VideoCodecs::kSliceCount;
+        break;
+    case DecoderThreading::Frame:
+        m_codecContext->thread_type = FF_THREAD_FRAME;
+        m_codecContext->thread_count = m_threading.threads; // 0为FFmpeg按CPU核数
+        break;
+    case DecoderThreading::Auto:
+        m_codecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        m_codecContext->thread_count = m_threading.threads;
+        break;
+    case DecoderThreading::None:
+        m_codecContext->thread_count = 1;
+        break;
+    }
+    if (m_threading.lowDelay) {
+        m_codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    if (m_threading.fast) {
+        m_codecContext->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+    LOG_DEBUG("Decoder threading: {}, {} threads, low delay: {}, fast: {}",
+              DecoderThreadingSettings::modeName(m_threading.mode), m_codecContext->thread_count,
+              m_threading.lowDelay, m_threading.fast);
+}
+
+bool VideoDecoder::initializeHardwareAccel(const QString& hwAccel)
 {
     // 根据不同的硬件加速器设置像素格式
     if (hwAccel == "cuda") {
@@ -387,7 +459,7 @@ bool H264Decoder::initializeHardwareAccel(const QString& hwAccel)
     return true;
 }
 
-QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
+QImage VideoDecoder::decodeFrame(const rtc::binary& data, bool output)
 {
     QMutexLocker locker(&m_mutex);
 
@@ -396,13 +468,13 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
         return QImage();
     }
 
-    if (h264Data.empty()) {
+    if (data.empty()) {
         return QImage();
     }
 
     // 设置数据包
-    m_packet->data = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(h264Data.data()));
-    m_packet->size = static_cast<int>(h264Data.size());
+    m_packet->data = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(data.data()));
+    m_packet->size = static_cast<int>(data.size());
 
     // 发送数据包到解码器
     int ret = avcodec_send_packet(m_codecContext, m_packet);
@@ -412,6 +484,7 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
         LOG_ERROR("Error sending packet to decoder: {}", errbuf);
                 
         av_packet_unref(m_packet);
+        markStreamBroken("send packet failed");
         return QImage();
     }
     
@@ -419,17 +492,41 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
     ret = avcodec_receive_frame(m_codecContext, m_frame);
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
         av_packet_unref(m_packet);
+        // 低延迟流每个包都应该输出一帧，持续没有输出通常是参考帧丢失后解码器在丢帧
+        // 帧级多线程会延迟输出thread_count-1帧，阈值要留出余量
+        if (++m_packetsWithoutFrame > qMax(10, m_codecContext->thread_count + 2)) {
+            m_packetsWithoutFrame = 0;
+            markStreamBroken("no frame output");
+        }
         return QImage(); // 需要更多数据或结束
     } else if (ret < 0) {
         char errbuf[AV_ERROR_MAX_STRING_SIZE];
         av_strerror(ret, errbuf, sizeof(errbuf));
         LOG_ERROR("Error receiving frame from decoder: {}", errbuf);
         av_packet_unref(m_packet);
+        markStreamBroken("receive frame failed");
+        return QImage();
+    }
+    m_packetsWithoutFrame = 0;
+
+    // 参考帧缺失时FFmpeg仍可能输出帧，但会打上损坏标记
+    if ((m_frame->flags & AV_FRAME_FLAG_CORRUPT) || m_frame->decode_error_flags) {
+        markStreamBroken("corrupt frame");
+    } else {
+        // 成功解码帧，重置错误计数
+        if (m_waitingForKeyFrame) {
+            LOG_INFO("Decoder recovered after {} errors", m_consecutiveErrors);
+        }
+        m_consecutiveErrors = 0;
+        m_waitingForKeyFrame = false;
+    }
+
+    if (!output) {
+        // 只作为后续帧的参考，不做硬件帧下载和颜色转换
+        av_packet_unref(m_packet);
+        av_frame_unref(m_frame);
         return QImage();
     }
-    
-    // 成功解码帧，重置错误计数
-    m_consecutiveErrors = 0;
     
     // 如果是硬件帧，需要转换到系统内存
     AVFrame* frameToConvert = m_frame;
@@ -445,7 +542,7 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
 
     if (isHardwareFrame && m_swFrame && !m_hwAccelName.isEmpty()) {
         // RKMPP/DRM_PRIME 在不同 FFmpeg 版本上对直接 transfer 到 NV12 的支持不一致。
-        // 这里优先选择更通用的 YUV420P 作为软帧目标，后续再统一转 NV12/RGB。
+        // 这里优先选择更通用的 YUV420P 作为软帧目标，之后与其它格式一样直接转 RGB32。
         AVPixelFormat transferTarget = AV_PIX_FMT_NV12;
         if (frameFormat == AV_PIX_FMT_DRM_PRIME || m_hwAccelName == "rkmpp") {
             transferTarget = AV_PIX_FMT_YUV420P;
@@ -504,17 +601,8 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
         LOG_DEBUG("Successfully transferred hardware frame to software {} format", av_get_pix_fmt_name(transferTarget));
         frameToConvert = m_swFrame;
     } else {
-        LOG_DEBUG("Using software frame format: {}", av_get_pix_fmt_name(frameFormat));
-        // 如果是软件解码但不是NV12格式，需要转换为NV12统一处理
-        if (frameFormat != AV_PIX_FMT_NV12) {
-            frameToConvert = convertToNV12(m_frame);
-            if (!frameToConvert) {
-                LOG_WARN("Failed to convert software frame to NV12, using original format");
-                frameToConvert = m_frame;
-            }
-        } else {
-            frameToConvert = m_frame;
-        }
+        // 软件帧（YUV420P/NV12等）直接转换，不经过中间格式
+        LOG_TRACE("Using software frame format: {}", av_get_pix_fmt_name(frameFormat));
     }
     
     // 转换为QImage
@@ -530,167 +618,37 @@ QImage H264Decoder::decodeFrame(const rtc::binary& h264Data)
         av_frame_unref(m_swFrame);
     }
     
-    // 清理转换产生的临时帧
-    if (frameToConvert != m_frame && frameToConvert != m_swFrame) {
-        av_frame_free(&frameToConvert);
-    }
-    
     return result;
 }
 
-AVFrame* H264Decoder::convertToNV12(AVFrame* inputFrame)
-{
-    if (!inputFrame) {
-        return nullptr;
-    }
-    
-    AVPixelFormat inputFormat = static_cast<AVPixelFormat>(inputFrame->format);
-    if (inputFormat == AV_PIX_FMT_NV12) {
-        // 已经是NV12格式，直接返回
-        return inputFrame;
-    }
-    
-    // 创建转换帧
-    AVFrame* nv12Frame = av_frame_alloc();
-    if (!nv12Frame) {
-        LOG_ERROR("Failed to allocate NV12 conversion frame");
-        return nullptr;
-    }
-    
-    nv12Frame->format = AV_PIX_FMT_NV12;
-    nv12Frame->width = inputFrame->width;
-    nv12Frame->height = inputFrame->height;
-    
-    int ret = av_frame_get_buffer(nv12Frame, 32);
-    if (ret < 0) {
-        char errbuf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, errbuf, sizeof(errbuf));
-        LOG_ERROR("Failed to allocate NV12 frame buffer: {}", errbuf);
-        av_frame_free(&nv12Frame);
-        return nullptr;
-    }
-    
-    // 创建转换上下文
-    struct SwsContext* swsCtx = sws_getContext(
-        inputFrame->width, inputFrame->height, inputFormat,
-        nv12Frame->width, nv12Frame->height, AV_PIX_FMT_NV12,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
-    
-    if (!swsCtx) {
-        LOG_ERROR("Failed to create sws context for NV12 conversion");
-        av_frame_free(&nv12Frame);
-        return nullptr;
-    }
-    
-    // 执行转换
-    int scaledHeight = sws_scale(swsCtx,
-                                inputFrame->data, inputFrame->linesize, 0, inputFrame->height,
-                                nv12Frame->data, nv12Frame->linesize);
-    
-    sws_freeContext(swsCtx);
-    
-    if (scaledHeight != inputFrame->height) {
-        LOG_ERROR("Failed to convert frame to NV12: expected {} lines, got {}", inputFrame->height, scaledHeight);
-        av_frame_free(&nv12Frame);
-        return nullptr;
-    }
-    
-    LOG_DEBUG("Successfully converted {} frame to NV12", av_get_pix_fmt_name(inputFormat));
-    return nv12Frame;
-}
-
-QImage H264Decoder::avframeToQImage(AVFrame* frame)
+QImage VideoDecoder::avframeToQImage(AVFrame* frame)
 {
     if (!frame) {
         return QImage();
     }
     
-    int width = frame->width;
-    int height = frame->height;
-    AVPixelFormat inputFormat = static_cast<AVPixelFormat>(frame->format);
-    
-    // 对于某些硬件格式，先转换为标准格式
-    AVFrame* frameToUse = frame;
+    const int width = frame->width;
+    const int height = frame->height;
+    const AVPixelFormat inputFormat = static_cast<AVPixelFormat>(frame->format);
     
-    // 检查是否需要中间转换（某些FFmpeg版本对NV12->RGB24的sws_scale支持有问题）
-    if (inputFormat == AV_PIX_FMT_NV12) {
-        // 使用成员变量重用转换帧
-        if (!m_convertFrame) {
-            m_convertFrame = av_frame_alloc();
-            if (!m_convertFrame) {
-                LOG_ERROR("Failed to allocate convert frame");
-                return QImage();
-            }
-        } else {
-            av_frame_unref(m_convertFrame); // 清理之前的数据
-        }
-        
-        m_convertFrame->format = AV_PIX_FMT_YUV420P;
-        m_convertFrame->width = width;
-        m_convertFrame->height = height;
-        
-        // 只在需要时重新分配缓冲区
-        if (!m_convertFrame->buf[0] || 
-            m_convertFrame->buf[0]->size < av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, 32)) {
-            int ret = av_frame_get_buffer(m_convertFrame, 32);
-            if (ret < 0) {
-                LOG_ERROR("Failed to allocate convert frame buffer");
-                return QImage();
-            }
-        }
-        
-        // 创建临时sws上下文进行NV12->YUV420P转换
-        struct SwsContext* tempSwsCtx = sws_getContext(
-            width, height, AV_PIX_FMT_NV12,
-            width, height, AV_PIX_FMT_YUV420P,
-            SWS_BILINEAR, nullptr, nullptr, nullptr
-        );
-        
-        if (tempSwsCtx) {
-            sws_scale(tempSwsCtx,
-                      frame->data, frame->linesize, 0, height,
-                      m_convertFrame->data, m_convertFrame->linesize);
-            sws_freeContext(tempSwsCtx);
-            frameToUse = m_convertFrame;
-            inputFormat = AV_PIX_FMT_YUV420P;
-        } else {
-            LOG_WARN("Failed to create NV12->YUV420P converter, using direct conversion");
-            frameToUse = frame;
-            inputFormat = static_cast<AVPixelFormat>(frame->format);
-        }
-    }
-    
-    // 创建或更新图像格式转换器
-    if (!m_swsContext || 
-        sws_isSupportedInput(inputFormat) <= 0) {
-        
-        if (m_swsContext) {
-            sws_freeContext(m_swsContext);
-        }
-        
-        m_swsContext = sws_getContext(
-            width, height, inputFormat,
-            width, height, AV_PIX_FMT_RGB24,
-            SWS_BILINEAR, nullptr, nullptr, nullptr
-        );
-        
-        if (!m_swsContext) {
-            LOG_ERROR("Could not initialize sws context for format {}", av_get_pix_fmt_name(inputFormat));
-            return QImage();
-        }
+    // AV_PIX_FMT_RGB32与QImage::Format_RGB32的内存布局相同（本机字节序的0xffRRGGBB），
+    // 显示时不需要再转换；尺寸和格式不变时sws_getCachedContext返回原上下文
+    m_swsContext = sws_getCachedContext(m_swsContext,
+                                        width, height, inputFormat,
+                                        width, height, AV_PIX_FMT_RGB32,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        LOG_ERROR("Could not initialize sws context for format {}", av_get_pix_fmt_name(inputFormat));
+        return QImage();
     }
     
-    // 创建QImage
-    QImage image(width, height, QImage::Format_RGB888);
-    
-    // 设置目标数据指针
-    uint8_t* dstData[1] = { image.bits() };
-    int dstLinesize[1] = { static_cast<int>(image.bytesPerLine()) };
+    // 图像只被环引用，bits()不会触发拷贝
+    QImage& image = m_imageRing.acquire(width, height);
+    uint8_t* dstData[4] = { image.bits(), nullptr, nullptr, nullptr };
+    int dstLinesize[4] = { static_cast<int>(image.bytesPerLine()), 0, 0, 0 };
     
-    // 转换YUV到RGB
     int result = sws_scale(m_swsContext,
-              frameToUse->data, frameToUse->linesize, 0, height,
+              frame->data, frame->linesize, 0, height,
               dstData, dstLinesize);
     
     if (result != height) {
@@ -698,14 +656,21 @@ QImage H264Decoder::avframeToQImage(AVFrame* frame)
         return QImage();
     }
     
+    if (m_overlay) {
+        m_overlay(image);
+    }
     return image;
 }
 
-void H264Decoder::cleanup()
+void VideoDecoder::cleanup()
 {
     // 防止与 decodeFrame 或其他线程并发清理，使用互斥锁保证线程安全
     QMutexLocker locker(&m_mutex);
+    releaseResources();
+}
 
+void VideoDecoder::releaseResources()
+{
     // 标记为未初始化，阻止新的解码请求进入
     m_initialized = false;
 
@@ -724,15 +689,11 @@ void H264Decoder::cleanup()
         m_swFrame = nullptr;
     }
 
-    if (m_convertFrame) {
-        av_frame_free(&m_convertFrame);
-        m_convertFrame = nullptr;
-    }
-
     if (m_swsContext) {
         sws_freeContext(m_swsContext);
         m_swsContext = nullptr;
     }
+    m_imageRing.clear();
 
     if (m_codecContext) {
         avcodec_free_context(&m_codecContext);
@@ -750,13 +711,13 @@ void H264Decoder::cleanup()
     m_hwAccelName.clear();
     m_initialized = false;
 
-    LOG_DEBUG("H264Decoder cleanup completed");
+    LOG_DEBUG("VideoDecoder cleanup completed");
 }
 
 // 硬件解码的关键回调函数 - 根据FFmpeg官方示例
-enum AVPixelFormat H264Decoder::get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts)
+enum AVPixelFormat VideoDecoder::get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts)
 {
-    H264Decoder* decoder = static_cast<H264Decoder*>(ctx->opaque);
+    VideoDecoder* decoder = static_cast<VideoDecoder*>(ctx->opaque);
     if (!decoder) {
         LOG_ERROR("Decoder instance is null in get_hw_format callback");
         return AV_PIX_FMT_NONE;
@@ -869,7 +830,7 @@ enum AVPixelFormat H264Decoder::get_hw_format(AVCodecContext *ctx, const enum AV
     return AV_PIX_FMT_NONE;
 }
 
-bool H264Decoder::validateHardwareDecoding()
+bool VideoDecoder::validateHardwareDecoding()
 {
     // 如果没有硬件加速器名称，说明是软件解码，无需验证
     if (m_hwAccelName.isEmpty()) {
@@ -906,7 +867,16 @@ bool H264Decoder::validateHardwareDecoding()
     return true;
 }
 
-void H264Decoder::flushDecoder()
+void VideoDecoder::markStreamBroken(const char *reason)
+{
+    m_consecutiveErrors++;
+    m_waitingForKeyFrame = true;
+    LOG_DEBUG("Decoder needs key frame ({}), consecutive errors: {}", reason, m_consecutiveErrors);
+    // 发送频率由接收方控制，这里每次出错都通知
+    emit keyFrameRequired();
+}
+
+void VideoDecoder::flushDecoder()
 {
     QMutexLocker locker(&m_mutex);
     
@@ -916,11 +886,13 @@ void H264Decoder::flushDecoder()
     }
 }
 
-void H264Decoder::resetDecoder()
+void VideoDecoder::resetDecoder()
 {
     QMutexLocker locker(&m_mutex);
     
     m_consecutiveErrors = 0;
+    m_packetsWithoutFrame = 0;
+    m_waitingForKeyFrame = true;
     
     if (m_codecContext) {
         avcodec_flush_buffers(m_codecContext);
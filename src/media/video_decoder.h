@@ -0,0 +1,126 @@
+#ifndef VIDEO_DECODER_H
+#define VIDEO_DECODER_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <functional>
+#include <memory>
+#include <rtc/rtc.hpp>
+
+#include "image_ring.h"
+#include "video_codec.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+#include <libavutil/hwcontext.h>
+}
+
+#ifndef AV_ERROR_MAX_STRING_SIZE
+#define AV_ERROR_MAX_STRING_SIZE 64
+#endif
+
+// 解码线程策略，对应配置decoderThreading
+enum class DecoderThreading {
+    Slice, // slice：一帧内按条带并行，不增加延迟；发送端每帧只有一个条带时没有并行效果
+    Frame, // frame：帧级并行，每多一个线程输出晚一帧
+    Auto,  // auto：帧级+条带，线程数按CPU核数（FFmpeg本身默认是单线程）
+    None,  // none：单线程，与未设置线程参数时的FFmpeg默认行为相同
+};
+
+struct DecoderThreadingSettings {
+    DecoderThreading mode = DecoderThreading::Slice;
+    int threads = 0;      // 0为自动：条带模式等于编码端条带数，帧级模式按CPU核数
+    bool lowDelay = true; // AV_CODEC_FLAG_LOW_DELAY，开启时FFmpeg不启用帧级线程
+    bool fast = true;     // AV_CODEC_FLAG2_FAST，允许不完全符合规范的加速
+
+    static DecoderThreadingSettings fromConfig();
+    static QString modeName(DecoderThreading mode);
+};
+
+// 视频解码器：按协商的编码格式选择FFmpeg解码器，优先硬件加速，输出RGB32格式的QImage
+class VideoDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VideoDecoder(QObject *parent = nullptr);
+    ~VideoDecoder();
+
+    // 线程策略，在initialize之前设置，默认取自配置
+    void setThreading(const DecoderThreadingSettings& settings) { m_threading = settings; }
+    const DecoderThreadingSettings& threading() const { return m_threading; }
+
+    // 初始化解码器
+    bool initialize(VideoCodec codec = VideoCodec::H264, const QString& hwAccel = QString());
+    VideoCodec codec() const { return m_videoCodec; }
+    
+    // 解码一帧码流为QImage，图像来自内部的图像环，持有者释放后会被复用；
+    // output为false时只更新参考帧不转换输出（追帧时跳过的帧）
+    QImage decodeFrame(const rtc::binary& data, bool output = true);
+    // 在输出图像交出之前直接在上面绘制（如无损文字块），不会引起整帧拷贝
+    void setOverlay(std::function<void(QImage&)> overlay) { m_overlay = std::move(overlay); }
+    
+    // 释放资源
+    void cleanup();
+    
+    // 错误恢复
+    void flushDecoder();          // 刷新解码器缓冲区
+    void resetDecoder();          // 重置解码器状态
+    bool isWaitingForKeyFrame() const { return m_waitingForKeyFrame; }
+    
+    // 检查硬件加速支持
+    static QStringList getAvailableHWAccels();
+
+signals:
+    // 解码出错、参考帧丢失或长时间没有输出时发出，需要发送端尽快补一个IDR
+    void keyFrameRequired();
+    
+private:
+    void markStreamBroken(const char *reason);
+    void releaseResources();      // cleanup()的实现，调用方需持有m_mutex
+
+    bool initializeCodec(const QString& hwAccel);
+    bool initializeHardwareAccel(const QString& hwAccel);
+    void applyThreading();            // 打开解码器前按m_threading设置线程和低延迟标志
+    bool validateHardwareDecoding();  // 验证硬件解码是否真正工作
+    // 从解码器原生格式一次转换到图像环中的RGB32图像
+    QImage avframeToQImage(AVFrame* frame);
+    
+    // 硬件解码回调函数
+    static enum AVPixelFormat get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *pix_fmts);
+    
+    VideoCodec m_videoCodec;
+    DecoderThreadingSettings m_threading;
+
+    // FFmpeg 组件
+    AVCodecContext* m_codecContext;
+    const AVCodec* m_codec;
+    AVFrame* m_frame;
+    AVFrame* m_swFrame;
+    AVPacket* m_packet;
+    SwsContext* m_swsContext;     // 按输入尺寸和格式缓存，不变时复用
+    ImageRing m_imageRing;        // 输出图像，避免每帧分配整帧内存
+    std::function<void(QImage&)> m_overlay;
+    AVBufferRef* m_hwDeviceCtx;
+    
+    // 线程安全
+    QMutex m_mutex;
+    
+    // 硬件加速
+    QString m_hwAccelName;
+    enum AVPixelFormat m_hwPixelFormat;
+    
+    bool m_initialized;
+    
+    // 错误恢复和状态管理
+    int m_consecutiveErrors;      // 连续错误计数
+    int m_packetsWithoutFrame;    // 自上次输出帧以来送入的数据包数
+    bool m_waitingForKeyFrame;    // 流已损坏，等待下一个关键帧恢复
+};
+
+#endif // VIDEO_DECODER_H
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "video_encoder.h"
+#include "ffmpeg_encoder.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#ifdef HAVE_OPENH264
+#include "openh264_encoder.h"
+#endif
+#ifdef HAVE_X264
+#include "x264_encoder.h"
+#endif
+#include <algorithm>
+
+std::unique_ptr<VideoEncoder> VideoEncoder::create(const QString &backend, VideoCodec codec)
+{
+    if (backend.compare("openh264", Qt::CaseInsensitive) == 0)
+    {
+#ifdef HAVE_OPENH264
+        if (codec == VideoCodec::H264)
+        {
+            return std::make_unique<OpenH264Encoder>();
+        }
+        LOG_INFO("OpenH264 only encodes H264, using FFmpeg for {}", VideoCodecs::name(codec));
+#else
+        LOG_WARN("OpenH264 encoder backend is not built in, using FFmpeg");
+#endif
+    }
+    else if (backend.compare("x264", Qt::CaseInsensitive) == 0)
+    {
+#ifdef HAVE_X264
+        if (codec == VideoCodec::H264)
+        {
+            return std::make_unique<X264Encoder>();
+        }
+        LOG_INFO("x264 only encodes H264, using FFmpeg for {}", VideoCodecs::name(codec));
+#else
+        LOG_WARN("x264 encoder backend is not built in, using FFmpeg");
+#endif
+    }
+    else if (!backend.isEmpty() && backend.compare("auto", Qt::CaseInsensitive) != 0 &&
+             backend.compare("ffmpeg", Qt::CaseInsensitive) != 0)
+    {
+        LOG_WARN("Unknown video encoder backend: {}, using FFmpeg", backend);
+    }
+    return std::make_unique<FFmpegEncoder>(codec);
+}
+
+QStringList VideoEncoder::availableBackends()
+{
+    QStringList backends{"ffmpeg"};
+#ifdef HAVE_OPENH264
+    backends << "openh264";
+#endif
+#ifdef HAVE_X264
+    backends << "x264";
+#endif
+    return backends;
+}
+
+RateControlSettings RateControlSettings::fromConfig()
+{
+    RateControlSettings settings;
+    const QString mode = ConfigUtil->rateControl.trimmed().toLower();
+    if (mode == "capped_crf")
+    {
+        settings.mode = RateControlMode::CappedCrf;
+    }
+    else if (mode == "quality")
+    {
+        settings.mode = RateControlMode::Quality;
+    }
+    else if (mode != "cbr")
+    {
+        LOG_WARN("Unknown rate control mode: {}, using cbr", mode);
+    }
+    settings.quality = qBound(0, ConfigUtil->rateControlQuality, 51);
+    settings.vbvFrames = qMax(1, ConfigUtil->vbvFrames);
+    return settings;
+}
+
+RoiSettings RoiSettings::fromConfig()
+{
+    RoiSettings settings;
+    settings.enabled = ConfigUtil->roiEncoding;
+    settings.focusQpOffset = qBound(-51, ConfigUtil->roiFocusQpOffset, 51);
+    settings.staticQpOffset = qBound(-51, ConfigUtil->roiStaticQpOffset, 51);
+    return settings;
+}
+
+QString RateControlSettings::modeName(RateControlMode mode)
+{
+    switch (mode)
+    {
+    case RateControlMode::CappedCrf:
+        return "capped_crf";
+    case RateControlMode::Quality:
+        return "quality";
+    case RateControlMode::Cbr:
+        break;
+    }
+    return "cbr";
+}
+
+void VideoEncoder::recordFrameSize(int size, bool keyFrame, int qp)
+{
+    QMutexLocker locker(&m_statsMutex);
+    m_frameSizes.push_back(size);
+    if (qp >= 0)
+    {
+        m_qpSum += qp;
+        m_qpFrames++;
+        m_maxQp = qMax(m_maxQp, qp);
+    }
+    if (keyFrame)
+    {
+        m_keyFrameCount++;
+        m_maxKeyFrameSize = qMax(m_maxKeyFrameSize, size);
+    }
+}
+
+FrameSizeStats VideoEncoder::takeFrameSizeStats()
+{
+    QMutexLocker locker(&m_statsMutex);
+
+    FrameSizeStats stats;
+    stats.frames = static_cast<int>(m_frameSizes.size());
+    stats.keyFrames = m_keyFrameCount;
+    stats.maxKeyFrame = m_maxKeyFrameSize;
+    if (m_qpFrames > 0)
+    {
+        stats.avgQp = static_cast<double>(m_qpSum) / m_qpFrames;
+        stats.maxQp = m_maxQp;
+    }
+    if (!m_frameSizes.empty())
+    {
+        std::sort(m_frameSizes.begin(), m_frameSizes.end());
+        stats.p50 = m_frameSizes[m_frameSizes.size() / 2];
+        stats.p95 = m_frameSizes[(m_frameSizes.size() * 95) / 100];
+        stats.max = m_frameSizes.back();
+    }
+
+    m_frameSizes.clear();
+    m_keyFrameCount = 0;
+    m_maxKeyFrameSize = 0;
+    m_qpSum = 0;
+    m_qpFrames = 0;
+    m_maxQp = -1;
+    return stats;
+}
+
+TileChanges VideoEncoder::takeTileChanges()
+{
+    TileChanges changes;
+    std::swap(changes, m_tileChanges);
+    return changes;
+}
+
+int VideoEncoder::takeRefinementQp()
+{
+    const int qp = m_refinementQp;
+    m_refinementQp = -1;
+    return qp;
+}
+
+ScrollMotion VideoEncoder::takeScrollMotion()
+{
+    ScrollMotion motion;
+    std::swap(motion, m_scrollMotion);
+    return motion;
+}
+
+int VideoEncoder::longTermRefs() const
+{
+    return m_longTermRefs >= 0 ? m_longTermRefs : ConfigUtil->longTermRefs;
+}
@@ -0,0 +1,136 @@
+#ifndef VIDEO_ENCODER_H
+#define VIDEO_ENCODER_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "encoded_frame.h"
+#include "scroll_detector.h"
+#include "tile_change_map.h"
+#include "video_codec.h"
+
+// 一段时间内编码输出帧大小（字节）的分布，用于观察关键帧码率尖峰
+struct FrameSizeStats {
+  int frames = 0;
+  int keyFrames = 0;
+  int p50 = 0;
+  int p95 = 0;
+  int max = 0;
+  int maxKeyFrame = 0;
+  double avgQp = -1; // 编码器报告了QP的帧的平均值，-1为未知
+  int maxQp = -1;
+};
+
+// 码率控制方式，对应配置rateControl
+enum class RateControlMode {
+  Cbr,       // cbr：恒定码率，VBV只有vbvFrames帧，帧大小最平稳
+  CappedCrf, // capped_crf：按质量编码但码率不超过目标码率，适合文字为主的桌面
+  Quality,   // quality：只按质量编码，码率随画面内容变化
+};
+
+struct RateControlSettings {
+  RateControlMode mode = RateControlMode::Cbr;
+  int quality = 23;  // CRF/CQ（H264刻度0-51，越小质量越高）
+  int vbvFrames = 1; // VBV缓冲能容纳的平均帧数
+
+  static RateControlSettings fromConfig();
+  static QString modeName(RateControlMode mode);
+};
+
+// 按分块变化图调整各区域QP，对应配置roiEncoding/roiFocusQpOffset/roiStaticQpOffset
+struct RoiSettings {
+  bool enabled = true;
+  int focusQpOffset = -4; // 变化的块和光标附近的块
+  int staticQpOffset = 8; // 内容未变化的块
+
+  static RoiSettings fromConfig();
+};
+
+// 视频编码后端接口，输入为32位BGRA像素，输出协商格式的一帧码流（H264/H265为Annex-B）
+// 实现：FFmpegEncoder（FFmpeg，硬件/软件编码，支持全部格式）、OpenH264Encoder（仅H264，面向低功耗设备）、
+// X264Encoder（直接调用libx264，支持条带输出）
+class VideoEncoder {
+public:
+  virtual ~VideoEncoder() = default;
+
+  virtual bool initialize(int width, int height, int fps, int bitrate) = 0;
+  // 尺寸与编码尺寸不同时由实现负责缩放；captureTimeUs为该帧的捕获时刻
+  virtual EncodedVideoFrame encodeFrame(const uchar *bgra, int width,
+                                        int height, int stride,
+                                        qint64 captureTimeUs = 0) = 0;
+  // 运行中调整编码参数，能就地修改时不重新打开编码器
+  virtual bool reconfigure(int width, int height, int fps, int bitrate) = 0;
+  // 请求下一帧编码为关键帧，可在任意线程调用
+  virtual void requestKeyFrame() = 0;
+  virtual void reset() = 0;   // 重置时间戳和帧计数
+  virtual void cleanup() = 0; // 释放编码器
+
+  virtual QString backendName() const = 0;
+  // 能显式标记并保留长期参考帧（setLongTermRefs生效），目前只有OpenH264
+  virtual bool supportsLongTermRefs() const { return false; }
+  // 能逐帧按区域调整QP（setTileChanges/setRefinementQp生效），不支持时精修帧只是白白重编码
+  virtual bool supportsRegionQp() const { return false; }
+  // 使用滚动提示（setScrollMotion生效），目前只有x264后端
+  virtual bool supportsScrollHints() const { return false; }
+  virtual VideoCodec codec() const { return VideoCodec::H264; }
+  virtual quint64 framePoolAllocations() const { return 0; }
+
+  // 低延迟条带输出：每个条带编码完成即回调（在编码器内部线程，按画面顺序），
+  // encodeFrame仍返回引用同样数据的整帧。须在initialize之前设置，返回false表示后端不支持
+  using SliceCallback = std::function<void(const EncodedVideoFrame &slice)>;
+  virtual bool setSliceCallback(SliceCallback callback) {
+    Q_UNUSED(callback);
+    return false;
+  }
+
+  // 取出自上次调用以来的帧大小统计并清零
+  FrameSizeStats takeFrameSizeStats();
+
+  // 下一帧的分块变化图，支持ROI的后端（FFmpeg ROI旁路数据、x264 quant_offsets）据此调整各区域QP
+  // 与encodeFrame在同一线程调用，只作用于下一帧
+  void setTileChanges(const TileChanges &changes) { m_tileChanges = changes; }
+  // 下一帧为画面静止后的精修帧：变化图中非Unchanged的块尽量按qp编码
+  // 按上一帧QP换算为变化块的QP偏移，仍受码率控制和VBV约束；不支持的后端忽略
+  void setRefinementQp(int qp) { m_refinementQp = qp; }
+  // 下一帧检测到的滚动，x264后端据此临时放大运动搜索范围，其它后端忽略
+  void setScrollMotion(const ScrollMotion &motion) { m_scrollMotion = motion; }
+  // 长期参考帧数，须在initialize之前设置；不设置时取配置longTermRefs，不支持的后端忽略
+  void setLongTermRefs(int count) { m_longTermRefs = qBound(0, count, 15); }
+
+  // 按名称创建后端：auto/ffmpeg/openh264/x264；不可用或不支持该格式时退回FFmpeg
+  static std::unique_ptr<VideoEncoder>
+  create(const QString &backend, VideoCodec codec = VideoCodec::H264);
+  // 本次构建可用的后端名称
+  static QStringList availableBackends();
+
+protected:
+  // qp为-1表示编码器没有报告
+  void recordFrameSize(int size, bool keyFrame, int qp = -1);
+  // 取出待应用的分块变化图，没有时返回无效的变化图
+  TileChanges takeTileChanges();
+  // 取出待应用的精修QP，没有时返回-1
+  int takeRefinementQp();
+  // 取出待应用的滚动提示，没有时返回无效结果
+  ScrollMotion takeScrollMotion();
+  int longTermRefs() const;
+
+private:
+  TileChanges m_tileChanges;
+  int m_refinementQp = -1;
+  ScrollMotion m_scrollMotion;
+  int m_longTermRefs = -1; // -1为使用配置
+  QMutex m_statsMutex;
+  std::vector<int> m_frameSizes;
+  qint64 m_qpSum = 0;
+  int m_qpFrames = 0;
+  int m_maxQp = -1;
+  int m_keyFrameCount = 0;
+  int m_maxKeyFrameSize = 0;
+};
+
+#endif // VIDEO_ENCODER_H
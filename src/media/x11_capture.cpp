@@ -0,0 +1,363 @@
+#include "x11_capture.h"
+
+#if defined(Q_OS_LINUX)
+#include "logger_manager.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <atomic>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#undef KeyPress // 避免与Qt宏冲突
+#undef KeyRelease
+
+namespace
+{
+    // X默认错误处理会直接退出进程，捕获期间改为记录错误码，由调用方判断
+    std::atomic<int> g_lastXError{0};
+
+    int captureXErrorHandler(Display *, XErrorEvent *event)
+    {
+        g_lastXError = event->error_code;
+        return 0;
+    }
+
+    // 主屏幕在X根窗口中的区域（物理像素）
+    QRect primaryScreenRegion()
+    {
+        QScreen *screen = QGuiApplication::primaryScreen();
+        if (!screen)
+        {
+            return QRect();
+        }
+        const QRect geometry = screen->geometry();
+        const qreal dpr = screen->devicePixelRatio();
+        return QRect(qRound(geometry.x() * dpr), qRound(geometry.y() * dpr),
+                     qRound(geometry.width() * dpr), qRound(geometry.height() * dpr));
+    }
+}
+
+struct XShmCaptureBackend::Private
+{
+    Display *display = nullptr;
+    Window root = 0;
+    XImage *image = nullptr;
+    XShmSegmentInfo shmInfo{};
+    bool attached = false;
+    XErrorHandler oldHandler = nullptr;
+    QRect region;
+
+    // XDamage
+    Damage damage = 0;
+    XserverRegion damageRegion = 0;
+    int damageEventBase = 0;
+    bool damagePending = true; // 首帧视为整屏损伤
+};
+
+XShmCaptureBackend::XShmCaptureBackend()
+    : d(new Private)
+{
+    d->shmInfo.shmid = -1;
+    d->shmInfo.shmaddr = reinterpret_cast<char *>(-1);
+}
+
+XShmCaptureBackend::~XShmCaptureBackend()
+{
+    close();
+}
+
+bool XShmCaptureBackend::open()
+{
+    if (d->display)
+    {
+        return true;
+    }
+
+    // Wayland等非xcb平台下根窗口不可读，直接交给Qt路径
+    if (QGuiApplication::platformName() != QLatin1String("xcb"))
+    {
+        LOG_INFO("XShm capture requires the xcb platform, current: {}", QGuiApplication::platformName());
+        return false;
+    }
+
+    d->display = XOpenDisplay(nullptr);
+    if (!d->display)
+    {
+        LOG_WARN("XShm capture: failed to open X display");
+        return false;
+    }
+
+    if (!XShmQueryExtension(d->display))
+    {
+        LOG_WARN("XShm capture: MIT-SHM extension not available");
+        close();
+        return false;
+    }
+
+    d->root = DefaultRootWindow(d->display);
+    d->oldHandler = XSetErrorHandler(captureXErrorHandler);
+    d->region = primaryScreenRegion();
+    if (d->region.isEmpty() || !createImage(d->region.width(), d->region.height()))
+    {
+        close();
+        return false;
+    }
+
+    LOG_INFO("XShm capture opened: {}x{} at ({}, {}), stride {}",
+             d->region.width(), d->region.height(), d->region.x(), d->region.y(),
+             d->image->bytes_per_line);
+    return true;
+}
+
+void XShmCaptureBackend::close()
+{
+    if (!d->display)
+    {
+        return;
+    }
+
+    destroyDamage();
+    destroyImage();
+    if (d->oldHandler)
+    {
+        XSetErrorHandler(d->oldHandler);
+        d->oldHandler = nullptr;
+    }
+    XCloseDisplay(d->display);
+    d->display = nullptr;
+    d->root = 0;
+}
+
+bool XShmCaptureBackend::grab(CaptureFrame &frame)
+{
+    if (!d->display)
+    {
+        return false;
+    }
+
+    // 屏幕分辨率变化时重建共享内存段
+    const QRect region = primaryScreenRegion();
+    if (region.isEmpty())
+    {
+        return false;
+    }
+    if (region != d->region || !d->image)
+    {
+        LOG_INFO("XShm capture: screen region changed to {}x{}", region.width(), region.height());
+        destroyImage();
+        d->region = region;
+        if (!createImage(region.width(), region.height()))
+        {
+            return false;
+        }
+        frame.damage = QRegion(0, 0, region.width(), region.height());
+    }
+
+    g_lastXError = 0;
+    if (!XShmGetImage(d->display, d->root, d->image, d->region.x(), d->region.y(), AllPlanes) || g_lastXError != 0)
+    {
+        LOG_WARN("XShmGetImage failed, X error code: {}", g_lastXError.load());
+        return false;
+    }
+
+    frame.bits = reinterpret_cast<const uchar *>(d->image->data);
+    frame.width = d->image->width;
+    frame.height = d->image->height;
+    frame.stride = d->image->bytes_per_line;
+    return true;
+}
+
+bool XShmCaptureBackend::enableDamageTracking()
+{
+    if (!d->display)
+    {
+        return false;
+    }
+    if (d->damage)
+    {
+        return true;
+    }
+
+    int damageErrorBase = 0;
+    int fixesEventBase = 0;
+    int fixesErrorBase = 0;
+    if (!XDamageQueryExtension(d->display, &d->damageEventBase, &damageErrorBase) ||
+        !XFixesQueryExtension(d->display, &fixesEventBase, &fixesErrorBase))
+    {
+        LOG_WARN("XDamage/XFixes extension not available, damage tracking disabled");
+        return false;
+    }
+
+    g_lastXError = 0;
+    // NonEmpty：损伤从无到有时只通知一次，具体区域在takeDamage中一次性取出
+    d->damage = XDamageCreate(d->display, d->root, XDamageReportNonEmpty);
+    d->damageRegion = XFixesCreateRegion(d->display, nullptr, 0);
+    XSync(d->display, False);
+    if (g_lastXError != 0 || !d->damage || !d->damageRegion)
+    {
+        LOG_WARN("XDamageCreate failed, X error code: {}", g_lastXError.load());
+        destroyDamage();
+        return false;
+    }
+
+    d->damagePending = true;
+    LOG_INFO("XDamage tracking enabled on root window");
+    return true;
+}
+
+bool XShmCaptureBackend::takeDamage(QRegion &damage)
+{
+    damage = QRegion();
+    if (!d->display || !d->damage)
+    {
+        return true;
+    }
+
+    // 排空事件队列，只关心是否有新的DamageNotify
+    while (XPending(d->display) > 0)
+    {
+        XEvent event;
+        XNextEvent(d->display, &event);
+        if (event.type == d->damageEventBase + XDamageNotify)
+        {
+            d->damagePending = true;
+        }
+    }
+
+    if (!d->damagePending)
+    {
+        return false;
+    }
+    d->damagePending = false;
+
+    // 取出累计损伤并清空，之后的变化会再次触发通知
+    XDamageSubtract(d->display, d->damage, 0, d->damageRegion);
+    int count = 0;
+    XRectangle *rects = XFixesFetchRegion(d->display, d->damageRegion, &count);
+    for (int i = 0; i < count; ++i)
+    {
+        damage += QRect(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+    }
+    if (rects)
+    {
+        XFree(rects);
+    }
+
+    // 转换到捕获区域坐标，丢弃其它屏幕上的损伤
+    damage = damage.intersected(d->region).translated(-d->region.topLeft());
+    return !damage.isEmpty();
+}
+
+void XShmCaptureBackend::destroyDamage()
+{
+    if (d->damage)
+    {
+        XDamageDestroy(d->display, d->damage);
+        d->damage = 0;
+    }
+    if (d->damageRegion)
+    {
+        XFixesDestroyRegion(d->display, d->damageRegion);
+        d->damageRegion = 0;
+    }
+    d->damagePending = true;
+}
+
+bool XShmCaptureBackend::createImage(int width, int height)
+{
+    const int screenNum = DefaultScreen(d->display);
+    d->image = XShmCreateImage(d->display, DefaultVisual(d->display, screenNum), DefaultDepth(d->display, screenNum),
+                               ZPixmap, nullptr, &d->shmInfo, width, height);
+    if (!d->image)
+    {
+        LOG_WARN("XShmCreateImage failed for {}x{}", width, height);
+        return false;
+    }
+
+    // 只接受小端32位BGRX布局，与编码器的BGRA输入一致
+    if (d->image->bits_per_pixel != 32 || d->image->byte_order != LSBFirst || d->image->red_mask != 0xff0000 ||
+        d->image->green_mask != 0x00ff00 || d->image->blue_mask != 0x0000ff)
+    {
+        LOG_WARN("XShm capture: unsupported visual ({} bpp, red mask {:#x})",
+                 d->image->bits_per_pixel, d->image->red_mask);
+        destroyImage();
+        return false;
+    }
+
+    d->shmInfo.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(d->image->bytes_per_line) * d->image->height,
+                              IPC_CREAT | 0600);
+    if (d->shmInfo.shmid < 0)
+    {
+        LOG_WARN("XShm capture: shmget failed");
+        destroyImage();
+        return false;
+    }
+
+    d->shmInfo.shmaddr = static_cast<char *>(shmat(d->shmInfo.shmid, nullptr, 0));
+    if (d->shmInfo.shmaddr == reinterpret_cast<char *>(-1))
+    {
+        LOG_WARN("XShm capture: shmat failed");
+        destroyImage();
+        return false;
+    }
+    d->image->data = d->shmInfo.shmaddr;
+    d->shmInfo.readOnly = False;
+
+    g_lastXError = 0;
+    if (!XShmAttach(d->display, &d->shmInfo))
+    {
+        LOG_WARN("XShm capture: XShmAttach failed");
+        destroyImage();
+        return false;
+    }
+    XSync(d->display, False);
+    d->attached = g_lastXError == 0;
+
+    // 服务端已经attach，标记删除后进程退出时由内核回收
+    shmctl(d->shmInfo.shmid, IPC_RMID, nullptr);
+
+    if (!d->attached)
+    {
+        // 远程X服务器无法共享本机内存
+        LOG_WARN("XShm capture: X server could not attach segment, error code {}", g_lastXError.load());
+        destroyImage();
+        return false;
+    }
+    return true;
+}
+
+void XShmCaptureBackend::destroyImage()
+{
+    if (d->attached)
+    {
+        XShmDetach(d->display, &d->shmInfo);
+        XSync(d->display, False);
+        d->attached = false;
+    }
+
+    if (d->image)
+    {
+        // 数据区属于共享内存段，不能交给XDestroyImage释放
+        d->image->data = nullptr;
+        XDestroyImage(d->image);
+        d->image = nullptr;
+    }
+
+    if (d->shmInfo.shmaddr != reinterpret_cast<char *>(-1))
+    {
+        shmdt(d->shmInfo.shmaddr);
+        d->shmInfo.shmaddr = reinterpret_cast<char *>(-1);
+    }
+
+    if (d->shmInfo.shmid >= 0)
+    {
+        shmctl(d->shmInfo.shmid, IPC_RMID, nullptr);
+        d->shmInfo.shmid = -1;
+    }
+}
+
+#endif // Q_OS_LINUX
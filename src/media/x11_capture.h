@@ -0,0 +1,34 @@
+#ifndef X11_CAPTURE_H
+#define X11_CAPTURE_H
+
+#include "media_capture.h"
+#include <memory>
+
+#if defined(Q_OS_LINUX)
+
+// 基于XShm的屏幕捕获后端：像素直接写入复用的共享内存段，避免经过X socket传输整帧
+// X11头文件只在cpp中包含，避免None/KeyPress等宏污染Qt头文件
+class XShmCaptureBackend : public ScreenCaptureBackend {
+public:
+  XShmCaptureBackend();
+  ~XShmCaptureBackend() override;
+
+  const char *name() const override { return "xshm"; }
+  bool open() override;
+  void close() override;
+  bool grab(CaptureFrame &frame) override;
+  bool enableDamageTracking() override;
+  bool takeDamage(QRegion &damage) override;
+
+private:
+  bool createImage(int width, int height);
+  void destroyImage();
+  void destroyDamage();
+
+  struct Private;
+  std::unique_ptr<Private> d;
+};
+
+#endif // Q_OS_LINUX
+
+#endif // X11_CAPTURE_H
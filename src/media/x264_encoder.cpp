@@ -0,0 +1,479 @@
+#include "x264_encoder.h"
+
+#ifdef HAVE_X264
+
+#include "color_convert.h"
+#include "logger_manager.h"
+#include "config_util.h"
+#include <QThread>
+#include <utility>
+
+X264Encoder::X264Encoder()
+    : m_encoder(nullptr), m_width(0), m_height(0), m_fps(30), m_bitrate(2000000), m_lastQp(-1), m_frameIndex(0),
+      m_frameIndexBase(0), m_timestampBaseUs(0), m_firstFrame(true), m_defaultMeMethod(X264_ME_HEX),
+      m_defaultMeRange(16), m_mbCount(0), m_nextMb(0),
+      m_sliceTimestampUs(0), m_sliceCaptureTimeUs(0)
+{
+    m_colorConverter = std::make_unique<ColorConverter>();
+    m_colorConverter->setVerifyInterval(ConfigUtil->colorConvertVerifyInterval);
+    m_keyFrameRequested = false;
+    m_keyFrameMinIntervalMs = ConfigUtil->keyFrameMinIntervalMs;
+    m_rateControl = RateControlSettings::fromConfig();
+    m_roi = RoiSettings::fromConfig();
+    m_intraRefresh = ConfigUtil->intraRefresh;
+    m_intraRefreshPeriod = ConfigUtil->intraRefreshPeriod;
+}
+
+X264Encoder::~X264Encoder()
+{
+    cleanup();
+}
+
+bool X264Encoder::setSliceCallback(SliceCallback callback)
+{
+    QMutexLocker locker(&m_mutex);
+    // 在下次打开编码器时生效
+    m_sliceCallback = std::move(callback);
+    return true;
+}
+
+bool X264Encoder::initialize(int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    closeEncoder();
+    // NV12输入要求偶数尺寸
+    m_width = width & ~1;
+    m_height = height & ~1;
+    m_fps = qBound(1, fps, 60);
+    m_bitrate = bitrate;
+
+    if (!openEncoder())
+    {
+        closeEncoder();
+        return false;
+    }
+
+    LOG_INFO("x264 encoder initialized: {}x{}, {}fps, {}bps, {} threads, {} refs, slice output {}", m_width, m_height,
+             m_fps, m_bitrate, m_param.i_threads, m_param.i_frame_reference, m_sliceCallback ? "on" : "off");
+    return true;
+}
+
+void X264Encoder::applyRateControl(x264_param_t *param) const
+{
+    // x264码率单位为kbit/s；VBV与FFmpeg后端一致，只容纳vbvFrames帧
+    const int kbps = qMax(1, m_bitrate / 1000);
+    const int vbvKbits = qMax(1, kbps * m_rateControl.vbvFrames / m_fps);
+    switch (m_rateControl.mode)
+    {
+    case RateControlMode::CappedCrf:
+        param->rc.i_rc_method = X264_RC_CRF;
+        param->rc.f_rf_constant = m_rateControl.quality;
+        param->rc.i_vbv_max_bitrate = kbps;
+        param->rc.i_vbv_buffer_size = vbvKbits;
+        break;
+    case RateControlMode::Quality:
+        param->rc.i_rc_method = X264_RC_CRF;
+        param->rc.f_rf_constant = m_rateControl.quality;
+        param->rc.i_vbv_max_bitrate = 0;
+        param->rc.i_vbv_buffer_size = 0;
+        break;
+    case RateControlMode::Cbr:
+    default:
+        param->rc.i_rc_method = X264_RC_ABR;
+        param->rc.i_bitrate = kbps;
+        param->rc.i_vbv_max_bitrate = kbps;
+        param->rc.i_vbv_buffer_size = vbvKbits;
+        break;
+    }
+}
+
+bool X264Encoder::openEncoder()
+{
+    x264_param_t &param = m_param;
+    if (x264_param_default_preset(&param, "fast", "zerolatency") < 0)
+    {
+        LOG_ERROR("Failed to load x264 preset");
+        return false;
+    }
+
+    param.i_log_level = X264_LOG_ERROR;
+    param.i_width = m_width;
+    param.i_height = m_height;
+    param.i_csp = X264_CSP_NV12;
+    param.i_fps_num = m_fps;
+    param.i_fps_den = 1;
+    param.b_vfr_input = 0;
+    param.i_keyint_max = X264_KEYINT_MAX_INFINITE; // 关键帧按需产生
+    param.i_scenecut_threshold = 0;
+    param.b_repeat_headers = 1; // 每个IDR前带SPS/PPS
+    param.b_annexb = 1;
+
+    // 条带并行（sliced-threads）：一帧内各条带同时编码，不引入帧级线程的延迟
+    // 采集线程也要占CPU，编码线程数不超过核心数-1；条带数与FFmpeg后端一致
+    param.i_threads = qBound(1, QThread::idealThreadCount() - 1, 4);
+    param.b_sliced_threads = 1;
+    param.i_slice_count = VideoCodecs::kSliceCount;
+
+    if (m_intraRefresh)
+    {
+        param.b_intra_refresh = 1;
+        param.i_keyint_max = m_intraRefreshPeriod;
+    }
+    else if (longTermRefs() > 0)
+    {
+        // x264没有显式标记长期参考的接口，加大参考帧数只是滑动窗口，保不住切换前的画面
+        LOG_WARN("Long-term references require the openh264 backend, ignored by x264");
+    }
+    applyRateControl(&param);
+
+    if (m_sliceCallback)
+    {
+        // 设置后x264_encoder_encode不再返回NAL，全部经由回调输出
+        param.nalu_process = &X264Encoder::onNal;
+    }
+
+    if (x264_param_apply_profile(&param, "baseline") < 0)
+    {
+        LOG_ERROR("Failed to apply x264 baseline profile");
+        return false;
+    }
+    m_defaultMeMethod = param.analyse.i_me_method;
+    m_defaultMeRange = param.analyse.i_me_range;
+
+    m_encoder = x264_encoder_open(&param);
+    if (!m_encoder)
+    {
+        LOG_ERROR("Failed to open x264 encoder ({}x{}, {}fps, {}bps)", m_width, m_height, m_fps, m_bitrate);
+        return false;
+    }
+
+    m_nv12.resize(static_cast<size_t>(m_width) * m_height * 3 / 2);
+    m_mbCount = ((m_width + 15) / 16) * ((m_height + 15) / 16);
+    m_firstFrame = true;
+    return true;
+}
+
+void X264Encoder::closeEncoder()
+{
+    if (m_encoder)
+    {
+        x264_encoder_close(m_encoder);
+        m_encoder = nullptr;
+    }
+    QMutexLocker sliceLocker(&m_sliceMutex);
+    resetSliceState();
+}
+
+void X264Encoder::resetSliceState()
+{
+    for (auto &entry : m_pendingSlices)
+    {
+        av_packet_free(&entry.second.packet);
+    }
+    m_pendingSlices.clear();
+    m_pendingHeaders = EncodedVideoFrame();
+    m_sliceFrame = EncodedVideoFrame();
+    m_nextMb = 0;
+}
+
+void X264Encoder::applyMotionSearchRange(int range)
+{
+    if (range == m_param.analyse.i_me_range)
+    {
+        return;
+    }
+    m_param.analyse.i_me_method = range > m_defaultMeRange ? X264_ME_UMH : m_defaultMeMethod;
+    m_param.analyse.i_me_range = range;
+    if (x264_encoder_reconfig(m_encoder, &m_param) < 0)
+    {
+        LOG_WARN("Failed to set x264 motion search range to {}", range);
+        return;
+    }
+    LOG_DEBUG("x264 motion search range set to {}", range);
+}
+
+bool X264Encoder::bgraToNv12(const uchar *bgra, int width, int height, int stride)
+{
+    uint8_t *dstY = m_nv12.data();
+    uint8_t *dstUV = dstY + static_cast<size_t>(m_width) * m_height;
+
+    // 同尺寸或2倍下采样走SIMD转换，x264直接接受NV12输入
+    int downscale = ColorConverter::downscaleFactor(width, height, m_width, m_height);
+    if (downscale > 0 &&
+        m_colorConverter->convertToNv12(bgra, width, height, stride, downscale, dstY, m_width, dstUV, m_width))
+    {
+        return true;
+    }
+
+    SwsContext *swsContext = m_swsCache.get(width, height, AV_PIX_FMT_BGRA, m_width, m_height, AV_PIX_FMT_NV12);
+    if (!swsContext)
+    {
+        LOG_ERROR("SwsContext creation failed for BGRA to NV12 conversion ({}x{} -> {}x{})", width, height, m_width,
+                  m_height);
+        return false;
+    }
+
+    const uint8_t *srcData[4] = {bgra, nullptr, nullptr, nullptr};
+    int srcLinesize[4] = {stride, 0, 0, 0};
+    uint8_t *dstData[4] = {dstY, dstUV, nullptr, nullptr};
+    int dstLinesize[4] = {m_width, m_width, 0, 0};
+    return sws_scale(swsContext, srcData, srcLinesize, 0, height, dstData, dstLinesize) == m_height;
+}
+
+void X264Encoder::onNal(x264_t *handle, x264_nal_t *nal, void *opaque)
+{
+    static_cast<X264Encoder *>(opaque)->handleNal(handle, nal);
+}
+
+void X264Encoder::handleNal(x264_t *handle, x264_nal_t *nal)
+{
+    // 加上起始码和防竞争字节，直接写进新的数据包，不再经过中间缓冲
+    AVPacket *packet = av_packet_alloc();
+    if (!packet || av_new_packet(packet, nal->i_payload * 3 / 2 + 5 + 64) < 0)
+    {
+        LOG_ERROR("Failed to allocate packet for x264 NAL unit");
+        av_packet_free(&packet);
+        return;
+    }
+    x264_nal_encode(handle, packet->data, nal);
+    av_shrink_packet(packet, nal->i_payload);
+    if (nal->i_type == NAL_SLICE_IDR || nal->i_type == NAL_SPS || nal->i_type == NAL_PPS)
+    {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    QMutexLocker locker(&m_sliceMutex);
+    if (nal->i_type != NAL_SLICE && nal->i_type != NAL_SLICE_IDR)
+    {
+        // 参数集和SEI在条带之前由调用线程写出
+        m_pendingHeaders.appendPacket(packet);
+        av_packet_free(&packet);
+        return;
+    }
+    m_pendingSlices[nal->i_first_mb] = PendingSlice{packet, nal->i_last_mb};
+
+    // 条带线程可能乱序完成，只发出从m_nextMb开始已经连续的条带，保证接收端按解码顺序收到
+    for (auto it = m_pendingSlices.find(m_nextMb); it != m_pendingSlices.end(); it = m_pendingSlices.find(m_nextMb))
+    {
+        EncodedVideoFrame slice;
+        std::swap(slice, m_pendingHeaders);
+        slice.appendPacket(it->second.packet);
+        av_packet_free(&it->second.packet);
+        m_nextMb = it->second.lastMb + 1;
+        m_pendingSlices.erase(it);
+
+        slice.setTimestampUs(m_sliceTimestampUs);
+        slice.setCaptureTimeUs(m_sliceCaptureTimeUs);
+        slice.setEncodeDurationUs(m_encodeTimer.nsecsElapsed() / 1000);
+        slice.setFrameEnd(m_nextMb >= m_mbCount);
+        m_sliceFrame.appendPackets(slice);
+        m_sliceCallback(slice);
+    }
+}
+
+EncodedVideoFrame X264Encoder::encodeFrame(const uchar *bgra, int width, int height, int stride, qint64 captureTimeUs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+
+    EncodedVideoFrame result;
+    quint64 timestamp_us = m_timestampBaseUs + (m_frameIndex - m_frameIndexBase) * (1000000 / m_fps);
+
+    if (!m_encoder)
+    {
+        LOG_ERROR("Encoder not initialized");
+        return result;
+    }
+    if (!bgraToNv12(bgra, width, height, stride))
+    {
+        LOG_ERROR("Failed to convert BGRA pixels to NV12");
+        return result;
+    }
+    m_frameIndex++;
+
+    x264_picture_t picture;
+    x264_picture_init(&picture);
+    picture.img.i_csp = X264_CSP_NV12;
+    picture.img.i_plane = 2;
+    picture.img.plane[0] = m_nv12.data();
+    picture.img.plane[1] = m_nv12.data() + static_cast<size_t>(m_width) * m_height;
+    picture.img.i_stride[0] = m_width;
+    picture.img.i_stride[1] = m_width;
+    picture.i_pts = m_frameIndex;
+    picture.opaque = this;
+
+    // 按分块变化图给每个宏块加QP偏移（依赖自适应量化，preset默认开启），编码返回前一直有效
+    // 精修帧不强制整帧QP（会绕过码率控制和单帧VBV），按上一帧QP换算成变化块的偏移，帧大小仍受VBV限制
+    const TileChanges tileChanges = takeTileChanges();
+    const int refinementQp = takeRefinementQp();
+    float focusOffset = m_roi.focusQpOffset;
+    if (refinementQp >= 0)
+    {
+        focusOffset = m_lastQp >= 0 ? qBound(-51, refinementQp - m_lastQp, 0) : -12;
+    }
+    if (tileChanges.isValid())
+    {
+        m_quantOffsets = tileChanges.macroblockQpOffsets(m_width, m_height, focusOffset, m_roi.staticQpOffset);
+        picture.prop.quant_offsets = m_quantOffsets.data();
+    }
+
+    // x264不接受外部运动矢量：检测到滚动时临时改用UMH并把搜索范围放大到滚动距离，
+    // 滚动区域就能按同一个运动矢量预测；按32取整，连续滚动时不必每帧重新配置
+    const ScrollMotion scroll = takeScrollMotion();
+    int meRange = m_defaultMeRange;
+    if (scroll.isValid())
+    {
+        const int shift = qAbs(scroll.dy) * m_height / qMax(1, scroll.sourceHeight);
+        meRange = qMax(meRange, (shift + 16 + 31) / 32 * 32);
+    }
+    applyMotionSearchRange(meRange);
+
+    // 首帧之后只在接收端请求时插入IDR（或开始新一轮帧内刷新），短时间内的多次请求合并
+    if (!m_firstFrame && m_keyFrameRequested.load() &&
+        (!m_lastKeyFrameTimer.isValid() || m_lastKeyFrameTimer.elapsed() >= m_keyFrameMinIntervalMs))
+    {
+        if (m_intraRefresh)
+        {
+            LOG_INFO("Starting intra refresh on key frame request");
+            x264_encoder_intra_refresh(m_encoder);
+        }
+        else
+        {
+            LOG_INFO("Forcing IDR on key frame request");
+            picture.i_type = X264_TYPE_IDR;
+        }
+        m_keyFrameRequested = false;
+        m_lastKeyFrameTimer.start();
+    }
+
+    if (m_sliceCallback)
+    {
+        QMutexLocker sliceLocker(&m_sliceMutex);
+        resetSliceState();
+        m_sliceTimestampUs = timestamp_us;
+        m_sliceCaptureTimeUs = captureTimeUs;
+        m_encodeTimer.start();
+    }
+
+    x264_nal_t *nals = nullptr;
+    int nalCount = 0;
+    x264_picture_t output;
+    int frameSize = x264_encoder_encode(m_encoder, &nals, &nalCount, &picture, &output);
+    if (frameSize < 0)
+    {
+        LOG_ERROR("x264_encoder_encode failed: {}", frameSize);
+        return result;
+    }
+
+    const bool keyFrame = output.b_keyframe != 0;
+    if (m_sliceCallback)
+    {
+        // 各条带已经在回调中发出，这里取回它们组成的整帧
+        QMutexLocker sliceLocker(&m_sliceMutex);
+        if (frameSize > 0 && m_nextMb < m_mbCount)
+        {
+            LOG_WARN("x264 frame finished with {} of {} macroblocks sent", m_nextMb, m_mbCount);
+        }
+        result = m_sliceFrame;
+        resetSliceState();
+    }
+    else if (frameSize > 0 && nalCount > 0)
+    {
+        // 各NAL在x264内部缓冲中连续存放，下一帧会被覆盖，需要拷贝出来
+        result.appendData(nals[0].p_payload, frameSize, keyFrame);
+    }
+
+    if (result.isEmpty())
+    {
+        return result;
+    }
+
+    if (keyFrame)
+    {
+        m_lastKeyFrameTimer.start();
+    }
+    m_firstFrame = false;
+    const int qp = output.i_qpplus1 - 1;
+    result.setQp(qp);
+    m_lastQp = qp;
+    recordFrameSize(static_cast<int>(result.size()), keyFrame, qp);
+
+    result.setTimestampUs(timestamp_us);
+    result.setCaptureTimeUs(captureTimeUs);
+    result.setEncodeDurationUs(encodeTimer.nsecsElapsed() / 1000);
+    return result;
+}
+
+bool X264Encoder::reconfigure(int width, int height, int fps, int bitrate)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_encoder)
+    {
+        LOG_WARN("Cannot reconfigure encoder - not initialized");
+        return false;
+    }
+
+    fps = qBound(1, fps, 60);
+    if (bitrate <= 0)
+    {
+        bitrate = m_bitrate;
+    }
+
+    if ((width & ~1) == m_width && (height & ~1) == m_height && fps == m_fps)
+    {
+        // 尺寸和帧率不变时就地修改码率和VBV
+        m_bitrate = bitrate;
+        applyRateControl(&m_param);
+        if (x264_encoder_reconfig(m_encoder, &m_param) == 0)
+        {
+            LOG_INFO("x264 encoder updated in place: {}bps", m_bitrate);
+            return true;
+        }
+    }
+
+    if (fps != m_fps)
+    {
+        m_timestampBaseUs += (m_frameIndex - m_frameIndexBase) * (1000000 / m_fps);
+        m_frameIndexBase = m_frameIndex;
+    }
+
+    // 尺寸或帧率变化需要重新打开，新参数集随首帧IDR一起下发
+    closeEncoder();
+    m_width = width & ~1;
+    m_height = height & ~1;
+    m_fps = fps;
+    m_bitrate = bitrate;
+    if (!openEncoder())
+    {
+        closeEncoder();
+        return false;
+    }
+    LOG_INFO("x264 encoder reopened: {}x{}, {}fps, {}bps", m_width, m_height, m_fps, m_bitrate);
+    return true;
+}
+
+void X264Encoder::requestKeyFrame()
+{
+    m_keyFrameRequested = true;
+}
+
+void X264Encoder::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_frameIndex = 0;
+    m_frameIndexBase = 0;
+    m_timestampBaseUs = 0;
+}
+
+void X264Encoder::cleanup()
+{
+    QMutexLocker locker(&m_mutex);
+    closeEncoder();
+    m_swsCache.clear();
+}
+
+#endif // HAVE_X264
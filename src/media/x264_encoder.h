@@ -0,0 +1,107 @@
+#ifndef X264_ENCODER_H
+#define X264_ENCODER_H
+
+#ifdef HAVE_X264
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <x264.h>
+}
+
+#include "frame_pool.h"
+#include "video_encoder.h"
+
+class ColorConverter;
+
+// 直接调用libx264的H264编码后端，参数与FFmpeg的libx264一致（zerolatency、baseline）
+// 设置条带回调后用sliced-threads并行编码各条带，每个条带完成即交给回调，不等整帧
+class X264Encoder : public VideoEncoder {
+public:
+  X264Encoder();
+  ~X264Encoder() override;
+
+  bool initialize(int width, int height, int fps, int bitrate) override;
+  EncodedVideoFrame encodeFrame(const uchar *bgra, int width, int height,
+                                int stride,
+                                qint64 captureTimeUs = 0) override;
+  bool reconfigure(int width, int height, int fps, int bitrate) override;
+  void requestKeyFrame() override;
+  void reset() override;
+  void cleanup() override;
+  bool setSliceCallback(SliceCallback callback) override;
+
+  QString backendName() const override { return "x264"; }
+  bool supportsRegionQp() const override { return true; }
+  bool supportsScrollHints() const override { return true; }
+
+private:
+  // 条带线程可能乱序完成，按首宏块序号暂存
+  struct PendingSlice {
+    AVPacket *packet;
+    int lastMb;
+  };
+
+  bool openEncoder();
+  void closeEncoder();
+  void applyRateControl(x264_param_t *param) const;
+  // 就地修改运动搜索范围，大于preset默认值时用UMH
+  void applyMotionSearchRange(int range);
+  bool bgraToNv12(const uchar *bgra, int width, int height, int stride);
+
+  static void onNal(x264_t *handle, x264_nal_t *nal, void *opaque);
+  void handleNal(x264_t *handle, x264_nal_t *nal);
+  void resetSliceState();
+
+  x264_t *m_encoder;
+  x264_param_t m_param;
+  std::unique_ptr<ColorConverter> m_colorConverter;
+  SwsContextCache m_swsCache;
+  std::vector<uint8_t> m_nv12; // 编码输入（Y后接交错UV）
+
+  int m_width;
+  int m_height;
+  int m_fps;
+  int m_bitrate;
+  RateControlSettings m_rateControl;
+  RoiSettings m_roi;
+  std::vector<float> m_quantOffsets; // 当前帧每个宏块的QP偏移
+  int m_lastQp; // 上一帧的QP，-1为未知
+  bool m_intraRefresh;
+  int m_intraRefreshPeriod;
+  qint64 m_frameIndex;
+  qint64 m_frameIndexBase;   // 最近一次帧率变化时的帧序号
+  quint64 m_timestampBaseUs; // 最近一次帧率变化时的时间戳
+  bool m_firstFrame;
+
+  int m_defaultMeMethod; // preset的运动搜索方法和范围，没有滚动时使用
+  int m_defaultMeRange;
+
+  std::atomic<bool> m_keyFrameRequested;
+  QElapsedTimer m_lastKeyFrameTimer;
+  int m_keyFrameMinIntervalMs;
+
+  // 条带输出状态，由m_sliceMutex保护（回调在x264的条带线程中执行）
+  SliceCallback m_sliceCallback;
+  QMutex m_sliceMutex;
+  int m_mbCount;                  // 每帧宏块数
+  int m_nextMb;                   // 下一个应发出的条带的首宏块
+  std::map<int, PendingSlice> m_pendingSlices;
+  EncodedVideoFrame m_pendingHeaders; // SPS/PPS/SEI，随第一个条带发出
+  EncodedVideoFrame m_sliceFrame;     // 已发出的条带组成的整帧
+  quint64 m_sliceTimestampUs;
+  qint64 m_sliceCaptureTimeUs;
+  QElapsedTimer m_encodeTimer;
+
+  QMutex m_mutex;
+};
+
+#endif // HAVE_X264
+
+#endif // X264_ENCODER_H
@@ -19,12 +19,77 @@ ConfigUtilData::ConfigUtilData(QObject *parent)
 
     m_configIni->beginGroup("remote");
     fps = m_configIni->value("fps", 15).toInt(); // 降低默认帧率从25到15
+    captureBackend = m_configIni->value("captureBackend", "auto").toString();
+    damageTracking = m_configIni->value("damageTracking", true).toBool();
+    idleKeepaliveMs = m_configIni->value("idleKeepaliveMs", 1000).toInt();
+    colorConvertVerifyInterval = m_configIni->value("colorConvertVerifyInterval", 300).toInt();
+    keyFrameMinIntervalMs = m_configIni->value("keyFrameMinIntervalMs", 300).toInt();
+    intraRefresh = m_configIni->value("intraRefresh", false).toBool();
+    intraRefreshPeriod = m_configIni->value("intraRefreshPeriod", 60).toInt();
+    encoderLatencyTargetMs = m_configIni->value("encoderLatencyTargetMs", 20).toInt();
+    videoEncoderBackend = m_configIni->value("videoEncoderBackend", "auto").toString();
+    sliceOutput = m_configIni->value("sliceOutput", false).toBool();
+    videoCodec = m_configIni->value("videoCodec", "h264").toString();
+    rateControl = m_configIni->value("rateControl", "cbr").toString();
+    rateControlQuality = m_configIni->value("rateControlQuality", 23).toInt();
+    vbvFrames = m_configIni->value("vbvFrames", 1).toInt();
+    roiEncoding = m_configIni->value("roiEncoding", true).toBool();
+    roiFocusQpOffset = m_configIni->value("roiFocusQpOffset", -4).toInt();
+    roiStaticQpOffset = m_configIni->value("roiStaticQpOffset", 8).toInt();
+    skipUnchangedFrames = m_configIni->value("skipUnchangedFrames", true).toBool();
+    refineAfterMs = m_configIni->value("refineAfterMs", 500).toInt();
+    refineFrames = m_configIni->value("refineFrames", 2).toInt();
+    refineQp = m_configIni->value("refineQp", 18).toInt();
+    longTermRefs = m_configIni->value("longTermRefs", 0).toInt();
+    scrollDetection = m_configIni->value("scrollDetection", true).toBool();
+    losslessTextTiles = m_configIni->value("losslessTextTiles", false).toBool();
+    textTileMaxColors = m_configIni->value("textTileMaxColors", 64).toInt();
+    textTileBudgetKbps = m_configIni->value("textTileBudgetKbps", 2000).toInt();
+    decoderThreading = m_configIni->value("decoderThreading", "slice").toString();
+    decoderThreads = m_configIni->value("decoderThreads", 0).toInt();
+    decoderLowDelay = m_configIni->value("decoderLowDelay", true).toBool();
+    decoderFast = m_configIni->value("decoderFast", true).toBool();
     m_configIni->endGroup();
 
     if (fps < 1 || fps > 60)
     {
         fps = 15;
     }
+    if (idleKeepaliveMs < 100)
+    {
+        idleKeepaliveMs = 1000;
+    }
+    if (colorConvertVerifyInterval < 0)
+    {
+        colorConvertVerifyInterval = 0;
+    }
+    if (keyFrameMinIntervalMs < 0)
+    {
+        keyFrameMinIntervalMs = 300;
+    }
+    if (intraRefreshPeriod < 2)
+    {
+        intraRefreshPeriod = 60;
+    }
+    if (encoderLatencyTargetMs <= 0)
+    {
+        encoderLatencyTargetMs = 20;
+    }
+    if (refineAfterMs < 0)
+    {
+        refineAfterMs = 500;
+    }
+    if (refineFrames < 0)
+    {
+        refineFrames = 0;
+    }
+    longTermRefs = qBound(0, longTermRefs, 15); // H264最多16个参考帧
+    textTileMaxColors = qBound(2, textTileMaxColors, 255);
+    if (textTileBudgetKbps <= 0)
+    {
+        textTileBudgetKbps = 2000;
+    }
+    decoderThreads = qBound(0, decoderThreads, 16);
     m_configIni->beginGroup("signal_server");
     wsUrl = m_configIni->value("wsUrl", "").toString();
     m_configIni->endGroup();
@@ -122,6 +187,36 @@ void ConfigUtilData::saveIni()
 
     m_configIni->beginGroup("remote");
     m_configIni->setValue("fps", fps);
+    m_configIni->setValue("captureBackend", captureBackend);
+    m_configIni->setValue("damageTracking", damageTracking);
+    m_configIni->setValue("idleKeepaliveMs", idleKeepaliveMs);
+    m_configIni->setValue("colorConvertVerifyInterval", colorConvertVerifyInterval);
+    m_configIni->setValue("keyFrameMinIntervalMs", keyFrameMinIntervalMs);
+    m_configIni->setValue("intraRefresh", intraRefresh);
+    m_configIni->setValue("intraRefreshPeriod", intraRefreshPeriod);
+    m_configIni->setValue("encoderLatencyTargetMs", encoderLatencyTargetMs);
+    m_configIni->setValue("videoEncoderBackend", videoEncoderBackend);
+    m_configIni->setValue("sliceOutput", sliceOutput);
+    m_configIni->setValue("videoCodec", videoCodec);
+    m_configIni->setValue("rateControl", rateControl);
+    m_configIni->setValue("rateControlQuality", rateControlQuality);
+    m_configIni->setValue("vbvFrames", vbvFrames);
+    m_configIni->setValue("roiEncoding", roiEncoding);
+    m_configIni->setValue("roiFocusQpOffset", roiFocusQpOffset);
+    m_configIni->setValue("roiStaticQpOffset", roiStaticQpOffset);
+    m_configIni->setValue("skipUnchangedFrames", skipUnchangedFrames);
+    m_configIni->setValue("refineAfterMs", refineAfterMs);
+    m_configIni->setValue("refineFrames", refineFrames);
+    m_configIni->setValue("refineQp", refineQp);
+    m_configIni->setValue("longTermRefs", longTermRefs);
+    m_configIni->setValue("scrollDetection", scrollDetection);
+    m_configIni->setValue("losslessTextTiles", losslessTextTiles);
+    m_configIni->setValue("textTileMaxColors", textTileMaxColors);
+    m_configIni->setValue("textTileBudgetKbps", textTileBudgetKbps);
+    m_configIni->setValue("decoderThreading", decoderThreading);
+    m_configIni->setValue("decoderThreads", decoderThreads);
+    m_configIni->setValue("decoderLowDelay", decoderLowDelay);
+    m_configIni->setValue("decoderFast", decoderFast);
     m_configIni->endGroup();
 
     m_configIni->beginGroup("signal_server");
@@ -25,6 +25,57 @@ public:
     QSettings *m_configIni;
     //帧率
     int fps;
+    //屏幕捕获后端 auto/xshm/qt
+    QString captureBackend;
+    //按屏幕损伤区域调度捕获（XDamage），以及空闲时的保活帧间隔
+    bool damageTracking;
+    int idleKeepaliveMs;
+    //SIMD颜色转换每隔多少帧与标量实现抽样比对一次，0为关闭
+    int colorConvertVerifyInterval;
+    //不再周期性插入IDR，只在控制端请求时插入；两次请求IDR之间的最小间隔（毫秒）
+    int keyFrameMinIntervalMs;
+    //周期帧内刷新：一列帧内宏块逐帧横扫画面代替IDR，避免关键帧码率尖峰
+    bool intraRefresh;
+    //一次完整刷新跨越的帧数
+    int intraRefreshPeriod;
+    //编码器自动选择的单帧编码耗时目标（毫秒，1080p测速结果）
+    int encoderLatencyTargetMs;
+    //视频编码后端 auto/ffmpeg/openh264/x264
+    QString videoEncoderBackend;
+    //低延迟条带输出：每个条带编码完成立即打包发送（x264后端）
+    bool sliceOutput;
+    //控制端偏好的视频编码格式 h264/h265/vp9/av1
+    QString videoCodec;
+    //码率控制方式 cbr/capped_crf/quality
+    QString rateControl;
+    //capped_crf/quality模式的CRF/CQ值（0-51，越小质量越高）
+    int rateControlQuality;
+    //VBV缓冲大小（帧数）
+    int vbvFrames;
+    //按64x64分块变化图做区域QP调整：变化/光标附近的块与未变化的块的QP偏移
+    bool roiEncoding;
+    int roiFocusQpOffset;
+    int roiStaticQpOffset;
+    //画面完全没有变化的帧不编码（仍按idleKeepaliveMs编码保活帧）
+    bool skipUnchangedFrames;
+    //画面静止refineAfterMs毫秒后，用refineFrames帧低QP（refineQp）精修之前变化过的区域，0帧为关闭；编码器不支持按区域调整QP时不生效
+    int refineAfterMs;
+    int refineFrames;
+    int refineQp;
+    //长期参考帧数（openh264后端），切换回最近显示过的窗口时可直接引用，0为关闭
+    int longTermRefs;
+    //检测变化区域的垂直滚动，作为运动搜索提示交给编码器（只有x264后端使用）
+    bool scrollDetection;
+    //文字类分块（颜色少、边缘多）另用数据通道发送无损调色板块，每帧不超过textTileBudgetKbps
+    bool losslessTextTiles;
+    int textTileMaxColors;
+    int textTileBudgetKbps;
+    //控制端解码线程策略 slice/frame/auto/none，线程数0为自动
+    QString decoderThreading;
+    int decoderThreads;
+    //解码器低延迟标志与允许不完全符合规范的加速
+    bool decoderLowDelay;
+    bool decoderFast;
     //是否显示UI
     bool showUI;
     //本机sn码
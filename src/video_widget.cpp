@@ -0,0 +1,168 @@
+#include "video_widget.h"
+#include "logger_manager.h"
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRegion>
+#include <QResizeEvent>
+
+VideoWidget::VideoWidget(QWidget *parent)
+    : QWidget(parent), m_scaled(false), m_framePending(false), m_consecutiveBadFrames(0),
+      m_qualityWarningLogged(false)
+{
+    // 每次都画满整个控件，不需要Qt先擦除背景
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_NoSystemBackground);
+}
+
+void VideoWidget::setFrame(const QImage &frame)
+{
+    const bool sizeChanged = frame.size() != m_frame.size();
+    const bool wasPoor = isQualityPoor();
+    checkQuality(frame);
+    m_frame = frame;
+    m_framePending = true;
+    if (sizeChanged)
+    {
+        updateTransform();
+    }
+    if (wasPoor != isQualityPoor())
+    {
+        update();
+        return;
+    }
+    // 只重绘画面区域，边距和提示边框不变
+    update(m_targetRect.toAlignedRect());
+}
+
+void VideoWidget::setPlaceholderText(const QString &text)
+{
+    m_placeholderText = text;
+    if (m_frame.isNull())
+    {
+        update();
+    }
+}
+
+QPointF VideoWidget::normalizedPos(const QPointF &pos) const
+{
+    if (m_frame.isNull() || !m_targetRect.contains(pos))
+    {
+        // 点击在边框区域，不处理
+        return QPointF();
+    }
+    const QPointF framePos = m_inverted.map(pos);
+    return QPointF(framePos.x() / m_frame.width(), framePos.y() / m_frame.height());
+}
+
+void VideoWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    updateTransform();
+}
+
+void VideoWidget::updateTransform()
+{
+    if (m_frame.isNull())
+    {
+        m_transform.reset();
+        m_inverted.reset();
+        m_targetRect = QRectF(rect());
+        m_scaled = false;
+        return;
+    }
+
+    // 保持宽高比缩放到控件内并居中
+    const QSize scaledSize = m_frame.size().scaled(size(), Qt::KeepAspectRatio);
+    const qreal scale = static_cast<qreal>(scaledSize.width()) / m_frame.width();
+    const QPointF offset((width() - scaledSize.width()) / 2.0, (height() - scaledSize.height()) / 2.0);
+    m_transform = QTransform::fromTranslate(offset.x(), offset.y()).scale(scale, scale);
+    m_inverted = m_transform.inverted();
+    m_targetRect = QRectF(offset, QSizeF(scaledSize));
+    m_scaled = scaledSize != m_frame.size();
+}
+
+void VideoWidget::checkQuality(const QImage &frame)
+{
+    if (frame.format() != QImage::Format_RGB32)
+    {
+        return;
+    }
+
+    // 采样检查第一行前250个像素，忽略恒为0xff的alpha
+    const QRgb *pixels = reinterpret_cast<const QRgb *>(frame.constScanLine(0));
+    const int checkPixels = qMin(250, frame.width());
+    int nonZeroPixels = 0;
+    for (int i = 0; i < checkPixels; i++)
+    {
+        if ((pixels[i] & 0x00FFFFFF) != 0)
+        {
+            nonZeroPixels++;
+        }
+    }
+
+    // 少于5%的非零像素，可能是解码问题
+    if (nonZeroPixels >= checkPixels / 20)
+    {
+        m_consecutiveBadFrames = 0;
+        return;
+    }
+    m_consecutiveBadFrames++;
+    LOG_WARN("Detected potentially corrupted frame: {}/{} non-zero pixels, consecutive bad frames: {}",
+             nonZeroPixels, checkPixels, m_consecutiveBadFrames);
+    if (isQualityPoor() && !m_qualityWarningLogged)
+    {
+        LOG_ERROR("Video quality appears poor, may need to check network connection");
+        m_qualityWarningLogged = true;
+    }
+}
+
+void VideoWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    if (m_frame.isNull())
+    {
+        painter.fillRect(rect(), Qt::black);
+        QFont font = painter.font();
+        font.setPixelSize(16);
+        painter.setFont(font);
+        painter.setPen(Qt::white);
+        painter.drawText(rect(), Qt::AlignCenter, m_placeholderText);
+        return;
+    }
+
+    // 画面以外的边距
+    const QRect target = m_targetRect.toAlignedRect();
+    const QRegion margins = event->region() - target;
+    for (const QRect &margin : margins)
+    {
+        painter.fillRect(margin, Qt::black);
+    }
+
+    if (m_scaled)
+    {
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.setTransform(m_transform);
+        painter.drawImage(QPointF(0, 0), m_frame);
+        painter.resetTransform();
+    }
+    else
+    {
+        // 原始尺寸只复制需要重绘的部分
+        const QRect dirty = event->rect() & target;
+        painter.drawImage(dirty.topLeft(), m_frame, dirty.translated(-target.topLeft()));
+    }
+
+    if (isQualityPoor())
+    {
+        // 连接质量警告，不阻止显示
+        painter.setPen(QPen(Qt::red, 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(QRectF(rect()).adjusted(1, 1, -1, -1));
+    }
+
+    if (m_framePending && event->rect().intersects(target))
+    {
+        m_framePending = false;
+        emit framePainted();
+    }
+}
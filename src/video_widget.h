@@ -0,0 +1,57 @@
+#ifndef VIDEO_WIDGET_H
+#define VIDEO_WIDGET_H
+
+#include <QImage>
+#include <QPointF>
+#include <QString>
+#include <QTransform>
+#include <QWidget>
+
+// 控制端的视频显示控件：paintEvent中直接绘制最新一帧，不经过QPixmap转换和样式表；
+// 帧到控件的缩放按帧尺寸和控件尺寸缓存，只在收到新帧时重绘
+class VideoWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit VideoWidget(QWidget *parent = nullptr);
+
+    // 显示新的一帧（浅拷贝，解码器图像环会跳过仍被持有的图像）
+    void setFrame(const QImage &frame);
+    const QImage &frame() const { return m_frame; }
+    bool hasFrame() const { return !m_frame.isNull(); }
+
+    // 还没有画面时显示的文字
+    void setPlaceholderText(const QString &text);
+
+    // 控件坐标转换为远端画面的归一化坐标（0-1），不在画面上时返回(0, 0)
+    QPointF normalizedPos(const QPointF &pos) const;
+
+    // 连续多帧疑似损坏（第一行几乎全黑）时画红色边框提示
+    bool isQualityPoor() const { return m_consecutiveBadFrames > kMaxBadFrames; }
+
+signals:
+    // setFrame之后第一次在paintEvent中画出这一帧，用于统计显示间隔
+    void framePainted();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    static constexpr int kMaxBadFrames = 5;
+
+    void updateTransform();
+    void checkQuality(const QImage &frame);
+
+    QImage m_frame;
+    QString m_placeholderText;
+    QTransform m_transform; // 帧坐标到控件坐标，保持宽高比居中
+    QTransform m_inverted;
+    QRectF m_targetRect;    // 画面在控件中的区域
+    bool m_scaled;          // 控件与帧尺寸不同，需要缩放绘制
+    bool m_framePending;    // 新帧还没有绘制过
+    int m_consecutiveBadFrames;
+    bool m_qualityWarningLogged;
+};
+
+#endif // VIDEO_WIDGET_H
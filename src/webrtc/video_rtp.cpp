@@ -0,0 +1,677 @@
+#include "video_rtp.h"
+#include "logger_manager.h"
+#include <algorithm>
+
+namespace
+{
+    const rtc::byte kStartCode[] = {rtc::byte{0}, rtc::byte{0}, rtc::byte{0}, rtc::byte{1}};
+
+    inline uint8_t byteAt(const rtc::binary &data, size_t index)
+    {
+        return std::to_integer<uint8_t>(data[index]);
+    }
+
+    void append(rtc::binary &out, const rtc::byte *begin, const rtc::byte *end)
+    {
+        out.insert(out.end(), begin, end);
+    }
+
+    // VP9未压缩帧头：是否为帧间预测帧（非关键帧）
+    bool vp9IsInterFrame(const rtc::binary &frame)
+    {
+        if (frame.empty())
+        {
+            return false;
+        }
+        uint8_t header = byteAt(frame, 0);
+        // frame_marker(2) profile_low_bit(1) profile_high_bit(1) [reserved_zero(1)] show_existing_frame(1) frame_type(1)
+        int bit = 4;
+        int profile = ((header >> 5) & 1) | (((header >> 4) & 1) << 1);
+        if (profile == 3)
+        {
+            bit++;
+        }
+        bool showExistingFrame = (header >> (7 - bit)) & 1;
+        if (showExistingFrame)
+        {
+            return true;
+        }
+        bit++;
+        return ((header >> (7 - bit)) & 1) != 0;
+    }
+
+    // 读取leb128，失败返回false
+    bool readLeb128(const rtc::binary &data, size_t &offset, size_t &value)
+    {
+        value = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            if (offset >= data.size())
+            {
+                return false;
+            }
+            uint8_t b = byteAt(data, offset++);
+            value |= static_cast<size_t>(b & 0x7f) << (i * 7);
+            if (!(b & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void writeLeb128(rtc::binary &out, size_t value)
+    {
+        do
+        {
+            uint8_t b = value & 0x7f;
+            value >>= 7;
+            if (value)
+            {
+                b |= 0x80;
+            }
+            out.push_back(rtc::byte{b});
+        } while (value);
+    }
+
+    // SEI的RBSP（[begin, end)，不含NAL头）中是否有recovery_point消息（payloadType 6）
+    bool seiHasRecoveryPoint(const rtc::binary &nal, size_t begin, size_t end)
+    {
+        // 去掉防竞争字节
+        std::vector<uint8_t> rbsp;
+        rbsp.reserve(end - begin);
+        int zeros = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint8_t b = byteAt(nal, i);
+            if (zeros >= 2 && b == 3)
+            {
+                zeros = 0;
+                continue;
+            }
+            zeros = b == 0 ? zeros + 1 : 0;
+            rbsp.push_back(b);
+        }
+
+        size_t pos = 0;
+        while (pos < rbsp.size() && rbsp[pos] != 0x80) // rbsp_trailing_bits
+        {
+            size_t values[2] = {0, 0}; // payloadType, payloadSize
+            for (size_t &value : values)
+            {
+                while (pos < rbsp.size() && rbsp[pos] == 0xff)
+                {
+                    value += 255;
+                    pos++;
+                }
+                if (pos >= rbsp.size())
+                {
+                    return false;
+                }
+                value += rbsp[pos++];
+            }
+            if (values[0] == 6)
+            {
+                return true;
+            }
+            pos += values[1];
+        }
+        return false;
+    }
+}
+
+Vp9RtpPacketizer::Vp9RtpPacketizer(std::shared_ptr<rtc::RtpPacketizationConfig> rtpConfig, size_t maxFragmentSize)
+    : rtc::RtpPacketizer(std::move(rtpConfig)), m_maxFragmentSize(maxFragmentSize)
+{
+}
+
+std::vector<rtc::binary> Vp9RtpPacketizer::fragment(rtc::binary data)
+{
+    std::vector<rtc::binary> fragments;
+    if (data.empty() || m_maxFragmentSize <= 1)
+    {
+        return fragments;
+    }
+
+    // 描述符：I P L F B E V Z，只使用P/B/E
+    const uint8_t interPicture = vp9IsInterFrame(data) ? 0x40 : 0x00;
+    const size_t chunkSize = m_maxFragmentSize - 1;
+    for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+    {
+        size_t size = std::min(chunkSize, data.size() - offset);
+        uint8_t descriptor = interPicture;
+        if (offset == 0)
+        {
+            descriptor |= 0x08; // B：帧的第一个包
+        }
+        if (offset + size == data.size())
+        {
+            descriptor |= 0x04; // E：帧的最后一个包
+        }
+
+        rtc::binary fragment;
+        fragment.reserve(size + 1);
+        fragment.push_back(rtc::byte{descriptor});
+        append(fragment, data.data() + offset, data.data() + offset + size);
+        fragments.push_back(std::move(fragment));
+    }
+    return fragments;
+}
+
+void RtpMarkerGate::outgoing(rtc::message_vector &messages, const rtc::message_callback &send)
+{
+    if (m_frameEnd)
+    {
+        return;
+    }
+    for (const auto &message : messages)
+    {
+        if (message->size() >= sizeof(rtc::RtpHeader))
+        {
+            reinterpret_cast<rtc::RtpHeader *>(message->data())->setMarker(false);
+        }
+    }
+}
+
+void FrameRtpDepacketizer::incoming(rtc::message_vector &messages, const rtc::message_callback &send)
+{
+    rtc::message_vector result;
+    for (auto &message : messages)
+    {
+        if (message->type == rtc::Message::Control)
+        {
+            result.push_back(std::move(message)); // RTCP原样向后传递
+            continue;
+        }
+        if (message->size() < sizeof(rtc::RtpHeader))
+        {
+            continue;
+        }
+
+        auto header = reinterpret_cast<const rtc::RtpHeader *>(message->data());
+        if (!m_packets.empty() && header->timestamp() != m_timestamp)
+        {
+            // 上一帧的最后一个包（marker）没有到达
+            LOG_DEBUG("Dropping incomplete video frame, timestamp {}", m_timestamp);
+            m_packets.clear();
+        }
+        m_timestamp = header->timestamp();
+        bool marker = header->marker();
+        m_packets.push_back(std::move(message));
+
+        if (marker)
+        {
+            if (auto frame = assembleFrame())
+            {
+                result.push_back(std::move(frame));
+            }
+            m_packets.clear();
+        }
+    }
+    messages.swap(result);
+}
+
+rtc::message_ptr FrameRtpDepacketizer::assembleFrame()
+{
+    auto seqOf = [](const rtc::message_ptr &packet)
+    {
+        return reinterpret_cast<const rtc::RtpHeader *>(packet->data())->seqNumber();
+    };
+    // 序号按与第一个包的有符号差值排序，兼容16位回绕
+    const uint16_t base = seqOf(m_packets.front());
+    std::stable_sort(m_packets.begin(), m_packets.end(), [&](const rtc::message_ptr &a, const rtc::message_ptr &b)
+                     { return static_cast<int16_t>(seqOf(a) - base) < static_cast<int16_t>(seqOf(b) - base); });
+
+    std::vector<rtc::binary> payloads;
+    payloads.reserve(m_packets.size());
+    uint8_t payloadType = 0;
+    for (size_t i = 0; i < m_packets.size(); ++i)
+    {
+        if (i > 0)
+        {
+            uint16_t step = seqOf(m_packets[i]) - seqOf(m_packets[i - 1]);
+            if (step == 0)
+            {
+                continue; // 重传造成的重复包
+            }
+            if (step != 1)
+            {
+                LOG_DEBUG("Dropping video frame with missing packets, timestamp {}", m_timestamp);
+                return nullptr;
+            }
+        }
+
+        const rtc::Message &packet = *m_packets[i];
+        auto header = reinterpret_cast<const rtc::RtpHeader *>(packet.data());
+        payloadType = header->payloadType();
+        size_t begin = header->getSize() + header->getExtensionHeaderSize();
+        size_t end = packet.size();
+        if (header->padding() && end > begin)
+        {
+            end -= std::min<size_t>(std::to_integer<uint8_t>(packet.back()), end - begin);
+        }
+        if (begin >= end)
+        {
+            continue;
+        }
+        payloads.emplace_back(packet.begin() + begin, packet.begin() + end);
+    }
+
+    rtc::binary frame = depacketize(payloads);
+    if (frame.empty())
+    {
+        return nullptr;
+    }
+    auto frameInfo = std::make_shared<rtc::FrameInfo>(m_timestamp);
+    frameInfo->payloadType = payloadType;
+    return rtc::make_message(frame.begin(), frame.end(), rtc::Message::Binary, 0, nullptr, frameInfo);
+}
+
+rtc::binary H265FrameDepacketizer::depacketize(const std::vector<rtc::binary> &payloads)
+{
+    rtc::binary out;
+    bool inFragment = false;
+    for (const rtc::binary &payload : payloads)
+    {
+        if (payload.size() < 2)
+        {
+            continue;
+        }
+        const uint8_t nalType = (byteAt(payload, 0) >> 1) & 0x3f;
+        if (nalType == 48)
+        {
+            // 聚合包：2字节NAL头之后是若干 [16位长度][NAL单元]
+            size_t offset = 2;
+            while (offset + 2 <= payload.size())
+            {
+                size_t size = (byteAt(payload, offset) << 8) | byteAt(payload, offset + 1);
+                offset += 2;
+                if (size == 0 || offset + size > payload.size())
+                {
+                    return {};
+                }
+                append(out, std::begin(kStartCode), std::end(kStartCode));
+                append(out, payload.data() + offset, payload.data() + offset + size);
+                offset += size;
+            }
+        }
+        else if (nalType == 49)
+        {
+            // 分片：NAL头 + FU头(S|E|FuType)，首个分片时还原原始NAL头
+            if (payload.size() < 3)
+            {
+                return {};
+            }
+            const uint8_t fuHeader = byteAt(payload, 2);
+            if (fuHeader & 0x80)
+            {
+                const uint8_t fuType = fuHeader & 0x3f;
+                append(out, std::begin(kStartCode), std::end(kStartCode));
+                out.push_back(rtc::byte((byteAt(payload, 0) & 0x81) | (fuType << 1)));
+                out.push_back(payload[1]);
+                inFragment = true;
+            }
+            else if (!inFragment)
+            {
+                return {}; // 丢了首个分片
+            }
+            append(out, payload.data() + 3, payload.data() + payload.size());
+            if (fuHeader & 0x40)
+            {
+                inFragment = false;
+            }
+        }
+        else if (nalType == 50)
+        {
+            continue; // PACI，不使用
+        }
+        else
+        {
+            append(out, std::begin(kStartCode), std::end(kStartCode));
+            append(out, payload.data(), payload.data() + payload.size());
+        }
+    }
+    return out;
+}
+
+rtc::binary Vp9FrameDepacketizer::depacketize(const std::vector<rtc::binary> &payloads)
+{
+    rtc::binary out;
+    for (const rtc::binary &payload : payloads)
+    {
+        if (payload.empty())
+        {
+            continue;
+        }
+        // I P L F B E V Z
+        const uint8_t descriptor = byteAt(payload, 0);
+        const bool hasPictureId = descriptor & 0x80;
+        const bool interPicture = descriptor & 0x40;
+        const bool hasLayerIndices = descriptor & 0x20;
+        const bool flexibleMode = descriptor & 0x10;
+        const bool hasScalability = descriptor & 0x02;
+        size_t offset = 1;
+
+        if (hasPictureId)
+        {
+            if (offset >= payload.size())
+            {
+                return {};
+            }
+            offset += (byteAt(payload, offset) & 0x80) ? 2 : 1;
+        }
+        if (hasLayerIndices)
+        {
+            offset += flexibleMode ? 1 : 2; // 非灵活模式多一个TL0PICIDX
+        }
+        if (flexibleMode && interPicture)
+        {
+            // P_DIFF列表，N位表示后面还有
+            for (int i = 0; i < 3; ++i)
+            {
+                if (offset >= payload.size())
+                {
+                    return {};
+                }
+                if (!(byteAt(payload, offset++) & 0x01))
+                {
+                    break;
+                }
+            }
+        }
+        if (hasScalability)
+        {
+            if (offset >= payload.size())
+            {
+                return {};
+            }
+            const uint8_t ss = byteAt(payload, offset++);
+            const int spatialLayers = (ss >> 5) + 1;
+            if (ss & 0x10)
+            {
+                offset += spatialLayers * 4; // 每层的宽高
+            }
+            if (ss & 0x08)
+            {
+                if (offset >= payload.size())
+                {
+                    return {};
+                }
+                const int pictureGroups = byteAt(payload, offset++);
+                for (int i = 0; i < pictureGroups; ++i)
+                {
+                    if (offset >= payload.size())
+                    {
+                        return {};
+                    }
+                    const int refs = (byteAt(payload, offset++) >> 2) & 0x03;
+                    offset += refs;
+                }
+            }
+        }
+        if (offset > payload.size())
+        {
+            return {};
+        }
+        append(out, payload.data() + offset, payload.data() + payload.size());
+    }
+    return out;
+}
+
+rtc::binary Av1FrameDepacketizer::depacketize(const std::vector<rtc::binary> &payloads)
+{
+    // 先还原出完整的OBU（可能跨包），再逐个补上长度字段
+    std::vector<rtc::binary> obus;
+    bool lastIncomplete = false;
+    for (const rtc::binary &payload : payloads)
+    {
+        if (payload.empty())
+        {
+            continue;
+        }
+        // 聚合头：Z Y W(2) N 保留(3)
+        const uint8_t aggregation = byteAt(payload, 0);
+        const bool continuesPrevious = aggregation & 0x80;
+        const bool continuesNext = aggregation & 0x40;
+        const int elementCount = (aggregation >> 4) & 0x03;
+        size_t offset = 1;
+
+        for (int element = 0; offset < payload.size(); ++element)
+        {
+            size_t size = payload.size() - offset;
+            if (elementCount == 0 || element < elementCount - 1)
+            {
+                if (!readLeb128(payload, offset, size) || offset + size > payload.size())
+                {
+                    return {};
+                }
+            }
+            if (element == 0 && continuesPrevious)
+            {
+                if (!lastIncomplete || obus.empty())
+                {
+                    return {}; // 丢了OBU的前半部分
+                }
+                append(obus.back(), payload.data() + offset, payload.data() + offset + size);
+            }
+            else
+            {
+                obus.emplace_back(payload.begin() + offset, payload.begin() + offset + size);
+            }
+            offset += size;
+            if (elementCount != 0 && element == elementCount - 1)
+            {
+                break;
+            }
+        }
+        lastIncomplete = continuesNext;
+    }
+
+    rtc::binary out{rtc::byte{0x12}, rtc::byte{0x00}}; // 时间分隔符
+    for (const rtc::binary &obu : obus)
+    {
+        if (obu.empty())
+        {
+            continue;
+        }
+        const uint8_t header = byteAt(obu, 0);
+        const int obuType = (header >> 3) & 0x0f;
+        if (obuType == 2 || obuType == 8)
+        {
+            continue; // 时间分隔符已经补上，tile list不应出现在RTP中
+        }
+        const bool hasExtension = header & 0x04;
+        const bool hasSizeField = header & 0x02;
+        if (hasSizeField)
+        {
+            append(out, obu.data(), obu.data() + obu.size());
+            continue;
+        }
+        const size_t headerSize = hasExtension ? 2 : 1;
+        if (obu.size() < headerSize)
+        {
+            return {};
+        }
+        out.push_back(rtc::byte(header | 0x02));
+        if (hasExtension)
+        {
+            out.push_back(obu[1]);
+        }
+        writeLeb128(out, obu.size() - headerSize);
+        append(out, obu.data() + headerSize, obu.data() + obu.size());
+    }
+    return out;
+}
+
+namespace VideoRtp
+{
+    void addCodec(rtc::Description::Video &description, VideoCodec codec)
+    {
+        const int payloadType = VideoCodecs::payloadType(codec);
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            description.addH264Codec(payloadType);
+            break;
+        case VideoCodec::H265:
+            description.addH265Codec(payloadType);
+            break;
+        case VideoCodec::VP9:
+            description.addVP9Codec(payloadType);
+            break;
+        case VideoCodec::AV1:
+            description.addAV1Codec(payloadType);
+            break;
+        }
+    }
+
+    std::shared_ptr<rtc::RtpPacketizer> createPacketizer(VideoCodec codec,
+                                                         std::shared_ptr<rtc::RtpPacketizationConfig> rtpConfig)
+    {
+        // H264/H265为FFmpeg输出的Annex-B格式（带0x00000001起始码）
+        switch (codec)
+        {
+        case VideoCodec::H265:
+            return std::make_shared<rtc::H265RtpPacketizer>(rtc::NalUnit::Separator::StartSequence, rtpConfig);
+        case VideoCodec::VP9:
+            return std::make_shared<Vp9RtpPacketizer>(rtpConfig);
+        case VideoCodec::AV1:
+            return std::make_shared<rtc::AV1RtpPacketizer>(rtc::AV1RtpPacketizer::Packetization::TemporalUnit,
+                                                           rtpConfig);
+        case VideoCodec::H264:
+        default:
+            return std::make_shared<rtc::H264RtpPacketizer>(rtc::NalUnit::Separator::StartSequence, rtpConfig);
+        }
+    }
+
+    std::shared_ptr<rtc::MediaHandler> createDepacketizer(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H265:
+            return std::make_shared<H265FrameDepacketizer>();
+        case VideoCodec::VP9:
+            return std::make_shared<Vp9FrameDepacketizer>();
+        case VideoCodec::AV1:
+            return std::make_shared<Av1FrameDepacketizer>();
+        case VideoCodec::H264:
+        default:
+            return std::make_shared<rtc::H264RtpDepacketizer>();
+        }
+    }
+
+    bool offeredCodec(const rtc::Description &description, VideoCodec *codec)
+    {
+        for (int i = 0; i < description.mediaCount(); ++i)
+        {
+            auto entry = description.media(i);
+            auto media = std::get_if<const rtc::Description::Media *>(&entry);
+            if (!media || !*media || (*media)->type() != "video")
+            {
+                continue;
+            }
+            for (int payloadType : (*media)->payloadTypes())
+            {
+                auto rtpMap = (*media)->rtpMap(payloadType);
+                if (rtpMap && VideoCodecs::fromName(QString::fromStdString(rtpMap->format), codec))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool isKeyFrame(VideoCodec codec, const rtc::binary &frame)
+    {
+        switch (codec)
+        {
+        case VideoCodec::VP9:
+            return !frame.empty() && !vp9IsInterFrame(frame);
+        case VideoCodec::AV1:
+        {
+            // 每个OBU都带长度字段（见Av1FrameDepacketizer），找到帧头看frame_type
+            size_t offset = 0;
+            while (offset < frame.size())
+            {
+                const uint8_t header = byteAt(frame, offset++);
+                const int obuType = (header >> 3) & 0x0f;
+                if (header & 0x04)
+                {
+                    offset++; // 扩展头
+                }
+                size_t size = 0;
+                if (!(header & 0x02) || !readLeb128(frame, offset, size) || offset + size > frame.size())
+                {
+                    return false;
+                }
+                if ((obuType == 3 || obuType == 6) && size > 0)
+                {
+                    // show_existing_frame(1) frame_type(2)，KEY_FRAME为0
+                    const uint8_t first = byteAt(frame, offset);
+                    return !(first & 0x80) && ((first >> 5) & 0x03) == 0;
+                }
+                offset += size;
+            }
+            return false;
+        }
+        case VideoCodec::H264:
+        case VideoCodec::H265:
+        default:
+            // Annex-B：逐个起始码后的NAL类型
+            for (size_t i = 2; i + 1 < frame.size(); ++i)
+            {
+                if (byteAt(frame, i) != 1 || byteAt(frame, i - 1) != 0 || byteAt(frame, i - 2) != 0)
+                {
+                    continue;
+                }
+                const uint8_t nal = byteAt(frame, i + 1);
+                if (codec == VideoCodec::H265)
+                {
+                    const int type = (nal >> 1) & 0x3f;
+                    if (type >= 16 && type <= 21)
+                    {
+                        return true;
+                    }
+                }
+                else if ((nal & 0x1f) == 5)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    bool isRecoveryPoint(VideoCodec codec, const rtc::binary &frame)
+    {
+        if (codec != VideoCodec::H264 && codec != VideoCodec::H265)
+        {
+            return false;
+        }
+        const size_t headerSize = codec == VideoCodec::H265 ? 2 : 1;
+        // 找出每个SEI NAL的范围，到下一个起始码为止
+        size_t seiBegin = 0;
+        bool inSei = false;
+        for (size_t i = 2; i < frame.size(); ++i)
+        {
+            if (byteAt(frame, i) != 1 || byteAt(frame, i - 1) != 0 || byteAt(frame, i - 2) != 0)
+            {
+                continue;
+            }
+            if (inSei && seiHasRecoveryPoint(frame, seiBegin + headerSize, i - 2))
+            {
+                return true;
+            }
+            inSei = false;
+            if (i + headerSize < frame.size())
+            {
+                const uint8_t nal = byteAt(frame, i + 1);
+                // H264 SEI为6，H265前缀SEI为39
+                inSei = codec == VideoCodec::H265 ? ((nal >> 1) & 0x3f) == 39 : (nal & 0x1f) == 6;
+                seiBegin = i + 1;
+            }
+        }
+        return inSei && seiHasRecoveryPoint(frame, seiBegin + headerSize, frame.size());
+    }
+}
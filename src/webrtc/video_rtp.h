@@ -0,0 +1,99 @@
+#ifndef VIDEO_RTP_H
+#define VIDEO_RTP_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <rtc/rtc.hpp>
+#include "video_codec.h"
+
+/**
+ * 各视频格式的RTP打包/解包
+ * H264/H265/AV1的打包和H264的解包直接使用libdatachannel，其余由这里补齐
+ */
+
+// VP9打包（RFC 9628）：每个包带1字节负载描述符，不携带图像ID和可伸缩结构
+class Vp9RtpPacketizer : public rtc::RtpPacketizer
+{
+public:
+    static constexpr uint32_t ClockRate = 90 * 1000;
+
+    explicit Vp9RtpPacketizer(std::shared_ptr<rtc::RtpPacketizationConfig> rtpConfig,
+                              size_t maxFragmentSize = 1200);
+
+protected:
+    std::vector<rtc::binary> fragment(rtc::binary data) override;
+
+private:
+    size_t m_maxFragmentSize;
+};
+
+// 条带输出时一帧分多次sendFrame：接在打包器之后，去掉非最后一段的RTP marker，接收端仍按marker收齐整帧
+// sendFrame在调用线程内同步走完处理链，发送前设置本段是否为帧尾即可
+class RtpMarkerGate : public rtc::MediaHandler
+{
+public:
+    void setFrameEnd(bool frameEnd) { m_frameEnd = frameEnd; }
+    void outgoing(rtc::message_vector &messages, const rtc::message_callback &send) override;
+
+private:
+    std::atomic<bool> m_frameEnd{true};
+};
+
+// 按RTP时间戳把一帧的包收齐（以marker结束）、按序号排好后交给子类拼成解码器输入
+// 帧内缺包时整帧丢弃，由解码器发现参考帧缺失后请求关键帧
+class FrameRtpDepacketizer : public rtc::MediaHandler
+{
+public:
+    void incoming(rtc::message_vector &messages, const rtc::message_callback &send) override;
+
+protected:
+    // payloads为去掉RTP头和填充后的负载，返回空表示这一帧无法解析
+    virtual rtc::binary depacketize(const std::vector<rtc::binary> &payloads) = 0;
+
+private:
+    rtc::message_ptr assembleFrame();
+
+    std::vector<rtc::message_ptr> m_packets; // 当前帧已收到的包
+    uint32_t m_timestamp = 0;
+};
+
+// H265解包（RFC 7798）：单NAL、聚合包(AP)和分片(FU)，输出带起始码的Annex-B
+class H265FrameDepacketizer : public FrameRtpDepacketizer
+{
+protected:
+    rtc::binary depacketize(const std::vector<rtc::binary> &payloads) override;
+};
+
+// VP9解包（RFC 9628）：去掉负载描述符后拼接
+class Vp9FrameDepacketizer : public FrameRtpDepacketizer
+{
+protected:
+    rtc::binary depacketize(const std::vector<rtc::binary> &payloads) override;
+};
+
+// AV1解包（AV1 RTP规范）：还原为带时间分隔符、每个OBU都带长度字段的低开销码流
+class Av1FrameDepacketizer : public FrameRtpDepacketizer
+{
+protected:
+    rtc::binary depacketize(const std::vector<rtc::binary> &payloads) override;
+};
+
+namespace VideoRtp
+{
+    // 把编码格式及其payload类型加入视频媒体描述
+    void addCodec(rtc::Description::Video &description, VideoCodec codec);
+    // 发送端打包器（处理链的第一个环节）
+    std::shared_ptr<rtc::RtpPacketizer> createPacketizer(VideoCodec codec,
+                                                         std::shared_ptr<rtc::RtpPacketizationConfig> rtpConfig);
+    // 接收端解包器
+    std::shared_ptr<rtc::MediaHandler> createDepacketizer(VideoCodec codec);
+    // 发送端在Offer中选定的视频格式（视频媒体的第一个payload类型），无法识别时返回false
+    bool offeredCodec(const rtc::Description &description, VideoCodec *codec);
+    // 解包后的一帧是否可以不依赖之前的帧解码（H264 IDR、H265 IRAP、VP9/AV1关键帧）
+    bool isKeyFrame(VideoCodec codec, const rtc::binary &frame);
+    // H264/H265帧是否带恢复点SEI（帧内刷新的起点），从这里开始解码经过一轮刷新后画面完整
+    bool isRecoveryPoint(VideoCodec codec, const rtc::binary &frame);
+}
+
+#endif // VIDEO_RTP_H
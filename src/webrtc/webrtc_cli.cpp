@@ -5,6 +5,8 @@
 #include "util/file_packet_util.h"
 #include "logger_manager.h"
 #include "media_capture.h"
+#include "video_rtp.h"
+#include "frame_ring.h"
 #include <QStorageInfo>
 #include <QDir>
 #include <QUuid>
@@ -23,7 +25,8 @@
  * -> on ice candidate -> add ice candidate
  */
 WebRtcCli::WebRtcCli(const QString &remoteId, int fps, bool isOnlyFile,
-                     int controlMaxWidth, int controlMaxHeight, QObject *parent)
+                     int controlMaxWidth, int controlMaxHeight, const QStringList &controlVideoCodecs,
+                     const QStringList &controlTextTiles, QObject *parent)
     : QObject(parent),
       m_remoteId(remoteId),
       m_isOnlyFile(isOnlyFile), // 默认不是仅文件传输
@@ -32,8 +35,31 @@ WebRtcCli::WebRtcCli(const QString &remoteId, int fps, bool isOnlyFile,
       m_channelsReady(false),
       m_destroying(false),
       m_fps(fps),
+      m_videoCodec(VideoCodec::H264),
+      m_textTileCompression(TextTileCompression::None),
       m_mediaCapture(nullptr)
 {
+    // 按控制端的偏好顺序选第一个本机能编码的格式，都不支持时用H264
+    if (!isOnlyFile && !controlVideoCodecs.isEmpty())
+    {
+        const QList<VideoCodec> encodable = VideoCodecs::encodable();
+        for (VideoCodec codec : VideoCodecs::fromNames(controlVideoCodecs))
+        {
+            if (encodable.contains(codec))
+            {
+                m_videoCodec = codec;
+                break;
+            }
+        }
+        LOG_INFO("Control side accepts {}, selected {}", controlVideoCodecs.join(","), VideoCodecs::name(m_videoCodec));
+    }
+    // 无损文字块需要两端都开启，旧版本控制端不带此字段
+    if (!isOnlyFile && ConfigUtil->losslessTextTiles && !controlTextTiles.isEmpty())
+    {
+        m_textTileCompression = TextTileCodec::negotiate(controlTextTiles);
+        LOG_INFO("Control side accepts text tiles with {}, selected {}", controlTextTiles.join(","),
+                 TextTileCodec::compressionName(m_textTileCompression));
+    }
 
     QScreen *screen = QGuiApplication::primaryScreen();
     QRect screenGeometry = screen ? screen->geometry() : QRect(0, 0, 1920, 1080);
@@ -86,7 +112,10 @@ void WebRtcCli::init()
     if (!m_isOnlyFile && !m_mediaCapture)
     {
         m_mediaCapture = new MediaCapture(); // 移除父对象参数
+        m_mediaCapture->setVideoCodec(m_videoCodec);
+        m_mediaCapture->setTextTileCompression(m_textTileCompression);
         connect(m_mediaCapture, &MediaCapture::videoFrameReady, this, &WebRtcCli::onVideoFrameReady);
+        connect(m_mediaCapture, &MediaCapture::textTilesReady, this, &WebRtcCli::onTextTilesReady);
         connect(m_mediaCapture, &MediaCapture::audioFrameReady, this, &WebRtcCli::onAudioFrameReady);
     }
 
@@ -184,7 +213,7 @@ void WebRtcCli::createTracksAndChannels()
             LOG_INFO("Creating video track");
             std::string video_name = Constant::TYPE_VIDEO.toStdString();
             rtc::Description::Video videoDesc(video_name); // 使用固定流名称匹配接收端
-            videoDesc.addH264Codec(96);                    // H264 payload type
+            VideoRtp::addCodec(videoDesc, m_videoCodec);   // 只提供协商好的格式
 
             // 设置SSRC和媒体流标识 - 关键配置
             uint32_t videoSSRC = 1;
@@ -194,19 +223,31 @@ void WebRtcCli::createTracksAndChannels()
             m_videoTrack = m_peerConnection->addTrack(videoDesc);
 
             // 为视频轨道设置RTP打包器链
-            auto rtpConfig = std::make_shared<rtc::RtpPacketizationConfig>(videoSSRC, video_name, 96, rtc::H264RtpPacketizer::ClockRate);
-            // 使用StartSequence分隔符，因为FFMPEG输出的是Annex-B格式（带有0x00000001起始码）
-            auto h264Packetizer = std::make_shared<rtc::H264RtpPacketizer>(rtc::NalUnit::Separator::StartSequence, rtpConfig);
+            // 所有视频格式的RTP时钟都是90kHz
+            auto rtpConfig = std::make_shared<rtc::RtpPacketizationConfig>(videoSSRC, video_name, VideoCodecs::payloadType(m_videoCodec),
+                                                                           rtc::H264RtpPacketizer::ClockRate);
+            auto packetizer = VideoRtp::createPacketizer(m_videoCodec, rtpConfig);
+
+            // 条带输出时由它控制RTP marker，整帧输出时不改动
+            m_videoMarkerGate = std::make_shared<RtpMarkerGate>();
+            packetizer->addToChain(m_videoMarkerGate);
 
             // 添加RTCP SR报告器
             auto srReporter = std::make_shared<rtc::RtcpSrReporter>(rtpConfig);
-            h264Packetizer->addToChain(srReporter);
+            packetizer->addToChain(srReporter);
 
             // 添加RTCP NACK响应器
             auto nackResponder = std::make_shared<rtc::RtcpNackResponder>();
-            h264Packetizer->addToChain(nackResponder);
+            packetizer->addToChain(nackResponder);
 
-            m_videoTrack->setMediaHandler(h264Packetizer);
+            // 收到PLI/FIR时让编码器插入IDR，编码器不再周期性产生关键帧
+            auto pliHandler = std::make_shared<rtc::PliHandler>([this]()
+                                                                {
+                LOG_INFO("Received PLI/FIR from controller");
+                QMetaObject::invokeMethod(this, [this]() { requestKeyFrame(); }, Qt::QueuedConnection); });
+            packetizer->addToChain(pliHandler);
+
+            m_videoTrack->setMediaHandler(packetizer);
 
             // 创建音频轨道
             LOG_INFO("Creating audio track");
@@ -223,6 +264,14 @@ void WebRtcCli::createTracksAndChannels()
             LOG_INFO("Creating input data channel");
             m_inputChannel = m_peerConnection->createDataChannel(Constant::TYPE_INPUT.toStdString());
             setupInputChannelCallbacks();
+
+            // 创建无损文字块通道（与控制端协商成功时）
+            if (m_textTileCompression != TextTileCompression::None)
+            {
+                LOG_INFO("Creating text tile data channel");
+                m_textTileChannel = m_peerConnection->createDataChannel(Constant::TYPE_TEXT_TILES.toStdString());
+                setupTextTileChannelCallbacks();
+            }
         }
         // 创建文件数据通道（用于二进制文件传输）
         LOG_INFO("Creating file data channel");
@@ -493,6 +542,33 @@ void WebRtcCli::setupInputChannelCallbacks()
                              { LOG_INFO("Input channel closed"); });
 }
 
+void WebRtcCli::setupTextTileChannelCallbacks()
+{
+    if (!m_textTileChannel)
+        return;
+
+    // 只有通道打开期间编码端才发送文字块并跳过已覆盖的块，打开后从头发送
+    m_textTileChannel->onOpen([this]()
+                              {
+        LOG_INFO("Text tile channel opened");
+        QMetaObject::invokeMethod(this, [this]() {
+            if (m_mediaCapture) {
+                m_mediaCapture->setTextTileChannelOpen(true);
+            } }, Qt::QueuedConnection); });
+
+    m_textTileChannel->onError([](std::string error)
+                               { LOG_ERROR("Text tile channel error: {}", error); });
+
+    // 控制端关闭时清除了全部无损块，这些区域要重新由视频流发送
+    m_textTileChannel->onClosed([this]()
+                                {
+        LOG_INFO("Text tile channel closed");
+        QMetaObject::invokeMethod(this, [this]() {
+            if (m_mediaCapture) {
+                m_mediaCapture->setTextTileChannelOpen(false);
+            } }, Qt::QueuedConnection); });
+}
+
 void WebRtcCli::destroy()
 {
     disconnect();
@@ -528,6 +604,12 @@ void WebRtcCli::destroy()
     {
         m_inputChannel.reset();
     }
+    if (m_textTileChannel)
+    {
+        // 关闭回调里会访问this
+        m_textTileChannel->resetCallbacks();
+        m_textTileChannel.reset();
+    }
 
     // 关闭PeerConnection
     if (m_peerConnection)
@@ -674,6 +756,23 @@ void WebRtcCli::parseInputMsg(const QJsonObject &object)
         // 处理键盘事件
         handleKeyboardEvent(object);
     }
+    else if (msgType == Constant::TYPE_VIDEO_CONFIG)
+    {
+        // 控制端请求调整视频参数
+        handleVideoConfig(object);
+    }
+    else if (msgType == Constant::TYPE_KEYFRAME_REQUEST)
+    {
+        // RTCP不可用时的关键帧请求
+        LOG_INFO("Keyframe requested via input channel");
+        QMetaObject::invokeMethod(this, [this]() { requestKeyFrame(); }, Qt::QueuedConnection);
+        QJsonObject response = JsonUtil::createObject()
+                                   .add(Constant::KEY_MSGTYPE, Constant::TYPE_KEYFRAME_RESPONSE)
+                                   .add(Constant::KEY_SENDER, ConfigUtil->local_id)
+                                   .add(Constant::KEY_RECEIVER, m_remoteId)
+                                   .build();
+        sendInputChannelMessage(response);
+    }
     else
     {
         LOG_WARNING("parseInputMsg: Unknown input message type: {}", msgType);
@@ -774,26 +873,52 @@ void WebRtcCli::stopMediaCapture()
         LOG_ERROR("Failed to stop media capture: {}", e.what());
     }
 }
-void WebRtcCli::onVideoFrameReady(const rtc::binary &frameData, quint64 timestamp_us)
+void WebRtcCli::onVideoFrameReady(const EncodedVideoFrame &frame)
 {
     if (!m_videoTrack || !m_connected)
         return;
 
-    // 验证H264数据有效性
-    if (frameData.empty())
+    // 验证视频数据有效性
+    if (frame.isEmpty())
     {
         LOG_WARN("Received empty video frame data");
         return;
     }
+    quint64 timestamp_us = frame.timestampUs();
     m_lastTimestamp = timestamp_us;
     try
     {
         // 发送视频帧 - 使用官方示例的方式
         if (m_videoTrack->isOpen())
         {
-            // 使用chrono duration发送帧
-            m_videoTrack->sendFrame(frameData, std::chrono::duration<double, std::micro>(timestamp_us));
-            LOG_TRACE("Sent video frame: {}, timestamp: {} us", Convert::formatFileSize(frameData.size()), timestamp_us);
+            rtc::FrameInfo frameInfo(std::chrono::duration<double, std::micro>(timestamp_us));
+            // 条带输出时同一帧的各段时间戳相同，只有最后一段带marker
+            if (m_videoMarkerGate)
+            {
+                m_videoMarkerGate->setFrameEnd(frame.isFrameEnd());
+            }
+            if (frame.packetCount() == 1)
+            {
+                // 常见情况：直接从编码器的AVPacket缓冲打包成RTP
+                m_videoTrack->sendFrame(reinterpret_cast<const rtc::byte *>(frame.packetData(0)),
+                                        static_cast<size_t>(frame.packetSize(0)), frameInfo);
+            }
+            else
+            {
+                // 同一帧的多个数据包必须作为一个访问单元发送（同一RTP时间戳，最后一个包带marker）
+                rtc::binary accessUnit(frame.size());
+                MediaBuffer::countCopy(accessUnit.size());
+                size_t offset = 0;
+                for (int i = 0; i < frame.packetCount(); ++i)
+                {
+                    memcpy(accessUnit.data() + offset, frame.packetData(i), frame.packetSize(i));
+                    offset += frame.packetSize(i);
+                }
+                m_videoTrack->sendFrame(std::move(accessUnit), frameInfo);
+            }
+            LOG_TRACE("Sent video frame: {}, packets: {}, timestamp: {} us", Convert::formatFileSize(frame.size()),
+                      frame.packetCount(), timestamp_us);
+            recordSendLatency(frame);
         }
     }
     catch (const std::exception &e)
@@ -801,7 +926,66 @@ void WebRtcCli::onVideoFrameReady(const rtc::binary &frameData, quint64 timestam
         LOG_ERROR("Failed to send video frame: {}", e.what());
     }
 }
-void WebRtcCli::onAudioFrameReady(const rtc::binary &frameData)
+void WebRtcCli::onTextTilesReady(const QByteArray &message)
+{
+    if (!m_textTileChannel || !m_textTileChannel->isOpen() || !m_connected)
+    {
+        // 消息发不出去，编码端不能再认为这些块已经被覆盖
+        if (m_mediaCapture)
+        {
+            m_mediaCapture->setTextTileChannelOpen(false);
+        }
+        return;
+    }
+
+    try
+    {
+        m_textTileChannel->send(reinterpret_cast<const rtc::byte *>(message.constData()),
+                                static_cast<size_t>(message.size()));
+        LOG_TRACE("Sent text tile message: {}", Convert::formatFileSize(message.size()));
+    }
+    catch (const std::exception &e)
+    {
+        // 丢了一条消息控制端的块就对不上了，从头发送
+        LOG_ERROR("Failed to send text tile message: {}", e.what());
+        if (m_mediaCapture)
+        {
+            m_mediaCapture->resetTextTiles();
+        }
+    }
+}
+void WebRtcCli::recordSendLatency(const EncodedVideoFrame &frame)
+{
+    if (frame.captureTimeUs() <= 0)
+    {
+        return;
+    }
+
+    // 捕获时刻与这里同属FrameRing::clockUs()，不含网络传输和接收端解码显示
+    const qint64 latencyUs = FrameRing::clockUs() - frame.captureTimeUs();
+    if (!m_sendLatency.inFrame)
+    {
+        m_sendLatency.firstSumUs += latencyUs;
+        m_sendLatency.inFrame = true;
+    }
+    if (!frame.isFrameEnd())
+    {
+        return;
+    }
+
+    m_sendLatency.inFrame = false;
+    m_sendLatency.frameSumUs += latencyUs;
+    m_sendLatency.frameMaxUs = qMax(m_sendLatency.frameMaxUs, latencyUs);
+    if (++m_sendLatency.frames >= 300)
+    {
+        LOG_INFO("Capture-to-send latency over {} frames: first slice avg {:.1f} ms, frame avg {:.1f} ms, max {:.1f} ms",
+                 m_sendLatency.frames, m_sendLatency.firstSumUs / 1e3 / m_sendLatency.frames,
+                 m_sendLatency.frameSumUs / 1e3 / m_sendLatency.frames, m_sendLatency.frameMaxUs / 1e3);
+        m_sendLatency = SendLatencyStats();
+    }
+}
+
+void WebRtcCli::onAudioFrameReady(const MediaBuffer &frameData)
 {
     if (!m_audioTrack || !m_connected)
         return;
@@ -813,7 +997,7 @@ void WebRtcCli::onAudioFrameReady(const rtc::binary &frameData)
         // 发送音频帧
         if (m_audioTrack->isOpen())
         {
-            m_audioTrack->sendFrame(frameData, frameInfo);
+            m_audioTrack->sendFrame(frameData.data(), frameData.size(), frameInfo);
             // 记录日志
             LOG_TRACE("Sent audio frame: {}, timestamp: {}", Convert::formatFileSize(frameData.size()), m_lastTimestamp);
         }
@@ -1037,6 +1221,45 @@ void WebRtcCli::handleMouseEvent(const QJsonObject &object)
     InputUtil::execMouseEvent(button, x, y, mouseData, flags);
     LOG_DEBUG("Handled mouse event: {} at ({}, {})", flags, x, y);
 }
+void WebRtcCli::handleVideoConfig(const QJsonObject &object)
+{
+    int controlMaxWidth = JsonUtil::getInt(object, Constant::KEY_CONTROL_MAX_WIDTH, -1);
+    int controlMaxHeight = JsonUtil::getInt(object, Constant::KEY_CONTROL_MAX_HEIGHT, -1);
+    int fps = JsonUtil::getInt(object, Constant::KEY_FPS, m_fps);
+    int bitrate = JsonUtil::getInt(object, Constant::KEY_BITRATE, 0);
+
+    LOG_INFO("Video config requested - control max display area: {}x{}, fps: {}, bitrate: {}",
+             controlMaxWidth, controlMaxHeight, fps, bitrate);
+
+    // 输入通道回调运行在libdatachannel线程，切回本对象所在线程再操作MediaCapture
+    QMetaObject::invokeMethod(this, [this, controlMaxWidth, controlMaxHeight, fps, bitrate]()
+                              {
+        if (!m_mediaCapture || m_destroying)
+        {
+            return;
+        }
+
+        // 被控端屏幕分辨率也可能已经变化
+        QScreen *screen = QGuiApplication::primaryScreen();
+        if (screen)
+        {
+            m_screen_width = screen->geometry().width();
+            m_screen_height = screen->geometry().height();
+        }
+        calculateOptimalResolution(controlMaxWidth, controlMaxHeight);
+        m_fps = qBound(1, fps, 60);
+        m_mediaCapture->reconfigureVideo(m_encode_width, m_encode_height, m_fps, qMax(0, bitrate)); }, Qt::QueuedConnection);
+}
+
+void WebRtcCli::requestKeyFrame()
+{
+    if (!m_mediaCapture || m_destroying)
+    {
+        return;
+    }
+    m_mediaCapture->requestKeyFrame();
+}
+
 void WebRtcCli::handleKeyboardEvent(const QJsonObject &object)
 {
     int key = JsonUtil::getInt(object, Constant::KEY_KEY, -1);
@@ -28,10 +28,15 @@
 #include <input_util.h>
 #include "constant.h"
 #include "util/json_util.h"
+#include "encoded_frame.h"
+#include "media_buffer.h"
+#include "video_codec.h"
+#include "text_tile_codec.h"
 
 // 前向声明
 class MediaCapture;
 class FilePacketUtil;
+class RtpMarkerGate;
 
 /**
  * @brief The WebRtcCli class 被控端的webrtc对象（main_window需要用到的）
@@ -41,8 +46,12 @@ class WebRtcCli : public QObject
 {
     Q_OBJECT
 public:
+    // controlVideoCodecs为控制端能解码的视频格式（按偏好排序），为空时使用H264
+    // controlTextTiles为控制端支持的无损文字块压缩方式，为空时不发送文字块
     WebRtcCli(const QString &remoteId, int fps, bool isOnlyFile,
-        int controlMaxWidth = 1920, int controlMaxHeight = 1080, QObject *parent = nullptr);
+        int controlMaxWidth = 1920, int controlMaxHeight = 1080,
+        const QStringList &controlVideoCodecs = QStringList(),
+        const QStringList &controlTextTiles = QStringList(), QObject *parent = nullptr);
     ~WebRtcCli();
 
     // 解析来自WebSocket的消息
@@ -63,6 +72,7 @@ private:
     void setupFileChannelCallbacks();
     void setupFileTextChannelCallbacks();
     void setupInputChannelCallbacks();
+    void setupTextTileChannelCallbacks();
 
     // 成员变量
     QString m_remoteId;
@@ -74,18 +84,33 @@ private:
     std::shared_ptr<rtc::DataChannel> m_fileChannel;
     std::shared_ptr<rtc::DataChannel> m_fileTextChannel;
     std::shared_ptr<rtc::DataChannel> m_inputChannel;
+    std::shared_ptr<rtc::DataChannel> m_textTileChannel; // 无损文字块，未协商时为空
     std::shared_ptr<rtc::Track> m_videoTrack;
     std::shared_ptr<rtc::Track> m_audioTrack;
+    std::shared_ptr<RtpMarkerGate> m_videoMarkerGate; // 条带输出时控制RTP marker
     // 连接状态
     bool m_connected;
     bool m_channelsReady;
     bool m_destroying; // 是否正在销毁
 
     int m_fps; // 帧率
+    VideoCodec m_videoCodec; // 与控制端协商的视频格式
+    TextTileCompression m_textTileCompression; // 与控制端协商的文字块压缩方式
     // 媒体相关
     MediaCapture *m_mediaCapture;
     qint64 m_lastTimestamp; // 上次视频帧时间戳
 
+    // 发送端延迟：捕获时刻到一帧第一段/最后一段交给打包器
+    struct SendLatencyStats
+    {
+        bool inFrame = false; // 当前帧已经发出第一段
+        int frames = 0;
+        qint64 firstSumUs = 0;
+        qint64 frameSumUs = 0;
+        qint64 frameMaxUs = 0;
+    };
+    SendLatencyStats m_sendLatency;
+
     // 文件分包工具类
     FilePacketUtil *m_filePacketUtil;
 
@@ -115,8 +140,11 @@ public slots:
     void onWsCliRecvBinaryMsg(const QByteArray &message);
     void onWsCliRecvTextMsg(const QString &message);
 
-    void onVideoFrameReady(const rtc::binary &h264Data, quint64 timestamp_us);
-    void onAudioFrameReady(const rtc::binary &audioData);
+    void onVideoFrameReady(const EncodedVideoFrame &frame);
+    void onAudioFrameReady(const MediaBuffer &audioData);
+    void onTextTilesReady(const QByteArray &message);
+    // 统计从捕获到交给RTP打包器的延迟
+    void recordSendLatency(const EncodedVideoFrame &frame);
 
     void handleFileReceived(bool status, const QString &tempPath);
 
@@ -142,6 +170,9 @@ private:
     // 输入处理
     void handleMouseEvent(const QJsonObject &object);
     void handleKeyboardEvent(const QJsonObject &object);
+    void handleVideoConfig(const QJsonObject &object);
+    // 让编码器尽快输出一个IDR帧（须在本对象线程调用）
+    void requestKeyFrame();
 
     // 通道消息发送
     void sendFileChannelMessage(const QJsonObject &message);
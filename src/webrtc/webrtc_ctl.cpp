@@ -1,8 +1,10 @@
 #include "webrtc_ctl.h"
 #include "constant.h"
 #include "logger_manager.h"
-#include "h264_decoder.h"
+#include "decode_worker.h"
+#include "video_rtp.h"
 #include "media_player.h"
+#include "text_tile_codec.h"
 #include "util/json_util.h"
 #include "util/file_packet_util.h"
 #include <QTimer>
@@ -26,7 +28,12 @@ WebRtcCtl::WebRtcCtl(const QString &remoteId, const QString &remotePwdMd5,
       m_remotePwdMd5(remotePwdMd5),
       m_connected(false),
       m_isOnlyFile(isOnlyFile),
-      m_adaptiveResolution(adaptiveResolution)
+      m_adaptiveResolution(adaptiveResolution),
+      m_decodeWorker(nullptr),
+      m_decodeThread(nullptr),
+      m_videoCodec(VideoCodec::H264),
+      m_textTileOverlay(std::make_unique<TextTileOverlay>()),
+      m_keyFrameRequestsPending(0)
 {
     // 初始化ICE服务器配置
     m_host = ConfigUtil->ice_host.toStdString();
@@ -58,9 +65,29 @@ void WebRtcCtl::init()
 
     if (!m_isOnlyFile)
     {
-        // 初始化H264解码器（启用硬件加速）
-        m_h264Decoder = std::make_unique<H264Decoder>();
-        m_h264Decoder->initialize();
+        // 初始化视频解码器（启用硬件加速），格式以被控端Offer中选定的为准
+        QList<VideoCodec> decodable = VideoCodecs::decodable();
+        m_videoCodec = decodable.isEmpty() ? VideoCodec::H264 : decodable.first();
+        // 解码在独立线程进行，libdatachannel的回调线程只负责入队
+        m_decodeThread = new QThread();
+        m_decodeWorker = new DecodeWorker();
+        // 无损文字块直接画在解码器图像环中的图像上
+        m_decodeWorker->setOverlay([this](QImage &frame) { m_textTileOverlay->composite(frame); });
+        m_decodeWorker->moveToThread(m_decodeThread);
+        connect(m_decodeThread, &QThread::finished, m_decodeWorker, &QObject::deleteLater);
+        connect(m_decodeWorker, &DecodeWorker::frameDecoded, this, &WebRtcCtl::videoFrameDecoded,
+                Qt::DirectConnection);
+        // 直接在解码线程发出PLI
+        connect(m_decodeWorker, &DecodeWorker::keyFrameRequired, this, &WebRtcCtl::requestKeyFrame,
+                Qt::DirectConnection);
+        connect(
+            m_decodeWorker, &DecodeWorker::decoderRecovered, this, [this]() { m_keyFrameRequestsPending = 0; },
+            Qt::DirectConnection);
+        m_decodeThread->start();
+        VideoCodec codec = m_videoCodec;
+        QMetaObject::invokeMethod(
+            m_decodeWorker, [worker = m_decodeWorker, codec]() { worker->initializeDecoder(codec); },
+            Qt::QueuedConnection);
         // 初始化媒体播放器
         m_mediaPlayer = std::make_unique<MediaPlayer>();
         // m_mediaPlayer->startPlayback(); // 启动音频播放
@@ -84,20 +111,28 @@ void WebRtcCtl::init()
                                               .add(Constant::KEY_SENDER, ConfigUtil->local_id)
                                               .add(Constant::KEY_IS_ONLY_FILE, m_isOnlyFile)
                                               .add(Constant::KEY_FPS, ConfigUtil->fps);
+    if (!m_isOnlyFile)
+    {
+        // 本机能解码的视频格式，被控端从中选第一个自己能编码的
+        connectMsgBuilder.add(Constant::KEY_VIDEO_CODECS,
+                              QJsonArray::fromStringList(VideoCodecs::names(VideoCodecs::decodable())));
+        // 本机能解压的无损文字块格式，被控端也开启时会另建一个数据通道发送
+        if (ConfigUtil->losslessTextTiles)
+        {
+            connectMsgBuilder.add(Constant::KEY_TEXT_TILES,
+                                  QJsonArray::fromStringList(TextTileCodec::supportedCompressions()));
+        }
+    }
 
     // 如果启用了自适应分辨率，则包含控制端可显示的最大区域信息
     if (m_adaptiveResolution)
     {
-        QScreen *screen = QApplication::primaryScreen();
-        QRect screenGeometry = screen ? screen->availableGeometry() : QRect(0, 0, 1920, 1080);
-
-        // 计算控制端窗口能够显示的最大内容区域（减去标题栏等UI开销）
-        int titleBarHeight = 30;                                         // 估算标题栏高度
-        int maxContentWidth = screenGeometry.width() - 20;               // 减去边距
-        int maxContentHeight = screenGeometry.height() - titleBarHeight; // 减去各种UI开销
+        QSize maxArea = maxDisplayArea(QApplication::primaryScreen());
+        int maxContentWidth = maxArea.width();
+        int maxContentHeight = maxArea.height();
 
-        connectMsgBuilder = connectMsgBuilder.add("control_max_width", maxContentWidth)
-                                .add("control_max_height", maxContentHeight);
+        connectMsgBuilder = connectMsgBuilder.add(Constant::KEY_CONTROL_MAX_WIDTH, maxContentWidth)
+                                .add(Constant::KEY_CONTROL_MAX_HEIGHT, maxContentHeight);
 
         LOG_INFO("Sending CONNECT message with adaptive resolution - max display area: {}x{}",
                  maxContentWidth, maxContentHeight);
@@ -112,6 +147,76 @@ void WebRtcCtl::init()
     emit sendWsCliTextMsg(message);
 }
 
+QSize WebRtcCtl::maxDisplayArea(QScreen *screen)
+{
+    QRect screenGeometry = screen ? screen->availableGeometry() : QRect(0, 0, 1920, 1080);
+
+    // 计算控制端窗口能够显示的最大内容区域（减去标题栏等UI开销）
+    int titleBarHeight = 30;                                         // 估算标题栏高度
+    int maxContentWidth = screenGeometry.width() - 20;               // 减去边距
+    int maxContentHeight = screenGeometry.height() - titleBarHeight; // 减去各种UI开销
+    return QSize(maxContentWidth, maxContentHeight);
+}
+
+void WebRtcCtl::sendVideoConfig(int maxWidth, int maxHeight, int fps, int bitrate)
+{
+    // 通过输入通道通知被控端调整编码参数，被控端在会话中直接重新配置编码器
+    JsonObjectBuilder builder = JsonUtil::createObject()
+                                    .add(Constant::KEY_MSGTYPE, Constant::TYPE_VIDEO_CONFIG)
+                                    .add(Constant::KEY_SENDER, ConfigUtil->local_id)
+                                    .add(Constant::KEY_RECEIVER, m_remoteId)
+                                    .add(Constant::KEY_RECEIVER_PWD, m_remotePwdMd5)
+                                    .add(Constant::KEY_FPS, fps)
+                                    .add(Constant::KEY_BITRATE, bitrate);
+    if (m_adaptiveResolution && maxWidth > 0 && maxHeight > 0)
+    {
+        builder = builder.add(Constant::KEY_CONTROL_MAX_WIDTH, maxWidth)
+                      .add(Constant::KEY_CONTROL_MAX_HEIGHT, maxHeight);
+    }
+
+    LOG_INFO("Sending video config - max display area: {}x{}, fps: {}, bitrate: {}", maxWidth, maxHeight, fps,
+             bitrate);
+    QByteArray msg = JsonUtil::toCompactBytes(builder.build());
+    inputChannelSendMsg(rtc::message_variant(msg.toStdString()));
+}
+
+void WebRtcCtl::requestKeyFrame()
+{
+    // 解码器恢复前会连续报错，限制请求频率，避免发送端连续产生IDR
+    if (m_keyFrameRequestTimer.isValid() && m_keyFrameRequestTimer.elapsed() < kKeyFrameRequestIntervalMs)
+    {
+        return;
+    }
+    m_keyFrameRequestTimer.start();
+
+    bool pliSent = false;
+    if (m_videoTrack && m_videoTrack->isOpen())
+    {
+        try
+        {
+            pliSent = m_videoTrack->requestKeyframe();
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Failed to send PLI: {}", e.what());
+        }
+    }
+
+    // PLI发送失败，或上一次请求后仍未恢复（RTCP可能被丢弃），再通过输入通道请求一次
+    int pending = m_keyFrameRequestsPending++;
+    LOG_INFO("Requesting keyframe - PLI sent: {}, pending requests: {}", pliSent, pending);
+    if (!pliSent || pending > 0)
+    {
+        QJsonObject request = JsonUtil::createObject()
+                                  .add(Constant::KEY_MSGTYPE, Constant::TYPE_KEYFRAME_REQUEST)
+                                  .add(Constant::KEY_SENDER, ConfigUtil->local_id)
+                                  .add(Constant::KEY_RECEIVER, m_remoteId)
+                                  .add(Constant::KEY_RECEIVER_PWD, m_remotePwdMd5)
+                                  .build();
+        inputChannelSendMsg(rtc::message_variant(JsonUtil::toCompactString(request).toStdString()));
+    }
+}
+
 void WebRtcCtl::initPeerConnection()
 {
     try
@@ -151,18 +256,18 @@ void WebRtcCtl::createTracks()
     {
         // 创建视频接收轨道 - 设置RTP解包器
         LOG_INFO("Creating video receive track");
-        std::string video_name = Constant::TYPE_VIDEO.toStdString();
-        rtc::Description::Video videoDesc(video_name); // 使用固定流名称匹配发送端
-        videoDesc.addH264Codec(96);                    // 确保payload type匹配
-        uint32_t videoSSRC = 1;
-        std::string msid = Constant::TYPE_VIDEO_MSID.toStdString();
-        videoDesc.addSSRC(videoSSRC, video_name, msid, video_name);
-        videoDesc.setDirection(rtc::Description::Direction::RecvOnly);
-        m_videoTrack = m_peerConnection->addTrack(videoDesc);
-
-        // 为视频轨道设置H264 RTP解包器 - 这是必需的！
-        auto h264Depacketizer = std::make_shared<rtc::H264RtpDepacketizer>();
-        m_videoTrack->setMediaHandler(h264Depacketizer);
+        QList<VideoCodec> decodable = VideoCodecs::decodable();
+        if (decodable.isEmpty())
+        {
+            decodable << VideoCodec::H264;
+        }
+        m_videoTrack = m_peerConnection->addTrack(videoDescription(decodable));
+
+        // 为视频轨道设置RTP解包器 - 这是必需的！
+        auto depacketizer = VideoRtp::createDepacketizer(m_videoCodec);
+        // RTCP接收会话：发送RR并支持通过requestKeyframe()发出PLI
+        depacketizer->addToChain(std::make_shared<rtc::RtcpReceivingSession>());
+        m_videoTrack->setMediaHandler(depacketizer);
 
         // 创建音频接收轨道
         LOG_INFO("Creating audio receive track");
@@ -180,6 +285,55 @@ void WebRtcCtl::createTracks()
     }
 }
 
+rtc::Description::Video WebRtcCtl::videoDescription(const QList<VideoCodec> &codecs) const
+{
+    std::string video_name = Constant::TYPE_VIDEO.toStdString();
+    rtc::Description::Video videoDesc(video_name); // 使用固定流名称匹配发送端
+    for (VideoCodec codec : codecs)
+    {
+        VideoRtp::addCodec(videoDesc, codec); // payload type与发送端一致
+    }
+    uint32_t videoSSRC = 1;
+    std::string msid = Constant::TYPE_VIDEO_MSID.toStdString();
+    videoDesc.addSSRC(videoSSRC, video_name, msid, video_name);
+    videoDesc.setDirection(rtc::Description::Direction::RecvOnly);
+    return videoDesc;
+}
+
+void WebRtcCtl::applyOfferedVideoCodec(const rtc::Description &offer)
+{
+    if (!m_videoTrack)
+    {
+        return;
+    }
+
+    // 旧版本被控端只会发H264
+    VideoCodec codec = VideoCodec::H264;
+    if (!VideoRtp::offeredCodec(offer, &codec))
+    {
+        LOG_WARN("No known video codec in offer, assuming H264");
+    }
+    LOG_INFO("Remote selected video codec: {}", VideoCodecs::name(codec));
+
+    // Answer直接使用本地轨道的描述，只保留选定的格式
+    m_videoTrack->setDescription(videoDescription({codec}));
+    if (codec == m_videoCodec)
+    {
+        return;
+    }
+
+    auto depacketizer = VideoRtp::createDepacketizer(codec);
+    depacketizer->addToChain(std::make_shared<rtc::RtcpReceivingSession>());
+    m_videoTrack->setMediaHandler(depacketizer);
+    m_videoCodec = codec;
+    if (m_decodeWorker)
+    {
+        QMetaObject::invokeMethod(
+            m_decodeWorker, [worker = m_decodeWorker, codec]() { worker->initializeDecoder(codec); },
+            Qt::QueuedConnection);
+    }
+}
+
 void WebRtcCtl::setupCallbacks()
 {
     if (!m_peerConnection)
@@ -301,14 +455,14 @@ void WebRtcCtl::setupCallbacks()
                                            LOG_DEBUG("Sent local candidate to cli: {}", message);
                                        });
 
-    // 设置轨道回调 - 使用onMessage接收解包后的H264数据
+    // 设置轨道回调 - 使用onFrame接收解包后的一帧视频数据
     if (m_videoTrack)
     {
         LOG_INFO("Setting up video track message callback");
         m_videoTrack->onFrame([this](rtc::binary data, rtc::FrameInfo info)
                               {
             LOG_DEBUG("Video frame received: {}, timestamp: {}", Convert::formatFileSize(data.size()), info.timestamp);
-            processVideoFrame(data, info); });
+            processVideoFrame(std::move(data), info); });
         LOG_INFO("Video track message callback set");
     }
 
@@ -318,7 +472,7 @@ void WebRtcCtl::setupCallbacks()
         m_audioTrack->onFrame([this](rtc::binary data, rtc::FrameInfo info)
                               {
             LOG_DEBUG("Audio frame received: {}, ts: {}", Convert::formatFileSize(data.size()), info.timestamp);
-            processAudioFrame(data, info); });
+            processAudioFrame(std::move(data), info); });
         LOG_INFO("Audio track message callback set");
     }
 
@@ -343,6 +497,9 @@ void WebRtcCtl::setupCallbacks()
         } else if (channelLabel == Constant::TYPE_INPUT) {
             m_inputChannel = channel;
             setupInputChannelCallbacks();
+        } else if (channelLabel == Constant::TYPE_TEXT_TILES) {
+            m_textTileChannel = channel;
+            setupTextTileChannelCallbacks();
         } });
 }
 
@@ -454,12 +611,52 @@ void WebRtcCtl::setupInputChannelCallbacks()
                               {
         if (std::holds_alternative<std::string>(message)) {
             // 输入通道现在只处理输入事件相关的消息
+            QJsonObject object = JsonUtil::safeParseObject(QByteArray::fromStdString(std::get<std::string>(message)));
+            if (JsonUtil::getString(object, Constant::KEY_MSGTYPE) == Constant::TYPE_KEYFRAME_RESPONSE) {
+                LOG_DEBUG("Keyframe request acknowledged by remote");
+                return;
+            }
             LOG_DEBUG("Input channel message received (control side)");
         } else {
             LOG_DEBUG("Input channel binary message received (control side)"); 
         } });
 }
 
+void WebRtcCtl::setupTextTileChannelCallbacks()
+{
+    if (!m_textTileChannel)
+        return;
+
+    QString channelLabel = QString::fromStdString(m_textTileChannel->label());
+
+    m_textTileChannel->onOpen([this, channelLabel]()
+                              { LOG_INFO("Text tile channel opened: {}", channelLabel); });
+
+    // 通道关闭后不会再收到清除消息，覆盖的块不能留在画面上
+    m_textTileChannel->onClosed([this, channelLabel]()
+                                {
+        LOG_INFO("Text tile channel closed: {}", channelLabel);
+        m_textTileOverlay->reset(); });
+
+    m_textTileChannel->onError([this, channelLabel](const std::string &error)
+                               { LOG_ERROR("Text tile channel error: {}", error); });
+
+    m_textTileChannel->onMessage([this, channelLabel](const rtc::message_variant &message)
+                                 {
+        if (std::holds_alternative<rtc::binary>(message)) {
+            const rtc::binary &binaryData = std::get<rtc::binary>(message);
+            const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(binaryData.data()),
+                                                            static_cast<int>(binaryData.size()));
+            if (!m_textTileOverlay->apply(data)) {
+                // 之后的增量都基于丢失的状态，清空后只显示H264画面
+                LOG_WARN("Invalid text tile message: {}", Convert::formatFileSize(binaryData.size()));
+                m_textTileOverlay->reset();
+            }
+        } else {
+            LOG_WARN("Text tile channel received text message, ignoring");
+        } });
+}
+
 void WebRtcCtl::parseWsMsg(const QJsonObject &object)
 {
     // 检查必要字段
@@ -485,6 +682,10 @@ void WebRtcCtl::parseWsMsg(const QJsonObject &object)
             {
                 LOG_INFO("Setting remote description: {}", type);
                 rtc::Description desc(data.toStdString(), type.toStdString());
+                if (type == Constant::TYPE_OFFER)
+                {
+                    applyOfferedVideoCodec(desc);
+                }
                 m_peerConnection->setRemoteDescription(desc);
                 m_peerConnection->createAnswer();
                 LOG_INFO("Remote description set successfully");
@@ -803,6 +1004,14 @@ void WebRtcCtl::destroy()
         m_fileTextChannel = nullptr;
     }
 
+    if (m_textTileChannel)
+    {
+        LOG_DEBUG("Cleaning up text tile channel");
+        m_textTileChannel->resetCallbacks();
+        m_textTileChannel->close();
+        m_textTileChannel = nullptr;
+    }
+
     // 清理轨道
     if (m_audioTrack)
     {
@@ -820,6 +1029,21 @@ void WebRtcCtl::destroy()
         m_videoTrack = nullptr;
     }
 
+    // 轨道关闭后不再有帧入队，停止解码线程（工作者随线程结束释放）
+    if (m_decodeThread)
+    {
+        LOG_DEBUG("Stopping decode thread");
+        m_decodeThread->quit();
+        if (!m_decodeThread->wait(3000))
+        {
+            m_decodeThread->terminate();
+            m_decodeThread->wait();
+        }
+        delete m_decodeThread;
+        m_decodeThread = nullptr;
+        m_decodeWorker = nullptr;
+    }
+
     // 清理媒体播放器
     if (m_mediaPlayer)
     {
@@ -841,7 +1065,7 @@ void WebRtcCtl::destroy()
 }
 
 // 处理接收到的音频数据
-void WebRtcCtl::processAudioFrame(const rtc::binary &audioData, const rtc::FrameInfo &frameInfo)
+void WebRtcCtl::processAudioFrame(rtc::binary &&audioData, const rtc::FrameInfo &frameInfo)
 {
     LOG_DEBUG("Received audio frame: {}", Convert::formatFileSize(audioData.size()));
 
@@ -856,7 +1080,8 @@ void WebRtcCtl::processAudioFrame(const rtc::binary &audioData, const rtc::Frame
         // 将音频数据发送给媒体播放器
         if (m_mediaPlayer)
         {
-            m_mediaPlayer->playAudioData(audioData);
+            // 接管解包后的数据，播放线程共享同一块缓冲
+            m_mediaPlayer->playAudioData(MediaBuffer(std::move(audioData)));
         }
         else
         {
@@ -870,7 +1095,7 @@ void WebRtcCtl::processAudioFrame(const rtc::binary &audioData, const rtc::Frame
 }
 
 // 处理接收到的视频数据
-void WebRtcCtl::processVideoFrame(const rtc::binary &data, const rtc::FrameInfo &frameInfo)
+void WebRtcCtl::processVideoFrame(rtc::binary &&data, const rtc::FrameInfo &frameInfo)
 {
     LOG_DEBUG("Received video frame: {}", Convert::formatFileSize(data.size()));
 
@@ -881,19 +1106,16 @@ void WebRtcCtl::processVideoFrame(const rtc::binary &data, const rtc::FrameInfo
 
     try
     {
-        // 解码H264数据为QImage
-        if (m_h264Decoder)
+        // 只入队，解码和转换在解码线程进行
+        if (m_decodeWorker)
         {
-            QImage decodedFrame = m_h264Decoder->decodeFrame(data);
-            if (!decodedFrame.isNull())
-            {
-                emit videoFrameDecoded(decodedFrame);
-                LOG_DEBUG("Successfully decoded video frame: {}x{}", decodedFrame.width(), decodedFrame.height());
-            }
+            const bool keyFrame = VideoRtp::isKeyFrame(m_videoCodec, data);
+            const bool recoveryPoint = !keyFrame && VideoRtp::isRecoveryPoint(m_videoCodec, data);
+            m_decodeWorker->enqueue(std::move(data), keyFrame, recoveryPoint);
         }
         else
         {
-            LOG_WARN("H264 decoder not initialized");
+            LOG_WARN("Video decoder not initialized");
         }
     }
     catch (const std::exception &e)
@@ -20,17 +20,20 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QUuid>
+#include <QElapsedTimer>
 #include <memory>
 #include <rtc/rtc.hpp>
 #include <config_util.h>
 #include <input_util.h>
 #include "util/json_util.h"
 #include "constant.h"
+#include "video_codec.h"
 
 // 前向声明
-class H264Decoder;
+class DecodeWorker;
 class MediaPlayer;
 class FilePacketUtil;
+class TextTileOverlay;
 
 /**
  * @brief The WebRtcCtl class 控制端的webrtc对象（control_window需要用到的）
@@ -50,14 +53,22 @@ public:
     // 初始化WebRTC连接
     void init();
 
+    // 控制端窗口能够显示视频的最大区域（自适应分辨率时发送给被控端）
+    static QSize maxDisplayArea(QScreen *screen);
+
 private:
     // WebRTC核心功能
     void initPeerConnection();
     void createTracks();
+    // 接收视频轨道的媒体描述，codecs为可接受的格式（按偏好排序）
+    rtc::Description::Video videoDescription(const QList<VideoCodec> &codecs) const;
+    // 收到Offer时按被控端选定的格式收窄视频轨道，并切换解包器和解码器
+    void applyOfferedVideoCodec(const rtc::Description &offer);
     void setupCallbacks();
     void setupFileChannelCallbacks();
     void setupFileTextChannelCallbacks();
     void setupInputChannelCallbacks();
+    void setupTextTileChannelCallbacks();
     void destroy();
 
     // 文件上传相关
@@ -65,8 +76,8 @@ private:
     void uploadDirectory(const QString &ctlPath, const QString &cliPath);
 
     // 媒体数据处理
-    void processVideoFrame(const rtc::binary &videoData, const rtc::FrameInfo &frameInfo);
-    void processAudioFrame(const rtc::binary &audioData, const rtc::FrameInfo &frameInfo);
+    void processVideoFrame(rtc::binary &&videoData, const rtc::FrameInfo &frameInfo);
+    void processAudioFrame(rtc::binary &&audioData, const rtc::FrameInfo &frameInfo);
 
     // 成员变量
     QString m_remoteId;
@@ -79,6 +90,7 @@ private:
     std::shared_ptr<rtc::DataChannel> m_fileChannel;
     std::shared_ptr<rtc::DataChannel> m_fileTextChannel;
     std::shared_ptr<rtc::DataChannel> m_inputChannel;
+    std::shared_ptr<rtc::DataChannel> m_textTileChannel; // 被控端协商了无损文字块时才有
     std::shared_ptr<rtc::Track> m_videoTrack;
     std::shared_ptr<rtc::Track> m_audioTrack;
 
@@ -96,13 +108,21 @@ private:
     std::string m_password;
 
     // 媒体处理
-    std::unique_ptr<H264Decoder> m_h264Decoder;
+    DecodeWorker *m_decodeWorker; // 在m_decodeThread中解码，网络线程只入队
+    QThread *m_decodeThread;
+    VideoCodec m_videoCodec; // 当前解码器和解包器对应的格式
     std::unique_ptr<MediaPlayer> m_mediaPlayer;
+    std::unique_ptr<TextTileOverlay> m_textTileOverlay; // 合成到解码画面上的无损文字块
 
     // H264帧重组
     rtc::binary m_h264FrameBuffer; // 累积NAL单元的缓冲区
     QMutex m_h264BufferMutex;      // 保护缓冲区的互斥锁
 
+    // 关键帧请求（只在解码线程访问）
+    static constexpr int kKeyFrameRequestIntervalMs = 500;
+    QElapsedTimer m_keyFrameRequestTimer;
+    int m_keyFrameRequestsPending; // 已发出但解码器尚未恢复的请求数
+
 signals:
     // WebSocket消息发送
     void sendWsCliBinaryMsg(const QByteArray &message);
@@ -114,7 +134,7 @@ signals:
     void recvUploadFileRes(bool status, const QString &filePath);
 
     // 媒体相关
-    void videoFrameDecoded(const QImage &frame);
+    void videoFrameDecoded(const QImage &frame); // 在解码线程发出
 
 public slots:
     // WebSocket消息处理
@@ -126,6 +146,10 @@ public slots:
     void fileChannelSendMsg(const rtc::message_variant &data);
     void fileTextChannelSendMsg(const rtc::message_variant &data);
     void uploadFile2CLI(const QString &ctlPath, const QString &cliPath);
+    // 会话中请求被控端调整视频参数，bitrate为0时由被控端自动估算
+    void sendVideoConfig(int maxWidth, int maxHeight, int fps, int bitrate);
+    // 请求被控端尽快发送关键帧：优先RTCP PLI，失败时走输入通道
+    void requestKeyFrame();
 };
 
 #endif // WEBRTC_CTL_H